@@ -62,6 +62,23 @@ power_test (lua_State *L);
 static int
 crystals_test (lua_State *L);
 
+/**
+ * Start a field object playing an animation clip.
+ * Takes the object name and the clip name; without the clip name the
+ * object stops animating.
+ */
+
+static int
+animate_object_binding (lua_State *L);
+
+/**
+ * Set how many raindrops fall on the field every frame; 0 stops the
+ * rain.
+ */
+
+static int
+set_rain_binding (lua_State *L);
+
 
 /* -- INTERNAL DEFINITIONS -- */
 
@@ -75,6 +92,9 @@ init_bindings (void)
   lua_setglobal (g_lua, "crystals_test"); /* make the c function visible for lua */
   
   lua_register (g_lua, "power_test", power_test); /* optional way */
+
+  lua_register (g_lua, "animate_object", animate_object_binding);
+  lua_register (g_lua, "set_rain", set_rain_binding);
 }
 
 void
@@ -152,6 +172,56 @@ crystals_test (lua_State *L)
   return L_SUCCESS;
 }
 
+static int
+animate_object_binding (lua_State *L)
+{
+  const char *clip_name = NULL;
+
+  if (lua_gettop (L) == 1)
+    {
+      if (lua_parameter_check (L, "animate_object", "s") == FAILURE)
+        return L_FAILURE;
+    }
+  else
+    {
+      if (lua_parameter_check (L, "animate_object", "ss") == FAILURE)
+        return L_FAILURE;
+
+      clip_name = lua_tostring (L, 2);
+    }
+
+  /* animate_object asserts the object exists, which a script can't
+     be trusted to get right. */
+  if (get_object (lua_tostring (L, 1)) == NULL)
+    {
+      error ("LUA: animate_object: No object named %s.",
+        lua_tostring (L, 1));
+      return L_FAILURE;
+    }
+
+  animate_object (lua_tostring (L, 1), clip_name);
+  return L_SUCCESS;
+}
+
+static int
+set_rain_binding (lua_State *L)
+{
+  lua_Integer rate;
+
+  if (lua_parameter_check (L, "set_rain", "d") == FAILURE)
+    return L_FAILURE;
+
+  rate = lua_tointeger (L, 1);
+  if (rate < 0)
+    {
+      error ("LUA: set_rain: Rate has to be at least 0.");
+      return L_FAILURE;
+    }
+
+  set_field_rain ((uint32_t) rate);
+  return L_SUCCESS;
+}
+
 bool_t
 lua_parameter_check (lua_State *L, const char *func_name, const char sig[])
 {
@@ -64,10 +64,29 @@ crystals_init (void);
 static PyObject*
 crystals_test (PyObject *self, PyObject *args);
 
+/** 
+ * Start a field object playing an animation clip, or stop it if no
+ * clip name is given.
+ */
+
+static PyObject*
+crystals_animate_object (PyObject *self, PyObject *args);
+
+/** 
+ * Set how many raindrops fall on the field every frame.
+ */
+
+static PyObject*
+crystals_set_rain (PyObject *self, PyObject *args);
+
 static PyMethodDef
 crystals_meth[] = {
   /* name, C func,        flags,        docstring */
   {"test", crystals_test, METH_VARARGS, "Test the Crystal Module."},
+  {"animate_object", crystals_animate_object, METH_VARARGS,
+   "Play an animation clip on a field object."},
+  {"set_rain", crystals_set_rain, METH_VARARGS,
+   "Set the raindrops falling on the field each frame."},
   {NULL, NULL, 0, NULL}
 };
 
@@ -141,4 +160,40 @@ crystals_test (PyObject *self, PyObject *args)
   return Py_None;
 }
 
+static PyObject*
+crystals_animate_object (PyObject *self, PyObject *args)
+{
+  char *object_name;
+  char *clip_name = NULL;
+
+  (void) self; /* to prevent unused error */
+
+  if (!PyArg_ParseTuple(args, "s|z:animate_object", &object_name,
+                        &clip_name))
+    return NULL;
+
+  if (get_object (object_name) == NULL)
+    {
+      PyErr_Format (PyExc_KeyError, "No object named %s.", object_name);
+      return NULL;
+    }
+
+  animate_object (object_name, clip_name);
+  Py_RETURN_NONE;
+}
+
+static PyObject*
+crystals_set_rain (PyObject *self, PyObject *args)
+{
+  unsigned int rate;
+
+  (void) self; /* to prevent unused error */
+
+  if (!PyArg_ParseTuple(args, "I:set_rain", &rate))
+    return NULL;
+
+  set_field_rain ((uint32_t) rate);
+  Py_RETURN_NONE;
+}
+
 /* vim: set et st=2 sw=2 softtabstop=2: */
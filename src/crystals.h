@@ -63,6 +63,7 @@
 #include "main.h"
 #include "module.h"
 #include "optionparser.h"
+#include "pacing.h"
 #include "state.h"
 #include "util.h"
 #include "timer.h"
@@ -71,13 +72,21 @@
 
 #include "map/map.h"
 #include "map/mapview.h"
+#include "map/tileset.h"
+#include "map/mapcache.h"
+#include "map/parallax.h"
+#include "map/minimap.h"
+#include "map/lightmap.h"
 #include "map/mapload.h"
 #include "map/maprender.h"
 
 #include "field/field.h"
+#include "field/atlas.h"
+#include "field/animation.h"
 #include "field/object-image.h"
 #include "field/object.h"
 #include "field/objectset.h"
 #include "field/object-api.h"
+#include "field/particle.h"
 
 #endif /* not _CRYSTALS_H */
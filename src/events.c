@@ -97,7 +97,11 @@ process_events (uint32_t delta)
 
   if (total_useconds >= USECONDS_PER_FRAME)
     {
+      /* The render thread may be presenting to the same window. */
+      lock_window ();
       (*g_modules.event.process_events_internal) ();
+      unlock_window ();
+
       total_useconds = 0;
     }
 }
@@ -0,0 +1,242 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/field/animation.c
+ * @author  agent
+ * @brief   Object animation clips.
+ */
+
+#include "../crystals.h"
+
+
+/* -- STATIC GLOBAL VARIABLES -- */
+
+static GPtrArray *sg_clips;      /**< Clips, as animation_clip_t, at
+                                    index (ID - 1). */
+static GHashTable *sg_clip_ids;  /**< Clip IDs, keyed by name. */
+
+
+/* -- STATIC DECLARATIONS -- */
+
+/**
+ * Frees an animation clip.
+ *
+ * @param clip  Pointer to the clip to free.
+ */
+static void free_animation_clip (gpointer clip);
+
+
+/* -- DEFINITIONS -- */
+
+/* Initialises the animation clip table. */
+void
+init_animations (void)
+{
+  sg_clips = g_ptr_array_new_with_free_func (free_animation_clip);
+  sg_clip_ids = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+
+/* Defines a new, empty animation clip. */
+clip_id_t
+define_animation_clip (const char name[],
+                       const char filename[],
+                       bool looping)
+{
+  animation_clip_t *clip;
+  clip_id_t id;
+
+  g_assert (sg_clips != NULL);
+  g_assert (name != NULL && filename != NULL);
+
+  if (g_hash_table_lookup (sg_clip_ids, name) != NULL)
+    {
+      error ("ANIMATION - define_animation_clip - Clip %s already exists.",
+             name);
+      return NULL_CLIP;
+    }
+
+  g_assert (sg_clips->len < UINT16_MAX);
+
+  clip = xcalloc (1, sizeof (animation_clip_t));
+  clip->name = g_strdup (name);
+  clip->filename = g_strdup (filename);
+  clip->region.image = NULL_IMAGE;
+  clip->looping = looping;
+
+  g_ptr_array_add (sg_clips, clip);
+  id = (clip_id_t) sg_clips->len;
+
+  /* The name is owned by the clip, and lives as long as the entry. */
+  g_hash_table_insert (sg_clip_ids, clip->name, GUINT_TO_POINTER (id));
+
+  return id;
+}
+
+
+/* Adds a frame to the end of an animation clip. */
+void
+add_animation_frame (clip_id_t clip,
+                     int16_t image_x,
+                     int16_t image_y,
+                     uint16_t width,
+                     uint16_t height,
+                     uint32_t duration)
+{
+  animation_clip_t *clipp = get_animation_clip (clip);
+  animation_frame_t *frame;
+
+  g_assert (duration > 0);
+
+  clipp->frames = realloc (clipp->frames,
+                           ((clipp->num_frames + 1)
+                            * sizeof (animation_frame_t)));
+  g_assert (clipp->frames != NULL);
+
+  frame = &(clipp->frames[clipp->num_frames]);
+  frame->image_x = image_x;
+  frame->image_y = image_y;
+  frame->width = width;
+  frame->height = height;
+  frame->duration = duration;
+
+  clipp->num_frames += 1;
+  clipp->total_duration += duration;
+}
+
+
+/* Looks up an animation clip's ID by name. */
+clip_id_t
+get_animation_clip_id (const char name[])
+{
+  g_assert (sg_clip_ids != NULL && name != NULL);
+
+  return (clip_id_t) GPOINTER_TO_UINT (g_hash_table_lookup (sg_clip_ids,
+                                                            name));
+}
+
+
+/* Gets an animation clip. */
+animation_clip_t *
+get_animation_clip (clip_id_t clip)
+{
+  g_assert (sg_clips != NULL);
+  g_assert (clip != NULL_CLIP && clip <= sg_clips->len);
+
+  return g_ptr_array_index (sg_clips, clip - 1);
+}
+
+
+/* Advances a position in an animation clip. */
+bool
+advance_animation (clip_id_t clip,
+                   uint16_t *frame,
+                   uint32_t *cursor,
+                   uint32_t delta)
+{
+  animation_clip_t *clipp = get_animation_clip (clip);
+  uint16_t old_frame = *frame;
+
+  g_assert (frame != NULL && cursor != NULL);
+
+  if (clipp->num_frames <= 1)
+    return false;
+
+  /* Skip whole runs of a looping clip rather than stepping through
+     them. */
+  if (clipp->looping)
+    delta %= clipp->total_duration;
+
+  *cursor += delta;
+
+  while (*cursor >= clipp->frames[*frame].duration)
+    {
+      if (*frame + 1 == clipp->num_frames)
+        {
+          if (!clipp->looping)
+            {
+              /* Stay on the last frame. */
+              *cursor = clipp->frames[*frame].duration - 1;
+              break;
+            }
+
+          *cursor -= clipp->frames[*frame].duration;
+          *frame = 0;
+        }
+      else
+        {
+          *cursor -= clipp->frames[*frame].duration;
+          *frame += 1;
+        }
+    }
+
+  return (*frame != old_frame);
+}
+
+
+/* Removes every animation clip. */
+void
+cleanup_animations (void)
+{
+  if (sg_clip_ids != NULL)
+    {
+      g_hash_table_destroy (sg_clip_ids);
+      sg_clip_ids = NULL;
+    }
+
+  if (sg_clips != NULL)
+    {
+      g_ptr_array_free (sg_clips, TRUE);
+      sg_clips = NULL;
+    }
+}
+
+
+/* -- STATIC DEFINITIONS -- */
+
+/* Frees an animation clip. */
+static void
+free_animation_clip (gpointer clip)
+{
+  animation_clip_t *clipc = clip;
+
+  g_free (clipc->name);
+  g_free (clipc->filename);
+  free (clipc->frames);
+  free (clipc);
+}
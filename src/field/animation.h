@@ -0,0 +1,195 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/field/animation.h
+ * @author  agent
+ * @brief   Prototypes and declarations for object animation clips.
+ *
+ * An animation clip is a sequence of frames cut from one image, each
+ * shown for its own length of time.  Clips are defined once, in a
+ * table shared by all objects, and referred to by ID.  An animated
+ * object only keeps its clip ID, its current frame and how long it
+ * has been showing it, and is redrawn only when the frame changes.
+ */
+
+#ifndef _ANIMATION_H
+#define _ANIMATION_H
+
+
+/* -- TYPEDEFS -- */
+
+typedef uint16_t clip_id_t;  /**< Type for animation clip IDs. */
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  NULL_CLIP = 0  /**< The clip ID reserved as a null value. */
+};
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * One frame of an animation clip.
+ */
+typedef struct animation_frame
+{
+  int16_t image_x;    /**< X co-ordinate of the left edge of the
+                         on-image rectangle, in pixels. */
+  int16_t image_y;    /**< Y co-ordinate of the top edge of the
+                         on-image rectangle, in pixels. */
+  uint16_t width;     /**< Width of the frame, in pixels. */
+  uint16_t height;    /**< Height of the frame, in pixels. */
+  uint32_t duration;  /**< Time to show the frame, in
+                         microseconds. */
+} animation_frame_t;
+
+
+/**
+ * An animation clip.
+ */
+typedef struct animation_clip
+{
+  char *name;                 /**< Unique name of the clip. */
+  char *filename;             /**< Filename of the image the frames
+                                 are cut from. */
+  atlas_region_t region;      /**< Where to draw that image from,
+                                 with a NULL_IMAGE handle until the
+                                 clip is first played. */
+  bool looping;               /**< Whether the clip starts again
+                                 after its last frame, rather than
+                                 staying on it. */
+  animation_frame_t *frames;  /**< Array of frames. */
+  uint16_t num_frames;        /**< Number of frames. */
+  uint32_t total_duration;    /**< Sum of the frame durations, in
+                                 microseconds. */
+} animation_clip_t;
+
+
+/* -- DECLARATIONS -- */
+
+/**
+ * Initialises the animation clip table.
+ */
+void init_animations (void);
+
+
+/**
+ * Defines a new, empty animation clip.
+ *
+ * @param name      Unique name of the clip.
+ * @param filename  Filename of the image the frames are cut from.
+ * @param looping   Whether the clip starts again after its last
+ *                  frame.
+ *
+ * @return  the ID of the new clip, or NULL_CLIP if a clip with the
+ *          name already exists.
+ */
+clip_id_t define_animation_clip (const char name[],
+                                 const char filename[],
+                                 bool looping);
+
+
+/**
+ * Adds a frame to the end of an animation clip.
+ *
+ * @param clip      ID of the clip.
+ * @param image_x   X co-ordinate of the left edge of the on-image
+ *                  rectangle, in pixels.
+ * @param image_y   Y co-ordinate of the top edge of the on-image
+ *                  rectangle, in pixels.
+ * @param width     Width of the frame, in pixels.
+ * @param height    Height of the frame, in pixels.
+ * @param duration  Time to show the frame, in microseconds; must be
+ *                  non-zero.
+ */
+void add_animation_frame (clip_id_t clip,
+                          int16_t image_x,
+                          int16_t image_y,
+                          uint16_t width,
+                          uint16_t height,
+                          uint32_t duration);
+
+
+/**
+ * Looks up an animation clip's ID by name.
+ *
+ * @param name  Name of the clip.
+ *
+ * @return  the clip's ID, or NULL_CLIP if there is no such clip.
+ */
+clip_id_t get_animation_clip_id (const char name[]);
+
+
+/**
+ * Gets an animation clip.
+ *
+ * @param clip  ID of the clip; must not be NULL_CLIP.
+ *
+ * @return  a pointer to the clip.
+ */
+animation_clip_t *get_animation_clip (clip_id_t clip);
+
+
+/**
+ * Advances a position in an animation clip by an amount of time.
+ *
+ * @param clip    ID of the clip.
+ * @param frame   Pointer to the index of the current frame, which is
+ *                updated.
+ * @param cursor  Pointer to the time the current frame has been
+ *                shown, in microseconds, which is updated.
+ * @param delta   Time to advance by, in microseconds.
+ *
+ * @return  true if the frame has changed; false otherwise.
+ */
+bool advance_animation (clip_id_t clip,
+                        uint16_t *frame,
+                        uint32_t *cursor,
+                        uint32_t delta);
+
+
+/**
+ * Removes every animation clip and frees the table.
+ */
+void cleanup_animations (void);
+
+
+#endif /* not _ANIMATION_H */
@@ -0,0 +1,491 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/field/atlas.c
+ * @author  agent
+ * @brief   Object sprite atlases.
+ */
+
+#include "../crystals.h"
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  ATLAS_SIZE = 1024,     /**< Width and height of each atlas, in
+                            pixels. */
+  MAX_PACKED_SIZE = 256  /**< Largest width or height of an image
+                            packed into an atlas, in pixels. */
+};
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * A segment of an atlas's skyline: a range of columns, and the
+ * lowest row in them that is free all the way down.
+ */
+typedef struct skyline_segment
+{
+  uint16_t x;      /**< X co-ordinate of the left edge of the
+                      segment. */
+  uint16_t y;      /**< Y co-ordinate of the first free row. */
+  uint16_t width;  /**< Width of the segment, in pixels. */
+} skyline_segment_t;
+
+
+/**
+ * An atlas image and its skyline.
+ */
+typedef struct atlas
+{
+  char *name;                   /**< Name of the atlas in the image
+                                   table. */
+  image_handle_t image;         /**< Handle of the atlas image. */
+  skyline_segment_t *skyline;   /**< Segments of the skyline, from
+                                   left to right, covering the whole
+                                   width of the atlas. */
+  uint16_t num_segments;        /**< Number of skyline segments. */
+} atlas_t;
+
+
+/* -- STATIC GLOBAL VARIABLES -- */
+
+static GPtrArray *sg_atlases;  /**< The atlases, as atlas_t. */
+static GHashTable *sg_regions; /**< Regions, as atlas_region_t, keyed
+                                  by image filename. */
+static atlas_stats_t sg_atlas_stats; /**< Packing counts. */
+static bool sg_atlases_unsupported;  /**< Whether the graphics module
+                                        has been found unable to draw
+                                        into images. */
+
+
+/* -- STATIC DECLARATIONS -- */
+
+/**
+ * Packs an image into the first atlas it fits in, opening a new
+ * atlas if none has room.
+ *
+ * @param data    The image data.
+ * @param width   The width of the image, in pixels.
+ * @param height  The height of the image, in pixels.
+ * @param region  Pointer to the region to fill in.
+ *
+ * @return  true if the image was packed; false if the graphics
+ *          module cannot draw into images.
+ */
+static bool pack_image (image_t *data,
+                        uint16_t width,
+                        uint16_t height,
+                        atlas_region_t *region);
+
+
+/**
+ * Opens a new, empty atlas.
+ *
+ * @return  the atlas, or NULL if the graphics module cannot create
+ *          or draw into images.
+ */
+static atlas_t *add_atlas (void);
+
+
+/**
+ * Finds the lowest place on an atlas's skyline that an image fits,
+ * preferring narrower segments where two places are as low.
+ *
+ * @param atlas   The atlas.
+ * @param width   The width of the image, in pixels.
+ * @param height  The height of the image, in pixels.
+ * @param index   Pointer to store the index of the segment the
+ *                image's left edge is on.
+ * @param x       Pointer to store the X co-ordinate of the place.
+ * @param y       Pointer to store the Y co-ordinate of the place.
+ *
+ * @return  true if the image fits; false otherwise.
+ */
+static bool find_skyline_position (atlas_t *atlas,
+                                   uint16_t width,
+                                   uint16_t height,
+                                   uint16_t *index,
+                                   uint16_t *x,
+                                   uint16_t *y);
+
+
+/**
+ * Raises an atlas's skyline over an image just placed on it.
+ *
+ * @param atlas   The atlas.
+ * @param index   Index of the segment the image's left edge is on.
+ * @param x       X co-ordinate of the image.
+ * @param y       Y co-ordinate of the image.
+ * @param width   The width of the image, in pixels.
+ * @param height  The height of the image, in pixels.
+ */
+static void raise_skyline (atlas_t *atlas,
+                           uint16_t index,
+                           uint16_t x,
+                           uint16_t y,
+                           uint16_t width,
+                           uint16_t height);
+
+
+/**
+ * Frees an atlas, and deletes its image.
+ *
+ * @param atlas  Pointer to the atlas to free.
+ */
+static void free_atlas (gpointer atlas);
+
+
+/* -- DEFINITIONS -- */
+
+/* Initialises the object sprite atlases. */
+void
+init_atlases (void)
+{
+  sg_atlases = g_ptr_array_new_with_free_func (free_atlas);
+  sg_regions = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                      g_free, free);
+  memset (&sg_atlas_stats, 0, sizeof (atlas_stats_t));
+  sg_atlases_unsupported = false;
+}
+
+
+/* Finds where to draw an object image from. */
+void
+get_atlas_region (const char filename[], atlas_region_t *region)
+{
+  atlas_region_t *known;
+
+  g_assert (sg_regions != NULL);
+  g_assert (filename != NULL && region != NULL);
+
+  known = g_hash_table_lookup (sg_regions, filename);
+  if (known == NULL)
+    {
+      image_handle_t image = load_image (filename);
+      image_t *data = get_image (image);
+      uint16_t width;
+      uint16_t height;
+
+      known = xcalloc (1, sizeof (atlas_region_t));
+
+      if (get_image_dimensions (data, &width, &height)
+          && width <= MAX_PACKED_SIZE
+          && height <= MAX_PACKED_SIZE
+          && pack_image (data, width, height, known))
+        {
+          sg_atlas_stats.packed += 1;
+          sg_atlas_stats.used_pixels += (uint32_t) width * height;
+
+          /* The atlas has its own copy, so this one can go until
+             something else wants it. */
+          (void) delete_image (filename);
+        }
+      else
+        {
+          known->image = image;
+          sg_atlas_stats.unpacked += 1;
+        }
+
+      g_hash_table_insert (sg_regions, g_strdup (filename), known);
+    }
+
+  *region = *known;
+}
+
+
+/* Gets the counts of how well the atlases are packed. */
+void
+get_atlas_stats (atlas_stats_t *stats)
+{
+  g_assert (stats != NULL);
+
+  *stats = sg_atlas_stats;
+}
+
+
+/* Frees every atlas. */
+void
+cleanup_atlases (void)
+{
+  if (sg_atlas_stats.atlases > 0)
+    g_debug ("Packed %lu images into %lu atlases, %lu%% full and "
+             "taking up %lu bytes; %lu images left unpacked.",
+             (unsigned long) sg_atlas_stats.packed,
+             (unsigned long) sg_atlas_stats.atlases,
+             (unsigned long) (sg_atlas_stats.used_pixels
+                              / (sg_atlas_stats.total_pixels / 100)),
+             (unsigned long) sg_atlas_stats.bytes,
+             (unsigned long) sg_atlas_stats.unpacked);
+
+  if (sg_regions != NULL)
+    {
+      g_hash_table_destroy (sg_regions);
+      sg_regions = NULL;
+    }
+
+  if (sg_atlases != NULL)
+    {
+      g_ptr_array_free (sg_atlases, TRUE);
+      sg_atlases = NULL;
+    }
+}
+
+
+/* -- STATIC DEFINITIONS -- */
+
+/* Packs an image into the first atlas it fits in. */
+static bool
+pack_image (image_t *data,
+            uint16_t width,
+            uint16_t height,
+            atlas_region_t *region)
+{
+  atlas_t *atlas = NULL;
+  uint16_t index = 0;
+  uint16_t x = 0;
+  uint16_t y = 0;
+  guint i;
+
+  for (i = 0; i < sg_atlases->len && atlas == NULL; i += 1)
+    {
+      atlas_t *candidate = g_ptr_array_index (sg_atlases, i);
+
+      if (find_skyline_position (candidate, width, height,
+                                 &index, &x, &y))
+        atlas = candidate;
+    }
+
+  if (atlas == NULL)
+    {
+      bool fits;
+
+      atlas = add_atlas ();
+      if (atlas == NULL)
+        return false;
+
+      /* Anything up to MAX_PACKED_SIZE fits in an empty atlas. */
+      fits = find_skyline_position (atlas, width, height,
+                                    &index, &x, &y);
+      g_assert (fits);
+    }
+
+  (void) set_draw_target (get_image (atlas->image));
+  draw_image_direct (data, 0, 0, (int16_t) x, (int16_t) y,
+                     width, height);
+  (void) set_draw_target (NULL);
+
+  raise_skyline (atlas, index, x, y, width, height);
+
+  region->image = atlas->image;
+  region->x = (int16_t) x;
+  region->y = (int16_t) y;
+  return true;
+}
+
+
+/* Opens a new, empty atlas. */
+static atlas_t *
+add_atlas (void)
+{
+  atlas_t *atlas;
+  image_t *data;
+
+  if (sg_atlases_unsupported)
+    return NULL;
+
+  data = create_image (ATLAS_SIZE, ATLAS_SIZE, true);
+
+  /* Make sure the module can draw into the atlas before keeping
+     it. */
+  if (data != NULL && !set_draw_target (data))
+    {
+      free_image (data);
+      data = NULL;
+    }
+
+  if (data == NULL)
+    {
+      sg_atlases_unsupported = true;
+      return NULL;
+    }
+
+  (void) set_draw_target (NULL);
+
+  atlas = xcalloc (1, sizeof (atlas_t));
+  atlas->name = g_strdup_printf ("<atlas %u>", sg_atlases->len);
+  atlas->image = add_image (atlas->name, data);
+
+  /* Placing an image can split a segment before the segments it
+     covers are cut back, so leave room for one more. */
+  atlas->skyline = xcalloc (ATLAS_SIZE + 1, sizeof (skyline_segment_t));
+  atlas->skyline[0].width = ATLAS_SIZE;
+  atlas->num_segments = 1;
+
+  g_ptr_array_add (sg_atlases, atlas);
+
+  sg_atlas_stats.atlases += 1;
+  sg_atlas_stats.total_pixels += (uint32_t) ATLAS_SIZE * ATLAS_SIZE;
+  sg_atlas_stats.bytes += ((uint32_t) ATLAS_SIZE * ATLAS_SIZE
+                           * (SCREEN_D / 8));
+  return atlas;
+}
+
+
+/* Finds the lowest place on an atlas's skyline that an image fits. */
+static bool
+find_skyline_position (atlas_t *atlas,
+                       uint16_t width,
+                       uint16_t height,
+                       uint16_t *index,
+                       uint16_t *x,
+                       uint16_t *y)
+{
+  uint32_t best_bottom = ATLAS_SIZE + 1;
+  uint16_t best_width = 0;
+  uint16_t i;
+
+  for (i = 0; i < atlas->num_segments; i += 1)
+    {
+      skyline_segment_t *segment = &(atlas->skyline[i]);
+      uint32_t top = 0;
+      uint32_t covered = 0;
+      uint16_t j;
+
+      if (segment->x + width > ATLAS_SIZE)
+        break;
+
+      /* The image rests on the highest segment under it. */
+      for (j = i; covered < width; j += 1)
+        {
+          top = MAX (top, atlas->skyline[j].y);
+          covered += atlas->skyline[j].width;
+        }
+
+      if (top + height > ATLAS_SIZE)
+        continue;
+
+      if (top + height < best_bottom
+          || (top + height == best_bottom
+              && segment->width < best_width))
+        {
+          best_bottom = top + height;
+          best_width = segment->width;
+          *index = i;
+          *x = segment->x;
+          *y = (uint16_t) top;
+        }
+    }
+
+  return (best_bottom <= ATLAS_SIZE);
+}
+
+
+/* Raises an atlas's skyline over an image just placed on it. */
+static void
+raise_skyline (atlas_t *atlas,
+               uint16_t index,
+               uint16_t x,
+               uint16_t y,
+               uint16_t width,
+               uint16_t height)
+{
+  skyline_segment_t *skyline = atlas->skyline;
+  uint16_t right = (uint16_t) (x + width);
+  uint16_t i;
+
+  memmove (&(skyline[index + 1]), &(skyline[index]),
+           (atlas->num_segments - index) * sizeof (skyline_segment_t));
+  skyline[index].x = x;
+  skyline[index].y = (uint16_t) (y + height);
+  skyline[index].width = width;
+  atlas->num_segments += 1;
+
+  /* Cut back, or remove, the segments the image now covers. */
+  i = (uint16_t) (index + 1);
+  while (i < atlas->num_segments && skyline[i].x < right)
+    {
+      uint16_t overlap = (uint16_t) (right - skyline[i].x);
+
+      if (overlap < skyline[i].width)
+        {
+          skyline[i].x = right;
+          skyline[i].width = (uint16_t) (skyline[i].width - overlap);
+          break;
+        }
+
+      memmove (&(skyline[i]), &(skyline[i + 1]),
+               ((atlas->num_segments - i - 1)
+                * sizeof (skyline_segment_t)));
+      atlas->num_segments -= 1;
+    }
+
+  /* Merge neighbouring segments at the same height. */
+  i = 0;
+  while (i + 1 < atlas->num_segments)
+    {
+      if (skyline[i].y == skyline[i + 1].y)
+        {
+          skyline[i].width = (uint16_t) (skyline[i].width
+                                         + skyline[i + 1].width);
+          memmove (&(skyline[i + 1]), &(skyline[i + 2]),
+                   ((atlas->num_segments - i - 2)
+                    * sizeof (skyline_segment_t)));
+          atlas->num_segments -= 1;
+        }
+      else
+        i += 1;
+    }
+}
+
+
+/* Frees an atlas, and deletes its image. */
+static void
+free_atlas (gpointer atlas)
+{
+  atlas_t *atlasc = atlas;
+
+  unpin_image (atlasc->image);
+  (void) delete_image (atlasc->name);
+
+  g_free (atlasc->name);
+  free (atlasc->skyline);
+  free (atlasc);
+}
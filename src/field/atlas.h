@@ -0,0 +1,127 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/field/atlas.h
+ * @author  agent
+ * @brief   Prototypes and declarations for object sprite atlases.
+ *
+ * Small object images are packed, as they are first used, into a few
+ * large atlas images, so that drawing the objects on a map blits
+ * from one image rather than hopping between many.  Each atlas is
+ * packed with a skyline packer, keeping the lowest free height in
+ * every column range and placing each image as low as it will go.
+ * Images too big to pack, or used when the graphics module cannot
+ * draw into images, are drawn from where they are instead.
+ */
+
+#ifndef _ATLAS_H
+#define _ATLAS_H
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * Where an object image is to be drawn from.
+ */
+typedef struct atlas_region
+{
+  image_handle_t image;  /**< Handle of the atlas the image has been
+                            packed into, or of the image itself if
+                            it has not been packed. */
+  int16_t x;             /**< X co-ordinate of the image's left edge
+                            within that image, in pixels. */
+  int16_t y;             /**< Y co-ordinate of the image's top edge
+                            within that image, in pixels. */
+} atlas_region_t;
+
+
+/**
+ * Counts of how well the atlases are packed.
+ */
+typedef struct atlas_stats
+{
+  uint32_t atlases;       /**< Number of atlases. */
+  uint32_t packed;        /**< Images packed into the atlases. */
+  uint32_t unpacked;      /**< Images drawn from where they are. */
+  uint32_t used_pixels;   /**< Area of the atlases covered by packed
+                             images, in pixels. */
+  uint32_t total_pixels;  /**< Total area of the atlases, in
+                             pixels. */
+  uint32_t bytes;         /**< Approximate memory the atlases take
+                             up, in bytes. */
+} atlas_stats_t;
+
+
+/* -- DECLARATIONS -- */
+
+/**
+ * Initialises the object sprite atlases.
+ */
+void init_atlases (void);
+
+
+/**
+ * Finds where to draw an object image from, packing it into an
+ * atlas the first time it is asked for.
+ *
+ * On-image rectangles within the image should be offset by the
+ * region's co-ordinates, and drawn from the region's image.
+ *
+ * @param filename  Filename of the image.
+ * @param region    Pointer to the region to fill in.
+ */
+void get_atlas_region (const char filename[], atlas_region_t *region);
+
+
+/**
+ * Gets the counts of how well the atlases are packed.
+ *
+ * Packing efficiency is used_pixels out of total_pixels.
+ *
+ * @param stats  Pointer to the structure to fill in.
+ */
+void get_atlas_stats (atlas_stats_t *stats);
+
+
+/**
+ * Frees every atlas.  Regions returned so far are no longer valid.
+ */
+void cleanup_atlases (void);
+
+
+#endif /* not _ATLAS_H */
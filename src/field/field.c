@@ -46,15 +46,82 @@
 #include "../crystals.h"
 
 
+/* -- CONSTANTS -- */
+
+enum
+{
+  FIELD_MINIMAP_TILE_PIXELS = 2,  /**< Size of one tile on the field
+                                     minimap, in pixels. */
+  FIELD_MINIMAP_MARGIN = 5,       /**< Gap between the minimap and the
+                                     screen edges, in pixels. */
+
+  MINUTES_PER_DAY = 24 * 60,      /**< Length of a field day, in
+                                     minutes. */
+
+  PLAYER_WALK_FRAME_USECONDS = 150000, /**< Time each frame of the
+                                          player's walk cycle is
+                                          shown, in microseconds. */
+
+  RAIN_RATE = 40,                 /**< Raindrops falling on the test
+                                     map every field frame. */
+  RAIN_LIFETIME = 24              /**< Field frames each raindrop
+                                     lasts. */
+};
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * A point in the field's day/night colour cycle.
+ */
+typedef struct time_tint
+{
+  uint16_t minute;  /**< Minute of the day of this point. */
+  uint8_t red;      /**< Red tint at this point. */
+  uint8_t green;    /**< Green tint at this point. */
+  uint8_t blue;     /**< Blue tint at this point. */
+} time_tint_t;
+
+
+/**
+ * The day/night colour cycle, in order of time.  Tints between
+ * points are interpolated.
+ */
+static const time_tint_t TIME_TINTS[] = {
+  {0, 80, 90, 150},         /* Midnight */
+  {5 * 60, 80, 90, 150},    /* Before dawn */
+  {7 * 60, 255, 200, 170},  /* Dawn */
+  {9 * 60, 255, 255, 255},  /* Morning */
+  {17 * 60, 255, 255, 255}, /* Afternoon */
+  {19 * 60, 255, 170, 130}, /* Dusk */
+  {21 * 60, 80, 90, 150},   /* Night */
+  {MINUTES_PER_DAY, 80, 90, 150}
+};
+
+
 /* -- STATIC GLOBAL VARIABLES -- */
 
 static map_t *sg_map;
-static mapview_t *sg_mapview;
+
+/* Map views onto sg_map.  The first is the main camera view; any
+   others (minimaps, split views) are drawn after it, in the order
+   they were added. */
+static GSList *sg_mapviews;
+
+static uint16_t sg_time_of_day;  /**< Minute of the field day. */
+static uint8_t sg_brightness;    /**< Fade level, from 0 (black) to
+                                    255 (fully visible). */
+
+static particle_emitter_t *sg_rain;  /**< Rain falling over the main
+                                        map view. */
 
 /* Test callbacks, woo */
 
 static unsigned char sg_field_held_special_keys[256];
 
+static bool sg_player_walking;  /**< Whether the player is playing its
+                                   walk cycle. */
+
 static event_callback_t *sg_field_skeyupcb;
 static event_callback_t *sg_field_skeydowncb;
 static event_callback_t *sg_field_quitcb;
@@ -77,12 +144,77 @@ field_cleanup_callbacks (void);
 
 
 /**
- * Checks to see if certain keys are held and handles the results.
+ * Checks to see if certain keys are held and handles the results,
+ * moving the player and starting or stopping its walk cycle.
  */
 static void
 field_handle_held_keys (void);
 
 
+/**
+ * Simulates one field frame: moves the player by any held keys,
+ * advances animations and particles, and marks what they change as
+ * dirty.
+ */
+static void
+field_simulate_frame (void);
+
+
+/**
+ * Renders one field map view.
+ *
+ * @param mapview  Pointer to the map view to render.
+ * @param unused   Unused.
+ */
+static void
+field_render_mapview (gpointer mapview, gpointer unused);
+
+
+/**
+ * Frees one field map view.
+ *
+ * @param mapview  Pointer to the map view to free.
+ */
+static void
+field_free_mapview (gpointer mapview);
+
+
+/**
+ * Marks the parts of the field minimap that a map view is about to
+ * draw over as dirty.
+ *
+ * @param mapview  Pointer to the map view about to be rendered.
+ */
+static void
+field_mark_minimap_under_mapview (mapview_t *mapview);
+
+
+/**
+ * Marks a tile whose light level has changed as dirty.
+ *
+ * @param x       X co-ordinate of the tile, in tiles.
+ * @param y       Y co-ordinate of the tile, in tiles.
+ * @param unused  Unused.
+ */
+static void
+field_mark_light_change (dimension_t x, dimension_t y, gpointer unused);
+
+
+/**
+ * Moves the rain emitter to cover the area the main map view shows.
+ */
+static void
+field_place_rain (void);
+
+
+/**
+ * Works out the screen tint for the current time of day and fade
+ * level, and passes it to the graphics subsystem.
+ */
+static void
+field_update_tint (void);
+
+
 /* -- DEFINITIONS -- */
 
 /* - Callbacks - */
@@ -125,17 +257,34 @@ field_on_special_key_down (event_t *event)
 void
 init_field (struct state_functions *function_table)
 {
+  clip_id_t walk;
+  clip_id_t stand;
+
   memset (sg_field_held_special_keys, 0, sizeof (unsigned char) * 256);
 
   field_init_callbacks ();
 
+  sg_time_of_day = 12 * 60;
+  sg_brightness = 255;
+  field_update_tint ();
+
+  /* Decode everything the map needs up front, so the first frame
+     does not stall on it. */
+  preload_map_images ("maps/test.map");
   sg_map = load_map ("maps/test.map");
 
+  init_atlases ();
+  init_animations ();
   init_objects ();
+  init_particles ();
 
-  sg_mapview = init_mapview (sg_map);
+  add_field_mapview (init_mapview (sg_map));
 
-  g_assert (sg_mapview != NULL);
+  init_minimap (sg_map,
+                (int16_t) (SCREEN_W - FIELD_MINIMAP_MARGIN
+                           - (sg_map->width * FIELD_MINIMAP_TILE_PIXELS)),
+                FIELD_MINIMAP_MARGIN,
+                FIELD_MINIMAP_TILE_PIXELS);
 
   /* TEST DATA */
   add_object ("Player", "null");
@@ -150,6 +299,26 @@ init_field (struct state_functions *function_table)
   change_object_image ("Test1", "testobj.png", 0, 0, 16, 48);
   change_object_image ("Test2", "testobj.png", 16, 0, 16, 48);
 
+  /* The player bobs while walking, and stands still otherwise. */
+  walk = define_animation_clip ("player-walk", "testobj.png", true);
+  add_animation_frame (walk, 32, 0, 48, 48, PLAYER_WALK_FRAME_USECONDS);
+  add_animation_frame (walk, 32, 2, 48, 46, PLAYER_WALK_FRAME_USECONDS);
+
+  stand = define_animation_clip ("player-stand", "testobj.png", false);
+  add_animation_frame (stand, 32, 0, 48, 48, PLAYER_WALK_FRAME_USECONDS);
+
+  sg_player_walking = false;
+
+  /* Rain, falling a little to the left. */
+  sg_rain = add_particle_emitter ("rain.png", 3, 8, 2, 4, RAIN_LIFETIME);
+  set_particle_emitter_velocity (sg_rain,
+                                 -PARTICLE_SUBPIXELS,
+                                 6 * PARTICLE_SUBPIXELS,
+                                 PARTICLE_SUBPIXELS / 4,
+                                 PARTICLE_SUBPIXELS,
+                                 0);
+  set_field_rain (RAIN_RATE);
+
   focus_camera_on_object ("Player");
 
   position_object ("Player",  200, 200, BOTTOM_LEFT);
@@ -168,7 +337,69 @@ init_field (struct state_functions *function_table)
 mapview_t *
 get_field_mapview (void)
 {
-  return sg_mapview;
+  g_assert (sg_mapviews != NULL);
+
+  return sg_mapviews->data;
+}
+
+
+/* Add a map view to the field. */
+void
+add_field_mapview (mapview_t *mapview)
+{
+  g_assert (mapview != NULL);
+
+  sg_mapviews = g_slist_append (sg_mapviews, mapview);
+}
+
+
+/* Mark a rectangle of the map as dirty in every field map view. */
+void
+mark_field_dirty_rect (int32_t x,
+                       int32_t y,
+                       uint32_t width,
+                       uint32_t height)
+{
+  GSList *view;
+
+  for (view = sg_mapviews; view != NULL; view = view->next)
+    mark_dirty_rect (view->data, x, y, width, height);
+}
+
+
+/* Set the time of day shown by the field. */
+void
+set_field_time_of_day (uint16_t minute)
+{
+  sg_time_of_day = (uint16_t) (minute % MINUTES_PER_DAY);
+  field_update_tint ();
+}
+
+
+/* Set the fade level of the field. */
+void
+set_field_brightness (uint8_t brightness)
+{
+  sg_brightness = brightness;
+  field_update_tint ();
+}
+
+
+/* Set how hard it is raining on the field. */
+void
+set_field_rain (uint32_t rate)
+{
+  if (sg_rain != NULL)
+    set_particle_emitter_rate (sg_rain, rate);
+}
+
+
+/* Show the position of something on the field minimap. */
+void
+set_field_minimap_marker (gconstpointer owner, int32_t x, int32_t y)
+{
+  if (sg_map != NULL && sg_map->minimap != NULL)
+    set_minimap_marker (sg_map->minimap, owner, x, y);
 }
 
 
@@ -195,6 +426,8 @@ get_field_map_boundaries (int *x0_pointer,
 static void
 field_handle_held_keys (void)
 {
+  bool walking = true;
+
   if (sg_field_held_special_keys[SK_UP])
     move_object ("Player", 0, -1);
   else if (sg_field_held_special_keys[SK_RIGHT])
@@ -203,6 +436,16 @@ field_handle_held_keys (void)
     move_object ("Player", 0, 1);
   else if (sg_field_held_special_keys[SK_LEFT])
     move_object ("Player", -1, 0);
+  else
+    walking = false;
+
+  /* Only switch clips when the player starts or stops, so the walk
+     cycle runs on rather than restarting every frame. */
+  if (walking != sg_player_walking)
+    {
+      animate_object ("Player", walking ? "player-walk" : "player-stand");
+      sg_player_walking = walking;
+    }
 }
 
 
@@ -242,30 +485,102 @@ void
 update_field (uint32_t delta)
 {
   static uint32_t total_useconds;
+  static uint32_t frame_useconds;
+  uint32_t ticks;
 
   total_useconds += delta;
+  frame_useconds += delta;
 
-  field_handle_held_keys ();
+  /* Frames the main loop fell behind by are simulated, but only the
+     last is drawn. */
+  ticks = take_frame_ticks (&total_useconds);
 
-  if (total_useconds >= USECONDS_PER_FRAME)
+  if (ticks > 0)
     {
       gchar *fps_indication;
+      frame_stats_t stats;
+      mapview_t *main_view = get_field_mapview ();
+      GSList *view;
+
+      for (; ticks > 0; ticks -= 1)
+        field_simulate_frame ();
 
-      render_map (sg_mapview);
+      if (sg_map->minimap != NULL)
+        for (view = sg_mapviews; view != NULL; view = view->next)
+          field_mark_minimap_under_mapview (view->data);
 
-      fps_indication = g_strdup_printf ("%05ufps",
+      render_map (main_view);
+      render_particles (main_view);
+
+      /* Scrolling the main view moves the whole screen, including
+         anything the other views have drawn over it. */
+      if (main_view->scrolled_screen)
+        {
+          for (view = sg_mapviews->next; view != NULL; view = view->next)
+            mark_screen_dirty_rect (view->data,
+                                    0, 0, SCREEN_W, SCREEN_H);
+
+          if (sg_map->minimap != NULL)
+            mark_minimap_redraw (sg_map->minimap);
+
+          main_view->scrolled_screen = false;
+        }
+
+      g_slist_foreach (sg_mapviews->next, field_render_mapview, NULL);
+
+      if (sg_map->minimap != NULL)
+        render_minimap (sg_map->minimap);
+
+      get_frame_stats (&stats);
+      fps_indication = g_strdup_printf ("%05ufps %05uskip",
                                         (USECONDS_PER_SECOND
-                                         / total_useconds));
+                                         / frame_useconds),
+                                        stats.frames_skipped);
       write_string (5, 5, fps_indication);
       g_free (fps_indication);
 
       write_string (5, SCREEN_H - FONT_H - 5, "Crystals");
 
-      total_useconds = 0;
+      frame_useconds = 0;
     }
 }
 
 
+/* Simulates one field frame. */
+static void
+field_simulate_frame (void)
+{
+  static uint32_t animation_useconds;
+  frame_quality_t quality = get_frame_quality ();
+  GSList *view;
+
+  animation_useconds += USECONDS_PER_FRAME;
+
+  /* Held keys move the player once per frame simulated, so it keeps
+     its speed when frames are skipped. */
+  field_handle_held_keys ();
+
+  /* At low quality, animations catch up every other frame. */
+  if (quality < QUALITY_HALF_ANIMATION
+      || animation_useconds >= 2 * USECONDS_PER_FRAME)
+    {
+      if (advance_tile_animations (sg_map->tileset, animation_useconds))
+        for (view = sg_mapviews; view != NULL; view = view->next)
+          mark_animated_tiles_dirty (view->data);
+
+      update_object_animations (animation_useconds);
+      animation_useconds = 0;
+    }
+
+  if (sg_map->light_map != NULL)
+    take_light_changes (sg_map->light_map,
+                        field_mark_light_change, NULL);
+
+  field_place_rain ();
+  update_particles (quality < QUALITY_NO_PARTICLES);
+}
+
+
 /* Handle a dirty rectangle passed from the user interface overlay for
    field. */
 void
@@ -274,10 +589,13 @@ field_handle_dirty_rect (int16_t x,
                          uint16_t width,
                          uint16_t height)
 {
-  mark_dirty_rect (sg_mapview,
-                   x + sg_mapview->x_offset,
-                   y + sg_mapview->y_offset,
-                   width, height);
+  GSList *view;
+
+  for (view = sg_mapviews; view != NULL; view = view->next)
+    mark_screen_dirty_rect (view->data, x, y, width, height);
+
+  if (sg_map->minimap != NULL)
+    mark_minimap_screen_dirty_rect (sg_map->minimap, x, y, width, height);
 }
 
 
@@ -285,9 +603,127 @@ field_handle_dirty_rect (int16_t x,
 void
 cleanup_field (void)
 {
-  free_mapview (sg_mapview);
+  /* Don't leave the field's lighting on other states. */
+  set_screen_tint (255, 255, 255);
+
+  g_slist_free_full (sg_mapviews, field_free_mapview);
+  sg_mapviews = NULL;
   free_map (sg_map);
   cleanup_objects ();
+  cleanup_particles ();
+  sg_rain = NULL;
+  cleanup_animations ();
+  cleanup_atlases ();
 
   field_cleanup_callbacks ();
 }
+
+
+/* Move the rain emitter over the main map view. */
+static void
+field_place_rain (void)
+{
+  mapview_t *mapview = get_field_mapview ();
+  int32_t width = (int32_t) get_mapview_visible_width (mapview);
+  int32_t height = (int32_t) get_mapview_visible_height (mapview);
+
+  /* Only drops that can be seen are emitted, so the rain costs the
+     same however large the map is. */
+  set_particle_emitter_origin (sg_rain,
+                               mapview->x_offset + (width / 2),
+                               mapview->y_offset + (height / 2),
+                               width / 2,
+                               height / 2);
+}
+
+
+/* Render one field map view. */
+static void
+field_render_mapview (gpointer mapview, gpointer unused)
+{
+  (void) unused;
+  render_map (mapview);
+}
+
+
+/* Free one field map view. */
+static void
+field_free_mapview (gpointer mapview)
+{
+  free_mapview (mapview);
+}
+
+
+/* Mark the parts of the field minimap under a map view's dirty
+   rectangles as dirty. */
+static void
+field_mark_minimap_under_mapview (mapview_t *mapview)
+{
+  GSList *rectangle;
+  int32_t scale = mapview->scale;
+
+  for (rectangle = mapview->dirty_rectangles;
+       rectangle != NULL;
+       rectangle = rectangle->next)
+    {
+      dirty_rectangle_t *rect = rectangle->data;
+
+      mark_minimap_screen_dirty_rect (sg_map->minimap,
+                                      (int16_t) (mapview->viewport_x
+                                                 + ((rect->start_x
+                                                     - mapview->x_offset)
+                                                    / scale)),
+                                      (int16_t) (mapview->viewport_y
+                                                 + ((rect->start_y
+                                                     - mapview->y_offset)
+                                                    / scale)),
+                                      (uint16_t) ((rect->width / scale)
+                                                  + 2),
+                                      (uint16_t) ((rect->height / scale)
+                                                  + 2));
+    }
+}
+
+
+/* Mark a tile whose light level has changed as dirty. */
+static void
+field_mark_light_change (dimension_t x, dimension_t y, gpointer unused)
+{
+  (void) unused;
+
+  mark_field_dirty_rect ((int32_t) x * TILE_W, (int32_t) y * TILE_H,
+                         TILE_W, TILE_H);
+}
+
+
+/* Work out and apply the screen tint for the time of day and fade
+   level. */
+static void
+field_update_tint (void)
+{
+  const time_tint_t *from = &TIME_TINTS[0];
+  const time_tint_t *to = &TIME_TINTS[1];
+  uint32_t span;
+  uint32_t along;
+  uint8_t tint[3];
+
+  while (to->minute <= sg_time_of_day && to->minute < MINUTES_PER_DAY)
+    {
+      from = to;
+      to += 1;
+    }
+
+  span = (uint32_t) (to->minute - from->minute);
+  along = (uint32_t) (sg_time_of_day - from->minute);
+
+  tint[0] = (uint8_t) ((from->red * (span - along) + to->red * along)
+                       / span);
+  tint[1] = (uint8_t) ((from->green * (span - along)
+                        + to->green * along) / span);
+  tint[2] = (uint8_t) ((from->blue * (span - along) + to->blue * along)
+                       / span);
+
+  set_screen_tint ((uint8_t) ((tint[0] * sg_brightness) / 255),
+                   (uint8_t) ((tint[1] * sg_brightness) / 255),
+                   (uint8_t) ((tint[2] * sg_brightness) / 255));
+}
@@ -99,6 +99,84 @@ mapview_t *
 get_field_mapview (void);
 
 
+/**
+ * Adds a map view onto the field map, such as a minimap or a split
+ * view.  Views are rendered in the order they are added, after the
+ * main camera view.
+ *
+ * The field takes ownership of the map view and frees it on cleanup.
+ *
+ * @param mapview  Pointer to the map view to add.
+ */
+void
+add_field_mapview (mapview_t *mapview);
+
+
+/**
+ * Marks a rectangle of the field map as dirty in every map view.
+ *
+ * @param x       X co-ordinate of the left edge of the rectangle,
+ *                in pixels from the left edge of the map.
+ * @param y       Y co-ordinate of the top edge of the rectangle,
+ *                in pixels from the top edge of the map.
+ * @param width   Width of the rectangle, in pixels.
+ * @param height  Height of the rectangle, in pixels.
+ */
+void
+mark_field_dirty_rect (int32_t x,
+                       int32_t y,
+                       uint32_t width,
+                       uint32_t height);
+
+
+/**
+ * Shows the position of something, such as an object, on the field
+ * minimap.  Does nothing if the field has no minimap.
+ *
+ * @param owner  Pointer identifying the marker.
+ * @param x      X co-ordinate of the position, in pixels from the left
+ *               edge of the map.
+ * @param y      Y co-ordinate of the position, in pixels from the top
+ *               edge of the map.
+ */
+void
+set_field_minimap_marker (gconstpointer owner, int32_t x, int32_t y);
+
+
+/**
+ * Sets the time of day shown by the field, which tints the screen
+ * from dark blue at night through warm tones at dawn and dusk to
+ * untinted during the day.
+ *
+ * @param minute  Minute of the day, from 0 (midnight) to 1439.
+ *                Larger values wrap around.
+ */
+void
+set_field_time_of_day (uint16_t minute);
+
+
+/**
+ * Sets the fade level of the field, for fading in and out.
+ *
+ * @param brightness  Brightness, from 0 (black) to 255 (fully
+ *                    visible).
+ */
+void
+set_field_brightness (uint8_t brightness);
+
+
+/**
+ * Sets how hard it is raining on the field.
+ *
+ * This does nothing if the field is not running.
+ *
+ * @param rate  Raindrops to emit every field frame, or 0 to stop the
+ *              rain.  Drops already falling carry on.
+ */
+void
+set_field_rain (uint32_t rate);
+
+
 /**
  * Retrieves the boundaries of the map currently in use, in pixels.
  *
@@ -143,6 +143,20 @@ rectangle_out_of_bounds (int x, int y, int width, int height);
 static bool_t move_field_camera (int32_t dx, int32_t dy);
 
 
+/**
+ * Advances one object's animation, marking it dirty if its frame
+ * changes.
+ *
+ * @param key_ptr     Unused.
+ * @param object_ptr  Pointer to the object.
+ * @param delta_ptr   Pointer to the time to advance by, in
+ *                    microseconds.
+ */
+static void update_object_animation (gpointer key_ptr,
+                                     gpointer object_ptr,
+                                     gpointer delta_ptr);
+
+
 /* -- DEFINITIONS -- */
 
 /* Set an object as the camera focus point. */
@@ -283,6 +297,41 @@ change_object_image (const char object_name[],
 				  x_offset, y_offset, width, height);
 }
 
+/* Starts an object playing an animation clip. */
+void
+animate_object (const char object_name[], const char clip_name[])
+{
+  object_t *object = get_object (object_name);
+  clip_id_t clip = NULL_CLIP;
+
+  g_assert (object != NULL);
+  g_assert (object->image != NULL);
+
+  if (clip_name != NULL)
+    {
+      clip = get_animation_clip_id (clip_name);
+      if (clip == NULL_CLIP)
+        {
+          error ("OBJECT-API - animate_object - No clip named %s.",
+                 clip_name);
+          return;
+        }
+    }
+
+  mark_object_field_location_dirty (object);
+  set_object_clip (object, clip);
+  mark_object_field_location_dirty (object);
+}
+
+
+/* Advances the animations of all animated objects. */
+void
+update_object_animations (uint32_t delta)
+{
+  apply_to_objects (update_object_animation, &delta);
+}
+
+
 /* Given a valid image filename, changes the image associated with an
  * object.
  */
@@ -314,19 +363,23 @@ change_object_image_post_check (const char object_name[],
 static void
 mark_object_field_location_dirty (object_t *object)
 {
-  mapview_t *mapview = get_field_mapview ();
-  g_assert (mapview != NULL);
-
   /* No point marking a dirty rectangle if the object is currently
    * invisible.
    */
   if (object->image->width == 0 || object->image->height == 0)
     return;
 
-  mark_dirty_rect (mapview,
-		   object->image->map_x,
-		   object->image->map_y,
-		   object->image->width, object->image->height);
+  mark_field_dirty_rect (object->image->map_x,
+                         object->image->map_y,
+                         object->image->width,
+                         object->image->height);
+
+  /* Mark the object by the middle of its base. */
+  set_field_minimap_marker (object,
+                            object->image->map_x
+                            + (object->image->width / 2),
+                            object->image->map_y
+                            + object->image->height - 1);
 }
 
 
@@ -347,3 +400,36 @@ rectangle_out_of_bounds (int x, int y, int width, int height)
   else
     return false;
 }
+
+
+/* Advances one object's animation. */
+static void
+update_object_animation (gpointer key_ptr,
+                         gpointer object_ptr,
+                         gpointer delta_ptr)
+{
+  object_t *object = (object_t *) object_ptr;
+  int32_t old_x;
+  int32_t old_y;
+  uint16_t old_width;
+  uint16_t old_height;
+
+  (void) key_ptr;
+
+  if (object->clip == NULL_CLIP)
+    return;
+
+  old_x = object->image->map_x;
+  old_y = object->image->map_y;
+  old_width = object->image->width;
+  old_height = object->image->height;
+
+  /* Objects showing the same frame as before need no redrawing. */
+  if (!advance_object_animation (object, *(uint32_t *) delta_ptr))
+    return;
+
+  if (old_width > 0 && old_height > 0)
+    mark_field_dirty_rect (old_x, old_y, old_width, old_height);
+
+  mark_object_field_location_dirty (object);
+}
@@ -148,4 +148,24 @@ change_object_image (const char object_name[],
 		     uint16_t width, uint16_t height);
 
 
+/**
+ * Starts an object playing an animation clip from its first frame.
+ *
+ * @param object_name  Name of the object to animate.
+ * @param clip_name    Name of the clip (see define_animation_clip),
+ *                     or NULL to stop animating the object, leaving
+ *                     its current frame showing.
+ */
+void animate_object (const char object_name[], const char clip_name[]);
+
+
+/**
+ * Advances the animations of all animated objects, marking those
+ * whose frames change as dirty.
+ *
+ * @param delta  Time to advance by, in microseconds.
+ */
+void update_object_animations (uint32_t delta);
+
+
 #endif /* not _OBJECT_API_H */
@@ -63,10 +63,5 @@ void
 free_object_image (object_image_t *image)
 {
   if (image)
-    {
-      if (image->filename)
-        free (image->filename);
-
-      free (image);
-    }
+    free (image);
 }
@@ -53,15 +53,16 @@
 
 typedef struct object_image
 {
-  char *filename;        /**<
-                          * Name of the image, used when looking up
-                          * the image in the image cache.
+  image_handle_t image;  /**<
+                          * Handle of the image in the image cache,
+                          * or NULL_IMAGE if there is none.
                           */
 
   int16_t image_x;       /**<
                           * X co-ordinate of the left edge of the
                           * on-image rectangle from which to source
-                          * the rendered image, in pixels.
+                          * the rendered image, in pixels, within the
+                          * image the handle refers to.
                           */
 
   int16_t image_y;       /**<
@@ -70,6 +71,19 @@ typedef struct object_image
                           * the rendered image, in pixels.
                           */
 
+  int16_t origin_x;      /**<
+                          * X co-ordinate of the left edge of the
+                          * object's source image within the image
+                          * the handle refers to, which is not 0 if
+                          * it has been packed into an atlas.
+                          */
+
+  int16_t origin_y;      /**<
+                          * Y co-ordinate of the top edge of the
+                          * object's source image within the image
+                          * the handle refers to.
+                          */
+
   int32_t map_x;         /**<
                           * X co-ordinate of the left edge of the
                           * on-map rectangle in which to render the
@@ -85,23 +85,110 @@ set_object_image (object_t *object,
 		  int16_t image_x,
 		  int16_t image_y, uint16_t width, uint16_t height)
 {
+  atlas_region_t region;
+
   g_assert (object && object->image && filename);
 
-  if (object->image->filename != NULL)
-    {
-      g_free (object->image->filename);
-    }
+  get_atlas_region (filename, &region);
+
+  /* A fixed image replaces any clip, which would otherwise cut its
+     next frame out of the new image. */
+  object->clip = NULL_CLIP;
+  object->clip_frame = 0;
+  object->clip_cursor = 0;
+
+  object->image->image = region.image;
+  object->image->origin_x = region.x;
+  object->image->origin_y = region.y;
+
+  object->image->image_x = (int16_t) (region.x + image_x);
+  object->image->image_y = (int16_t) (region.y + image_y);
+  object->image->width = width;
+  object->image->height = height;
+}
 
-  object->image->filename = g_strdup (filename);
-  g_assert (object->image->filename != NULL);
 
-  object->image->image_x = image_x;
-  object->image->image_y = image_y;
+/* Changes the on-image rectangle of an object's graphic. */
+void
+set_object_image_rect (object_t *object,
+                       int16_t image_x,
+                       int16_t image_y,
+                       uint16_t width,
+                       uint16_t height)
+{
+  g_assert (object && object->image);
+
+  /* Keep the base where it is. */
+  object->image->map_y += (int32_t) object->image->height - height;
+
+  object->image->image_x = (int16_t) (object->image->origin_x + image_x);
+  object->image->image_y = (int16_t) (object->image->origin_y + image_y);
   object->image->width = width;
   object->image->height = height;
 }
 
 
+/* Starts an object playing an animation clip. */
+void
+set_object_clip (object_t *object, clip_id_t clip)
+{
+  animation_clip_t *clipp;
+
+  g_assert (object && object->image);
+
+  object->clip = clip;
+  object->clip_frame = 0;
+  object->clip_cursor = 0;
+
+  if (clip == NULL_CLIP)
+    return;
+
+  clipp = get_animation_clip (clip);
+  g_assert (clipp->num_frames > 0);
+
+  /* The image is only looked up here, the first time the clip is
+     played, not on every frame. */
+  if (clipp->region.image == NULL_IMAGE)
+    get_atlas_region (clipp->filename, &(clipp->region));
+
+  object->image->image = clipp->region.image;
+  object->image->origin_x = clipp->region.x;
+  object->image->origin_y = clipp->region.y;
+
+  set_object_image_rect (object,
+                         clipp->frames[0].image_x,
+                         clipp->frames[0].image_y,
+                         clipp->frames[0].width,
+                         clipp->frames[0].height);
+}
+
+
+/* Advances an object's animation. */
+bool
+advance_object_animation (object_t *object, uint32_t delta)
+{
+  animation_frame_t *frame;
+
+  g_assert (object != NULL);
+
+  if (object->clip == NULL_CLIP
+      || !advance_animation (object->clip,
+                             &(object->clip_frame),
+                             &(object->clip_cursor),
+                             delta))
+    return false;
+
+  frame = &(get_animation_clip (object->clip)->frames[object->clip_frame]);
+  set_object_image_rect (object,
+                         frame->image_x,
+                         frame->image_y,
+                         frame->width,
+                         frame->height);
+
+  return true;
+}
+
+
 /* Retrieves the object's co-ordinates on-map. */
 void
 get_object_coordinates (object_t *object,
@@ -157,9 +244,8 @@ set_object_dirty (object_t *object, mapview_t *mapview)
   if (object->is_dirty)
     return;
 
-  /* If the object has no image (the filename is NULL) then ignore the
-     dirty request. */
-  if (object->image->filename == NULL)
+  /* If the object has no image then ignore the dirty request. */
+  if (object->image->image == NULL_IMAGE)
     return;
 
   /* Ensure the object's co-ordinates don't go over the map
@@ -81,6 +81,16 @@ typedef struct object
 
   object_image_t *image;      /**< Pointer to the object's associated
                                  image data. */
+
+  clip_id_t clip;             /**< ID of the animation clip the object
+                                 is playing, or NULL_CLIP if it is not
+                                 animated. */
+
+  uint16_t clip_frame;        /**< Index of the clip frame being
+                                 shown. */
+
+  uint32_t clip_cursor;       /**< Time the clip frame has been shown,
+                                 in microseconds. */
 } object_t;
 
 
@@ -108,7 +118,8 @@ struct object_image *get_object_image (object_t *object);
 /**
  * Change the graphic associated with an object.
  *
- * This will instantly update the object image.
+ * This will instantly update the object image, and stops any
+ * animation clip the object was playing.
  *
  * @note  In order to make an object have no physical presence on the
  *        map, change its tag to 0.
@@ -136,6 +147,53 @@ set_object_image (object_t *object,
 		  int16_t image_y, uint16_t width, uint16_t height);
 
 
+/**
+ * Change the on-image rectangle of an object's graphic, keeping the
+ * same image.
+ *
+ * The object's base (the bottom edge of its graphic) stays where it
+ * is if the height changes.
+ *
+ * @param object    Pointer to the object to change.
+ * @param image_x   X co-ordinate of the left edge of the on-image
+ *                  rectangle, in pixels.
+ * @param image_y   Y co-ordinate of the top edge of the on-image
+ *                  rectangle, in pixels.
+ * @param width     Width of the image rectangle to render, in
+ *                  pixels.
+ * @param height    Height of the image rectangle to render, in
+ *                  pixels.
+ */
+void
+set_object_image_rect (object_t *object,
+                       int16_t image_x,
+                       int16_t image_y,
+                       uint16_t width,
+                       uint16_t height);
+
+
+/**
+ * Start an object playing an animation clip from its first frame.
+ *
+ * @param object  Pointer to the object to animate.
+ * @param clip    ID of the clip, or NULL_CLIP to stop animating the
+ *                object, leaving its current frame showing.
+ */
+void set_object_clip (object_t *object, clip_id_t clip);
+
+
+/**
+ * Advance an object's animation by an amount of time.
+ *
+ * @param object  Pointer to the object to animate.
+ * @param delta   Time to advance by, in microseconds.
+ *
+ * @return  true if the object's graphic has changed frame; false
+ *          otherwise, including if the object is not animated.
+ */
+bool advance_object_animation (object_t *object, uint32_t delta);
+
+
 /**
  * Retrieve the object's co-ordinates on-map.
  *
@@ -0,0 +1,778 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/field/particle.c
+ * @author  agent
+ * @brief   The particle system.
+ */
+
+#include "../crystals.h"
+
+/* The SIMD motion kernels need GCC's per-function target attributes;
+   elsewhere only the scalar kernel is built. */
+#if defined (__GNUC__) \
+  && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) \
+  && (defined (__i386__) || defined (__x86_64__))
+#define PARTICLE_SIMD
+#include <immintrin.h>
+#endif
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  PARTICLES_INITIAL_CAPACITY = 64  /**< Particles an emitter starts
+                                      with room for. */
+};
+
+
+/* -- STATIC GLOBAL VARIABLES -- */
+
+static GSList *sg_emitters;  /**< List of particle_emitter_t. */
+
+/** Motion kernel chosen for the processor by init_particles. */
+static void (*sg_step_particles) (particle_emitter_t *emitter,
+                                  uint32_t start);
+
+static uint32_t sg_batch_capacity;  /**< Entries the batch arrays can
+                                       hold. */
+static int16_t *sg_batch_image_x;   /**< On-image X co-ordinates of the
+                                       batch being drawn. */
+static int16_t *sg_batch_image_y;   /**< On-image Y co-ordinates of the
+                                       batch being drawn. */
+static int16_t *sg_batch_screen_x;  /**< On-screen X co-ordinates of
+                                       the batch being drawn. */
+static int16_t *sg_batch_screen_y;  /**< On-screen Y co-ordinates of
+                                       the batch being drawn. */
+
+
+/* -- STATIC DECLARATIONS -- */
+
+/**
+ * Moves particles on by one frame, and counts down their lives,
+ * one particle at a time.
+ *
+ * @param emitter  Pointer to the emitter owning the particles.
+ * @param start    Index of the first particle to move.
+ */
+static void step_particles_scalar (particle_emitter_t *emitter,
+                                   uint32_t start);
+
+
+#ifdef PARTICLE_SIMD
+/**
+ * Moves particles on by one frame, four at a time, using SSE2.
+ *
+ * @param emitter  Pointer to the emitter owning the particles.
+ * @param start    Index of the first particle to move.
+ */
+static void __attribute__ ((target ("sse2")))
+step_particles_sse2 (particle_emitter_t *emitter, uint32_t start);
+
+
+/**
+ * Moves particles on by one frame, eight at a time, using AVX2.
+ *
+ * @param emitter  Pointer to the emitter owning the particles.
+ * @param start    Index of the first particle to move.
+ */
+static void __attribute__ ((target ("avx2")))
+step_particles_avx2 (particle_emitter_t *emitter, uint32_t start);
+#endif /* PARTICLE_SIMD */
+
+
+/**
+ * Removes dead particles, works out the animation frames of the
+ * rest, and finds the area they cover.
+ *
+ * @param emitter  Pointer to the emitter.
+ * @param left     Pointer to a variable to hold the left edge of
+ *                 the covered area, in map pixels.
+ * @param top      Pointer to a variable to hold the top edge.
+ * @param right    Pointer to a variable to hold the right edge
+ *                 (exclusive).
+ * @param bottom   Pointer to a variable to hold the bottom edge
+ *                 (exclusive).
+ *
+ * @return  true if any particles are left; false otherwise, in
+ *          which case the area is undefined.
+ */
+static bool expire_particles (particle_emitter_t *emitter,
+                              int32_t *left,
+                              int32_t *top,
+                              int32_t *right,
+                              int32_t *bottom);
+
+
+/**
+ * Marks the area an emitter's particles covered last frame, together
+ * with the area they cover now, as one dirty rectangle.
+ *
+ * @param emitter  Pointer to the emitter.
+ * @param visible  Whether any particles are left.
+ * @param left     Left edge of the covered area, in map pixels.
+ * @param top      Top edge of the covered area.
+ * @param right    Right edge (exclusive) of the covered area.
+ * @param bottom   Bottom edge (exclusive) of the covered area.
+ */
+static void mark_particle_area (particle_emitter_t *emitter,
+                                bool visible,
+                                int32_t left,
+                                int32_t top,
+                                int32_t right,
+                                int32_t bottom);
+
+
+/**
+ * Makes room in an emitter's arrays for further particles.
+ *
+ * @param emitter  Pointer to the emitter.
+ * @param count    Number of particles to make room for.
+ */
+static void reserve_particles (particle_emitter_t *emitter,
+                               uint32_t count);
+
+
+/**
+ * Makes room in the drawing batch arrays.
+ *
+ * @param count  Number of entries to make room for.
+ */
+static void reserve_batch (uint32_t count);
+
+
+/**
+ * Resizes one array, aborting if memory runs out.
+ *
+ * @param array     The array to resize.
+ * @param capacity  The new number of elements.
+ * @param size      The size of each element.
+ *
+ * @return  the resized array.
+ */
+static void *resize_array (void *array, uint32_t capacity, size_t size);
+
+
+/**
+ * Converts a particle position into whole map pixels, rounding
+ * down.
+ *
+ * @param position  The position, in PARTICLE_SUBPIXELS per pixel.
+ *
+ * @return  the position in map pixels.
+ */
+static int32_t particle_pixel (int32_t position);
+
+
+/**
+ * Picks a random offset.
+ *
+ * @param spread  Largest magnitude of the offset.
+ *
+ * @return  a random number from -spread to spread inclusive.
+ */
+static int32_t random_spread (int32_t spread);
+
+
+/**
+ * Frees a particle emitter and its particles.
+ *
+ * @param emitter  Pointer to the emitter.
+ */
+static void free_particle_emitter (gpointer emitter);
+
+
+/* -- DEFINITIONS -- */
+
+/* Initialises the particle system. */
+void
+init_particles (void)
+{
+  sg_emitters = NULL;
+  sg_step_particles = step_particles_scalar;
+
+#ifdef PARTICLE_SIMD
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    sg_step_particles = step_particles_avx2;
+  else if (__builtin_cpu_supports ("sse2"))
+    sg_step_particles = step_particles_sse2;
+#endif /* PARTICLE_SIMD */
+}
+
+
+/* Creates a particle emitter. */
+particle_emitter_t *
+add_particle_emitter (const char filename[],
+                      uint16_t frame_width,
+                      uint16_t frame_height,
+                      uint16_t num_frames,
+                      uint16_t frame_duration,
+                      int32_t lifetime)
+{
+  particle_emitter_t *emitter;
+
+  g_assert (filename != NULL);
+  g_assert (frame_width > 0 && frame_height > 0);
+  g_assert (num_frames > 0 && frame_duration > 0);
+  g_assert (lifetime > 0);
+
+  emitter = xcalloc (1, sizeof (particle_emitter_t));
+  emitter->image = load_image (filename);
+  emitter->frame_width = frame_width;
+  emitter->frame_height = frame_height;
+  emitter->num_frames = num_frames;
+  emitter->frame_duration = frame_duration;
+  emitter->lifetime = lifetime;
+
+  emitter->capacity = PARTICLES_INITIAL_CAPACITY;
+  emitter->x = xcalloc (emitter->capacity, sizeof (int32_t));
+  emitter->y = xcalloc (emitter->capacity, sizeof (int32_t));
+  emitter->dx = xcalloc (emitter->capacity, sizeof (int32_t));
+  emitter->dy = xcalloc (emitter->capacity, sizeof (int32_t));
+  emitter->life = xcalloc (emitter->capacity, sizeof (int32_t));
+  emitter->frame = xcalloc (emitter->capacity, sizeof (uint16_t));
+
+  sg_emitters = g_slist_append (sg_emitters, emitter);
+
+  return emitter;
+}
+
+
+/* Sets the area a particle emitter emits particles in. */
+void
+set_particle_emitter_origin (particle_emitter_t *emitter,
+                             int32_t x,
+                             int32_t y,
+                             int32_t spread_x,
+                             int32_t spread_y)
+{
+  g_assert (emitter != NULL);
+  g_assert (spread_x >= 0 && spread_y >= 0);
+
+  emitter->origin_x = x;
+  emitter->origin_y = y;
+  emitter->spread_x = spread_x;
+  emitter->spread_y = spread_y;
+}
+
+
+/* Sets how a particle emitter's particles move. */
+void
+set_particle_emitter_velocity (particle_emitter_t *emitter,
+                               int32_t dx,
+                               int32_t dy,
+                               int32_t spread_x,
+                               int32_t spread_y,
+                               int32_t gravity)
+{
+  g_assert (emitter != NULL);
+  g_assert (spread_x >= 0 && spread_y >= 0);
+
+  emitter->velocity_x = dx;
+  emitter->velocity_y = dy;
+  emitter->velocity_spread_x = spread_x;
+  emitter->velocity_spread_y = spread_y;
+  emitter->gravity = gravity;
+}
+
+
+/* Sets how many particles an emitter emits every frame. */
+void
+set_particle_emitter_rate (particle_emitter_t *emitter, uint32_t rate)
+{
+  g_assert (emitter != NULL);
+
+  emitter->rate = rate;
+}
+
+
+/* Emits a burst of particles at once. */
+void
+emit_particles (particle_emitter_t *emitter, uint32_t count)
+{
+  uint32_t i;
+
+  g_assert (emitter != NULL);
+
+  reserve_particles (emitter, count);
+
+  for (i = emitter->count; i < emitter->count + count; i += 1)
+    {
+      emitter->x[i] = (emitter->origin_x
+                       + random_spread (emitter->spread_x))
+        * PARTICLE_SUBPIXELS;
+      emitter->y[i] = (emitter->origin_y
+                       + random_spread (emitter->spread_y))
+        * PARTICLE_SUBPIXELS;
+      emitter->dx[i] = emitter->velocity_x
+        + random_spread (emitter->velocity_spread_x);
+      emitter->dy[i] = emitter->velocity_y
+        + random_spread (emitter->velocity_spread_y);
+      emitter->life[i] = emitter->lifetime;
+      emitter->frame[i] = 0;
+    }
+
+  emitter->count += count;
+}
+
+
+/* Removes and frees a particle emitter. */
+void
+remove_particle_emitter (particle_emitter_t *emitter)
+{
+  g_assert (emitter != NULL);
+
+  /* Clear away whatever the emitter last drew. */
+  mark_particle_area (emitter, false, 0, 0, 0, 0);
+
+  sg_emitters = g_slist_remove (sg_emitters, emitter);
+  free_particle_emitter (emitter);
+}
+
+
+/* Advances every particle by one field frame. */
+void
+update_particles (bool emit)
+{
+  GSList *node;
+
+  for (node = sg_emitters; node != NULL; node = node->next)
+    {
+      particle_emitter_t *emitter = node->data;
+      int32_t left = 0;
+      int32_t top = 0;
+      int32_t right = 0;
+      int32_t bottom = 0;
+      bool visible;
+
+      if (emit && emitter->rate > 0)
+        emit_particles (emitter, emitter->rate);
+
+      (*sg_step_particles) (emitter, 0);
+
+      visible = expire_particles (emitter, &left, &top, &right, &bottom);
+      mark_particle_area (emitter, visible, left, top, right, bottom);
+    }
+}
+
+
+/* Draws every particle over a map view. */
+void
+render_particles (mapview_t *mapview)
+{
+  int32_t view_left;
+  int32_t view_top;
+  int32_t view_right;
+  int32_t view_bottom;
+  GSList *node;
+
+  g_assert (mapview != NULL);
+
+  /* Particles are effects on the playing area, so scaled-down views
+     (such as overviews) leave them out. */
+  if (mapview->scale != 1)
+    return;
+
+  view_left = (int32_t) mapview->x_offset;
+  view_top = (int32_t) mapview->y_offset;
+  view_right = view_left + (int32_t) mapview->viewport_width;
+  view_bottom = view_top + (int32_t) mapview->viewport_height;
+
+  set_clip_rectangle (mapview->viewport_x,
+                      mapview->viewport_y,
+                      mapview->viewport_width,
+                      mapview->viewport_height);
+
+  for (node = sg_emitters; node != NULL; node = node->next)
+    {
+      particle_emitter_t *emitter = node->data;
+      image_t *image;
+      uint32_t batch_size = 0;
+      uint32_t i;
+
+      if (emitter->count == 0)
+        continue;
+
+      image = get_image (emitter->image);
+
+      reserve_batch (emitter->count);
+
+      for (i = 0; i < emitter->count; i += 1)
+        {
+          int32_t left = particle_pixel (emitter->x[i])
+            - (emitter->frame_width / 2);
+          int32_t top = particle_pixel (emitter->y[i])
+            - (emitter->frame_height / 2);
+
+          /* Leave out particles off the view before their
+             co-ordinates are narrowed to screen range. */
+          if (left >= view_right || top >= view_bottom
+              || left + emitter->frame_width <= view_left
+              || top + emitter->frame_height <= view_top)
+            continue;
+
+          sg_batch_image_x[batch_size] =
+            (int16_t) (emitter->frame[i] * emitter->frame_width);
+          sg_batch_image_y[batch_size] = 0;
+          sg_batch_screen_x[batch_size] =
+            (int16_t) (mapview->viewport_x + left - view_left);
+          sg_batch_screen_y[batch_size] =
+            (int16_t) (mapview->viewport_y + top - view_top);
+          batch_size += 1;
+        }
+
+      draw_image_batch (image,
+                        emitter->frame_width,
+                        emitter->frame_height,
+                        batch_size,
+                        sg_batch_image_x,
+                        sg_batch_image_y,
+                        sg_batch_screen_x,
+                        sg_batch_screen_y);
+    }
+
+  clear_clip_rectangle ();
+}
+
+
+/* Removes every particle emitter. */
+void
+cleanup_particles (void)
+{
+  g_slist_free_full (sg_emitters, free_particle_emitter);
+  sg_emitters = NULL;
+
+  free (sg_batch_image_x);
+  free (sg_batch_image_y);
+  free (sg_batch_screen_x);
+  free (sg_batch_screen_y);
+  sg_batch_image_x = sg_batch_image_y = NULL;
+  sg_batch_screen_x = sg_batch_screen_y = NULL;
+  sg_batch_capacity = 0;
+}
+
+
+/* -- STATIC DEFINITIONS -- */
+
+/* Moves particles on by one frame, one at a time. */
+static void
+step_particles_scalar (particle_emitter_t *emitter, uint32_t start)
+{
+  uint32_t i;
+
+  for (i = start; i < emitter->count; i += 1)
+    {
+      emitter->x[i] += emitter->dx[i];
+      emitter->y[i] += emitter->dy[i];
+      emitter->dy[i] += emitter->gravity;
+      emitter->life[i] -= 1;
+    }
+}
+
+
+#ifdef PARTICLE_SIMD
+/* Moves particles on by one frame, using SSE2. */
+static void
+step_particles_sse2 (particle_emitter_t *emitter, uint32_t start)
+{
+  __m128i gravity = _mm_set1_epi32 (emitter->gravity);
+  __m128i one = _mm_set1_epi32 (1);
+  uint32_t i;
+
+  for (i = start; i + 4 <= emitter->count; i += 4)
+    {
+      __m128i x = _mm_loadu_si128 ((__m128i *) (emitter->x + i));
+      __m128i y = _mm_loadu_si128 ((__m128i *) (emitter->y + i));
+      __m128i dx = _mm_loadu_si128 ((__m128i *) (emitter->dx + i));
+      __m128i dy = _mm_loadu_si128 ((__m128i *) (emitter->dy + i));
+      __m128i life = _mm_loadu_si128 ((__m128i *) (emitter->life + i));
+
+      _mm_storeu_si128 ((__m128i *) (emitter->x + i),
+                        _mm_add_epi32 (x, dx));
+      _mm_storeu_si128 ((__m128i *) (emitter->y + i),
+                        _mm_add_epi32 (y, dy));
+      _mm_storeu_si128 ((__m128i *) (emitter->dy + i),
+                        _mm_add_epi32 (dy, gravity));
+      _mm_storeu_si128 ((__m128i *) (emitter->life + i),
+                        _mm_sub_epi32 (life, one));
+    }
+
+  step_particles_scalar (emitter, i);
+}
+
+
+/* Moves particles on by one frame, using AVX2. */
+static void
+step_particles_avx2 (particle_emitter_t *emitter, uint32_t start)
+{
+  __m256i gravity = _mm256_set1_epi32 (emitter->gravity);
+  __m256i one = _mm256_set1_epi32 (1);
+  uint32_t i;
+
+  for (i = start; i + 8 <= emitter->count; i += 8)
+    {
+      __m256i x = _mm256_loadu_si256 ((__m256i *) (emitter->x + i));
+      __m256i y = _mm256_loadu_si256 ((__m256i *) (emitter->y + i));
+      __m256i dx = _mm256_loadu_si256 ((__m256i *) (emitter->dx + i));
+      __m256i dy = _mm256_loadu_si256 ((__m256i *) (emitter->dy + i));
+      __m256i life =
+        _mm256_loadu_si256 ((__m256i *) (emitter->life + i));
+
+      _mm256_storeu_si256 ((__m256i *) (emitter->x + i),
+                           _mm256_add_epi32 (x, dx));
+      _mm256_storeu_si256 ((__m256i *) (emitter->y + i),
+                           _mm256_add_epi32 (y, dy));
+      _mm256_storeu_si256 ((__m256i *) (emitter->dy + i),
+                           _mm256_add_epi32 (dy, gravity));
+      _mm256_storeu_si256 ((__m256i *) (emitter->life + i),
+                           _mm256_sub_epi32 (life, one));
+    }
+
+  step_particles_scalar (emitter, i);
+}
+#endif /* PARTICLE_SIMD */
+
+
+/* Removes dead particles and finds the area the rest cover. */
+static bool
+expire_particles (particle_emitter_t *emitter,
+                  int32_t *left,
+                  int32_t *top,
+                  int32_t *right,
+                  int32_t *bottom)
+{
+  int32_t min_x = 0;
+  int32_t min_y = 0;
+  int32_t max_x = 0;
+  int32_t max_y = 0;
+  uint32_t i = 0;
+
+  while (i < emitter->count)
+    {
+      int32_t x;
+      int32_t y;
+
+      /* Fill dead particles' slots from the end, keeping the arrays
+         dense. */
+      if (emitter->life[i] <= 0)
+        {
+          uint32_t last = emitter->count - 1;
+
+          emitter->x[i] = emitter->x[last];
+          emitter->y[i] = emitter->y[last];
+          emitter->dx[i] = emitter->dx[last];
+          emitter->dy[i] = emitter->dy[last];
+          emitter->life[i] = emitter->life[last];
+          emitter->count = last;
+          continue;
+        }
+
+      emitter->frame[i] =
+        (uint16_t) (((emitter->lifetime - emitter->life[i])
+                     / emitter->frame_duration) % emitter->num_frames);
+
+      x = particle_pixel (emitter->x[i]);
+      y = particle_pixel (emitter->y[i]);
+
+      if (i == 0)
+        {
+          min_x = max_x = x;
+          min_y = max_y = y;
+        }
+      else
+        {
+          min_x = MIN (min_x, x);
+          min_y = MIN (min_y, y);
+          max_x = MAX (max_x, x);
+          max_y = MAX (max_y, y);
+        }
+
+      i += 1;
+    }
+
+  if (emitter->count == 0)
+    return false;
+
+  *left = min_x - (emitter->frame_width / 2);
+  *top = min_y - (emitter->frame_height / 2);
+  *right = max_x - (emitter->frame_width / 2) + emitter->frame_width;
+  *bottom = max_y - (emitter->frame_height / 2) + emitter->frame_height;
+
+  return true;
+}
+
+
+/* Marks the old and new particle areas as one dirty rectangle. */
+static void
+mark_particle_area (particle_emitter_t *emitter,
+                    bool visible,
+                    int32_t left,
+                    int32_t top,
+                    int32_t right,
+                    int32_t bottom)
+{
+  int32_t dirty_left = left;
+  int32_t dirty_top = top;
+  int32_t dirty_right = right;
+  int32_t dirty_bottom = bottom;
+
+  if (emitter->drawn)
+    {
+      if (visible)
+        {
+          dirty_left = MIN (dirty_left, emitter->drawn_left);
+          dirty_top = MIN (dirty_top, emitter->drawn_top);
+          dirty_right = MAX (dirty_right, emitter->drawn_right);
+          dirty_bottom = MAX (dirty_bottom, emitter->drawn_bottom);
+        }
+      else
+        {
+          dirty_left = emitter->drawn_left;
+          dirty_top = emitter->drawn_top;
+          dirty_right = emitter->drawn_right;
+          dirty_bottom = emitter->drawn_bottom;
+        }
+    }
+  else if (!visible)
+    return;
+
+  mark_field_dirty_rect (dirty_left, dirty_top,
+                         (uint32_t) (dirty_right - dirty_left),
+                         (uint32_t) (dirty_bottom - dirty_top));
+
+  emitter->drawn = visible;
+  emitter->drawn_left = left;
+  emitter->drawn_top = top;
+  emitter->drawn_right = right;
+  emitter->drawn_bottom = bottom;
+}
+
+
+/* Makes room in an emitter's arrays for further particles. */
+static void
+reserve_particles (particle_emitter_t *emitter, uint32_t count)
+{
+  uint32_t capacity = emitter->capacity;
+
+  if (emitter->count + count <= capacity)
+    return;
+
+  while (emitter->count + count > capacity)
+    capacity *= 2;
+
+  emitter->x = resize_array (emitter->x, capacity, sizeof (int32_t));
+  emitter->y = resize_array (emitter->y, capacity, sizeof (int32_t));
+  emitter->dx = resize_array (emitter->dx, capacity, sizeof (int32_t));
+  emitter->dy = resize_array (emitter->dy, capacity, sizeof (int32_t));
+  emitter->life = resize_array (emitter->life, capacity,
+                                sizeof (int32_t));
+  emitter->frame = resize_array (emitter->frame, capacity,
+                                 sizeof (uint16_t));
+  emitter->capacity = capacity;
+}
+
+
+/* Makes room in the drawing batch arrays. */
+static void
+reserve_batch (uint32_t count)
+{
+  if (count <= sg_batch_capacity)
+    return;
+
+  sg_batch_capacity = MAX (count, sg_batch_capacity * 2);
+
+  sg_batch_image_x = resize_array (sg_batch_image_x, sg_batch_capacity,
+                                   sizeof (int16_t));
+  sg_batch_image_y = resize_array (sg_batch_image_y, sg_batch_capacity,
+                                   sizeof (int16_t));
+  sg_batch_screen_x = resize_array (sg_batch_screen_x, sg_batch_capacity,
+                                    sizeof (int16_t));
+  sg_batch_screen_y = resize_array (sg_batch_screen_y, sg_batch_capacity,
+                                    sizeof (int16_t));
+}
+
+
+/* Resizes one array. */
+static void *
+resize_array (void *array, uint32_t capacity, size_t size)
+{
+  array = realloc (array, capacity * size);
+  g_assert (array != NULL);
+
+  return array;
+}
+
+
+/* Converts a particle position into whole map pixels. */
+static int32_t
+particle_pixel (int32_t position)
+{
+  if (position >= 0)
+    return position / PARTICLE_SUBPIXELS;
+
+  return -((PARTICLE_SUBPIXELS - 1 - position) / PARTICLE_SUBPIXELS);
+}
+
+
+/* Picks a random offset. */
+static int32_t
+random_spread (int32_t spread)
+{
+  if (spread == 0)
+    return 0;
+
+  return g_random_int_range (-spread, spread + 1);
+}
+
+
+/* Frees a particle emitter and its particles. */
+static void
+free_particle_emitter (gpointer emitter)
+{
+  particle_emitter_t *emitterc = emitter;
+
+  free (emitterc->x);
+  free (emitterc->y);
+  free (emitterc->dx);
+  free (emitterc->dy);
+  free (emitterc->life);
+  free (emitterc->frame);
+  free (emitterc);
+}
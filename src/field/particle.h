@@ -0,0 +1,260 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/field/particle.h
+ * @author  agent
+ * @brief   Prototypes and declarations for the particle system.
+ *
+ * Particles are short-lived, unscripted sprites, such as rain or
+ * sparkles, produced in their thousands by emitters.  They are far
+ * too numerous to be objects.
+ *
+ * Each emitter keeps its particles as separate arrays of each
+ * attribute, so the per-frame motion update runs over plain runs of
+ * integers, several particles at a time where the processor allows.
+ * Every emitter draws all its particles in one batch, and marks one
+ * dirty rectangle per frame: the union of the areas its particles
+ * covered on the previous frame and cover now.
+ *
+ * Positions and velocities are in fixed point, with
+ * PARTICLE_SUBPIXELS units to a map pixel.  Times are in field
+ * frames.
+ */
+
+#ifndef _PARTICLE_H
+#define _PARTICLE_H
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  PARTICLE_SUBPIXELS = 256  /**< Position units per map pixel. */
+};
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * A particle emitter, and the particles it has emitted.
+ */
+typedef struct particle_emitter
+{
+  image_handle_t image;     /**< Handle of the particle image. */
+  uint16_t frame_width;     /**< Width of one animation frame. */
+  uint16_t frame_height;    /**< Height of one animation frame. */
+  uint16_t num_frames;      /**< Number of animation frames, laid
+                               left to right in the image. */
+  uint16_t frame_duration;  /**< Field frames per animation frame. */
+  int32_t lifetime;         /**< Field frames each particle lives. */
+
+  int32_t origin_x;         /**< X co-ordinate particles are emitted
+                               around, in map pixels. */
+  int32_t origin_y;         /**< Y co-ordinate particles are emitted
+                               around, in map pixels. */
+  int32_t spread_x;         /**< Largest horizontal distance from the
+                               origin, in map pixels. */
+  int32_t spread_y;         /**< Largest vertical distance from the
+                               origin, in map pixels. */
+  int32_t velocity_x;       /**< Mean X velocity of new particles. */
+  int32_t velocity_y;       /**< Mean Y velocity of new particles. */
+  int32_t velocity_spread_x;  /**< Largest difference from the mean X
+                                 velocity. */
+  int32_t velocity_spread_y;  /**< Largest difference from the mean Y
+                                 velocity. */
+  int32_t gravity;          /**< Added to each particle's Y velocity
+                               every frame. */
+  uint32_t rate;            /**< Particles emitted every frame. */
+
+  uint32_t count;           /**< Number of live particles. */
+  uint32_t capacity;        /**< Number of particles the arrays can
+                               hold. */
+  int32_t *x;               /**< X co-ordinates of the particles'
+                               centres. */
+  int32_t *y;               /**< Y co-ordinates of the particles'
+                               centres. */
+  int32_t *dx;              /**< X velocities of the particles. */
+  int32_t *dy;              /**< Y velocities of the particles. */
+  int32_t *life;            /**< Frames each particle has left. */
+  uint16_t *frame;          /**< Animation frame of each particle. */
+
+  bool drawn;               /**< Whether any particles were on the
+                               map last frame. */
+  int32_t drawn_left;       /**< Left edge of the area covered last
+                               frame, in map pixels. */
+  int32_t drawn_top;        /**< Top edge of the area covered last
+                               frame, in map pixels. */
+  int32_t drawn_right;      /**< Right edge (exclusive) of the area
+                               covered last frame. */
+  int32_t drawn_bottom;     /**< Bottom edge (exclusive) of the area
+                               covered last frame. */
+} particle_emitter_t;
+
+
+/* -- DECLARATIONS -- */
+
+/**
+ * Initialises the particle system.
+ */
+void init_particles (void);
+
+
+/**
+ * Creates a particle emitter.
+ *
+ * The emitter starts at the map origin, with no velocity, and emits
+ * nothing until given a rate or told to emit particles.
+ *
+ * @param filename        Filename of the particle image, relative to
+ *                        the graphics path.
+ * @param frame_width     Width of one animation frame, in pixels.
+ * @param frame_height    Height of one animation frame, in pixels.
+ * @param num_frames      Number of animation frames, laid left to
+ *                        right in the image.
+ * @param frame_duration  Field frames to show each animation frame.
+ * @param lifetime        Field frames each particle lives.
+ *
+ * @return  a pointer to the new emitter.
+ */
+particle_emitter_t *add_particle_emitter (const char filename[],
+                                          uint16_t frame_width,
+                                          uint16_t frame_height,
+                                          uint16_t num_frames,
+                                          uint16_t frame_duration,
+                                          int32_t lifetime);
+
+
+/**
+ * Sets the area a particle emitter emits particles in.
+ *
+ * @param emitter   Pointer to the emitter.
+ * @param x         X co-ordinate of the centre of the area, in map
+ *                  pixels.
+ * @param y         Y co-ordinate of the centre of the area, in map
+ *                  pixels.
+ * @param spread_x  Largest horizontal distance from the centre, in
+ *                  map pixels.
+ * @param spread_y  Largest vertical distance from the centre, in map
+ *                  pixels.
+ */
+void set_particle_emitter_origin (particle_emitter_t *emitter,
+                                  int32_t x,
+                                  int32_t y,
+                                  int32_t spread_x,
+                                  int32_t spread_y);
+
+
+/**
+ * Sets how a particle emitter's particles move.
+ *
+ * Velocities are in PARTICLE_SUBPIXELS per field frame.
+ *
+ * @param emitter   Pointer to the emitter.
+ * @param dx        Mean X velocity of new particles.
+ * @param dy        Mean Y velocity of new particles.
+ * @param spread_x  Largest difference from the mean X velocity.
+ * @param spread_y  Largest difference from the mean Y velocity.
+ * @param gravity   Added to each particle's Y velocity every frame.
+ */
+void set_particle_emitter_velocity (particle_emitter_t *emitter,
+                                    int32_t dx,
+                                    int32_t dy,
+                                    int32_t spread_x,
+                                    int32_t spread_y,
+                                    int32_t gravity);
+
+
+/**
+ * Sets how many particles an emitter emits every frame.
+ *
+ * @param emitter  Pointer to the emitter.
+ * @param rate     Particles to emit every field frame, or 0 to emit
+ *                 only on request.
+ */
+void set_particle_emitter_rate (particle_emitter_t *emitter,
+                                uint32_t rate);
+
+
+/**
+ * Emits a burst of particles at once.
+ *
+ * @param emitter  Pointer to the emitter.
+ * @param count    Number of particles to emit.
+ */
+void emit_particles (particle_emitter_t *emitter, uint32_t count);
+
+
+/**
+ * Removes and frees a particle emitter, along with its particles.
+ *
+ * @param emitter  Pointer to the emitter.
+ */
+void remove_particle_emitter (particle_emitter_t *emitter);
+
+
+/**
+ * Advances every particle by one field frame, emitting and expiring
+ * particles as needed, and marks the areas to redraw dirty.
+ *
+ * This should be called once per field frame, before the map is
+ * rendered.
+ *
+ * @param emit  Whether emitters with a rate emit particles this
+ *              frame.  Particles already emitted carry on either
+ *              way.
+ */
+void update_particles (bool emit);
+
+
+/**
+ * Draws every particle over a map view.
+ *
+ * This should be called straight after the map view is rendered.
+ *
+ * @param mapview  Pointer to the map view.
+ */
+void render_particles (mapview_t *mapview);
+
+
+/**
+ * Removes every particle emitter and frees the particle system.
+ */
+void cleanup_particles (void);
+
+
+#endif /* not _PARTICLE_H */
@@ -83,345 +83,2092 @@ const uint16_t FONT_W = 10;
 const uint16_t FONT_H = 10;
 
 
+/**
+ * Number of drawing commands the command buffer initially has room
+ * for.  The buffer doubles in size whenever it fills up.
+ */
+enum
+{
+  DRAW_COMMANDS_INITIAL_CAPACITY = 256
+};
+
+
+/**
+ * Number of images the image table initially has room for.  The
+ * table doubles in size whenever it fills up.
+ */
+enum
+{
+  IMAGE_TABLE_INITIAL_CAPACITY = 64
+};
+
+
+/**
+ * Number of command buffers: one being recorded, one waiting for the
+ * render thread, and one being drawn by it.
+ */
+enum
+{
+  NUM_DRAW_FRAMES = 3
+};
+
+
+/**
+ * Sizes of the cache of strings rendered by write_string.
+ */
+enum
+{
+  TEXT_CACHE_SIZE = 16,        /**< Most strings kept rendered at
+                                  once. */
+
+  TEXT_CACHE_MAX_CHARS = 128,  /**< Longest string kept rendered, in
+                                  characters; longer ones are drawn a
+                                  glyph at a time. */
+
+  TEXT_CACHE_ROUNDING = 16     /**< Rendered strings have room for a
+                                  multiple of this many characters,
+                                  so they can grow a little without
+                                  being made again. */
+};
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * An entry in the image table.
+ */
+typedef struct image_entry
+{
+  char *filename;  /**< Filename of the image, relative to the
+                      graphics path. */
+  image_t *data;   /**< The image data, or NULL if the image has
+                      been deleted from the cache. */
+  uint32_t bytes;  /**< Memory the image data takes up, in bytes, or
+                      0 if it is not loaded. */
+  uint32_t pins;   /**< Number of pin_image calls not yet undone. */
+  uint32_t last_used; /**< Value of sg_image_clock when the image was
+                         last used. */
+} image_entry_t;
+
+
+/**
+ * A buffer of drawing commands, holding one or more frames' worth of
+ * drawing in order.
+ */
+typedef struct draw_frame
+{
+  draw_command_t *commands; /**< The commands. */
+  uint32_t num_commands;    /**< Number of commands in the buffer. */
+  uint32_t capacity;        /**< Number of commands the buffer can
+                               hold. */
+} draw_frame_t;
+
+
+/**
+ * A string written by write_string, rendered into an image so that
+ * writing it again is a single blit.
+ */
+typedef struct text_cache_entry
+{
+  image_t *image;      /**< The rendered string, or NULL if the entry
+                          is unused. */
+  int16_t x;           /**< X co-ordinate the string is written at. */
+  int16_t y;           /**< Y co-ordinate the string is written at. */
+  uint16_t capacity;   /**< Number of glyph cells in the image. */
+  uint32_t last_used;  /**< Value of sg_image_clock when the string
+                          was last written. */
+  char cells[TEXT_CACHE_MAX_CHARS]; /**< The character rendered in
+                                       each glyph cell, or '\0' if
+                                       the cell's contents are
+                                       unknown. */
+} text_cache_entry_t;
+
+
+/**
+ * An image being decoded ahead of use by preload_images.
+ */
+typedef struct image_preload
+{
+  image_handle_t image;  /**< Handle of the image. */
+  char *path;            /**< Absolute path of the image file. */
+  image_t *data;         /**< The decoded image, or NULL until a
+                            worker has decoded it. */
+} image_preload_t;
+
+
 /* -- STATIC GLOBAL VARIABLES -- */
 
-static GHashTable *sg_images;
+static GHashTable *sg_images; /**< Map from image filenames to
+                                 their handles, used only when
+                                 loading. */
+
+static image_entry_t *sg_image_table; /**< The image table, indexed by
+                                         handle minus 1. */
+
+static uint32_t sg_num_images; /**< Number of images in the table. */
+
+static uint32_t sg_image_table_capacity; /**< Number of images the
+                                            table can hold. */
+
+static image_handle_t sg_font; /**< Handle of the font image, or
+                                  NULL_IMAGE if not yet loaded. */
+
+static uint32_t sg_image_clock; /**< Number of frames presented,
+                                   used to date image uses. */
+
+static image_cache_stats_t sg_image_stats; /**< Image cache counts,
+                                              including the current
+                                              size and budget. */
+
+static draw_frame_t sg_frames[NUM_DRAW_FRAMES]; /**< The command
+                                                   buffers. */
+
+static draw_frame_t *sg_back_frame; /**< The buffer drawing functions
+                                       record into. */
+
+static draw_frame_t *sg_ready_frame; /**< The buffer last handed to
+                                        the render thread. */
+
+static draw_frame_t *sg_front_frame; /**< The buffer the render thread
+                                        is drawing. */
+
+static GThread *sg_render_thread; /**< The render thread, or NULL if
+                                     commands are carried out on the
+                                     calling thread. */
+
+static GMutex sg_frame_mutex; /**< Guards sg_ready_frame,
+                                 sg_front_frame, sg_frame_ready,
+                                 sg_rendering and sg_render_quit. */
+
+static GCond sg_frame_cond; /**< Signalled when a buffer is handed
+                               over or finished with. */
+
+static bool sg_frame_ready; /**< Whether sg_ready_frame holds commands
+                               the render thread has yet to take. */
+
+static bool sg_rendering; /**< Whether the render thread is drawing
+                             sg_front_frame. */
+
+static bool sg_render_quit; /**< Whether the render thread should
+                               stop once it has drawn everything. */
+
+static GMutex sg_window_mutex; /**< Held while presenting to, or
+                                  taking events from, the window. */
+
+static bool sg_window_locked; /**< Whether lock_window has been
+                                 called without unlock_window. */
+
+static bool sg_clip_enabled; /**< Whether drawing is clipped to the
+                                clipping rectangle. */
+
+static bool sg_drawing_to_image; /**< Whether drawing is going into an
+                                    image rather than the screen. */
+
+static int32_t sg_clip_left;   /**< Left edge of the clipping
+                                  rectangle. */
+static int32_t sg_clip_top;    /**< Top edge of the clipping
+                                  rectangle. */
+static int32_t sg_clip_right;  /**< Column right of the clipping
+                                  rectangle. */
+static int32_t sg_clip_bottom; /**< Row below the clipping
+                                  rectangle. */
+
+static transition_type_t sg_transition_type; /**< Style of the
+                                                current transition. */
+
+static uint16_t sg_transition_frames; /**< Length of the current
+                                         transition, in frames, or 0
+                                         if there is none. */
+
+static uint16_t sg_transition_frame; /**< Frames of the current
+                                        transition shown so far. */
+
+static text_cache_entry_t sg_text_cache[TEXT_CACHE_SIZE]; /**< Strings
+                                                             rendered
+                                                             by
+                                                             write_string. */
+
+static image_t *sg_text_blank; /**< A transparent glyph cell, copied
+                                  over cells of rendered strings to
+                                  clear them, or NULL if not yet
+                                  made. */
+
+static uint32_t sg_dump_every; /**< Frames presented between screen
+                                  dumps, or 0 to never dump. */
+
+static char *sg_dump_path; /**< Start of the path of each screen
+                              dump, which the frame number and .png
+                              are added to, or NULL. */
+
+static uint32_t sg_frames_presented; /**< Frames presented so far. */
+
+
+/* -- STATIC DECLARATIONS -- */
+
+/**
+ * Sets up scaling of the screen up to the window, as configured by
+ * the output_scale and output_filter keys of the gfx group.
+ */
+static void init_output_scale (void);
+
+
+/**
+ * Sets up dumping the screen every so many frames, as configured by
+ * the dump_every and dump_path keys of the gfx group.
+ */
+static void init_screen_dumps (void);
+
+
+/**
+ * Dumps the screen, if this is a frame the configuration asks to
+ * dump.
+ *
+ * This should be called once each frame is presented.
+ */
+static void dump_presented_frame (void);
+
+
+/**
+ * Starts the render thread, if the render_thread key of the gfx group
+ * asks for one and the graphics module can draw from it.
+ */
+static void init_render_thread (void);
+
+
+/**
+ * Draws the command buffers on the render thread until told to quit.
+ *
+ * @param ignored  Unused.
+ *
+ * @return  NULL.
+ */
+static gpointer render_frames (gpointer ignored);
+
+
+/**
+ * Hands the buffer being recorded to the render thread.
+ *
+ * If the render thread has not yet taken the last buffer handed to
+ * it, the commands are added to that buffer instead, so no drawing
+ * is lost.
+ */
+static void publish_draw_frame (void);
+
+
+/**
+ * Waits until the render thread has drawn everything handed to it.
+ */
+static void wait_for_render_thread (void);
+
+
+/**
+ * Appends the commands of one buffer to another, emptying the first.
+ *
+ * @param to    The buffer to append to.
+ * @param from  The buffer to take the commands from.
+ */
+static void append_draw_frame (draw_frame_t *to, draw_frame_t *from);
+
+
+/**
+ * Adds an entry for an image, not yet loaded, to the image table.
+ *
+ * @param filename  The filename of the image, relative from the
+ *                  graphics path.
+ *
+ * @return  the handle of the new entry.
+ */
+static image_handle_t add_image_entry (const char filename[]);
+
+
+/**
+ * Loads an image table entry's image from its resource file.
+ *
+ * @param entry  Pointer to the entry.  Its data must be NULL.
+ *
+ * @return  A pointer to the raw data of the image, which is also
+ *          stored in the entry.  If the image cannot be loaded, this
+ *          is a fatal error.
+ */
+static image_t *load_image_from_file (image_entry_t *entry);
+
+
+/**
+ * Places newly loaded data into an image table entry, keeping the
+ * cache within its budget.
+ *
+ * @param entry  Pointer to the entry.  Its data must be NULL.
+ * @param data   The loaded image data.
+ *
+ * @return  data.
+ */
+static image_t *install_image_data (image_entry_t *entry, image_t *data);
+
+
+/**
+ * Decodes one image for preload_images.
+ *
+ * This is run by the preload worker threads, and touches nothing but
+ * the preload itself and the graphics module's load_image_data.
+ *
+ * @param preload  Pointer to the image_preload_t to decode.
+ * @param ignored  Unused.
+ */
+static void decode_preload (gpointer preload, gpointer ignored);
+
+
+/**
+ * Works out how much memory an image takes up.
+ *
+ * @param data  The image data.
+ *
+ * @return  the size of the image's pixel data, in bytes, as well as
+ *          the graphics module can tell.
+ */
+static uint32_t get_image_bytes (image_t *data);
+
+
+/**
+ * Deletes the least recently used unpinned images until the image
+ * cache fits within its budget, or nothing more can be deleted.
+ *
+ * @param keep  Pointer to an entry that must not be deleted.
+ */
+static void trim_image_cache (image_entry_t *keep);
+
+
+/**
+ * Frees the data of an image table entry, leaving the entry itself.
+ *
+ * @param entry  Pointer to the entry.  Its data must not be NULL.
+ */
+static void unload_image_entry (image_entry_t *entry);
+
+
+/**
+ * Reserves the next free slot in the drawing command buffer,
+ * growing the buffer if needed.
+ *
+ * @param type  The type of the command to be enqueued.
+ *
+ * @return  A pointer to the new command, which the caller must
+ *          populate.
+ */
+static draw_command_t *enqueue_draw_command (draw_command_type_t type);
+
+
+/**
+ * Grows a drawing command buffer, if needed, so that it has room for
+ * a number of further commands.
+ *
+ * @param frame  The buffer to grow.
+ * @param count  The number of commands to make room for.
+ */
+static void reserve_draw_commands (draw_frame_t *frame, uint32_t count);
+
+
+/**
+ * Carries out, and then empties, a drawing command buffer.
+ *
+ * @param frame  The buffer to draw.
+ */
+static void execute_draw_frame (draw_frame_t *frame);
+
+
+/**
+ * Executes a run of image and rect commands, as one batch if the
+ * graphics module supports batched drawing.
+ *
+ * @param commands  The commands to execute.  These may be modified.
+ * @param count     The number of commands.
+ */
+static void execute_draw_batch (draw_command_t commands[],
+                                uint32_t count);
+
+
+/**
+ * Executes a single drawing command through the graphics module's
+ * individual functions.
+ *
+ * @param command  Pointer to the command to execute.
+ */
+static void execute_draw_command (draw_command_t *command);
+
+
+/**
+ * Clips a drawing rectangle to the clipping rectangle, if one is
+ * set.
+ *
+ * @param screen_x  Pointer to the X co-ordinate of the left edge of
+ *                  the rectangle on-screen.  May be modified.
+ * @param screen_y  Pointer to the Y co-ordinate of the top edge of
+ *                  the rectangle on-screen.  May be modified.
+ * @param width     Pointer to the width of the rectangle.  May be
+ *                  modified.
+ * @param height    Pointer to the height of the rectangle.  May be
+ *                  modified.
+ * @param image_x   Pointer to the X co-ordinate of the matching
+ *                  on-image rectangle, which is moved along with the
+ *                  screen rectangle, or NULL.
+ * @param image_y   Pointer to the Y co-ordinate of the matching
+ *                  on-image rectangle, or NULL.
+ *
+ * @return  true if any of the rectangle remains to be drawn; false
+ *          otherwise.
+ */
+static bool clip_draw_rectangle (int16_t *screen_x,
+                                 int16_t *screen_y,
+                                 uint16_t *width,
+                                 uint16_t *height,
+                                 int16_t *image_x,
+                                 int16_t *image_y);
+
+
+/**
+ * Draws one character of the standard font.
+ *
+ * @param font       The font image.
+ * @param character  The character to draw.
+ * @param x          X co-ordinate of the left edge of the glyph.
+ * @param y          Y co-ordinate of the top edge of the glyph.
+ */
+static void draw_glyph (image_t *font, char character,
+                        int16_t x, int16_t y);
+
+
+/**
+ * Finds the text cache entry for strings written at a position,
+ * taking over the entry left unused longest if there is none.
+ *
+ * @param x       X co-ordinate the string is written at.
+ * @param y       Y co-ordinate the string is written at.
+ * @param length  Length of the string, in characters.
+ *
+ * @return  the entry, whose image has room for the string, or NULL if
+ *          the string cannot be rendered into an image.
+ */
+static text_cache_entry_t *get_text_cache_entry (int16_t x,
+                                                 int16_t y,
+                                                 size_t length);
+
+
+/**
+ * Frees every string rendered by write_string.
+ */
+static void clear_text_cache (void);
+
+
+/* -- DEFINITIONS -- */
+
+/* Initialise the graphics subsystem. */
+
+void
+init_graphics (void)
+{
+  uint32_t i;
+
+  if (!load_module_gfx (cfg_get_str ("modules",
+                                    "graphics_module",
+                                    g_config),
+                        &g_modules))
+    {
+      fatal ("GRAPHICS - init_graphics - Could not load graphics module.");
+    }
+
+
+  /* Call on the graphics backend to create a screen. */
+  if (!(*g_modules.gfx.init_screen_internal)
+      (SCREEN_W, SCREEN_H, SCREEN_D))
+    {
+      fatal ("GRAPHICS - init_graphics - Could not init screen.");
+    }
+
+
+  init_output_scale ();
+  init_screen_dumps ();
+
+  /* Initialise the image table.  Its entries own the filenames the
+     hash table is keyed on. */
+  sg_images = g_hash_table_new (g_str_hash, g_str_equal);
+
+  sg_image_table_capacity = IMAGE_TABLE_INITIAL_CAPACITY;
+  sg_num_images = 0;
+  sg_image_table = xcalloc (sg_image_table_capacity,
+                            sizeof (image_entry_t));
+  sg_font = NULL_IMAGE;
+
+  sg_image_clock = 0;
+  memset (&sg_image_stats, 0, sizeof (image_cache_stats_t));
+  sg_image_stats.budget =
+    (uint32_t) MAX (0, cfg_get_int ("gfx", "image_cache_mb", g_config))
+    * 1024 * 1024;
+
+  /* Initialise the drawing command buffers. */
+  for (i = 0; i < NUM_DRAW_FRAMES; i += 1)
+    {
+      sg_frames[i].capacity = DRAW_COMMANDS_INITIAL_CAPACITY;
+      sg_frames[i].num_commands = 0;
+      sg_frames[i].commands = xcalloc (sg_frames[i].capacity,
+                                       sizeof (draw_command_t));
+    }
+
+  sg_back_frame = &(sg_frames[0]);
+  sg_ready_frame = &(sg_frames[1]);
+  sg_front_frame = &(sg_frames[2]);
+
+  sg_clip_enabled = false;
+  sg_drawing_to_image = false;
+
+  memset (sg_text_cache, 0, sizeof (sg_text_cache));
+  sg_text_blank = NULL;
+
+  init_render_thread ();
+}
+
+
+/* Starts the render thread, if configured and the module allows it. */
+static void
+init_render_thread (void)
+{
+  sg_render_thread = NULL;
+  sg_window_locked = false;
+
+  if (cfg_get_int ("gfx", "render_thread", g_config) != 1)
+    return;
+
+  /* Some modules can only draw on the thread that made the screen,
+     which is this one, so drawing stays here for them. */
+  if (g_modules.gfx.is_thread_bound_internal != NULL
+      && (*g_modules.gfx.is_thread_bound_internal) ())
+    return;
+
+  g_mutex_init (&sg_frame_mutex);
+  g_cond_init (&sg_frame_cond);
+  g_mutex_init (&sg_window_mutex);
+
+  sg_frame_ready = false;
+  sg_rendering = false;
+  sg_render_quit = false;
+
+  sg_render_thread = g_thread_try_new ("render", render_frames, NULL,
+                                       NULL);
+  if (sg_render_thread == NULL)
+    {
+      error ("GRAPHICS - init_render_thread - Could not start thread.");
+      g_mutex_clear (&sg_frame_mutex);
+      g_cond_clear (&sg_frame_cond);
+      g_mutex_clear (&sg_window_mutex);
+    }
+}
+
+
+/* Draws the command buffers on the render thread. */
+static gpointer
+render_frames (gpointer ignored)
+{
+  draw_frame_t *frame;
+
+  (void) ignored;
+
+  g_mutex_lock (&sg_frame_mutex);
+
+  for (;;)
+    {
+      while (!sg_frame_ready && !sg_render_quit)
+        g_cond_wait (&sg_frame_cond, &sg_frame_mutex);
+
+      if (!sg_frame_ready)
+        break;
+
+      frame = sg_front_frame;
+      sg_front_frame = sg_ready_frame;
+      sg_ready_frame = frame;
+      sg_frame_ready = false;
+      sg_rendering = true;
+
+      g_mutex_unlock (&sg_frame_mutex);
+      execute_draw_frame (sg_front_frame);
+      g_mutex_lock (&sg_frame_mutex);
+
+      sg_rendering = false;
+      g_cond_broadcast (&sg_frame_cond);
+    }
+
+  g_mutex_unlock (&sg_frame_mutex);
+  return NULL;
+}
+
+
+/* Hands the buffer being recorded to the render thread. */
+static void
+publish_draw_frame (void)
+{
+  draw_frame_t *frame;
+
+  if (sg_back_frame->num_commands == 0)
+    return;
+
+  g_mutex_lock (&sg_frame_mutex);
+
+  if (sg_frame_ready)
+    append_draw_frame (sg_ready_frame, sg_back_frame);
+  else
+    {
+      frame = sg_ready_frame;
+      sg_ready_frame = sg_back_frame;
+      sg_back_frame = frame;
+      sg_frame_ready = true;
+    }
+
+  g_cond_broadcast (&sg_frame_cond);
+  g_mutex_unlock (&sg_frame_mutex);
+}
+
+
+/* Waits for the render thread to draw everything handed to it. */
+static void
+wait_for_render_thread (void)
+{
+  bool window_locked = sg_window_locked;
+
+  /* The render thread may need the window to finish its frame. */
+  if (window_locked)
+    unlock_window ();
+
+  g_mutex_lock (&sg_frame_mutex);
+
+  while (sg_frame_ready || sg_rendering)
+    g_cond_wait (&sg_frame_cond, &sg_frame_mutex);
+
+  g_mutex_unlock (&sg_frame_mutex);
+
+  if (window_locked)
+    lock_window ();
+}
+
+
+/* Appends the commands of one buffer to another. */
+static void
+append_draw_frame (draw_frame_t *to, draw_frame_t *from)
+{
+  draw_command_t *to_last;
+  draw_command_type_t from_last;
+
+  g_assert (to->num_commands > 0);
+  g_assert (from->num_commands > 0);
+
+  to_last = &(to->commands[to->num_commands - 1]);
+  from_last = from->commands[from->num_commands - 1].type;
+
+  /* If both buffers end by presenting the screen, the first
+     presentation would only be drawn over straight away.  The last
+     frame of a transition must stay, as it ends the transition. */
+  if ((from_last == DRAW_COMMAND_PRESENT
+       || from_last == DRAW_COMMAND_PRESENT_TRANSITION)
+      && (to_last->type == DRAW_COMMAND_PRESENT
+          || (to_last->type == DRAW_COMMAND_PRESENT_TRANSITION
+              && to_last->progress < TRANSITION_ONE)))
+    to->num_commands -= 1;
+
+  reserve_draw_commands (to, from->num_commands);
+  memcpy (&(to->commands[to->num_commands]),
+          from->commands,
+          from->num_commands * sizeof (draw_command_t));
+
+  to->num_commands += from->num_commands;
+  from->num_commands = 0;
+}
+
+
+/* Sets up scaling of the screen up to the window. */
+static void
+init_output_scale (void)
+{
+  int32_t scale = cfg_get_int ("gfx", "output_scale", g_config);
+  char *filter_name = cfg_get_str ("gfx", "output_filter", g_config);
+  output_filter_t filter = OUTPUT_NEAREST;
+
+  if (filter_name != NULL)
+    {
+      if (strcmp (filter_name, "scale2x") == 0)
+        filter = OUTPUT_SCALE2X;
+      else if (strcmp (filter_name, "nearest") != 0)
+        error ("GRAPHICS - init_output_scale - Unknown filter %s.",
+               filter_name);
+
+      g_free (filter_name);
+    }
+
+  if (scale <= 1)
+    return;
+
+  if (scale > 4)
+    {
+      error ("GRAPHICS - init_output_scale - Scale %d is over 4.", scale);
+      scale = 4;
+    }
+
+  if (g_modules.gfx.set_output_scale_internal == NULL
+      || !(*g_modules.gfx.set_output_scale_internal) ((uint8_t) scale,
+                                                      filter))
+    error ("GRAPHICS - init_output_scale - Could not scale output.");
+}
+
+
+/* Sets up dumping the screen every so many frames. */
+static void
+init_screen_dumps (void)
+{
+  int32_t every = cfg_get_int ("gfx", "dump_every", g_config);
+
+  sg_dump_every = (uint32_t) MAX (0, every);
+  sg_dump_path = NULL;
+  sg_frames_presented = 0;
+
+  if (sg_dump_every == 0)
+    return;
+
+  sg_dump_path = cfg_get_str ("gfx", "dump_path", g_config);
+  if (sg_dump_path == NULL)
+    sg_dump_every = 0;
+}
+
+
+/* Dumps the screen, if the configuration asks for this frame. */
+static void
+dump_presented_frame (void)
+{
+  char *filename;
+
+  sg_frames_presented += 1;
+
+  if (sg_dump_every == 0 || (sg_frames_presented % sg_dump_every) != 0)
+    return;
+
+  filename = g_strdup_printf ("%s%06u.png", sg_dump_path,
+                              sg_frames_presented);
+
+  /* A module that can't dump once won't manage it later either. */
+  if (!dump_screen (filename))
+    {
+      error ("GRAPHICS - dump_presented_frame - Could not dump to %s.",
+             filename);
+      sg_dump_every = 0;
+    }
+
+  g_free (filename);
+}
+
+
+/* Given a relative path to an image file, appends the graphics root
+   path to it and returns a pointer to the created string. */
+char *
+get_absolute_path (const char path[])
+{
+  char *root_path;
+  char *absolute_path;
+
+  /* Get the root path from the configuration, if it exists. */
+
+  root_path = cfg_get_str ("gfx", "graphics_path", g_config);
+
+  if (root_path == NULL)
+    {
+      /* Using default path (this is a fallback). */
+      error ("GRAPHICS - get_absolute_path - No graphics_path in config.");
+      error ("Using default path instead.");
+
+      absolute_path = xcalloc (strlen (path) + strlen (DEFGFXPATH) + 1,
+                               sizeof (char));
+
+      strncat (absolute_path, DEFGFXPATH, strlen (DEFGFXPATH));
+    }
+  else
+    {
+      /* Using configuration path. */
+      absolute_path = xcalloc (strlen (path) + strlen (root_path) + 1,
+                               sizeof (char));
+
+      strncat (absolute_path, root_path, strlen (root_path));
+    }
+
+  strncat (absolute_path, path, strlen (path));
+
+  return absolute_path;
+}
+
+
+/* Writes a string on the screen, using the standard font and given
+   alignment. */
+void
+write_string_aligned (int16_t x,
+                      int16_t y,
+                      uint16_t box_width,
+                      alignment_t alignment,
+                      const char string[])
+{
+  size_t slength;    /* Length of the string, in characters. */
+  int16_t x1;
+  uint16_t length;   /* Length of the string on-screen, in pixels. */
+
+  slength = strlen (string);
+  length = ulong_to_uint16 (FONT_W * slength);
+
+  /* Use the given alignment to position text. */
+  switch (alignment)
+    {
+    default:
+    case ALIGN_LEFT:
+      x1 = x;
+      break;
+    case ALIGN_RIGHT:
+      x1 = ulong_to_int16 (box_width - slength);
+      break;
+    case ALIGN_CENTRE:
+      {
+        uint16_t midpoint = long_to_uint16 (x + (box_width / 2));
+        x1 = long_to_int16 (midpoint - (length / 2));
+      }
+      break;
+    }
+
+
+  write_string (x1, y, string);
+}
+
+
+/* Writes a string on the screen, using the standard font. */
+void
+write_string (int16_t x,
+              int16_t y,
+              const char string[])
+{
+  size_t i;
+  size_t slength = strlen (string);
+  uint16_t length = ulong_to_uint16 (FONT_W * slength);
+  text_cache_entry_t *entry = NULL;
+  image_t *font;
+
+  if (sg_font == NULL_IMAGE)
+    sg_font = load_image (FONT_FILENAME);
+
+  font = get_image (sg_font);
+
+  /* Rendering into the cache would lose the caller's draw target, so
+     text written into an image is drawn a glyph at a time. */
+  if (slength > 0 && !sg_drawing_to_image)
+    entry = get_text_cache_entry (x, y, slength);
+
+  if (entry == NULL)
+    for (i = 0; i < slength; i += 1)
+      draw_glyph (font, string[i],
+                  long_to_int16 ((long) x + (long) (FONT_W * i)), y);
+  else
+    {
+      bool rendering = false;
+
+      /* Only the cells whose character has changed are cleared and
+         drawn again. */
+      for (i = 0; i < slength; i += 1)
+        if (entry->cells[i] != string[i])
+          {
+            int16_t cell_x = ulong_to_int16 (FONT_W * i);
+
+            if (!rendering)
+              rendering = set_draw_target (entry->image);
+
+            draw_image_direct (sg_text_blank, 0, 0, cell_x, 0,
+                               FONT_W, FONT_H);
+            draw_glyph (font, string[i], cell_x, 0);
+            entry->cells[i] = string[i];
+          }
+
+      if (rendering)
+        (void) set_draw_target (NULL);
+
+      draw_image_direct (entry->image, 0, 0, x, y, length, FONT_H);
+    }
+
+  /* Instruct the current state to update the screen. */
+  add_update_rectangle (x, y, length + 1, FONT_H);
+  state_handle_dirty_rect (x, y, length + 1, FONT_H);
+}
+
+
+/* Draws one character of the standard font. */
+static void
+draw_glyph (image_t *font, char character, int16_t x, int16_t y)
+{
+  uint8_t chr = (uint8_t) character;
+
+  draw_image_direct (font,
+                     long_to_int16 ((chr % 16) * FONT_W),
+                     long_to_int16 ((chr / 16) * FONT_H),
+                     x,
+                     y,
+                     FONT_W,
+                     FONT_H);
+}
+
+
+/* Finds the text cache entry for strings written at a position. */
+static text_cache_entry_t *
+get_text_cache_entry (int16_t x, int16_t y, size_t length)
+{
+  text_cache_entry_t *entry = NULL;
+  uint32_t i;
+
+  if (length > TEXT_CACHE_MAX_CHARS
+      || g_modules.gfx.set_draw_target_internal == NULL)
+    return NULL;
+
+  /* Prefer this position's entry, then an unused one, then the one
+     left unused longest. */
+  for (i = 0; i < TEXT_CACHE_SIZE; i += 1)
+    {
+      text_cache_entry_t *candidate = &(sg_text_cache[i]);
+
+      if (candidate->image != NULL
+          && candidate->x == x
+          && candidate->y == y)
+        {
+          entry = candidate;
+          break;
+        }
+
+      if (entry == NULL
+          || (entry->image != NULL
+              && (candidate->image == NULL
+                  || candidate->last_used < entry->last_used)))
+        entry = candidate;
+    }
+
+  /* Another position's image can be drawn over, but nothing in it
+     can be trusted. */
+  if (entry->x != x || entry->y != y)
+    {
+      memset (entry->cells, 0, sizeof (entry->cells));
+      entry->x = x;
+      entry->y = y;
+    }
+
+  if (entry->image == NULL || entry->capacity < length)
+    {
+      uint16_t capacity = (uint16_t) MIN (TEXT_CACHE_MAX_CHARS,
+                                          (length + TEXT_CACHE_ROUNDING - 1)
+                                          / TEXT_CACHE_ROUNDING
+                                          * TEXT_CACHE_ROUNDING);
+
+      if (entry->image != NULL)
+        free_image (entry->image);
+
+      memset (entry->cells, 0, sizeof (entry->cells));
+      entry->capacity = capacity;
+      entry->image = create_image (ulong_to_uint16 (FONT_W * capacity),
+                                   FONT_H,
+                                   true);
+      if (entry->image == NULL)
+        return NULL;
+    }
+
+  if (sg_text_blank == NULL)
+    {
+      sg_text_blank = create_image (FONT_W, FONT_H, true);
+      if (sg_text_blank == NULL)
+        return NULL;
+    }
+
+  entry->last_used = sg_image_clock;
+  return entry;
+}
+
+
+/* Frees every string rendered by write_string. */
+static void
+clear_text_cache (void)
+{
+  uint32_t i;
+
+  for (i = 0; i < TEXT_CACHE_SIZE; i += 1)
+    if (sg_text_cache[i].image != NULL)
+      {
+        free_image (sg_text_cache[i].image);
+        sg_text_cache[i].image = NULL;
+      }
+
+  if (sg_text_blank != NULL)
+    {
+      free_image (sg_text_blank);
+      sg_text_blank = NULL;
+    }
+}
+
+
+/* Updates the screen. */
+void
+update_screen (uint32_t delta)
+{
+  static uint32_t total_useconds;
+  draw_command_t *command;
+  bool presented = false;
+
+  total_useconds += delta;
+
+  if (total_useconds >= USECONDS_PER_FRAME)
+    {
+      if (sg_transition_frames > 0)
+        {
+          sg_transition_frame += 1;
+
+          command = enqueue_draw_command (DRAW_COMMAND_PRESENT_TRANSITION);
+          command->transition = sg_transition_type;
+          command->progress =
+            (uint16_t) ((sg_transition_frame * TRANSITION_ONE)
+                        / sg_transition_frames);
+
+          /* The transition ends once this last frame is drawn. */
+          if (sg_transition_frame >= sg_transition_frames)
+            sg_transition_frames = 0;
+        }
+      else
+        enqueue_draw_command (DRAW_COMMAND_PRESENT);
+
+      total_useconds = 0;
+      sg_image_clock += 1;
+
+      presented = true;
+
+      /* The render thread only ever takes whole frames. */
+      if (sg_render_thread != NULL)
+        publish_draw_frame ();
+    }
+
+  if (sg_render_thread == NULL)
+    execute_draw_frame (sg_back_frame);
+
+  if (presented)
+    dump_presented_frame ();
+}
+
+
+/* Draws a rectangle on the screen of the given colour. */
+void
+draw_rectangle (int16_t x,
+                int16_t y,
+                uint16_t width,
+                uint16_t height,
+                uint8_t red,
+                uint8_t green,
+                uint8_t blue)
+{
+  draw_command_t *command;
+
+  if (!clip_draw_rectangle (&x, &y, &width, &height, NULL, NULL))
+    return;
+
+  command = enqueue_draw_command (DRAW_COMMAND_RECT);
+  command->screen_x = x;
+  command->screen_y = y;
+  command->width = width;
+  command->height = height;
+  command->red = red;
+  command->green = green;
+  command->blue = blue;
+}
+
+
+/* Fills the screen with the given colour. */
+void
+fill_screen (uint8_t red, uint8_t green, uint8_t blue)
+{
+  draw_rectangle (0, 0, SCREEN_W, SCREEN_H, red, green, blue);
+}
+
+
+/* Translates the screen by a co-ordinate pair, leaving damage. */
+void
+scroll_screen (int16_t x_offset, int16_t y_offset)
+{
+  draw_command_t *command = enqueue_draw_command (DRAW_COMMAND_SCROLL);
+
+  command->screen_x = x_offset;
+  command->screen_y = y_offset;
+}
+
+
+/* Loads an image and returns its handle. */
+image_handle_t
+load_image (const char filename[])
+{
+  image_handle_t handle;
+
+  g_assert (filename != NULL);
+
+  handle = GPOINTER_TO_UINT (g_hash_table_lookup (sg_images, filename));
+  if (handle == NULL_IMAGE)
+    handle = add_image_entry (filename);
+
+  (void) get_image (handle);
+  return handle;
+}
+
+
+/* Gets the data of an image by its handle. */
+image_t *
+get_image (image_handle_t image)
+{
+  image_entry_t *entry;
+
+  g_assert (image != NULL_IMAGE && image <= sg_num_images);
+
+  entry = &(sg_image_table[image - 1]);
+  entry->last_used = sg_image_clock;
+
+  if (entry->data == NULL)
+    {
+      sg_image_stats.misses += 1;
+      return load_image_from_file (entry);
+    }
+
+  sg_image_stats.hits += 1;
+  return entry->data;
+}
+
+
+/* Pins an image into the image cache. */
+void
+pin_image (image_handle_t image)
+{
+  /* The image must be loaded for the pin to mean anything. */
+  (void) get_image (image);
+  sg_image_table[image - 1].pins += 1;
+}
+
+
+/* Undoes one pin_image call. */
+void
+unpin_image (image_handle_t image)
+{
+  g_assert (image != NULL_IMAGE && image <= sg_num_images);
+  g_assert (sg_image_table[image - 1].pins > 0);
+
+  sg_image_table[image - 1].pins -= 1;
+}
+
+
+/* Gets the counts of how the image cache has been used. */
+void
+get_image_cache_stats (image_cache_stats_t *stats)
+{
+  g_assert (stats != NULL);
+
+  *stats = sg_image_stats;
+}
+
+
+/* Places a created image into the image table. */
+image_handle_t
+add_image (const char name[], image_t *data)
+{
+  image_handle_t handle;
+  image_entry_t *entry;
+
+  g_assert (name != NULL && data != NULL);
+
+  /* A name may be reused once the image it named has been deleted. */
+  handle = GPOINTER_TO_UINT (g_hash_table_lookup (sg_images, name));
+  if (handle == NULL_IMAGE)
+    handle = add_image_entry (name);
+
+  entry = &(sg_image_table[handle - 1]);
+  g_assert (entry->data == NULL && entry->pins == 0);
+
+  entry->pins = 1;
+  entry->last_used = sg_image_clock;
+  (void) install_image_data (entry, data);
+
+  return handle;
+}
+
+
+/* Adds an entry for an image to the image table. */
+static image_handle_t
+add_image_entry (const char filename[])
+{
+  image_entry_t *entry;
+
+  g_assert (sg_num_images < UINT16_MAX);
+
+  if (sg_num_images == sg_image_table_capacity)
+    {
+      sg_image_table_capacity *= 2;
+      sg_image_table = realloc (sg_image_table,
+                                (sg_image_table_capacity
+                                 * sizeof (image_entry_t)));
+      g_assert (sg_image_table != NULL);
+    }
+
+  entry = &(sg_image_table[sg_num_images]);
+  entry->filename = g_strdup (filename);
+  entry->data = NULL;
+  entry->bytes = 0;
+  entry->pins = 0;
+  entry->last_used = sg_image_clock;
+
+  sg_num_images += 1;
+
+  g_hash_table_insert (sg_images, entry->filename,
+                       GUINT_TO_POINTER (sg_num_images));
+  return (image_handle_t) sg_num_images;
+}
+
+
+/* Loads an image table entry's image from its resource file. */
+static image_t *
+load_image_from_file (image_entry_t *entry)
+{
+  char *path;
+  image_t *data;
+
+  g_assert (entry != NULL && entry->data == NULL);
+
+  path = get_absolute_path (entry->filename);
+
+  data = (*g_modules.gfx.load_image_data) (path);
+  free (path);
+
+  if (data == NULL)
+    fatal ("GFX - load_image - Couldn't load image data for %s.",
+           entry->filename);
+
+  return install_image_data (entry, data);
+}
+
+
+/* Places newly loaded data into an image table entry. */
+static image_t *
+install_image_data (image_entry_t *entry, image_t *data)
+{
+  g_assert (entry->data == NULL && data != NULL);
+
+  entry->data = data;
+  entry->bytes = get_image_bytes (data);
+  sg_image_stats.bytes += entry->bytes;
+
+  if (sg_image_stats.budget > 0
+      && sg_image_stats.bytes > sg_image_stats.budget)
+    trim_image_cache (entry);
+
+  return data;
+}
+
+
+/* Loads a set of images ahead of use, in parallel. */
+void
+preload_images (const char *filenames[], uint32_t count)
+{
+  image_preload_t *preloads;
+  uint32_t num_preloads = 0;
+  GThreadPool *pool = NULL;
+  uint32_t i;
+
+  g_assert (filenames != NULL || count == 0);
+
+  /* The image table is only ever changed from this thread, so every
+     entry is made before the workers start, and the workers' results
+     are only placed in it after they have all finished. */
+  preloads = xcalloc (MAX (count, 1), sizeof (image_preload_t));
+
+  for (i = 0; i < count; i += 1)
+    {
+      image_handle_t handle;
+      uint32_t j;
+
+      handle = GPOINTER_TO_UINT (g_hash_table_lookup (sg_images,
+                                                      filenames[i]));
+      if (handle == NULL_IMAGE)
+        handle = add_image_entry (filenames[i]);
+
+      /* Mark the image as used now, so that installing the others
+         does not evict it. */
+      sg_image_table[handle - 1].last_used = sg_image_clock;
+
+      if (sg_image_table[handle - 1].data != NULL)
+        continue;
+
+      for (j = 0; j < num_preloads; j += 1)
+        if (preloads[j].image == handle)
+          break;
+
+      if (j < num_preloads)
+        continue;
+
+      preloads[num_preloads].image = handle;
+      preloads[num_preloads].path = get_absolute_path (filenames[i]);
+      num_preloads += 1;
+    }
+
+  if (num_preloads > 1 && g_get_num_processors () > 1)
+    pool = g_thread_pool_new (decode_preload, NULL,
+                              (gint) MIN (g_get_num_processors (),
+                                          num_preloads),
+                              TRUE, NULL);
+
+  for (i = 0; i < num_preloads; i += 1)
+    {
+      if (pool != NULL)
+        g_thread_pool_push (pool, &(preloads[i]), NULL);
+      else
+        decode_preload (&(preloads[i]), NULL);
+    }
+
+  /* Waits for every image to be decoded. */
+  if (pool != NULL)
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 0; i < num_preloads; i += 1)
+    {
+      image_entry_t *entry = &(sg_image_table[preloads[i].image - 1]);
+
+      if (preloads[i].data == NULL)
+        error ("GFX - preload_images - Couldn't load image data for %s.",
+               entry->filename);
+      else
+        {
+          sg_image_stats.misses += 1;
+          install_image_data (entry, preloads[i].data);
+        }
+
+      free (preloads[i].path);
+    }
+
+  free (preloads);
+}
+
+
+/* Decodes one image for preload_images. */
+static void
+decode_preload (gpointer preload, gpointer ignored)
+{
+  image_preload_t *preloadc = (image_preload_t *) preload;
+
+  (void) ignored;
+
+  preloadc->data = (*g_modules.gfx.load_image_data) (preloadc->path);
+}
+
+
+/* Works out how much memory an image takes up. */
+static uint32_t
+get_image_bytes (image_t *data)
+{
+  uint16_t width;
+  uint16_t height;
+
+  if (g_modules.gfx.get_image_bytes_internal != NULL)
+    return (*g_modules.gfx.get_image_bytes_internal) (data);
+
+  if (!get_image_dimensions (data, &width, &height))
+    return 0;
+
+  return (uint32_t) width * height * (SCREEN_D / 8);
+}
+
+
+/* Deletes least recently used images until the cache fits. */
+static void
+trim_image_cache (image_entry_t *keep)
+{
+  while (sg_image_stats.bytes > sg_image_stats.budget)
+    {
+      image_entry_t *oldest = NULL;
+      uint32_t i;
+
+      for (i = 0; i < sg_num_images; i += 1)
+        {
+          image_entry_t *entry = &(sg_image_table[i]);
+
+          /* Images used this frame are likely to be used again
+             straight away, so evicting them would only thrash. */
+          if (entry->data == NULL || entry->pins > 0 || entry == keep
+              || entry->last_used == sg_image_clock)
+            continue;
+
+          if (oldest == NULL || entry->last_used < oldest->last_used)
+            oldest = entry;
+        }
+
+      /* Everything left is pinned or in use. */
+      if (oldest == NULL)
+        return;
+
+      unload_image_entry (oldest);
+      sg_image_stats.evictions += 1;
+    }
+}
+
+
+/* Frees the data of an image table entry. */
+static void
+unload_image_entry (image_entry_t *entry)
+{
+  g_assert (entry->data != NULL);
+
+  free_image (entry->data);
+  entry->data = NULL;
+
+  sg_image_stats.bytes -= entry->bytes;
+  entry->bytes = 0;
+}
+
+
+/* Frees image data. */
+void
+free_image (image_t *image)
+{
+  g_assert (image != NULL);
+
+  /* Commands not yet drawn may still refer to the image. */
+  flush_draw_commands ();
+
+  (*g_modules.gfx.free_image_data) (image);
+}
+
+
+/* Retrieves the dimensions of an image. */
+bool
+get_image_dimensions (image_t *image, uint16_t *width, uint16_t *height)
+{
+  g_assert (image != NULL);
+  g_assert (width != NULL);
+  g_assert (height != NULL);
+
+  if (g_modules.gfx.get_image_dimensions_internal == NULL)
+    return false;
+
+  (*g_modules.gfx.get_image_dimensions_internal) (image, width, height);
+  return true;
+}
+
+
+/* Works out the average colour of a rectangular portion of an
+   image. */
+bool
+get_image_average_colour (image_t *image,
+                          int16_t image_x,
+                          int16_t image_y,
+                          uint16_t width,
+                          uint16_t height,
+                          uint8_t colour[4])
+{
+  g_assert (image != NULL);
+  g_assert (colour != NULL);
+
+  if (g_modules.gfx.get_image_average_colour_internal == NULL)
+    return false;
+
+  /* Commands not yet drawn may still be drawing into the image. */
+  flush_draw_commands ();
+
+  (*g_modules.gfx.get_image_average_colour_internal) (image,
+                                                      image_x,
+                                                      image_y,
+                                                      width,
+                                                      height,
+                                                      colour);
+  return true;
+}
+
+
+/* Works out the average colours of a grid of equally sized cells
+   tiled across an image. */
+bool
+get_image_grid_colours (image_t *image,
+                        uint16_t cell_w,
+                        uint16_t cell_h,
+                        uint32_t num_cells,
+                        uint8_t colours[][4])
+{
+  uint16_t width;
+  uint16_t height;
+  uint32_t columns;
+  uint32_t cell;
+
+  g_assert (image != NULL);
+  g_assert (colours != NULL);
+  g_assert (cell_w > 0 && cell_h > 0);
+
+  if (g_modules.gfx.get_image_average_colour_internal == NULL)
+    return false;
+
+  if (!get_image_dimensions (image, &width, &height))
+    return false;
+
+  columns = width / cell_w;
+  if (num_cells > columns * (height / cell_h))
+    return false;
+
+  /* One flush covers the whole grid; nothing is drawn in between. */
+  flush_draw_commands ();
+
+  for (cell = 0; cell < num_cells; cell += 1)
+    {
+      (*g_modules.gfx.get_image_average_colour_internal)
+        (image,
+         (int16_t) ((cell % columns) * cell_w),
+         (int16_t) ((cell / columns) * cell_h),
+         cell_w,
+         cell_h,
+         colours[cell]);
+    }
+
+  return true;
+}
+
+
+/* Draws a rectangular portion of an image on-screen. */
+void
+draw_image (image_handle_t image,
+            int16_t image_x,
+            int16_t image_y,
+            int16_t screen_x,
+            int16_t screen_y,
+            uint16_t width,
+            uint16_t height)
+{
+  draw_image_direct (get_image (image),
+                     image_x,
+                     image_y,
+                     screen_x,
+                     screen_y,
+                     width,
+                     height);
+}
+
+
+/* Draws a rectangular portion of an image on-screen, using a direct
+   pointer to the driver-specific image data. */
+void
+draw_image_direct (void *data, int16_t image_x, int16_t image_y,
+                   int16_t screen_x, int16_t screen_y, uint16_t width,
+                   uint16_t height)
+{
+  draw_command_t *command;
+
+  if (!clip_draw_rectangle (&screen_x, &screen_y, &width, &height,
+                            &image_x, &image_y))
+    return;
+
+  command = enqueue_draw_command (DRAW_COMMAND_IMAGE);
+  command->image = data;
+  command->image_x = image_x;
+  command->image_y = image_y;
+  command->screen_x = screen_x;
+  command->screen_y = screen_y;
+  command->width = width;
+  command->height = height;
+}
+
+
+/* Draws many same-sized portions of one image on-screen. */
+void
+draw_image_batch (image_t *data,
+                  uint16_t width,
+                  uint16_t height,
+                  uint32_t count,
+                  const int16_t image_x[],
+                  const int16_t image_y[],
+                  const int16_t screen_x[],
+                  const int16_t screen_y[])
+{
+  uint32_t i;
+
+  g_assert (data != NULL);
+
+  reserve_draw_commands (sg_back_frame, count);
+
+  for (i = 0; i < count; i += 1)
+    {
+      draw_command_t *command;
+      int16_t clipped_image_x = image_x[i];
+      int16_t clipped_image_y = image_y[i];
+      int16_t clipped_screen_x = screen_x[i];
+      int16_t clipped_screen_y = screen_y[i];
+      uint16_t clipped_width = width;
+      uint16_t clipped_height = height;
+
+      if (!clip_draw_rectangle (&clipped_screen_x, &clipped_screen_y,
+                                &clipped_width, &clipped_height,
+                                &clipped_image_x, &clipped_image_y))
+        continue;
+
+      /* Room has been reserved, so this never grows the buffer. */
+      command = enqueue_draw_command (DRAW_COMMAND_IMAGE);
+      command->image = data;
+      command->image_x = clipped_image_x;
+      command->image_y = clipped_image_y;
+      command->screen_x = clipped_screen_x;
+      command->screen_y = clipped_screen_y;
+      command->width = clipped_width;
+      command->height = clipped_height;
+    }
+}
+
+
+/* Draws a rectangular portion of an image, scaled to fit a
+   rectangle of a different size. */
+bool
+draw_image_scaled_direct (image_t *data,
+                          int16_t image_x,
+                          int16_t image_y,
+                          uint16_t image_width,
+                          uint16_t image_height,
+                          int16_t screen_x,
+                          int16_t screen_y,
+                          uint16_t width,
+                          uint16_t height)
+{
+  draw_command_t *command;
 
+  g_assert (data != NULL);
 
-/* -- STATIC DECLARATIONS -- */
+  if (g_modules.gfx.draw_image_scaled_internal == NULL)
+    return false;
 
-/**
- * Attempts to load an image from the image cache.
- *
- * @param filename  The filename of the image to load, relative from
- *                  the graphics path.
- *
- * @return A pointer to the raw data of the image if
- *         successfully loaded and stored in the image cache;
- *         NULL otherwise.
- */
-static image_t *load_image_from_cache (const char filename[]);
+  if (width == 0 || height == 0)
+    return true;
 
+  if (sg_clip_enabled && !sg_drawing_to_image)
+    {
+      int32_t left = MAX (screen_x, sg_clip_left);
+      int32_t top = MAX (screen_y, sg_clip_top);
+      int32_t right = MIN (screen_x + width, sg_clip_right);
+      int32_t bottom = MIN (screen_y + height, sg_clip_bottom);
+
+      if (right <= left || bottom <= top)
+        return true;
+
+      /* Move the on-image rectangle in proportion. */
+      image_x = (int16_t) (image_x + (((left - screen_x) * image_width)
+                                      / width));
+      image_y = (int16_t) (image_y + (((top - screen_y) * image_height)
+                                      / height));
+      image_width = (uint16_t) MAX (1, ((right - left) * image_width)
+                                       / width);
+      image_height = (uint16_t) MAX (1, ((bottom - top) * image_height)
+                                        / height);
+
+      screen_x = (int16_t) left;
+      screen_y = (int16_t) top;
+      width = (uint16_t) (right - left);
+      height = (uint16_t) (bottom - top);
+    }
 
-/**
- * Loads an image from its resource file.
- *
- * @param filename  The filename of the image to load, relative from
- *                  the graphics path.
- *
- * @return A pointer to the raw data of the image if
- *         successfully loaded and stored in the image cache;
- *         NULL otherwise.
- */
-static image_t *load_image_from_file (const char filename[]);
+  command = enqueue_draw_command (DRAW_COMMAND_SCALED_IMAGE);
+  command->image = data;
+  command->image_x = image_x;
+  command->image_y = image_y;
+  command->image_width = image_width;
+  command->image_height = image_height;
+  command->screen_x = screen_x;
+  command->screen_y = screen_y;
+  command->width = width;
+  command->height = height;
+  return true;
+}
 
 
-/* -- DEFINITIONS -- */
+/* Restricts all drawing to a rectangle of the screen. */
+void
+set_clip_rectangle (int16_t x, int16_t y, uint16_t width, uint16_t height)
+{
+  sg_clip_enabled = true;
+  sg_clip_left = x;
+  sg_clip_top = y;
+  sg_clip_right = x + width;
+  sg_clip_bottom = y + height;
+}
 
-/* Initialise the graphics subsystem. */
 
+/* Lifts any restriction set by set_clip_rectangle. */
 void
-init_graphics (void)
+clear_clip_rectangle (void)
 {
-  if (!load_module_gfx (cfg_get_str ("modules",
-                                    "graphics_module",
-                                    g_config),
-                        &g_modules))
-    {
-      fatal ("GRAPHICS - init_graphics - Could not load graphics module.");
-    }
+  sg_clip_enabled = false;
+}
 
 
-  /* Call on the graphics backend to create a screen. */
-  if (!(*g_modules.gfx.init_screen_internal)
-      (SCREEN_W, SCREEN_H, SCREEN_D))
-    {
-      fatal ("GRAPHICS - init_graphics - Could not init screen.");
-    }
+/* Sets a colour tint for the whole screen. */
+void
+set_screen_tint (uint8_t red, uint8_t green, uint8_t blue)
+{
+  draw_command_t *command;
 
+  if (g_modules.gfx.set_tint_internal == NULL)
+    return;
 
-  /* Initialise the image list. */
-  sg_images = g_hash_table_new_full(g_str_hash,
-                                    g_str_equal,
-                                    free,
-                                    free_image);
+  command = enqueue_draw_command (DRAW_COMMAND_TINT);
+  command->red = red;
+  command->green = green;
+  command->blue = blue;
 }
 
 
-/* Given a relative path to an image file, appends the graphics root
-   path to it and returns a pointer to the created string. */
-char *
-get_absolute_path (const char path[])
+/* Starts a transition away from what is currently on-screen. */
+bool
+start_transition (transition_type_t type, uint16_t frames)
 {
-  char *root_path;
-  char *absolute_path;
-
-  /* Get the root path from the configuration, if it exists. */
-
-  root_path = cfg_get_str ("gfx", "graphics_path", g_config);
+  if (frames == 0
+      || g_modules.gfx.begin_transition_internal == NULL
+      || g_modules.gfx.present_transition_internal == NULL
+      || g_modules.gfx.end_transition_internal == NULL)
+    return false;
 
-  if (root_path == NULL)
-    {
-      /* Using default path (this is a fallback). */
-      error ("GRAPHICS - get_absolute_path - No graphics_path in config.");
-      error ("Using default path instead.");
+  /* The module keeps the screen as presented so far, so everything
+     up to now must have been drawn. */
+  flush_draw_commands ();
 
-      absolute_path = xcalloc (strlen (path) + strlen (DEFGFXPATH) + 1,
-                               sizeof (char));
+  /* A transition already under way restarts from whatever it has
+     got to on-screen. */
+  if (sg_transition_frames > 0)
+    (*g_modules.gfx.end_transition_internal) ();
 
-      strncat (absolute_path, DEFGFXPATH, strlen (DEFGFXPATH));
-    }
-  else
-    {
-      /* Using configuration path. */
-      absolute_path = xcalloc (strlen (path) + strlen (root_path) + 1,
-                               sizeof (char));
+  sg_transition_frames = 0;
 
-      strncat (absolute_path, root_path, strlen (root_path));
-    }
+  if (!(*g_modules.gfx.begin_transition_internal) ())
+    return false;
 
-  strncat (absolute_path, path, strlen (path));
+  sg_transition_type = type;
+  sg_transition_frames = frames;
+  sg_transition_frame = 0;
 
-  return absolute_path;
+  return true;
 }
 
 
-/* Writes a string on the screen, using the standard font and given
-   alignment. */
+/* Darkens a rectangle of what has already been drawn. */
 void
-write_string_aligned (int16_t x,
-                      int16_t y,
-                      uint16_t box_width,
-                      alignment_t alignment,
-                      const char string[])
+shade_rectangle (int16_t x,
+                 int16_t y,
+                 uint16_t width,
+                 uint16_t height,
+                 uint8_t brightness)
 {
-  size_t slength;    /* Length of the string, in characters. */
-  int16_t x1;
-  uint16_t length;   /* Length of the string on-screen, in pixels. */
-
-  slength = strlen (string);
-  length = ulong_to_uint16 (FONT_W * slength);
+  draw_command_t *command;
 
-  /* Use the given alignment to position text. */
-  switch (alignment)
-    {
-    default:
-    case ALIGN_LEFT:
-      x1 = x;
-      break;
-    case ALIGN_RIGHT:
-      x1 = ulong_to_int16 (box_width - slength);
-      break;
-    case ALIGN_CENTRE:
-      {
-        uint16_t midpoint = long_to_uint16 (x + (box_width / 2));
-        x1 = long_to_int16 (midpoint - (length / 2));
-      }
-      break;
-    }
+  if (g_modules.gfx.shade_rect_internal == NULL || brightness == 255)
+    return;
 
+  if (!clip_draw_rectangle (&x, &y, &width, &height, NULL, NULL))
+    return;
 
-  write_string (x1, y, string);
+  command = enqueue_draw_command (DRAW_COMMAND_SHADE);
+  command->screen_x = x;
+  command->screen_y = y;
+  command->width = width;
+  command->height = height;
+  command->brightness = brightness;
 }
 
 
-/* Writes a string on the screen, using the standard font and given
-   alignment. */
-void
-write_string (int16_t x,
-              int16_t y,
-              const char string[])
+/* Creates a blank image. */
+image_t *
+create_image (uint16_t width, uint16_t height, bool transparent)
 {
-  uint8_t chr;
-  int16_t current_x = x;
-  size_t i;
-  size_t slength = strlen (string);
-  image_t *font = load_image (FONT_FILENAME);
+  g_assert (width > 0 && height > 0);
 
-  if (font == NULL)
-    {
-      error ("Couldn't load font!");
-      return;
-    }
+  if (g_modules.gfx.create_image_data == NULL)
+    return NULL;
 
-  for (i = 0; i < slength; i+= 1)
-    {
-      chr = (uint8_t) string[i];
-      draw_image_direct (font,
-                         long_to_int16 ((chr % 16) * FONT_W),
-                         long_to_int16 (((chr - (chr % 16))/16) * FONT_H),
-                         current_x,
-                         y,
-                         FONT_W,
-                         FONT_H);
+  return (*g_modules.gfx.create_image_data) (width, height, transparent);
+}
 
-      current_x += FONT_W;
-    }
 
+/* Redirects drawing into an image. */
+bool
+set_draw_target (image_t *image)
+{
+  draw_command_t *command;
+
+  if (g_modules.gfx.set_draw_target_internal == NULL)
+    return (image == NULL);
 
-  /* Instruct the current state to update the screen. */
-  add_update_rectangle (x, y, current_x - x + 1, FONT_H);
-  state_handle_dirty_rect (x, y, current_x - x + 1, FONT_H);
+  command = enqueue_draw_command (DRAW_COMMAND_TARGET);
+  command->image = image;
+  sg_drawing_to_image = (image != NULL);
+  return true;
 }
 
 
-/* Updates the screen. */
+/* Sends all buffered drawing commands to the graphics module, and
+   waits for them to be drawn. */
 void
-update_screen (uint32_t delta)
+flush_draw_commands (void)
 {
-  static uint32_t total_useconds;
-
-  total_useconds += delta;
-
-  if (total_useconds >= USECONDS_PER_FRAME)
+  if (sg_render_thread == NULL)
     {
-      (*g_modules.gfx.update_screen_internal) ();
-      total_useconds = 0;
+      execute_draw_frame (sg_back_frame);
+      return;
     }
+
+  publish_draw_frame ();
+  wait_for_render_thread ();
 }
 
 
-/* Draws a rectangle on the screen of the given colour. */
-void
-draw_rectangle (int16_t x,
-                int16_t y,
-                uint16_t width,
-                uint16_t height,
-                uint8_t red,
-                uint8_t green,
-                uint8_t blue)
+/* Writes the screen as last presented to a PNG file. */
+bool
+dump_screen (const char filename[])
 {
-  (*g_modules.gfx.draw_rect_internal)
-    (x, y, width, height, red, green, blue);
+  g_assert (filename != NULL);
+
+  if (g_modules.gfx.dump_screen_internal == NULL)
+    return false;
+
+  /* The module must not be drawing while it reads the screen. */
+  flush_draw_commands ();
+
+  return (*g_modules.gfx.dump_screen_internal) (filename);
 }
 
 
-/* Fills the screen with the given colour. */
+/* Stops the render thread presenting to the window. */
 void
-fill_screen (uint8_t red, uint8_t green, uint8_t blue)
+lock_window (void)
 {
-  draw_rectangle (0, 0, SCREEN_W, SCREEN_H, red, green, blue);
+  if (sg_render_thread == NULL)
+    return;
+
+  g_mutex_lock (&sg_window_mutex);
+  sg_window_locked = true;
 }
 
 
-/* Translates the screen by a co-ordinate pair, leaving damage. */
+/* Lets the render thread present to the window again. */
 void
-scroll_screen (int16_t x_offset, int16_t y_offset)
+unlock_window (void)
 {
-  (*g_modules.gfx.scroll_screen_internal)
-    (x_offset, y_offset);
+  if (sg_render_thread == NULL)
+    return;
+
+  sg_window_locked = false;
+  g_mutex_unlock (&sg_window_mutex);
 }
 
 
-/* Loads an image. */
-void *
-load_image (const char filename[])
+/* Reserves the next free slot in the drawing command buffer. */
+static draw_command_t *
+enqueue_draw_command (draw_command_type_t type)
 {
-  image_t *cache_data;
-  image_t *file_data;
+  draw_command_t *command;
 
-  g_assert (filename != NULL);
+  reserve_draw_commands (sg_back_frame, 1);
 
-  cache_data = load_image_from_cache (filename);
-  if (cache_data != NULL)
-    return cache_data;
+  command = &(sg_back_frame->commands[sg_back_frame->num_commands]);
+  sg_back_frame->num_commands += 1;
 
-  /* Cache miss */
-  file_data = load_image_from_file (filename);
-  if (file_data != NULL)
-    return file_data;
+  memset (command, 0, sizeof (draw_command_t));
+  command->type = type;
 
-  fatal ("GFX - load_image - Couldn't load image data for %s.",
-         filename);
-  return NULL;
+  return command;
 }
 
 
-/* Attempts to load an image from the image cache. */
-static image_t *
-load_image_from_cache (const char filename[])
+/* Makes room in a drawing command buffer for further commands. */
+static void
+reserve_draw_commands (draw_frame_t *frame, uint32_t count)
 {
-  g_assert (filename != NULL);
-  return g_hash_table_lookup (sg_images, filename);
+  g_assert (frame->commands != NULL);
+
+  if (frame->num_commands + count <= frame->capacity)
+    return;
+
+  while (frame->num_commands + count > frame->capacity)
+    frame->capacity *= 2;
+
+  frame->commands = realloc (frame->commands,
+                             frame->capacity * sizeof (draw_command_t));
+  g_assert (frame->commands != NULL);
 }
 
 
-/* Loads an image from its resource file. */
-static image_t *
-load_image_from_file (const char filename[])
+/* Carries out, and then empties, a drawing command buffer. */
+static void
+execute_draw_frame (draw_frame_t *frame)
 {
-  char *path;
-  image_t *data;
+  uint32_t start = 0;
+  uint32_t end;
 
-  g_assert (filename != NULL);
+  while (start < frame->num_commands)
+    {
+      /* Image and rect commands go to the module as a batch, as far
+         as the next command of any other type. */
+      for (end = start;
+           end < frame->num_commands
+             && (frame->commands[end].type == DRAW_COMMAND_IMAGE
+                 || frame->commands[end].type == DRAW_COMMAND_RECT);
+           end += 1)
+        ;
+
+      if (end > start)
+        {
+          execute_draw_batch (&(frame->commands[start]), end - start);
+          start = end;
+        }
+      else
+        {
+          execute_draw_command (&(frame->commands[start]));
+          start += 1;
+        }
+    }
 
-  path = get_absolute_path (filename);
+  frame->num_commands = 0;
+}
 
-  data = (*g_modules.gfx.load_image_data) (path);
-  free (path);
 
-  if (data == NULL)
+/* Executes a run of image and rect commands. */
+static void
+execute_draw_batch (draw_command_t commands[], uint32_t count)
+{
+  uint32_t i;
+
+  if (g_modules.gfx.draw_batch_internal != NULL)
     {
-      fatal ("GFX - load_image - Couldn't load image data for %s.",
-             filename);
-      return NULL;
+      (*g_modules.gfx.draw_batch_internal) (commands, count);
+      return;
     }
 
-  g_hash_table_insert(sg_images, g_strdup(filename), data);
-  return data;
+  for (i = 0; i < count; i += 1)
+    execute_draw_command (&(commands[i]));
 }
 
 
-/* Frees image data. */
-void
-free_image (image_t *image)
+/* Clips a drawing rectangle to the clipping rectangle. */
+static bool
+clip_draw_rectangle (int16_t *screen_x,
+                     int16_t *screen_y,
+                     uint16_t *width,
+                     uint16_t *height,
+                     int16_t *image_x,
+                     int16_t *image_y)
 {
-  g_assert (image != NULL);
-  (*g_modules.gfx.free_image_data) (image);
+  int32_t left;
+  int32_t top;
+  int32_t right;
+  int32_t bottom;
+
+  if (!sg_clip_enabled || sg_drawing_to_image)
+    return true;
+
+  left = MAX (*screen_x, sg_clip_left);
+  top = MAX (*screen_y, sg_clip_top);
+  right = MIN (*screen_x + *width, sg_clip_right);
+  bottom = MIN (*screen_y + *height, sg_clip_bottom);
+
+  if (right <= left || bottom <= top)
+    return false;
+
+  if (image_x != NULL)
+    *image_x = (int16_t) (*image_x + (left - *screen_x));
+  if (image_y != NULL)
+    *image_y = (int16_t) (*image_y + (top - *screen_y));
+
+  *screen_x = (int16_t) left;
+  *screen_y = (int16_t) top;
+  *width = (uint16_t) (right - left);
+  *height = (uint16_t) (bottom - top);
+
+  return true;
 }
 
 
-/* Draws a rectangular portion of an image on-screen. */
-void
-draw_image (const char filename[],
-            int16_t image_x,
-            int16_t image_y,
-            int16_t screen_x,
-            int16_t screen_y,
-            uint16_t width,
-            uint16_t height)
+/* Executes a single drawing command through the graphics module's
+   individual functions. */
+static void
+execute_draw_command (draw_command_t *command)
 {
-  image_t *img = load_image (filename);
-  if (img == NULL)
+  switch (command->type)
     {
-      error ("GFX - draw_image - Image load failure for %s.",
-             filename);
-    }
+    case DRAW_COMMAND_IMAGE:
+      (*g_modules.gfx.draw_image_internal) (command->image,
+                                            command->image_x,
+                                            command->image_y,
+                                            command->screen_x,
+                                            command->screen_y,
+                                            command->width,
+                                            command->height);
+      break;
+    case DRAW_COMMAND_RECT:
+      (*g_modules.gfx.draw_rect_internal) (command->screen_x,
+                                           command->screen_y,
+                                           command->width,
+                                           command->height,
+                                           command->red,
+                                           command->green,
+                                           command->blue);
+      break;
+    case DRAW_COMMAND_SCALED_IMAGE:
+      (*g_modules.gfx.draw_image_scaled_internal) (command->image,
+                                                   command->image_x,
+                                                   command->image_y,
+                                                   command->image_width,
+                                                   command->image_height,
+                                                   command->screen_x,
+                                                   command->screen_y,
+                                                   command->width,
+                                                   command->height);
+      break;
+    case DRAW_COMMAND_SHADE:
+      (*g_modules.gfx.shade_rect_internal) (command->screen_x,
+                                            command->screen_y,
+                                            command->width,
+                                            command->height,
+                                            command->brightness);
+      break;
+    case DRAW_COMMAND_SCROLL:
+      (*g_modules.gfx.scroll_screen_internal) (command->screen_x,
+                                               command->screen_y);
+      break;
+    case DRAW_COMMAND_TARGET:
+      (*g_modules.gfx.set_draw_target_internal) (command->image);
+      break;
+    case DRAW_COMMAND_UPDATE_RECT:
+      (*g_modules.gfx.add_update_rectangle_internal) (command->screen_x,
+                                                      command->screen_y,
+                                                      command->width,
+                                                      command->height);
+      break;
+    case DRAW_COMMAND_TINT:
+      (*g_modules.gfx.set_tint_internal) (command->red,
+                                          command->green,
+                                          command->blue);
+      break;
+    case DRAW_COMMAND_PRESENT:
+      if (sg_render_thread != NULL)
+        g_mutex_lock (&sg_window_mutex);
 
-  draw_image_direct (img,
-                     image_x,
-                     image_y,
-                     screen_x,
-                     screen_y,
-                     width,
-                     height);
-}
+      (*g_modules.gfx.update_screen_internal) ();
 
+      if (sg_render_thread != NULL)
+        g_mutex_unlock (&sg_window_mutex);
+      break;
+    case DRAW_COMMAND_PRESENT_TRANSITION:
+      if (sg_render_thread != NULL)
+        g_mutex_lock (&sg_window_mutex);
 
-/* Draws a rectangular portion of an image on-screen, using a direct
-   pointer to the driver-specific image data. */
-void
-draw_image_direct (void *data, int16_t image_x, int16_t image_y,
-                   int16_t screen_x, int16_t screen_y, uint16_t width,
-                   uint16_t height)
-{
-  (*g_modules.gfx.draw_image_internal) (data,
-                                        image_x,
-                                        image_y,
-                                        screen_x,
-                                        screen_y,
-                                        width,
-                                        height);
+      (*g_modules.gfx.present_transition_internal) (command->transition,
+                                                    command->progress);
+
+      if (sg_render_thread != NULL)
+        g_mutex_unlock (&sg_window_mutex);
+
+      if (command->progress >= TRANSITION_ONE)
+        (*g_modules.gfx.end_transition_internal) ();
+      break;
+    default:
+      error ("GFX - execute_draw_command - Unknown command type.");
+      break;
+    }
 }
 
 
@@ -429,11 +2176,19 @@ draw_image_direct (void *data, int16_t image_x, int16_t image_y,
 bool
 delete_image (const char filename[])
 {
-  gboolean success = g_hash_table_remove (sg_images, filename);
-  if (success == TRUE)
-    return true;
-  else
+  image_handle_t handle;
+  image_entry_t *entry;
+
+  handle = GPOINTER_TO_UINT (g_hash_table_lookup (sg_images, filename));
+  if (handle == NULL_IMAGE)
+    return false;
+
+  entry = &(sg_image_table[handle - 1]);
+  if (entry->data == NULL || entry->pins > 0)
     return false;
+
+  unload_image_entry (entry);
+  return true;
 }
 
 
@@ -441,7 +2196,11 @@ delete_image (const char filename[])
 void
 clear_images (void)
 {
-  g_hash_table_destroy (sg_images);
+  uint32_t i;
+
+  for (i = 0; i < sg_num_images; i += 1)
+    if (sg_image_table[i].data != NULL)
+      unload_image_entry (&(sg_image_table[i]));
 }
 
 
@@ -449,7 +2208,13 @@ clear_images (void)
 image_t *
 find_image (const char filename[])
 {
-  return g_hash_table_lookup (sg_images, filename);
+  image_handle_t handle;
+
+  handle = GPOINTER_TO_UINT (g_hash_table_lookup (sg_images, filename));
+  if (handle == NULL_IMAGE)
+    return NULL;
+
+  return sg_image_table[handle - 1].data;
 }
 
 
@@ -460,10 +2225,13 @@ add_update_rectangle (int16_t x,
                       uint16_t width,
                       uint16_t height)
 {
-  (*g_modules.gfx.add_update_rectangle_internal) (x,
-                                                  y,
-                                                  width,
-                                                  height);
+  draw_command_t *command;
+
+  command = enqueue_draw_command (DRAW_COMMAND_UPDATE_RECT);
+  command->screen_x = x;
+  command->screen_y = y;
+  command->width = width;
+  command->height = height;
 }
 
 
@@ -471,6 +2239,53 @@ add_update_rectangle (int16_t x,
 void
 cleanup_graphics (void)
 {
+  uint32_t i;
+
+  /* Freeing images flushes drawing, so do it while the render thread
+     is still there to draw. */
+  clear_text_cache ();
+
+  g_free (sg_dump_path);
+  sg_dump_path = NULL;
+
+  if (sg_render_thread != NULL)
+    {
+      g_mutex_lock (&sg_frame_mutex);
+      sg_render_quit = true;
+      g_cond_broadcast (&sg_frame_cond);
+      g_mutex_unlock (&sg_frame_mutex);
+
+      g_thread_join (sg_render_thread);
+      sg_render_thread = NULL;
+
+      g_mutex_clear (&sg_frame_mutex);
+      g_cond_clear (&sg_frame_cond);
+      g_mutex_clear (&sg_window_mutex);
+    }
+
+  /* Commands may refer to images, so drop them first. */
+  for (i = 0; i < NUM_DRAW_FRAMES; i += 1)
+    {
+      sg_frames[i].num_commands = 0;
+      free (sg_frames[i].commands);
+      sg_frames[i].commands = NULL;
+    }
+
+  if (sg_transition_frames > 0)
+    {
+      (*g_modules.gfx.end_transition_internal) ();
+      sg_transition_frames = 0;
+    }
+
   clear_images ();
+
+  for (i = 0; i < sg_num_images; i += 1)
+    g_free (sg_image_table[i].filename);
+
+  g_hash_table_destroy (sg_images);
+  free (sg_image_table);
+  sg_image_table = NULL;
+  sg_num_images = 0;
+  sg_font = NULL_IMAGE;
 }
 
@@ -51,9 +51,19 @@
 
 typedef void image_t;	      /**< Generic image data type. */
 
+typedef uint16_t image_handle_t; /**< Handle to an image in the image
+                                    cache, as returned by
+                                    load_image. */
+
 
 /* -- CONSTANTS -- */
 
+enum
+{
+  NULL_IMAGE = 0  /**< Image handle that refers to no image. */
+};
+
+
 typedef enum alignment
 {
   ALIGN_LEFT,	   /**< Left alignment for text. */
@@ -64,10 +74,36 @@ typedef enum alignment
 
 enum
 {
-  SCREEN_D = 32		/**< Screen colour depth (in bits per pixel). */
+  SCREEN_D = 32,	/**< Screen colour depth (in bits per pixel). */
+  TRANSITION_ONE = 256  /**< Transition progress when the incoming
+                           screen is fully shown. */
 };
 
 
+/**
+ * Styles of screen transition.
+ */
+typedef enum transition_type
+{
+  TRANSITION_FADE,   /**< Cross-fade from the outgoing screen. */
+  TRANSITION_WIPE,   /**< Uncover the incoming screen from the left. */
+  TRANSITION_MOSAIC  /**< Break the outgoing screen into ever larger
+                        blocks, then resolve the incoming screen out
+                        of them. */
+} transition_type_t;
+
+
+/**
+ * Filters for scaling the screen up to the window.
+ */
+typedef enum output_filter
+{
+  OUTPUT_NEAREST,  /**< Repeat each pixel. */
+  OUTPUT_SCALE2X   /**< Smooth diagonal edges with the Scale2x
+                      (EPX) rules. */
+} output_filter_t;
+
+
 /**
  * Width of the screen, in pixels.
  *
@@ -96,6 +132,99 @@ extern const uint16_t FONT_W;
 extern const uint16_t FONT_H;
 
 
+/* -- STRUCTURES -- */
+
+/**
+ * Types of deferred drawing command.
+ */
+typedef enum draw_command_type
+{
+  DRAW_COMMAND_IMAGE,         /**< Blit a rectangle of an image
+                                 on-screen. */
+  DRAW_COMMAND_RECT,          /**< Fill a rectangle on-screen with
+                                 colour. */
+  DRAW_COMMAND_SCALED_IMAGE,  /**< Blit a rectangle of an image,
+                                 scaled to the on-screen
+                                 rectangle. */
+  DRAW_COMMAND_SHADE,         /**< Darken a rectangle on-screen. */
+  DRAW_COMMAND_SCROLL,        /**< Translate the screen by the
+                                 on-screen co-ordinates. */
+  DRAW_COMMAND_TARGET,        /**< Redirect drawing into the image, or
+                                 the screen if it is NULL. */
+  DRAW_COMMAND_UPDATE_RECT,   /**< Add the on-screen rectangle to the
+                                 next update. */
+  DRAW_COMMAND_TINT,          /**< Set the screen tint. */
+  DRAW_COMMAND_PRESENT,       /**< Update the screen. */
+  DRAW_COMMAND_PRESENT_TRANSITION /**< Update the screen with a frame
+                                     of the current transition. */
+} draw_command_type_t;
+
+
+/**
+ * Counts of how the image cache has been used since start-up.
+ */
+typedef struct image_cache_stats
+{
+  uint32_t hits;       /**< Image uses that found the image loaded. */
+  uint32_t misses;     /**< Image uses that had to load the image. */
+  uint32_t evictions;  /**< Images deleted to keep to the budget. */
+  uint32_t bytes;      /**< Memory the loaded images take up, in
+                          bytes. */
+  uint32_t budget;     /**< Memory the loaded images may take up, in
+                          bytes, or 0 if there is no limit. */
+} image_cache_stats_t;
+
+
+/**
+ * A deferred drawing command.
+ *
+ * The graphics subsystem collects these into a frame-local command
+ * buffer, which is handed to the graphics module in one go when the
+ * buffer is flushed.  Only image and rect commands are passed to the
+ * module's draw_batch_internal; the graphics subsystem carries out
+ * the others itself.
+ */
+typedef struct draw_command
+{
+  draw_command_type_t type;  /**< Type of the command. */
+
+  image_t *image;       /**< Image data to blit (image commands), or
+                           to draw into (target commands). */
+  int16_t image_x;      /**< X co-ordinate of the left edge of the
+                           on-image rectangle (image commands
+                           only). */
+  int16_t image_y;      /**< Y co-ordinate of the top edge of the
+                           on-image rectangle (image commands
+                           only). */
+
+  int16_t screen_x;     /**< X co-ordinate of the left edge of the
+                           on-screen rectangle. */
+  int16_t screen_y;     /**< Y co-ordinate of the top edge of the
+                           on-screen rectangle. */
+  uint16_t width;       /**< Width of the rectangle, in pixels. */
+  uint16_t height;      /**< Height of the rectangle, in pixels. */
+
+  uint16_t image_width;  /**< Width of the on-image rectangle
+                            (scaled image commands only). */
+  uint16_t image_height; /**< Height of the on-image rectangle
+                            (scaled image commands only). */
+
+  uint8_t red;          /**< Red fill component (rect commands), or
+                           multiplier (tint commands). */
+  uint8_t green;        /**< Green fill component or multiplier. */
+  uint8_t blue;         /**< Blue fill component or multiplier. */
+  uint8_t brightness;   /**< Brightness to leave (shade commands
+                           only). */
+
+  transition_type_t transition; /**< Style of the transition
+                                   (present transition commands
+                                   only). */
+  uint16_t progress;    /**< Progress of the transition, out of
+                           TRANSITION_ONE (present transition
+                           commands only). */
+} draw_command_t;
+
+
 /* -- DECLARATIONS -- */
 
 /**
@@ -146,6 +275,10 @@ void write_string_aligned (int16_t x,
 /**
  * Writes a string on the screen, using the standard font.
  *
+ * Strings are kept rendered by where they are written, so writing
+ * the same string in the same place again is a single blit, and a
+ * changed string only redraws the characters that differ.
+ *
  * @param x          X position of the left edge of the text box,
  *                   in pixels from the left edge of the screen.
  * @param y          Y position of the top edge of the text box,
@@ -205,28 +338,107 @@ void scroll_screen (int16_t x_offset, int16_t y_offset);
 
 
 /**
- * Loads an image.
+ * Loads an image into the image cache, if it is not already there,
+ * and returns its handle.
  *
- * This does not need to be called directly in normal circumstances,
- * as draw_image automatically loads its requested image if it is not
- * present in the image cache.  Still, this function may be useful on
- * its own for pre-caching images, especially on systems with
- * noticeably slow disk access.
+ * Handles are small integers indexing a table, so drawing with one
+ * involves no filename lookups.  A filename keeps the same handle
+ * for as long as the graphics subsystem is running, even if the
+ * image is deleted from the cache; drawing with the handle then
+ * loads the image again.
  *
- * @note            It is safe to directly use the pointer returned,
- *                  for example as an argument to draw_image_direct,
- *                  so long as the image is known to still be loaded.
- *                  This can be used to speed up successive drawing
- *                  calls after an image load check.
+ * If the image_cache_mb key of the gfx group is set, loading an
+ * image deletes the least recently used images that are not pinned
+ * until the cache fits within that many megabytes again.
  *
  * @param filename  The filename of the image to load, relative from
  *                  the graphics path.
  *
- * @return  A pointer to the raw data of the image if
- *          successfully loaded and stored in the image cache;
- *          NULL otherwise.
+ * @return  the handle of the image.  If the image cannot be loaded,
+ *          this is a fatal error.
+ */
+image_handle_t load_image (const char filename[]);
+
+
+/**
+ * Gets the data of an image in the image cache by its handle,
+ * loading the image again if it has been deleted.
+ *
+ * @note  It is safe to directly use the pointer returned, for
+ *        example as an argument to draw_image_direct, until the next
+ *        image is loaded, which may evict this one from the cache.
+ *        Pin the image with pin_image to keep the pointer for
+ *        longer.
+ *
+ * @param image  The handle of the image, as returned by load_image.
+ *
+ * @return  a pointer to the raw data of the image.
+ */
+image_t *get_image (image_handle_t image);
+
+
+/**
+ * Loads a set of images into the image cache ahead of use, decoding
+ * them in parallel on a pool of worker threads.
+ *
+ * This returns once every image is loaded, so nothing drawn
+ * afterwards waits on decoding.  Images already loaded are left as
+ * they are.  Images that cannot be loaded are reported, and are left
+ * to fail when first used.
+ *
+ * @param filenames  Array of the filenames of the images, relative
+ *                   to the graphics path.
+ * @param count      The number of filenames.
+ */
+void preload_images (const char *filenames[], uint32_t count);
+
+
+/**
+ * Pins an image into the image cache, so that it is never evicted
+ * to keep to the cache budget.
+ *
+ * Maps and states should pin the images they keep pointers to, or
+ * expect to use all the time.  Pins are counted, and each should be
+ * undone with unpin_image.
+ *
+ * @param image  The handle of the image, as returned by load_image.
+ */
+void pin_image (image_handle_t image);
+
+
+/**
+ * Undoes one pin_image call, letting the image be evicted again once
+ * every pin has been undone.
+ *
+ * @param image  The handle of the image.
+ */
+void unpin_image (image_handle_t image);
+
+
+/**
+ * Gets the counts of how the image cache has been used.
+ *
+ * @param stats  Pointer to the structure to fill in.
  */
-image_t *load_image (const char filename[]);
+void get_image_cache_stats (image_cache_stats_t *stats);
+
+
+/**
+ * Places an image made with create_image into the image table, so it
+ * can be referred to by handle like a loaded image.
+ *
+ * As the image cannot be reloaded from a file, it is pinned.  To
+ * free it, undo the pin with unpin_image and then delete it with
+ * delete_image.
+ *
+ * @param name  Name to give the image, which must not be the
+ *              filename of an image file, nor the name of an image
+ *              that is still loaded.
+ * @param data  The image data, which the image table takes over.
+ *
+ * @return  the handle of the image.
+ */
+image_handle_t add_image (const char name[], image_t *data);
 
 
 /**
@@ -241,12 +453,84 @@ void free_image (image_t * image);
 
 
 /**
- * Draws a rectangular portion of an image on-screen.
+ * Retrieves the dimensions of an image.
+ *
+ * Not all graphics modules can report image dimensions.
  *
- * This will pre-load the image into the cache, if it does not
- * already exist there.
+ * @param image   Pointer to the image data to query.
+ * @param width   Pointer to a variable in which to store the width of
+ *                the image, in pixels.
+ * @param height  Pointer to a variable in which to store the height
+ *                of the image, in pixels.
  *
- * @param filename  The filename of the image.
+ * @return  true if the dimensions were retrieved; false if the
+ *          graphics module does not know them.
+ */
+bool get_image_dimensions (image_t *image,
+                           uint16_t *width,
+                           uint16_t *height);
+
+
+/**
+ * Works out the average colour of a rectangular portion of an image.
+ *
+ * Only opaque pixels count towards the colour.  Not all graphics
+ * modules can read back image pixels.
+ *
+ * @param image     Pointer to the image data to query.
+ * @param image_x   The X-coordinate of the left edge of the
+ *                  rectangle, in pixels from the left edge of the
+ *                  image.
+ * @param image_y   The Y-coordinate of the top edge of the rectangle.
+ * @param width     The width of the rectangle, in pixels.
+ * @param height    The height of the rectangle, in pixels.
+ * @param colour    Array in which to store the average red, green
+ *                  and blue, followed by the proportion of the
+ *                  rectangle that is opaque (0 to 255).
+ *
+ * @return  true if the colour was worked out; false if the graphics
+ *          module cannot read image pixels.
+ */
+bool get_image_average_colour (image_t *image,
+                               int16_t image_x,
+                               int16_t image_y,
+                               uint16_t width,
+                               uint16_t height,
+                               uint8_t colour[4]);
+
+
+/**
+ * Works out the average colours of a grid of equally sized cells
+ * tiled across an image, such as the tiles of a tileset image.
+ *
+ * Cells are numbered left to right, then top to bottom.  This is
+ * cheaper than calling get_image_average_colour once per cell, as
+ * pending draw commands are only flushed once.
+ *
+ * @param image      Pointer to the image data to query.
+ * @param cell_w     The width of each cell, in pixels.
+ * @param cell_h     The height of each cell, in pixels.
+ * @param num_cells  The number of cells to work out, counting from
+ *                   the top-left cell.
+ * @param colours    Array of num_cells entries in which to store each
+ *                   cell's colour, as in get_image_average_colour.
+ *
+ * @return  true if the colours were worked out; false if the graphics
+ *          module cannot read image pixels or dimensions, or the
+ *          image holds fewer than num_cells cells.
+ */
+bool get_image_grid_colours (image_t *image,
+                             uint16_t cell_w,
+                             uint16_t cell_h,
+                             uint32_t num_cells,
+                             uint8_t colours[][4]);
+
+
+/**
+ * Draws a rectangular portion of an image on-screen.
+ *
+ * @param image     The handle of the image, as returned by
+ *                  load_image.
  * @param image_x   The X-coordinate of the left edge of the
  *                  on-image rectangle to display, in pixels from the
  *                  left edge of the entire image.
@@ -266,7 +550,7 @@ void free_image (image_t * image);
  *                  cases, a failure will simply cause the image to
  *                  not appear.
  */
-void draw_image (const char filename[],
+void draw_image (image_handle_t image,
 		 int16_t image_x,
 		 int16_t image_y,
 		 int16_t screen_x,
@@ -305,9 +589,44 @@ void draw_image_direct (image_t * data,
 			uint16_t width, uint16_t height);
 
 
+/**
+ * Draws many same-sized rectangular portions of one image on-screen.
+ *
+ * This is equivalent to calling draw_image_direct once per
+ * rectangle, but reserves room in the drawing command buffer for the
+ * whole batch at once, so the rectangles reach the graphics module
+ * together.  It is meant for large numbers of small sprites, such
+ * as particles.
+ *
+ * @param data      Pointer to the driver-specific image data.
+ * @param width     The width of each rectangle, in pixels.
+ * @param height    The height of each rectangle, in pixels.
+ * @param count     The number of rectangles.
+ * @param image_x   Array of count X co-ordinates of the left edges of
+ *                  the on-image rectangles.
+ * @param image_y   Array of count Y co-ordinates of the top edges of
+ *                  the on-image rectangles.
+ * @param screen_x  Array of count X co-ordinates of the left edges of
+ *                  the on-screen rectangles.
+ * @param screen_y  Array of count Y co-ordinates of the top edges of
+ *                  the on-screen rectangles.
+ */
+void draw_image_batch (image_t *data,
+                       uint16_t width,
+                       uint16_t height,
+                       uint32_t count,
+                       const int16_t image_x[],
+                       const int16_t image_y[],
+                       const int16_t screen_x[],
+                       const int16_t screen_y[]);
+
+
 /**
  * Deletes an image previously loaded into the image cache.
  *
+ * The image keeps its handle, and is loaded again if drawn.  Pinned
+ * images are not deleted.
+ *
  * @param filename  Filename of the image.
  *
  * @return          true if the deletion succeeded;
@@ -318,6 +637,8 @@ bool delete_image (const char filename[]);
 
 /**
  * Deletes all images in the image cache.
+ *
+ * As with delete_image, the images keep their handles.
  */
 void clear_images (void);
 
@@ -348,9 +669,221 @@ void add_update_rectangle (int16_t x,
 			   uint16_t width, uint16_t height);
 
 
+/**
+ * Draws a rectangular portion of an image, scaled to fit a rectangle
+ * of a different size.
+ *
+ * Like draw_image_direct, this is buffered, and drawn in order with
+ * other buffered commands.
+ *
+ * @param data          Pointer to the driver-specific image data.
+ * @param image_x       The X-coordinate of the left edge of the
+ *                      on-image rectangle.
+ * @param image_y       The Y-coordinate of the top edge of the
+ *                      on-image rectangle.
+ * @param image_width   The width of the on-image rectangle.
+ * @param image_height  The height of the on-image rectangle.
+ * @param screen_x      The X-coordinate of the left edge of the
+ *                      on-screen rectangle.
+ * @param screen_y      The Y-coordinate of the top edge of the
+ *                      on-screen rectangle.
+ * @param width         The width of the on-screen rectangle.
+ * @param height        The height of the on-screen rectangle.
+ *
+ * @return  true if the graphics module supports scaled drawing;
+ *          false otherwise.
+ */
+bool draw_image_scaled_direct (image_t *data,
+                               int16_t image_x,
+                               int16_t image_y,
+                               uint16_t image_width,
+                               uint16_t image_height,
+                               int16_t screen_x,
+                               int16_t screen_y,
+                               uint16_t width,
+                               uint16_t height);
+
+
+/**
+ * Restricts all drawing to a rectangle of the screen.
+ *
+ * Drawing commands are clipped to the rectangle as they are issued,
+ * until the rectangle is changed or clear_clip_rectangle is called.
+ * Update rectangles, and drawing into images (see set_draw_target),
+ * are not clipped.
+ *
+ * @param x       The X co-ordinate of the left edge of the rectangle,
+ *                in pixels from the left edge of the screen.
+ * @param y       The Y co-ordinate of the top edge of the rectangle,
+ *                in pixels from the top edge of the screen.
+ * @param width   The width of the rectangle, in pixels.
+ * @param height  The height of the rectangle, in pixels.
+ */
+void set_clip_rectangle (int16_t x,
+                         int16_t y,
+                         uint16_t width,
+                         uint16_t height);
+
+
+/**
+ * Lifts any restriction set by set_clip_rectangle.
+ */
+void clear_clip_rectangle (void);
+
+
+/**
+ * Creates a blank image, to be drawn into with set_draw_target.
+ *
+ * The image is not placed in the image cache, and should be freed
+ * with free_image.
+ *
+ * @param width        The width of the image, in pixels.
+ * @param height       The height of the image, in pixels.
+ * @param transparent  If true, the image starts fully transparent,
+ *                     and images drawn into it keep their
+ *                     transparency; otherwise it starts black.
+ *
+ * @return  a pointer to the new image, or NULL if the graphics
+ *          module cannot create images.
+ */
+image_t *create_image (uint16_t width, uint16_t height, bool transparent);
+
+
+/**
+ * Redirects drawing into an image instead of the screen.
+ *
+ * Drawing commands buffered so far still go to the old target.
+ * Screen co-ordinates given to drawing functions then refer to
+ * positions on the image.
+ *
+ * @param image  The image to draw into, as returned by
+ *               create_image, or NULL to draw to the screen again.
+ *
+ * @return  true if the target was changed; false if the graphics
+ *          module cannot draw into images.
+ */
+bool set_draw_target (image_t *image);
+
+
+/**
+ * Sets a colour tint for the whole screen, such as for time of day
+ * or fading out.
+ *
+ * The tint is applied as the screen is presented, so drawing is
+ * unaffected and the tint may change freely.  Changing the tint
+ * updates the whole screen on the next update.  Not all graphics
+ * modules support tinting; those that do not ignore it.
+ *
+ * @param red    Red multiplier, from 0 (no red) to 255 (unchanged).
+ * @param green  Green multiplier, likewise.
+ * @param blue   Blue multiplier, likewise.
+ */
+void set_screen_tint (uint8_t red, uint8_t green, uint8_t blue);
+
+
+/**
+ * Darkens a rectangle of what has already been drawn, for example to
+ * light a map.
+ *
+ * The shading is buffered along with other drawing commands, so it
+ * applies to anything drawn before it.  Not all graphics modules
+ * support shading; those that do not ignore it.
+ *
+ * @param x           The X co-ordinate of the left edge of the
+ *                    rectangle, in pixels from the left edge of the
+ *                    screen.
+ * @param y           The Y co-ordinate of the top edge of the
+ *                    rectangle, in pixels from the top edge of the
+ *                    screen.
+ * @param width       The width of the rectangle, in pixels.
+ * @param height      The height of the rectangle, in pixels.
+ * @param brightness  Brightness to leave, from 0 (black) to 255
+ *                    (unchanged).
+ */
+void shade_rectangle (int16_t x,
+                      int16_t y,
+                      uint16_t width,
+                      uint16_t height,
+                      uint8_t brightness);
+
+
+/**
+ * Starts a transition away from what is currently on-screen.
+ *
+ * The screen as last presented is kept, and for the given number of
+ * frames afterwards each screen update shows a mix of it and the
+ * screen as drawn since, according to the transition style.  Drawing
+ * carries on as normal during the transition.
+ *
+ * @param type    The style of transition.
+ * @param frames  The number of frames the transition lasts.
+ *
+ * @return  true if the transition has started; false if the
+ *          graphics module does not support transitions, or frames
+ *          is 0, in which case the screen will simply cut over.
+ */
+bool start_transition (transition_type_t type, uint16_t frames);
+
+
+/**
+ * Sends all buffered drawing commands to the graphics module, and
+ * waits for them to be carried out.
+ *
+ * Drawing functions such as draw_image_direct and draw_rectangle do
+ * not draw immediately, but instead append to a frame-local command
+ * buffer.  This is flushed automatically when the screen is updated,
+ * and before anything that reads or frees image data, so there is
+ * normally no need to call this directly.
+ */
+void flush_draw_commands (void);
+
+
+/**
+ * Writes the screen as last presented to a PNG file, for example to
+ * check rendering on a machine with no display.
+ *
+ * Drawing commands buffered so far are flushed first, but are not
+ * presented until the next screen update.  Not all graphics modules
+ * support dumping the screen.
+ *
+ * @param filename  Path of the file to write.
+ *
+ * @return  true if the file was written; false if it could not be,
+ *          or the graphics module does not support dumping.
+ */
+bool dump_screen (const char filename[]);
+
+
+/**
+ * Stops the render thread, if there is one, from presenting to the
+ * window until unlock_window is called.
+ *
+ * Event handling must be done inside this lock, as it may talk to
+ * the same window system connection as screen updates do.  Graphics
+ * functions that wait for drawing to finish may still be called,
+ * as the lock is lifted while they wait.
+ */
+void lock_window (void);
+
+
+/**
+ * Lifts the lock taken by lock_window.
+ */
+void unlock_window (void);
+
+
 /**
  * Updates the screen.
  *
+ * If the render_thread key of the gfx group is set to 1, the frame's
+ * drawing commands are handed to a separate render thread, which
+ * carries them out while the next frame is simulated.  Otherwise,
+ * they are carried out before this returns.
+ *
+ * If the dump_every key of the gfx group is above 0, every that many
+ * presented frames are also written out with dump_screen, to the
+ * dump_path key followed by the frame number and .png.
+ *
  * @param useconds  Elapsed microseconds in the frame.
  */
 void update_screen (uint32_t useconds);
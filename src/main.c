@@ -98,6 +98,7 @@ init (void)
   init_bindings ();
   init_events ();
   init_timer ();
+  init_pacing ();
 
   set_state (STATE_FIELD);
 
@@ -0,0 +1,499 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/map/lightmap.c
+ * @author  agent
+ * @brief   Map lighting.
+ */
+
+#include "../crystals.h"
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  MAX_LIGHT_SEARCH = ((2 * MAX_LIGHT_LEVEL) - 1)
+                     * ((2 * MAX_LIGHT_LEVEL) - 1)  /**< Most tiles one
+                                                       source can
+                                                       reach. */
+};
+
+
+/* -- STATIC GLOBAL VARIABLES -- */
+
+static const int32_t NEIGHBOUR_X[4] = { 1, -1, 0, 0 };  /**< X offsets
+                                                           of a tile's
+                                                           neighbours. */
+static const int32_t NEIGHBOUR_Y[4] = { 0, 0, 1, -1 };  /**< Y offsets
+                                                           of a tile's
+                                                           neighbours. */
+
+
+/* -- STATIC DECLARATIONS -- */
+
+/**
+ * Re-lights a rectangle of tiles from the ambient level and every
+ * source in reach, queueing any tiles whose level changes.
+ *
+ * @param light_map  Pointer to the light map.
+ * @param left       X co-ordinate of the leftmost tile.
+ * @param top        Y co-ordinate of the topmost tile.
+ * @param right      X co-ordinate of the column after the rightmost
+ *                   tile.
+ * @param bottom     Y co-ordinate of the row after the bottommost
+ *                   tile.
+ */
+static void relight_area (light_map_t *light_map,
+                          int32_t left,
+                          int32_t top,
+                          int32_t right,
+                          int32_t bottom);
+
+
+/**
+ * Spreads the light of one source by breadth-first search, raising
+ * the scratch levels of tiles within a rectangle.
+ *
+ * @param light_map  Pointer to the light map.
+ * @param source     Pointer to the light source.
+ * @param left       X co-ordinate of the leftmost tile to light.
+ * @param top        Y co-ordinate of the topmost tile to light.
+ * @param right      X co-ordinate of the column after the rightmost
+ *                   tile to light.
+ * @param bottom     Y co-ordinate of the row after the bottommost
+ *                   tile to light.
+ */
+static void spread_light (light_map_t *light_map,
+                          light_source_t *source,
+                          int32_t left,
+                          int32_t top,
+                          int32_t right,
+                          int32_t bottom);
+
+
+/**
+ * Relights the tiles a light source can reach.
+ *
+ * @param light_map  Pointer to the light map.
+ * @param source     Pointer to the light source.
+ */
+static void relight_source_reach (light_map_t *light_map,
+                                  light_source_t *source);
+
+
+/**
+ * Checks whether a tile stops light from passing through it.
+ *
+ * @param map    Pointer to the map.
+ * @param index  Index (y * width + x) of the tile.
+ *
+ * @return  true if any layer's zone at the tile blocks light; false
+ *          otherwise.
+ */
+static bool tile_blocks_light (map_t *map, uint32_t index);
+
+
+/* -- DEFINITIONS -- */
+
+/* Creates a light map for a map. */
+light_map_t *
+init_light_map (map_t *map, uint8_t ambient)
+{
+  light_map_t *light_map;
+  uint32_t num_tiles;
+
+  g_assert (map != NULL);
+  g_assert (ambient <= MAX_LIGHT_LEVEL);
+
+  num_tiles = (uint32_t) map->width * map->height;
+
+  light_map = xcalloc (1, sizeof (light_map_t));
+  light_map->map = map;
+  light_map->ambient = ambient;
+  light_map->levels = xcalloc (num_tiles, sizeof (uint8_t));
+  light_map->scratch = xcalloc (num_tiles, sizeof (uint8_t));
+  light_map->spread = xcalloc (num_tiles, sizeof (uint8_t));
+  light_map->visited = xcalloc (num_tiles, sizeof (uint32_t));
+  light_map->queue = xcalloc (MAX_LIGHT_SEARCH, sizeof (uint32_t));
+  light_map->changed = xcalloc (num_tiles, sizeof (uint8_t));
+  light_map->changed_tiles = g_array_new (FALSE, FALSE,
+                                          sizeof (uint32_t));
+
+  /* With no sources yet, everything is at the ambient level; there
+     is nothing to redraw. */
+  memset (light_map->levels, ambient, num_tiles);
+
+  free_light_map (map->light_map);
+  map->light_map = light_map;
+
+  return light_map;
+}
+
+
+/* Changes the ambient light level of a light map. */
+void
+set_ambient_light (light_map_t *light_map, uint8_t ambient)
+{
+  g_assert (light_map != NULL);
+  g_assert (ambient <= MAX_LIGHT_LEVEL);
+
+  if (light_map->ambient == ambient)
+    return;
+
+  light_map->ambient = ambient;
+  refresh_light_map (light_map);
+}
+
+
+/* Adds a light source. */
+light_source_t *
+add_light_source (light_map_t *light_map,
+                  dimension_t x,
+                  dimension_t y,
+                  uint8_t intensity)
+{
+  light_source_t *source;
+
+  g_assert (light_map != NULL);
+  g_assert (x < light_map->map->width && y < light_map->map->height);
+  g_assert (intensity > 0 && intensity <= MAX_LIGHT_LEVEL);
+
+  source = xcalloc (1, sizeof (light_source_t));
+  source->x = x;
+  source->y = y;
+  source->intensity = intensity;
+
+  light_map->sources = g_slist_prepend (light_map->sources, source);
+  relight_source_reach (light_map, source);
+
+  return source;
+}
+
+
+/* Moves a light source. */
+void
+move_light_source (light_map_t *light_map,
+                   light_source_t *source,
+                   dimension_t x,
+                   dimension_t y)
+{
+  light_source_t old;
+
+  g_assert (light_map != NULL && source != NULL);
+  g_assert (x < light_map->map->width && y < light_map->map->height);
+
+  if (source->x == x && source->y == y)
+    return;
+
+  /* Relight where the light was, then where it now is, rather than
+     the box around both, which could be huge after a long jump. */
+  old = *source;
+  source->x = x;
+  source->y = y;
+
+  relight_source_reach (light_map, &old);
+  relight_source_reach (light_map, source);
+}
+
+
+/* Removes and frees a light source. */
+void
+remove_light_source (light_map_t *light_map, light_source_t *source)
+{
+  light_source_t old;
+
+  g_assert (light_map != NULL && source != NULL);
+
+  old = *source;
+
+  light_map->sources = g_slist_remove (light_map->sources, source);
+  free (source);
+
+  relight_source_reach (light_map, &old);
+}
+
+
+/* Re-lights the area around a tile whose light-blocking has
+   changed. */
+void
+mark_light_tile_changed (light_map_t *light_map,
+                         dimension_t x,
+                         dimension_t y)
+{
+  GSList *node;
+
+  g_assert (light_map != NULL);
+
+  /* Only sources that can reach the tile can be affected. */
+  for (node = light_map->sources; node != NULL; node = node->next)
+    {
+      light_source_t *source = node->data;
+      int32_t reach = source->intensity - 1;
+
+      if (abs ((int) x - (int) source->x) <= reach
+          && abs ((int) y - (int) source->y) <= reach)
+        relight_source_reach (light_map, source);
+    }
+}
+
+
+/* Re-lights the whole map. */
+void
+refresh_light_map (light_map_t *light_map)
+{
+  g_assert (light_map != NULL);
+
+  relight_area (light_map, 0, 0,
+                light_map->map->width, light_map->map->height);
+}
+
+
+/* Gets the light level of a tile. */
+uint8_t
+get_light_level (light_map_t *light_map, dimension_t x, dimension_t y)
+{
+  g_assert (light_map != NULL);
+  g_assert (x < light_map->map->width && y < light_map->map->height);
+
+  return light_map->levels[((uint32_t) y * light_map->map->width) + x];
+}
+
+
+/* Passes every tile whose light level has changed to a callback. */
+void
+take_light_changes (light_map_t *light_map,
+                    light_change_func_t function,
+                    gpointer data)
+{
+  uint32_t *tiles;
+  dimension_t width;
+  guint i;
+
+  g_assert (light_map != NULL && function != NULL);
+
+  tiles = (uint32_t *) light_map->changed_tiles->data;
+  width = light_map->map->width;
+
+  for (i = 0; i < light_map->changed_tiles->len; i += 1)
+    {
+      light_map->changed[tiles[i]] = 0;
+      (*function) ((dimension_t) (tiles[i] % width),
+                   (dimension_t) (tiles[i] / width),
+                   data);
+    }
+
+  g_array_set_size (light_map->changed_tiles, 0);
+}
+
+
+/* De-initialises a light map. */
+void
+free_light_map (light_map_t *light_map)
+{
+  if (light_map)
+    {
+      free (light_map->levels);
+      free (light_map->scratch);
+      free (light_map->spread);
+      free (light_map->visited);
+      free (light_map->queue);
+      free (light_map->changed);
+
+      if (light_map->changed_tiles)
+        g_array_free (light_map->changed_tiles, TRUE);
+
+      g_slist_free_full (light_map->sources, free);
+      free (light_map);
+    }
+}
+
+
+/* -- STATIC DEFINITIONS -- */
+
+/* Re-lights a rectangle of tiles. */
+static void
+relight_area (light_map_t *light_map,
+              int32_t left,
+              int32_t top,
+              int32_t right,
+              int32_t bottom)
+{
+  map_t *map = light_map->map;
+  GSList *node;
+  int32_t x;
+  int32_t y;
+
+  left = MAX (left, 0);
+  top = MAX (top, 0);
+  right = MIN (right, (int32_t) map->width);
+  bottom = MIN (bottom, (int32_t) map->height);
+
+  if (right <= left || bottom <= top)
+    return;
+
+  for (y = top; y < bottom; y += 1)
+    memset (light_map->scratch + (y * map->width) + left,
+            light_map->ambient, (size_t) (right - left));
+
+  for (node = light_map->sources; node != NULL; node = node->next)
+    {
+      light_source_t *source = node->data;
+      int32_t reach = source->intensity - 1;
+
+      if (source->x + reach >= left && source->x - reach < right
+          && source->y + reach >= top && source->y - reach < bottom)
+        spread_light (light_map, source, left, top, right, bottom);
+    }
+
+  for (y = top; y < bottom; y += 1)
+    for (x = left; x < right; x += 1)
+      {
+        uint32_t index = ((uint32_t) y * map->width) + (uint32_t) x;
+
+        if (light_map->scratch[index] == light_map->levels[index])
+          continue;
+
+        light_map->levels[index] = light_map->scratch[index];
+
+        if (!light_map->changed[index])
+          {
+            light_map->changed[index] = 1;
+            g_array_append_val (light_map->changed_tiles, index);
+          }
+      }
+}
+
+
+/* Spreads the light of one source by breadth-first search. */
+static void
+spread_light (light_map_t *light_map,
+              light_source_t *source,
+              int32_t left,
+              int32_t top,
+              int32_t right,
+              int32_t bottom)
+{
+  map_t *map = light_map->map;
+  uint32_t start = ((uint32_t) source->y * map->width) + source->x;
+  uint32_t head = 0;
+  uint32_t tail = 0;
+
+  /* Search numbers save clearing the visited marks every time. */
+  light_map->search += 1;
+  if (light_map->search == 0)
+    {
+      memset (light_map->visited, 0,
+              sizeof (uint32_t) * map->width * map->height);
+      light_map->search = 1;
+    }
+
+  light_map->visited[start] = light_map->search;
+  light_map->spread[start] = source->intensity;
+  light_map->queue[tail++] = start;
+
+  while (head < tail)
+    {
+      uint32_t index = light_map->queue[head++];
+      uint8_t level = light_map->spread[index];
+      int32_t x = (int32_t) (index % map->width);
+      int32_t y = (int32_t) (index / map->width);
+      int n;
+
+      if (x >= left && x < right && y >= top && y < bottom
+          && level > light_map->scratch[index])
+        light_map->scratch[index] = level;
+
+      /* Blocking tiles are lit, but pass no light on.  The source
+         always shines, even from inside a wall. */
+      if (level <= 1 || (index != start && tile_blocks_light (map, index)))
+        continue;
+
+      for (n = 0; n < 4; n += 1)
+        {
+          int32_t nx = x + NEIGHBOUR_X[n];
+          int32_t ny = y + NEIGHBOUR_Y[n];
+          uint32_t neighbour;
+
+          if (nx < 0 || ny < 0
+              || nx >= (int32_t) map->width || ny >= (int32_t) map->height)
+            continue;
+
+          neighbour = ((uint32_t) ny * map->width) + (uint32_t) nx;
+          if (light_map->visited[neighbour] == light_map->search)
+            continue;
+
+          light_map->visited[neighbour] = light_map->search;
+          light_map->spread[neighbour] = (uint8_t) (level - 1);
+          light_map->queue[tail++] = neighbour;
+        }
+    }
+}
+
+
+/* Relights the tiles a light source can reach. */
+static void
+relight_source_reach (light_map_t *light_map, light_source_t *source)
+{
+  int32_t reach = source->intensity - 1;
+
+  relight_area (light_map,
+                source->x - reach,
+                source->y - reach,
+                source->x + reach + 1,
+                source->y + reach + 1);
+}
+
+
+/* Checks whether a tile stops light from passing through it. */
+static bool
+tile_blocks_light (map_t *map, uint32_t index)
+{
+  layer_index_t l;
+
+  for (l = 0; l <= map->max_layer_index; l += 1)
+    {
+      layer_zone_t zone = map->zone_planes[l][index];
+
+      if (zone <= map->max_zone_index
+          && (map->zone_properties[zone] & ZONE_BLOCKS_LIGHT))
+        return true;
+    }
+
+  return false;
+}
@@ -0,0 +1,256 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/map/lightmap.h
+ * @author  agent
+ * @brief   Prototypes and declarations for map lighting.
+ *
+ * A light map holds a light level for every tile of a map, made up
+ * of an ambient level plus the light of any number of light sources
+ * (torches, lanterns and so on).  Light spreads out from each
+ * source tile by tile, losing one level per step, and stops at tiles
+ * whose zone has the ZONE_BLOCKS_LIGHT property; such tiles are
+ * themselves lit, but pass no light on.
+ *
+ * Light levels are never recomputed wholesale.  When a source is
+ * added, moved or removed, or a tile's zone changes, only the tiles
+ * within reach of the sources involved are re-lit, by a bounded
+ * breadth-first search from each source in range.  Tiles whose level
+ * actually changes are queued, so that renderers can redraw just
+ * those tiles.
+ */
+
+#ifndef _LIGHTMAP_H
+#define _LIGHTMAP_H
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  MAX_LIGHT_LEVEL = 15  /**< Light level of a fully lit tile. */
+};
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * A light source.
+ */
+typedef struct light_source
+{
+  dimension_t x;      /**< X co-ordinate of the source tile. */
+  dimension_t y;      /**< Y co-ordinate of the source tile. */
+  uint8_t intensity;  /**< Light level at the source tile, from 1 to
+                         MAX_LIGHT_LEVEL.  Also the number of tiles
+                         the light reaches, counting the source. */
+} light_source_t;
+
+
+/**
+ * A map light map.
+ */
+typedef struct light_map
+{
+  map_t *map;              /**< The map being lit. */
+  uint8_t ambient;         /**< Light level of tiles lit by no
+                              source. */
+
+  uint8_t *levels;         /**< Light level of each tile. */
+  uint8_t *scratch;        /**< Light levels being recomputed. */
+
+  uint8_t *spread;         /**< Light level reached by the current
+                              search, for tiles it has visited. */
+  uint32_t *visited;       /**< Search in which each tile was last
+                              visited. */
+  uint32_t search;         /**< Number of the current search. */
+  uint32_t *queue;         /**< Search queue of tile indices. */
+
+  GSList *sources;         /**< List of light_source_t. */
+
+  uint8_t *changed;        /**< Per-tile flags, set if the tile is in
+                              changed_tiles. */
+  GArray *changed_tiles;   /**< Indices (y * width + x) of tiles
+                              whose light level has changed since
+                              they were last taken, as uint32_t. */
+} light_map_t;
+
+
+/**
+ * Type of callbacks receiving tiles whose light level has changed.
+ *
+ * @param x     X co-ordinate of the tile.
+ * @param y     Y co-ordinate of the tile.
+ * @param data  User data.
+ */
+typedef void (*light_change_func_t) (dimension_t x,
+                                     dimension_t y,
+                                     gpointer data);
+
+
+/* -- DECLARATIONS -- */
+
+/**
+ * Creates a light map for a map, and attaches it to the map.
+ *
+ * Any previous light map of the map is freed.  The light map is freed
+ * along with the map.
+ *
+ * @param map      Pointer to the map to light.
+ * @param ambient  Light level of tiles lit by no source, from 0 to
+ *                 MAX_LIGHT_LEVEL.
+ *
+ * @return  a pointer to the new light map.
+ */
+light_map_t *init_light_map (map_t *map, uint8_t ambient);
+
+
+/**
+ * Changes the ambient light level of a light map.
+ *
+ * This re-lights the whole map, and is meant for occasional changes
+ * such as entering a cave.
+ *
+ * @param light_map  Pointer to the light map.
+ * @param ambient    New ambient light level, from 0 to
+ *                   MAX_LIGHT_LEVEL.
+ */
+void set_ambient_light (light_map_t *light_map, uint8_t ambient);
+
+
+/**
+ * Adds a light source.
+ *
+ * @param light_map  Pointer to the light map.
+ * @param x          X co-ordinate of the source tile.
+ * @param y          Y co-ordinate of the source tile.
+ * @param intensity  Light level at the source tile, from 1 to
+ *                   MAX_LIGHT_LEVEL.
+ *
+ * @return  a pointer to the new light source, owned by the light
+ *          map.
+ */
+light_source_t *add_light_source (light_map_t *light_map,
+                                  dimension_t x,
+                                  dimension_t y,
+                                  uint8_t intensity);
+
+
+/**
+ * Moves a light source.
+ *
+ * @param light_map  Pointer to the light map.
+ * @param source     Pointer to the light source.
+ * @param x          New X co-ordinate of the source tile.
+ * @param y          New Y co-ordinate of the source tile.
+ */
+void move_light_source (light_map_t *light_map,
+                        light_source_t *source,
+                        dimension_t x,
+                        dimension_t y);
+
+
+/**
+ * Removes and frees a light source.
+ *
+ * @param light_map  Pointer to the light map.
+ * @param source     Pointer to the light source.
+ */
+void remove_light_source (light_map_t *light_map,
+                          light_source_t *source);
+
+
+/**
+ * Re-lights the area around a tile whose light-blocking has changed.
+ *
+ * @param light_map  Pointer to the light map.
+ * @param x          X co-ordinate of the tile.
+ * @param y          Y co-ordinate of the tile.
+ */
+void mark_light_tile_changed (light_map_t *light_map,
+                              dimension_t x,
+                              dimension_t y);
+
+
+/**
+ * Re-lights the whole map, for example after zone properties change.
+ *
+ * @param light_map  Pointer to the light map.
+ */
+void refresh_light_map (light_map_t *light_map);
+
+
+/**
+ * Gets the light level of a tile.
+ *
+ * @param light_map  Pointer to the light map.
+ * @param x          X co-ordinate of the tile.
+ * @param y          Y co-ordinate of the tile.
+ *
+ * @return  the light level, from 0 to MAX_LIGHT_LEVEL.
+ */
+uint8_t get_light_level (light_map_t *light_map,
+                         dimension_t x,
+                         dimension_t y);
+
+
+/**
+ * Passes every tile whose light level has changed since the last
+ * call to a callback, then forgets them.
+ *
+ * @param light_map  Pointer to the light map.
+ * @param function   The callback.
+ * @param data       User data to pass to the callback.
+ */
+void take_light_changes (light_map_t *light_map,
+                         light_change_func_t function,
+                         gpointer data);
+
+
+/**
+ * De-initialises a light map.
+ *
+ * This does not detach the light map from its map; it is normally
+ * called by free_map.
+ *
+ * @param light_map  Pointer to the light map to free.
+ */
+void free_light_map (light_map_t *light_map);
+
+
+#endif /* not _LIGHTMAP_H */
@@ -176,6 +176,10 @@ set_zone_properties (map_t *map, zone_index_t zone,
   g_assert (zone <= map->max_zone_index);
 
   map->zone_properties[zone] = properties;
+
+  /* Any tile of the zone may now block light differently. */
+  if (map->light_map != NULL)
+    refresh_light_map (map->light_map);
 }
 
 
@@ -190,6 +194,10 @@ set_tile_value (map_t *map,
   g_assert (x < map->width && y < map->height);
 
   map->value_planes[layer][(y * map->width) + x] = value;
+  map->value_revision += 1;
+
+  if (map->minimap != NULL)
+    mark_minimap_tile_dirty (map->minimap, x, y);
 }
 
 
@@ -205,6 +213,9 @@ set_tile_zone (map_t *map,
   g_assert (x < map->width && y < map->height);
 
   map->zone_planes[layer][(y * map->width) + x] = zone;
+
+  if (map->light_map != NULL)
+    mark_light_tile_changed (map->light_map, x, y);
 }
 
 
@@ -288,6 +299,12 @@ free_map (map_t *map)
       free_planes (map->max_layer_index, map->value_planes,
 		   map->zone_planes);
 
+      free_map_chunk_cache (map->chunk_cache);
+      free_minimap (map->minimap);
+      free_light_map (map->light_map);
+      free_parallax_layers (map->parallax_layers);
+      free_tileset (map->tileset);
+
       free (map);
     }
 }
@@ -70,6 +70,16 @@ enum
 };
 
 
+/**
+ * Zone property bits.
+ */
+enum
+{
+  ZONE_BLOCKS_LIGHT = 1 << 0  /**< Tiles in the zone stop light from
+                                 passing through (see lightmap.h). */
+};
+
+
 /* -- STRUCTURES -- */
 
 /** The map data structure.
@@ -94,6 +104,28 @@ typedef struct map
   layer_value_t **value_planes;	    /**< Pointers to map layer value planes. */
   layer_zone_t **zone_planes;	    /**< Pointers to map layer value planes. */
 
+  struct tileset *tileset;          /**< The map's tileset, or NULL if
+                                       none has been loaded. */
+
+  struct map_chunk_cache *chunk_cache;  /**< Cache of pre-rendered
+                                           chunks, or NULL if none
+                                           have been rendered. */
+
+  GSList *parallax_layers;          /**< Parallax layers declared by
+                                       the map, as parallax_layer_t,
+                                       from back to front. */
+
+  struct light_map *light_map;      /**< The map's light map, or NULL
+                                       if the map is not lit. */
+
+  struct minimap *minimap;          /**< The map's minimap, or NULL if
+                                       none has been created. */
+
+  uint32_t value_revision;          /**< Incremented whenever a tile
+                                       value changes, so that caches
+                                       of tile values can tell when
+                                       they are stale. */
+
 } map_t;
 
 
@@ -0,0 +1,242 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/map/mapcache.c
+ * @author  agent
+ * @brief   The map chunk cache.
+ */
+
+#include "../crystals.h"
+
+
+/* -- STATIC DECLARATIONS -- */
+
+/**
+ * Works out the hash key of a chunk.
+ *
+ * @param map      Pointer to the map the chunk belongs to.
+ * @param scale    Scale divisor of the chunk.
+ * @param chunk_x  X co-ordinate of the chunk, in chunks.
+ * @param chunk_y  Y co-ordinate of the chunk, in chunks.
+ *
+ * @return  the chunk's key, packed into a pointer.
+ */
+static gpointer chunk_key (map_t *map,
+                           uint16_t scale,
+                           dimension_t chunk_x,
+                           dimension_t chunk_y);
+
+
+/**
+ * Renders a chunk of a map into its image.
+ *
+ * @param map      Pointer to the map to render from.
+ * @param chunk    Pointer to the chunk to render.
+ * @param scale    Scale divisor to render at.
+ * @param chunk_x  X co-ordinate of the chunk, in chunks.
+ * @param chunk_y  Y co-ordinate of the chunk, in chunks.
+ */
+static void render_map_chunk (map_t *map,
+                              map_chunk_t *chunk,
+                              uint16_t scale,
+                              dimension_t chunk_x,
+                              dimension_t chunk_y);
+
+
+/**
+ * Frees a cached chunk.
+ *
+ * @param chunk  Pointer to the chunk to free.
+ */
+static void free_map_chunk (gpointer chunk);
+
+
+/* -- DEFINITIONS -- */
+
+/* Retrieves a pre-rendered chunk of a map. */
+image_t *
+get_map_chunk (map_t *map,
+               uint16_t scale,
+               dimension_t chunk_x,
+               dimension_t chunk_y)
+{
+  map_chunk_t *chunk;
+  gpointer key;
+
+  g_assert (map != NULL);
+  g_assert (scale > 1);
+
+  if (map->chunk_cache == NULL)
+    {
+      map->chunk_cache = xcalloc (1, sizeof (map_chunk_cache_t));
+      map->chunk_cache->chunks = g_hash_table_new_full (g_direct_hash,
+                                                        g_direct_equal,
+                                                        NULL,
+                                                        free_map_chunk);
+    }
+
+  key = chunk_key (map, scale, chunk_x, chunk_y);
+  chunk = g_hash_table_lookup (map->chunk_cache->chunks, key);
+
+  if (chunk == NULL)
+    {
+      image_t *image = create_image ((uint16_t) ((CHUNK_TILES * TILE_W)
+                                                 / scale),
+                                     (uint16_t) ((CHUNK_TILES * TILE_H)
+                                                 / scale),
+                                     false);
+      if (image == NULL)
+        return NULL;
+
+      chunk = xcalloc (1, sizeof (map_chunk_t));
+      chunk->image = image;
+      render_map_chunk (map, chunk, scale, chunk_x, chunk_y);
+
+      g_hash_table_insert (map->chunk_cache->chunks, key, chunk);
+    }
+  else if (chunk->revision != map->value_revision)
+    render_map_chunk (map, chunk, scale, chunk_x, chunk_y);
+
+  return chunk->image;
+}
+
+
+/* De-initialises a map chunk cache. */
+void
+free_map_chunk_cache (map_chunk_cache_t *cache)
+{
+  if (cache)
+    {
+      if (cache->chunks)
+        g_hash_table_destroy (cache->chunks);
+
+      free (cache);
+    }
+}
+
+
+/* -- STATIC DEFINITIONS -- */
+
+/* Works out the hash key of a chunk. */
+static gpointer
+chunk_key (map_t *map,
+           uint16_t scale,
+           dimension_t chunk_x,
+           dimension_t chunk_y)
+{
+  guint chunks_w = (map->width + CHUNK_TILES - 1) / CHUNK_TILES;
+  guint chunks_h = (map->height + CHUNK_TILES - 1) / CHUNK_TILES;
+
+  return GUINT_TO_POINTER ((((guint) scale * chunks_h) + chunk_y)
+                           * chunks_w + chunk_x);
+}
+
+
+/* Renders a chunk of a map into its image. */
+static void
+render_map_chunk (map_t *map,
+                  map_chunk_t *chunk,
+                  uint16_t scale,
+                  dimension_t chunk_x,
+                  dimension_t chunk_y)
+{
+  uint16_t tile_w = (uint16_t) (TILE_W / scale);
+  uint16_t tile_h = (uint16_t) (TILE_H / scale);
+  uint32_t start_x = (uint32_t) chunk_x * CHUNK_TILES;
+  uint32_t start_y = (uint32_t) chunk_y * CHUNK_TILES;
+  uint32_t end_x = MIN (start_x + CHUNK_TILES, map->width);
+  uint32_t end_y = MIN (start_y + CHUNK_TILES, map->height);
+  layer_index_t l;
+
+  g_assert (map->tileset != NULL);
+
+  set_draw_target (chunk->image);
+
+  draw_rectangle (0, 0,
+                  (uint16_t) (CHUNK_TILES * tile_w),
+                  (uint16_t) (CHUNK_TILES * tile_h),
+                  0, 0, 0);
+
+  for (l = 0; l <= map->max_layer_index; l += 1)
+    {
+      uint32_t x;
+      uint32_t y;
+
+      for (y = start_y; y < end_y; y += 1)
+        for (x = start_x; x < end_x; x += 1)
+          {
+            layer_value_t value = map->value_planes[l][x + y * map->width];
+            tile_source_t *source;
+
+            /* 0 = transparency */
+            if (value == 0)
+              continue;
+
+            source = get_tile_source (map->tileset, value);
+            if (source == NULL || source->image == NULL)
+              continue;
+
+            draw_image_scaled_direct (source->image,
+                                      source->x, source->y,
+                                      TILE_W, TILE_H,
+                                      (int16_t) ((x - start_x) * tile_w),
+                                      (int16_t) ((y - start_y) * tile_h),
+                                      tile_w, tile_h);
+          }
+    }
+
+  set_draw_target (NULL);
+
+  chunk->revision = map->value_revision;
+}
+
+
+/* Frees a cached chunk. */
+static void
+free_map_chunk (gpointer chunk)
+{
+  map_chunk_t *chunkc = (map_chunk_t *) chunk;
+
+  if (chunkc)
+    {
+      if (chunkc->image)
+        free_image (chunkc->image);
+
+      free (chunkc);
+    }
+}
@@ -0,0 +1,119 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/map/mapcache.h
+ * @author  agent
+ * @brief   Prototypes and declarations for the map chunk cache.
+ *
+ * Scaled-down map views are drawn from pre-rendered chunks of the
+ * map: square blocks of CHUNK_TILES by CHUNK_TILES tiles, with all
+ * layers flattened, shrunk to the view's scale.  Chunks are cached
+ * on the map itself, so all views of one map at one scale share
+ * them.
+ *
+ * Chunks are re-rendered when the map's tile values change.  They do
+ * not follow tile animations.
+ */
+
+#ifndef _MAPCACHE_H
+#define _MAPCACHE_H
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  CHUNK_TILES = 8  /**< Width and height of a chunk, in tiles. */
+};
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * A cached, pre-rendered map chunk.
+ */
+typedef struct map_chunk
+{
+  image_t *image;     /**< The rendered chunk. */
+  uint32_t revision;  /**< The map value revision the chunk was
+                         rendered at. */
+} map_chunk_t;
+
+
+/**
+ * A map chunk cache.
+ */
+typedef struct map_chunk_cache
+{
+  GHashTable *chunks;  /**< Hash table of map_chunk_t, keyed on
+                          chunk position and scale. */
+} map_chunk_cache_t;
+
+
+/* -- DECLARATIONS -- */
+
+/**
+ * Retrieves a pre-rendered chunk of a map, rendering it if it is not
+ * cached or is out of date.
+ *
+ * @param map      Pointer to the map to render from.
+ * @param scale    Scale divisor to render at (2, 4 or 8).
+ * @param chunk_x  X co-ordinate of the chunk, in chunks from the left
+ *                 edge of the map.
+ * @param chunk_y  Y co-ordinate of the chunk, in chunks from the top
+ *                 edge of the map.
+ *
+ * @return  the chunk image, which is CHUNK_TILES * TILE_W / scale
+ *          pixels wide and CHUNK_TILES * TILE_H / scale pixels high,
+ *          or NULL if the graphics module cannot render chunks.
+ */
+image_t *get_map_chunk (map_t *map,
+                        uint16_t scale,
+                        dimension_t chunk_x,
+                        dimension_t chunk_y);
+
+
+/**
+ * De-initialises a map chunk cache, freeing all chunk images.
+ *
+ * @param cache  Pointer to the cache to free.
+ */
+void free_map_chunk_cache (map_chunk_cache_t *cache);
+
+
+#endif /* not _MAPCACHE_H */
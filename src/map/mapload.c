@@ -72,6 +72,13 @@ static const long HEADER_POSITION = 4;
 static const long CHUNK_NOT_FOUND = -1;
 
 
+/**
+ * Suffix added to a map's path to give the path of its image
+ * manifest.
+ */
+static const char MANIFEST_SUFFIX[] = ".manifest";
+
+
 typedef enum chunk_id
 {
   ID_FORM,
@@ -82,7 +89,12 @@ typedef enum chunk_id
   ID_VALUES,
   ID_ZONES,
   ID_PROPERTIES,
+  ID_TILESETS,
+  ID_ANIMATIONS,
+  ID_PARALLAX,
+  ID_LIGHTING,
   NUM_CHUNKS,
+  FIRST_OPTIONAL_CHUNK = ID_TILESETS,
   UNKNOWN_CHUNK = -1
 } chunk_id_t;
 
@@ -105,6 +117,10 @@ static const char CHUNK_IDS[NUM_CHUNKS][5] = {
   "VALS",			/* ID_VALUES */
   "ZONE",			/* ID_ZONES */
   "PROP",			/* ID_PROPERTIES */
+  "TSET",			/* ID_TILESETS */
+  "ANIM",			/* ID_ANIMATIONS */
+  "PLAX",			/* ID_PARALLAX */
+  "LITE",			/* ID_LIGHTING */
 };
 
 
@@ -181,6 +197,9 @@ static chunk_id_t get_chunk_of_id (const char chunk_name[]);
  * @param chunk_positions  The array of chunk positions, as returned
  *                         by find_chunks.
  *
+ * Chunks from FIRST_OPTIONAL_CHUNK onwards are optional and are not
+ * checked.
+ *
  * @return TRUE if one or more chunks is missing; FALSE otherwise.
  */
 static bool chunks_missing (long *chunk_locations);
@@ -380,6 +399,106 @@ static void read_map_zone_properties_chunk (FILE *file,
 static void read_map_zone_properties (FILE *file, map_t *map);
 
 
+/**
+ * Reads the map tileset chunk from a file, if present, and loads the
+ * map's tileset.
+ *
+ * If the chunk is absent, the map uses the default tileset
+ * (FN_TILESET).
+ *
+ * @param file            The file pointer to read from.
+ * @param map             The map to populate with the read data.
+ * @param chunk_position  The position within the file, in bytes from
+ *                        the file start, of the chunk, or
+ *                        CHUNK_NOT_FOUND.
+ */
+static void read_map_tileset_chunk (FILE *file,
+				    map_t *map,
+				    long chunk_position);
+
+
+/**
+ * Reads the list of tileset image filenames from a file and loads
+ * the map's tileset.
+ *
+ * @param file  The file pointer to read from.
+ * @param map   The map to populate with the read data.
+ */
+static void read_map_tileset (FILE *file, map_t *map);
+
+
+/**
+ * Reads the tile animations chunk from a file, if present, adding
+ * the animations to the map's tileset.
+ *
+ * @param file            The file pointer to read from.
+ * @param map             The map to populate with the read data.
+ *                        Its tileset must already be loaded.
+ * @param chunk_position  The position within the file, in bytes from
+ *                        the file start, of the chunk, or
+ *                        CHUNK_NOT_FOUND.
+ */
+static void read_map_animations_chunk (FILE *file,
+				       map_t *map,
+				       long chunk_position);
+
+
+/**
+ * Reads the tile animations from a file.
+ *
+ * @param file  The file pointer to read from.
+ * @param map   The map to populate with the read data.
+ */
+static void read_map_animations (FILE *file, map_t *map);
+
+
+/**
+ * Reads the parallax layers chunk from a file, if present.
+ *
+ * @param file            The file pointer to read from.
+ * @param map             The map to populate with the read data.
+ * @param chunk_position  The position within the file, in bytes from
+ *                        the file start, of the chunk, or
+ *                        CHUNK_NOT_FOUND.
+ */
+static void read_map_parallax_chunk (FILE *file,
+                                     map_t *map,
+                                     long chunk_position);
+
+
+/**
+ * Reads the parallax layer declarations from a file.
+ *
+ * @param file  The file pointer to read from.
+ * @param map   The map to populate with the read data.
+ */
+static void read_map_parallax (FILE *file, map_t *map);
+
+
+/**
+ * Reads the lighting chunk from a file, if present.
+ *
+ * @param file            The file pointer to read from.
+ * @param map             The map to populate with the read data.
+ * @param chunk_position  The position within the file, in bytes from
+ *                        the file start, of the chunk, or
+ *                        CHUNK_NOT_FOUND.
+ */
+static void read_map_lighting_chunk (FILE *file,
+                                     map_t *map,
+                                     long chunk_position);
+
+
+/**
+ * Reads the ambient light level and light sources from a file, and
+ * gives the map a light map lit by them.
+ *
+ * @param file  The file pointer to read from.
+ * @param map   The map to populate with the read data.
+ */
+static void read_map_lighting (FILE *file, map_t *map);
+
+
 /**
  * Reads the next ID_LENGTH bytes from the file and checks
  * whether they match a given chunkID.
@@ -413,6 +532,51 @@ load_map (const char path[])
 }
 
 
+/* Loads the images a map lists in its manifest. */
+bool
+preload_map_images (const char path[])
+{
+  char *manifest_path;
+  gchar *contents;
+  gchar **lines;
+  const char **filenames;
+  uint32_t count = 0;
+  uint32_t i;
+  gboolean read;
+
+  g_assert (path != NULL);
+
+  manifest_path = g_strdup_printf ("%s%s", path, MANIFEST_SUFFIX);
+  read = g_file_get_contents (manifest_path, &contents, NULL, NULL);
+  g_free (manifest_path);
+
+  if (!read)
+    return false;
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  filenames = xcalloc (g_strv_length (lines) + 1, sizeof (char *));
+
+  for (i = 0; lines[i] != NULL; i += 1)
+    {
+      g_strstrip (lines[i]);
+
+      if (lines[i][0] != '\0' && lines[i][0] != '#')
+        {
+          filenames[count] = lines[i];
+          count += 1;
+        }
+    }
+
+  preload_images (filenames, count);
+
+  free (filenames);
+  g_strfreev (lines);
+  return true;
+}
+
+
 /* Parses the given file as a map file and attempts to return a map
  * created from its contents.
  */
@@ -449,6 +613,10 @@ parse_map_file (FILE *file)
   read_map_value_planes_chunk (file, map, chunks[ID_VALUES]);
   read_map_zone_planes_chunk (file, map, chunks[ID_ZONES]);
   read_map_zone_properties_chunk (file, map, chunks[ID_PROPERTIES]);
+  read_map_tileset_chunk (file, map, chunks[ID_TILESETS]);
+  read_map_animations_chunk (file, map, chunks[ID_ANIMATIONS]);
+  read_map_parallax_chunk (file, map, chunks[ID_PARALLAX]);
+  read_map_lighting_chunk (file, map, chunks[ID_LIGHTING]);
 
   free (chunks);
 
@@ -581,7 +749,7 @@ chunks_missing (long *chunk_positions)
 {
   chunk_id_t i;
 
-  for (i = 0; i < NUM_CHUNKS; i += 1)
+  for (i = 0; i < FIRST_OPTIONAL_CHUNK; i += 1)
     {
       if (chunk_positions[i] == CHUNK_NOT_FOUND)
 	return true;
@@ -781,6 +949,208 @@ read_map_zone_properties (FILE *file, map_t *map)
 }
 
 
+/* Reads the map tileset chunk from a file, if present. */
+static void
+read_map_tileset_chunk (FILE *file, map_t *map, long chunk_position)
+{
+  if (chunk_position == CHUNK_NOT_FOUND)
+    {
+      char *filenames[1];
+
+      filenames[0] = (char *) FN_TILESET;
+      map->tileset = init_tileset (1, filenames);
+      return;
+    }
+
+  skip_to_chunk (file, chunk_position);
+  read_map_tileset (file, map);
+}
+
+
+/* Reads the tileset image filenames from a file. */
+static void
+read_map_tileset (FILE *file, map_t *map)
+{
+  uint16_t num_images;
+  uint16_t length;
+  uint16_t i;
+  size_t count;
+  char **filenames;
+
+  num_images = read_uint16 (file);
+  if (num_images == 0 || num_images > MAX_TILESET_IMAGES)
+    {
+      fatal ("MAPLOAD - read_map_tileset - Bad tileset count %u.",
+             num_images);
+    }
+
+  filenames = xcalloc (num_images, sizeof (char *));
+
+  for (i = 0; i < num_images; i += 1)
+    {
+      length = read_uint16 (file);
+      filenames[i] = xcalloc ((size_t) length + 1, sizeof (char));
+
+      count = fread (filenames[i], sizeof (char), length, file);
+      g_assert (count == length);
+    }
+
+  map->tileset = init_tileset (num_images, filenames);
+
+  for (i = 0; i < num_images; i += 1)
+    free (filenames[i]);
+  free (filenames);
+}
+
+
+/* Reads the tile animations chunk from a file, if present. */
+static void
+read_map_animations_chunk (FILE *file, map_t *map, long chunk_position)
+{
+  if (chunk_position == CHUNK_NOT_FOUND)
+    return;
+
+  skip_to_chunk (file, chunk_position);
+  read_map_animations (file, map);
+}
+
+
+/* Reads the tile animations from a file. */
+static void
+read_map_animations (FILE *file, map_t *map)
+{
+  uint16_t num_animations;
+  uint16_t i;
+
+  g_assert (map->tileset != NULL);
+
+  num_animations = read_uint16 (file);
+
+  for (i = 0; i < num_animations; i += 1)
+    {
+      layer_value_t value = read_uint16 (file);
+      uint16_t num_frames = read_uint16 (file);
+      layer_value_t *frames;
+      uint32_t *durations;
+      uint16_t j;
+
+      if (num_frames == 0)
+        {
+          fatal ("MAPLOAD - read_map_animations - "
+                 "Animation for tile %u has no frames.", value);
+        }
+
+      frames = xcalloc (num_frames, sizeof (layer_value_t));
+      durations = xcalloc (num_frames, sizeof (uint32_t));
+
+      for (j = 0; j < num_frames; j += 1)
+        {
+          frames[j] = read_uint16 (file);
+
+          /* Stored in milliseconds. */
+          durations[j] = (uint32_t) read_uint16 (file) * 1000;
+        }
+
+      add_tile_animation (map->tileset, value, num_frames,
+                          frames, durations);
+
+      free (frames);
+      free (durations);
+    }
+}
+
+
+/* Reads the parallax layers chunk from a file, if present. */
+static void
+read_map_parallax_chunk (FILE *file, map_t *map, long chunk_position)
+{
+  if (chunk_position == CHUNK_NOT_FOUND)
+    return;
+
+  skip_to_chunk (file, chunk_position);
+  read_map_parallax (file, map);
+}
+
+
+/* Reads the parallax layer declarations from a file. */
+static void
+read_map_parallax (FILE *file, map_t *map)
+{
+  uint16_t num_layers;
+  uint16_t i;
+
+  num_layers = read_uint16 (file);
+
+  for (i = 0; i < num_layers; i += 1)
+    {
+      /* Scroll factors are signed, in 256ths of the map's speed. */
+      int16_t factor_x = (int16_t) read_uint16 (file);
+      int16_t factor_y = (int16_t) read_uint16 (file);
+      uint16_t length = read_uint16 (file);
+      char *filename = xcalloc ((size_t) length + 1, sizeof (char));
+      size_t count = fread (filename, sizeof (char), length, file);
+
+      g_assert (count == length);
+
+      declare_map_parallax_layer (map, filename, factor_x, factor_y);
+      free (filename);
+    }
+}
+
+
+/* Reads the lighting chunk from a file, if present. */
+static void
+read_map_lighting_chunk (FILE *file, map_t *map, long chunk_position)
+{
+  if (chunk_position == CHUNK_NOT_FOUND)
+    return;
+
+  skip_to_chunk (file, chunk_position);
+  read_map_lighting (file, map);
+}
+
+
+/* Reads the ambient light level and light sources from a file. */
+static void
+read_map_lighting (FILE *file, map_t *map)
+{
+  light_map_t *light_map;
+  uint16_t ambient;
+  uint16_t num_sources;
+  uint16_t i;
+
+  /* Maps without this chunk have no light map, and are fully lit. */
+  ambient = read_uint16 (file);
+  if (ambient > MAX_LIGHT_LEVEL)
+    {
+      fatal ("MAPLOAD - read_map_lighting - "
+             "Ambient light level %u is over %u.",
+             ambient, MAX_LIGHT_LEVEL);
+    }
+
+  light_map = init_light_map (map, (uint8_t) ambient);
+
+  num_sources = read_uint16 (file);
+
+  for (i = 0; i < num_sources; i += 1)
+    {
+      uint16_t x = read_uint16 (file);
+      uint16_t y = read_uint16 (file);
+      uint16_t intensity = read_uint16 (file);
+
+      if (x >= map->width || y >= map->height
+          || intensity == 0 || intensity > MAX_LIGHT_LEVEL)
+        {
+          fatal ("MAPLOAD - read_map_lighting - "
+                 "Light source %u at (%u, %u) with intensity %u "
+                 "is invalid.", i, x, y, intensity);
+        }
+
+      (void) add_light_source (light_map, x, y, (uint8_t) intensity);
+    }
+}
+
+
 /* Checks that a given chunk ID is present. */
 static bool
 next_chunk_is (FILE *file, chunk_id_t chunk_index)
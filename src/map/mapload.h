@@ -59,4 +59,22 @@
  */
 map_t *load_map (const char path[]);
 
+
+/**
+ * Loads the images a map lists in its manifest, so that they are
+ * ready before the map is first drawn.
+ *
+ * The manifest is a text file next to the map, named after it with
+ * ".manifest" appended, giving one image filename per line relative
+ * to the graphics path.  Blank lines and lines starting with # are
+ * ignored.  The images are decoded in parallel (see preload_images).
+ *
+ * @param path  The path to the map file.
+ *
+ * @return      true if the manifest was read; false if the map has
+ *              no manifest, in which case its images load as they are
+ *              first drawn.
+ */
+bool preload_map_images (const char path[]);
+
 #endif /* not _MAPLOAD_H */
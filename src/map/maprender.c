@@ -45,6 +45,14 @@
  * as requiring an update ("dirty") and renders the contents of those
  * visible on-screen to the display.
  *
+ * Full-size map views are rendered tile by tile, layer by layer, with
+ * objects drawn over the first layer bearing their tag.  Scaled-down
+ * views are rendered from the map's cache of pre-rendered chunks,
+ * with all objects drawn on top.
+ *
+ * If the map has a light map, full-size views are then shaded tile by
+ * tile to each tile's light level.
+ *
  * @todo FIXME: Reduce coupling to mapview_t.
  */
 
@@ -59,12 +67,22 @@
 typedef struct render_map_layer_tile_rect_data
 {
   mapview_t *mapview;
-  image_t *tileset;
+  tileset_t *tileset;
   bool *tile_rendered;
   layer_index_t layer;
 } render_map_layer_tile_rect_data_t;
 
 
+/**
+ * Structure of data needed during a lighting pass.
+ */
+typedef struct render_map_lighting_data
+{
+  mapview_t *mapview;
+  GHashTable *tile_shaded;
+} render_map_lighting_data_t;
+
+
 /* -- STATIC DECLARATIONS -- */
 
 /**
@@ -120,6 +138,57 @@ static void clamp_rectangle (dirty_rectangle_t *rectangle);
 static void render_map_layers (mapview_t *mapview);
 
 
+/**
+ * Grows a dirty rectangle outwards to the tile grid, so that lit
+ * tiles are always redrawn and shaded whole.
+ *
+ * @param rectangle  Pointer to the dirty rectangle to grow.
+ * @param unused     Unused.
+ */
+static void align_rectangle_to_tiles (gpointer rectangle,
+                                      gpointer unused);
+
+
+/**
+ * Shades every tile under the map view's dirty rectangles to its
+ * light level, each only once.
+ *
+ * @param mapview    Pointer to the map view to render.
+ */
+static void render_map_lighting (mapview_t *mapview);
+
+
+/**
+ * Shades the tiles under one dirty rectangle that have not yet been
+ * shaded in this pass.
+ *
+ * @param rectangle  Pointer to the dirty rectangle.
+ * @param data       Pointer to the render_map_lighting_data_t for
+ *                   the pass.
+ */
+static void render_map_lighting_rect (gpointer rectangle,
+                                      gpointer data);
+
+
+/**
+ * Renders a scaled-down map view from the map's chunk cache, and
+ * then renders the objects of every layer on top.
+ *
+ * @param mapview    Pointer to the map view to render.
+ */
+static void render_map_chunks (mapview_t *mapview);
+
+
+/**
+ * Renders the chunks of the map covering one dirty rectangle.
+ *
+ * @param rectangle  A pointer to the dirty rectangle to render.
+ * @param mapview    A pointer to the map view to render.
+ */
+static void render_map_chunk_rect (gpointer rectangle,
+                                   gpointer mapview);
+
+
 /**
  * Renders the tile compnent of a given layer on a map.
  *
@@ -150,7 +219,8 @@ static void render_map_layer_tile_rect (gpointer rectangle,
  * @param tile_end_x     The rightmost tile X co-ordinate.
  * @param tile_end_y     The lowermost tile Y co-ordinate.
  * @param mapview        Pointer to the map view to render with.
- * @param tileset        Pointer to the tileset to render with.
+ * @param tileset        Pointer to the tileset to look up tile
+ *                       images in.
  * @param tile_rendered  Boolean array of all tiles in the map,
  *                       marking those already rendered for
  *                       this layer as true.
@@ -162,7 +232,7 @@ render_map_layer_tile_rect_body (dimension_t tile_start_x,
                                  dimension_t tile_end_x,
                                  dimension_t tile_end_y,
                                  mapview_t *mapview,
-                                 image_t *tileset,
+                                 tileset_t *tileset,
                                  bool *tile_rendered,
                                  layer_index_t layer);
 
@@ -207,6 +277,8 @@ static void render_map_layer_object_image (mapview_t *mapview,
 void
 render_map (mapview_t *mapview)
 {
+  bool lit;
+
   g_assert (mapview != NULL);
   g_assert (mapview->map != NULL);
 
@@ -216,10 +288,29 @@ render_map (mapview_t *mapview)
       return;
     }
 
+  /* Keep this view's drawing inside its viewport. */
+  set_clip_rectangle (mapview->viewport_x,
+                      mapview->viewport_y,
+                      mapview->viewport_width,
+                      mapview->viewport_height);
+
+  lit = (mapview->map->light_map != NULL && mapview->scale == 1);
+  if (lit)
+    g_slist_foreach (mapview->dirty_rectangles,
+                     align_rectangle_to_tiles, NULL);
+
   g_slist_foreach (mapview->dirty_rectangles,
 		   handle_dirty_rectangle, mapview);
 
-  render_map_layers (mapview);
+  if (mapview->scale == 1)
+    render_map_layers (mapview);
+  else
+    render_map_chunks (mapview);
+
+  if (lit)
+    render_map_lighting (mapview);
+
+  clear_clip_rectangle ();
 
   g_slist_free_full (mapview->dirty_rectangles, free);
   mapview->dirty_rectangles = NULL;
@@ -258,10 +349,12 @@ rectangle_outside_viewport (dirty_rectangle_t *rectangle,
      This could do with a good fine-toothed combing later. */
   int32_t viewport_left_edge = (int32_t) mapview->x_offset;
   int32_t viewport_right_edge =
-    (int32_t) (mapview->x_offset + SCREEN_W - 1);
+    (int32_t) (mapview->x_offset
+               + get_mapview_visible_width (mapview) - 1);
   int32_t viewport_top_edge = (int32_t) mapview->y_offset;
   int32_t viewport_bottom_edge =
-    (int32_t) (mapview->y_offset + SCREEN_H - 1);
+    (int32_t) (mapview->y_offset
+               + get_mapview_visible_height (mapview) - 1);
 
   int32_t rectangle_left_edge = (int32_t) rectangle->start_x;
   int32_t rectangle_right_edge =
@@ -287,45 +380,53 @@ static void
 propagate_rectangle_to_screen (dirty_rectangle_t *rectangle,
 			       mapview_t *mapview)
 {
+  int32_t scale = mapview->scale;
+  int32_t left;
+  int32_t top;
+  int32_t right;
+  int32_t bottom;
   int16_t screen_x;
   int16_t screen_y;
   uint16_t screen_width;
   uint16_t screen_height;
 
-  /* Clamp rectangle to screen.
-     If the rectangle starts above or to the left of the screen,
+  /* Clamp rectangle to the visible part of the map.
+     If the rectangle starts above or to the left of the view,
      chop the unseen part off. */
-  if (rectangle->start_x < mapview->x_offset)
-    {
-      screen_x = 0;
-      screen_width =
-	(uint16_t) (rectangle->width -
-		    (mapview->x_offset - rectangle->start_x));
-    }
-  else
-    {
-      screen_x = (int16_t) (rectangle->start_x - mapview->x_offset);
-      screen_width = rectangle->width;
-    }
-  if (rectangle->start_y < mapview->y_offset)
-    {
-      screen_y = 0;
-      screen_height =
-	(uint16_t) (rectangle->height -
-		    (mapview->y_offset - rectangle->start_y));
-    }
-  else
-    {
-      screen_y = (int16_t) (rectangle->start_y - mapview->y_offset);
-      screen_height = rectangle->height;
-    }
-
+  left = MAX (rectangle->start_x, mapview->x_offset);
+  top = MAX (rectangle->start_y, mapview->y_offset);
+  right = MIN ((int32_t) (rectangle->start_x + rectangle->width),
+               (int32_t) (mapview->x_offset
+                          + get_mapview_visible_width (mapview)));
+  bottom = MIN ((int32_t) (rectangle->start_y + rectangle->height),
+                (int32_t) (mapview->y_offset
+                           + get_mapview_visible_height (mapview)));
+
+  /* Translate into the viewport, rounding outwards so that scaled
+     views cover every screen pixel touched. */
+  screen_x = (int16_t) (mapview->viewport_x
+                        + ((left - mapview->x_offset) / scale));
+  screen_y = (int16_t) (mapview->viewport_y
+                        + ((top - mapview->y_offset) / scale));
+  screen_width = (uint16_t) (mapview->viewport_x
+                             + ((right - mapview->x_offset
+                                 + scale - 1) / scale)
+                             - screen_x);
+  screen_height = (uint16_t) (mapview->viewport_y
+                              + ((bottom - mapview->y_offset
+                                  + scale - 1) / scale)
+                              - screen_y);
 
   /* This is done to hide artefacts when the map is fully
      scrolled. */
   draw_rectangle (screen_x, screen_y, screen_width, screen_height,
 		  0, 0, 0);
 
+  /* Fill in the background behind the map, if any. */
+  if (mapview->parallax_layers != NULL)
+    render_parallax_layers (mapview, screen_x, screen_y,
+                            screen_width, screen_height);
+
   /* Propagate to graphics subsystem. */
   add_update_rectangle (screen_x, screen_y, screen_width,
 			screen_height);
@@ -368,7 +469,7 @@ static void
 render_map_layer_tiles (mapview_t *mapview, layer_index_t layer)
 {
   render_map_layer_tile_rect_data_t data;
-  image_t *tileset = load_image (FN_TILESET);
+  tileset_t *tileset = mapview->map->tileset;
   /* TODO: find better way of doing this? */
   bool *tile_rendered =
     xcalloc (mapview->map->width * mapview->map->height,
@@ -377,7 +478,7 @@ render_map_layer_tiles (mapview_t *mapview, layer_index_t layer)
   if (tileset == NULL)
     {
       fatal
-	("MAPVIEW - render_map_layer_tiles - Couldn't load tileset.");
+	("MAPVIEW - render_map_layer_tiles - Map has no tileset.");
     }
 
   data.mapview = mapview;
@@ -455,7 +556,7 @@ render_map_layer_tile_rect_body (dimension_t tile_start_x,
                                  dimension_t tile_end_x,
                                  dimension_t tile_end_y,
                                  mapview_t *mapview,
-                                 image_t *tileset,
+                                 tileset_t *tileset,
                                  bool *tile_rendered,
                                  layer_index_t layer)
 {
@@ -465,33 +566,38 @@ render_map_layer_tile_rect_body (dimension_t tile_start_x,
   int16_t screen_y;
 
   layer_value_t tile;
-  uint32_t tileset_x;
+  tile_source_t *source;
 
   dimension_t x;
   dimension_t y;
 
   for (x = tile_start_x; x < tile_end_x; x += 1)
     {
-      screen_x = (int16_t) ((x * TILE_W) - mapview->x_offset);
+      screen_x = (int16_t) (mapview->viewport_x
+                            + (x * TILE_W) - mapview->x_offset);
 
       for (y = tile_start_y; y < tile_end_y; y += 1)
 	{
           /* Don't render a tile twice */
-          if (tile_rendered[x + (y * map->height)])
+          if (tile_rendered[x + (y * map->width)])
             continue;
-          tile_rendered[x + (y * map->height)] = true;
+          tile_rendered[x + (y * map->width)] = true;
 
 	  screen_y
-            = (int16_t) ((y * TILE_H) - mapview->y_offset);
+            = (int16_t) (mapview->viewport_y
+                         + (y * TILE_H) - mapview->y_offset);
 
 	  tile
-	    = map->value_planes[layer][x + (y * map->height)];
+	    = map->value_planes[layer][x + (y * map->width)];
 	  /* 0 = transparency */
-	  if (tile > 0)
+	  if (tile == 0)
+	    continue;
+
+	  source = get_tile_source (tileset, tile);
+	  if (source != NULL && source->image != NULL)
 	    {
-	      tileset_x = (uint32_t) (TILE_W * tile);
-	      draw_image_direct (tileset,
-				 (int16_t) tileset_x, 0,
+	      draw_image_direct (source->image,
+				 source->x, source->y,
 				 (int16_t) screen_x,
 				 (int16_t) screen_y, TILE_W, TILE_H);
 	    }
@@ -538,12 +644,210 @@ static void
 render_map_layer_object_image (mapview_t *mapview,
 			       object_image_t *image)
 {
-  g_assert (image != NULL && image->filename != NULL);
-
-  draw_image (image->filename,
-	      image->image_x,
-	      image->image_y,
-	      (int16_t) (image->map_x - mapview->x_offset),
-	      (int16_t) (image->map_y - mapview->y_offset),
-	      image->width, image->height);
+  int32_t scale = mapview->scale;
+
+  g_assert (image != NULL && image->image != NULL_IMAGE);
+
+  if (scale == 1)
+    {
+      draw_image (image->image,
+                  image->image_x,
+                  image->image_y,
+                  (int16_t) (mapview->viewport_x
+                             + image->map_x - mapview->x_offset),
+                  (int16_t) (mapview->viewport_y
+                             + image->map_y - mapview->y_offset),
+                  image->width, image->height);
+      return;
+    }
+
+  draw_image_scaled_direct (get_image (image->image),
+                            image->image_x,
+                            image->image_y,
+                            image->width,
+                            image->height,
+                            (int16_t) (mapview->viewport_x
+                                       + ((image->map_x
+                                           - mapview->x_offset)
+                                          / scale)),
+                            (int16_t) (mapview->viewport_y
+                                       + ((image->map_y
+                                           - mapview->y_offset)
+                                          / scale)),
+                            (uint16_t) MAX (1, image->width / scale),
+                            (uint16_t) MAX (1, image->height / scale));
+}
+
+
+/* Renders a scaled-down map view from the map's chunk cache. */
+static void
+render_map_chunks (mapview_t *mapview)
+{
+  layer_index_t l;
+
+  g_slist_foreach (mapview->dirty_rectangles,
+                   render_map_chunk_rect, mapview);
+
+  for (l = 0; l <= get_max_layer (mapview->map); l += 1)
+    render_map_layer_objects (mapview, l);
+}
+
+
+/* Renders the chunks of the map covering one dirty rectangle. */
+static void
+render_map_chunk_rect (gpointer rectangle, gpointer mapview)
+{
+  dirty_rectangle_t *rectanglec = rectangle;
+  mapview_t *mapviewc = mapview;
+  map_t *map = mapviewc->map;
+  int32_t scale = mapviewc->scale;
+  int32_t chunk_w = CHUNK_TILES * TILE_W;
+  int32_t chunk_h = CHUNK_TILES * TILE_H;
+  int32_t left;
+  int32_t top;
+  int32_t right;
+  int32_t bottom;
+  int32_t cx;
+  int32_t cy;
+
+  /* Clamp to the map, as chunks only exist within it. */
+  left = MAX (rectanglec->start_x, 0);
+  top = MAX (rectanglec->start_y, 0);
+  right = MIN ((int32_t) (rectanglec->start_x + rectanglec->width),
+               (int32_t) (map->width * TILE_W));
+  bottom = MIN ((int32_t) (rectanglec->start_y + rectanglec->height),
+                (int32_t) (map->height * TILE_H));
+
+  /* Work in whole screen pixels. */
+  left -= left % scale;
+  top -= top % scale;
+
+  for (cy = top / chunk_h; cy * chunk_h < bottom; cy += 1)
+    for (cx = left / chunk_w; cx * chunk_w < right; cx += 1)
+      {
+        image_t *chunk = get_map_chunk (map, (uint16_t) scale,
+                                        (dimension_t) cx,
+                                        (dimension_t) cy);
+        /* Part of the chunk inside the rectangle, in map pixels. */
+        int32_t x0 = MAX (left, cx * chunk_w);
+        int32_t y0 = MAX (top, cy * chunk_h);
+        int32_t x1 = MIN (right, (cx + 1) * chunk_w);
+        int32_t y1 = MIN (bottom, (cy + 1) * chunk_h);
+
+        if (chunk == NULL)
+          {
+            error ("MAPRENDER - render_map_chunk_rect - "
+                   "Graphics module cannot render scaled views.");
+            return;
+          }
+
+        draw_image_direct (chunk,
+                           (int16_t) ((x0 - (cx * chunk_w)) / scale),
+                           (int16_t) ((y0 - (cy * chunk_h)) / scale),
+                           (int16_t) (mapviewc->viewport_x
+                                      + ((x0 - mapviewc->x_offset)
+                                         / scale)),
+                           (int16_t) (mapviewc->viewport_y
+                                      + ((y0 - mapviewc->y_offset)
+                                         / scale)),
+                           (uint16_t) ((x1 - x0 + scale - 1) / scale),
+                           (uint16_t) ((y1 - y0 + scale - 1) / scale));
+      }
+}
+
+
+/* Grows a dirty rectangle outwards to the tile grid. */
+static void
+align_rectangle_to_tiles (gpointer rectangle, gpointer unused)
+{
+  dirty_rectangle_t *rectanglec = rectangle;
+  int32_t left = rectanglec->start_x;
+  int32_t top = rectanglec->start_y;
+  int32_t right = left + (int32_t) rectanglec->width;
+  int32_t bottom = top + (int32_t) rectanglec->height;
+
+  (void) unused;
+
+  left = MAX (left, 0);
+  top = MAX (top, 0);
+
+  left -= left % TILE_W;
+  top -= top % TILE_H;
+  right += (TILE_W - (right % TILE_W)) % TILE_W;
+  bottom += (TILE_H - (bottom % TILE_H)) % TILE_H;
+
+  rectanglec->start_x = left;
+  rectanglec->start_y = top;
+  rectanglec->width = (uint32_t) MAX (right - left, 0);
+  rectanglec->height = (uint32_t) MAX (bottom - top, 0);
+}
+
+
+/* Shades every tile under the dirty rectangles to its light level. */
+static void
+render_map_lighting (mapview_t *mapview)
+{
+  render_map_lighting_data_t data;
+
+  /* Dirty rectangles often overlap; shading a tile twice would
+     darken it twice. */
+  data.mapview = mapview;
+  data.tile_shaded = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  g_slist_foreach (mapview->dirty_rectangles,
+                   render_map_lighting_rect, &data);
+
+  g_hash_table_destroy (data.tile_shaded);
+}
+
+
+/* Shades the not-yet-shaded tiles under one dirty rectangle. */
+static void
+render_map_lighting_rect (gpointer rectangle, gpointer data)
+{
+  dirty_rectangle_t *rectanglec = rectangle;
+  render_map_lighting_data_t *datac = data;
+  mapview_t *mapview = datac->mapview;
+  map_t *map = mapview->map;
+  int32_t tile_start_x;
+  int32_t tile_start_y;
+  int32_t tile_end_x;
+  int32_t tile_end_y;
+  int32_t x;
+  int32_t y;
+
+  tile_start_x = MAX (rectanglec->start_x, 0) / TILE_W;
+  tile_start_y = MAX (rectanglec->start_y, 0) / TILE_H;
+  tile_end_x = MIN ((int32_t) ((rectanglec->start_x + rectanglec->width
+                                + TILE_W - 1) / TILE_W),
+                    (int32_t) map->width);
+  tile_end_y = MIN ((int32_t) ((rectanglec->start_y + rectanglec->height
+                                + TILE_H - 1) / TILE_H),
+                    (int32_t) map->height);
+
+  for (y = tile_start_y; y < tile_end_y; y += 1)
+    for (x = tile_start_x; x < tile_end_x; x += 1)
+      {
+        uint32_t index = ((uint32_t) y * map->width) + (uint32_t) x;
+        uint8_t level;
+
+        /* Index 0 is a valid tile, so offset keys away from NULL. */
+        if (g_hash_table_lookup (datac->tile_shaded,
+                                 GUINT_TO_POINTER (index + 1)))
+          continue;
+
+        g_hash_table_insert (datac->tile_shaded,
+                             GUINT_TO_POINTER (index + 1),
+                             GUINT_TO_POINTER (1));
+
+        level = get_light_level (map->light_map,
+                                 (dimension_t) x, (dimension_t) y);
+
+        shade_rectangle ((int16_t) (mapview->viewport_x
+                                    + (x * TILE_W) - mapview->x_offset),
+                         (int16_t) (mapview->viewport_y
+                                    + (y * TILE_H) - mapview->y_offset),
+                         TILE_W, TILE_H,
+                         (uint8_t) ((level * 255) / MAX_LIGHT_LEVEL));
+      }
 }
@@ -63,6 +63,9 @@ const uint16_t TILE_H = 32;
 const char FN_TILESET[] = "tiles.png";	/**< Tileset filename. */
 
 
+const uint16_t MAX_MAPVIEW_SCALE = 8;
+
+
 /* -- STATIC DECLARATIONS -- */
 
 /**
@@ -79,6 +82,28 @@ static gint
 compare_objects_by_image_y_order (gconstpointer a, gconstpointer b);
 
 
+/**
+ * Rebuilds the index of on-screen positions holding animated tiles.
+ *
+ * @param mapview  The map view whose index should be rebuilt.
+ */
+static void build_animated_tile_index (mapview_t *mapview);
+
+
+/**
+ * Adds an entry to the index of on-screen animated tiles.
+ *
+ * @param mapview    The map view whose index should be added to.
+ * @param x          X co-ordinate of the tile, in tiles.
+ * @param y          Y co-ordinate of the tile, in tiles.
+ * @param animation  One plus the index of the tile's animation.
+ */
+static void add_animated_tile (mapview_t *mapview,
+                               dimension_t x,
+                               dimension_t y,
+                               uint16_t animation);
+
+
 /* -- DEFINITIONS -- */
 
 mapview_t *
@@ -90,6 +115,12 @@ init_mapview (map_t *map)
 
   mapview->map = map;
 
+  mapview->viewport_x = 0;
+  mapview->viewport_y = 0;
+  mapview->viewport_width = SCREEN_W;
+  mapview->viewport_height = SCREEN_H;
+  mapview->scale = 1;
+
   /* Get the number of object queues to reserve, by finding the
      highest tag number in the map. */
   mapview->num_object_queues = get_max_tag (mapview->map);
@@ -100,6 +131,8 @@ init_mapview (map_t *map)
   mapview->object_queue = xcalloc (mapview->num_object_queues,
 				   sizeof (struct GSList *));
 
+  add_map_parallax_layers (mapview);
+
   /* Set all tiles as dirty. */
   mark_dirty_rect (mapview,
 		   0, 0,
@@ -111,6 +144,58 @@ init_mapview (map_t *map)
 }
 
 
+/* Moves, resizes or rescales a map view's viewport. */
+void
+set_mapview_viewport (mapview_t *mapview,
+                      int16_t x,
+                      int16_t y,
+                      uint16_t width,
+                      uint16_t height,
+                      uint16_t scale)
+{
+  g_assert (mapview != NULL);
+  g_assert (width > 0 && height > 0);
+
+  /* Powers of two only, so that tiles and chunks shrink to whole
+     numbers of pixels. */
+  g_assert (scale == 1 || scale == 2 || scale == 4 || scale == 8);
+  g_assert (scale <= MAX_MAPVIEW_SCALE);
+
+  mapview->viewport_x = x;
+  mapview->viewport_y = y;
+  mapview->viewport_width = width;
+  mapview->viewport_height = height;
+  mapview->scale = scale;
+
+  /* Parallax surfaces are sized to the viewport. */
+  invalidate_parallax_layers (mapview);
+
+  mark_dirty_rect (mapview,
+                   mapview->x_offset,
+                   mapview->y_offset,
+                   get_mapview_visible_width (mapview),
+                   get_mapview_visible_height (mapview));
+}
+
+
+/* Gets the width of the area of the map visible in a map view. */
+uint32_t
+get_mapview_visible_width (mapview_t *mapview)
+{
+  g_assert (mapview != NULL);
+  return (uint32_t) mapview->viewport_width * mapview->scale;
+}
+
+
+/* Gets the height of the area of the map visible in a map view. */
+uint32_t
+get_mapview_visible_height (mapview_t *mapview)
+{
+  g_assert (mapview != NULL);
+  return (uint32_t) mapview->viewport_height * mapview->scale;
+}
+
+
 /* Adds an object sprite to the rendering queue. */
 void
 add_object_image (mapview_t *mapview, struct object *object)
@@ -120,7 +205,7 @@ add_object_image (mapview_t *mapview, struct object *object)
   g_assert (object->tag != NULL_TAG);
   g_assert (object->tag <= mapview->num_object_queues);
   g_assert (object->image != NULL);
-  g_assert (object->image->filename != NULL);
+  g_assert (object->image->image != NULL_IMAGE);
   g_assert (object->image->width != 0 && object->image->height != 0);
 
   mapview->object_queue[object->tag - 1] =
@@ -133,10 +218,39 @@ add_object_image (mapview_t *mapview, struct object *object)
 void
 scroll_map (mapview_t *mapview, int16_t x_offset, int16_t y_offset)
 {
+  uint32_t view_w;
+  uint32_t view_h;
+
   g_assert (mapview != NULL);
   g_assert (x_offset != (int16_t) SHRT_MIN);
   g_assert (y_offset != (int16_t) SHRT_MIN);
 
+  view_w = get_mapview_visible_width (mapview);
+  view_h = get_mapview_visible_height (mapview);
+
+  /* Only a full-size view covering the whole screen, with no
+     parallax layers moving at their own speeds, can be scrolled by
+     moving the screen.  Any other view is redrawn in full, which
+     means a handful of cached chunks for scaled-down views, and one
+     blit per parallax layer behind the map. */
+  if (mapview->scale != 1
+      || mapview->parallax_layers != NULL
+      || mapview->viewport_x != 0
+      || mapview->viewport_y != 0
+      || mapview->viewport_width != SCREEN_W
+      || mapview->viewport_height != SCREEN_H)
+    {
+      mapview->x_offset += x_offset;
+      mapview->y_offset += y_offset;
+
+      mark_dirty_rect (mapview,
+                       mapview->x_offset,
+                       mapview->y_offset,
+                       view_w,
+                       view_h);
+      return;
+    }
+
   /* Work out the dirty rectangles to mark. */
 
   /* West scroll. */
@@ -146,17 +260,17 @@ scroll_map (mapview_t *mapview, int16_t x_offset, int16_t y_offset)
 		       mapview->x_offset,
 		       mapview->y_offset,
 		       (uint32_t) abs ((int) x_offset),
-                       (uint32_t) SCREEN_H);
+                       view_h);
     }
 
   /* East scroll. */
   else if (x_offset > 0)
     {
       mark_dirty_rect (mapview,
-		       (int32_t) (SCREEN_W + mapview->x_offset - x_offset),
+		       (int32_t) (view_w + mapview->x_offset - x_offset),
 		       mapview->y_offset,
 		       (uint32_t) x_offset,
-                       (uint32_t) SCREEN_H);
+                       view_h);
     }
 
 
@@ -166,7 +280,7 @@ scroll_map (mapview_t *mapview, int16_t x_offset, int16_t y_offset)
       mark_dirty_rect (mapview,
 		       mapview->x_offset,
 		       mapview->y_offset,
-		       (uint32_t) SCREEN_W,
+		       view_w,
                        (uint32_t) abs ((int) y_offset));
     }
 
@@ -175,14 +289,50 @@ scroll_map (mapview_t *mapview, int16_t x_offset, int16_t y_offset)
     {
       mark_dirty_rect (mapview,
 		       mapview->x_offset,
-		       (int32_t) (SCREEN_H + mapview->y_offset - y_offset),
-		       (uint32_t) SCREEN_W, (uint32_t) y_offset);
+		       (int32_t) (view_h + mapview->y_offset - y_offset),
+		       view_w, (uint32_t) y_offset);
     }
 
   mapview->x_offset += x_offset;
   mapview->y_offset += y_offset;
 
   (void) scroll_screen ((int16_t) -(x_offset), (int16_t) -(y_offset));
+  mapview->scrolled_screen = true;
+}
+
+
+/* Marks a rectangle of the screen as dirty on a map view. */
+void
+mark_screen_dirty_rect (mapview_t *mapview,
+                        int16_t x,
+                        int16_t y,
+                        uint16_t width,
+                        uint16_t height)
+{
+  int32_t left;
+  int32_t top;
+  int32_t right;
+  int32_t bottom;
+
+  g_assert (mapview != NULL);
+
+  left = MAX (x, mapview->viewport_x);
+  top = MAX (y, mapview->viewport_y);
+  right = MIN (x + width,
+               mapview->viewport_x + mapview->viewport_width);
+  bottom = MIN (y + height,
+                mapview->viewport_y + mapview->viewport_height);
+
+  if (right <= left || bottom <= top)
+    return;
+
+  mark_dirty_rect (mapview,
+                   mapview->x_offset
+                   + ((left - mapview->viewport_x) * mapview->scale),
+                   mapview->y_offset
+                   + ((top - mapview->viewport_y) * mapview->scale),
+                   (uint32_t) ((right - left) * mapview->scale),
+                   (uint32_t) ((bottom - top) * mapview->scale));
 }
 
 
@@ -209,6 +359,46 @@ mark_dirty_rect (mapview_t *mapview,
 }
 
 
+/* Marks all on-screen tiles whose animations have just changed frame
+   as dirty. */
+void
+mark_animated_tiles_dirty (mapview_t *mapview)
+{
+  tileset_t *tileset;
+  uint32_t i;
+
+  g_assert (mapview != NULL);
+  g_assert (mapview->map != NULL);
+
+  tileset = mapview->map->tileset;
+  if (tileset == NULL || tileset->num_animations == 0)
+    return;
+
+  /* Scaled-down views draw from cached chunks, which do not follow
+     animations. */
+  if (mapview->scale != 1)
+    return;
+
+  if (mapview->animated_tiles_built == false
+      || mapview->animated_tiles_x_offset != mapview->x_offset
+      || mapview->animated_tiles_y_offset != mapview->y_offset
+      || mapview->animated_tiles_revision
+      != mapview->map->value_revision)
+    build_animated_tile_index (mapview);
+
+  for (i = 0; i < mapview->num_animated_tiles; i += 1)
+    {
+      animated_tile_t *tile = &(mapview->animated_tiles[i]);
+
+      if (tileset->animations[tile->animation - 1].changed)
+        mark_dirty_rect (mapview,
+                         (int32_t) (tile->x * TILE_W),
+                         (int32_t) (tile->y * TILE_H),
+                         TILE_W, TILE_H);
+    }
+}
+
+
 /* De-initialises a mapview. */
 void
 free_mapview (mapview_t *mapview)
@@ -233,6 +423,11 @@ free_mapview (mapview_t *mapview)
 	  mapview->dirty_rectangles = NULL;
 	}
 
+      if (mapview->animated_tiles)
+        free (mapview->animated_tiles);
+
+      free_parallax_layers (mapview->parallax_layers);
+
       free (mapview);
     }
 }
@@ -259,3 +454,89 @@ compare_objects_by_image_y_order (gconstpointer a, gconstpointer b)
 
   return (gint)(a_baseline - b_baseline);
 }
+
+
+/* Rebuilds the index of on-screen positions holding animated
+   tiles. */
+static void
+build_animated_tile_index (mapview_t *mapview)
+{
+  map_t *map = mapview->map;
+  tileset_t *tileset = map->tileset;
+  int32_t start_x;
+  int32_t start_y;
+  int32_t end_x;
+  int32_t end_y;
+  int32_t x;
+  int32_t y;
+  layer_index_t l;
+
+  mapview->num_animated_tiles = 0;
+
+  /* Work out the range of tiles on-screen, clamped to the map. */
+  start_x = MAX (mapview->x_offset, 0) / TILE_W;
+  start_y = MAX (mapview->y_offset, 0) / TILE_H;
+  end_x = MIN ((mapview->x_offset
+                + (int32_t) get_mapview_visible_width (mapview) - 1)
+               / TILE_W,
+               (int32_t) map->width - 1);
+  end_y = MIN ((mapview->y_offset
+                + (int32_t) get_mapview_visible_height (mapview) - 1)
+               / TILE_H,
+               (int32_t) map->height - 1);
+
+  for (y = start_y; y <= end_y; y += 1)
+    for (x = start_x; x <= end_x; x += 1)
+      {
+        uint16_t last_animation = 0;
+
+        for (l = 0; l <= map->max_layer_index; l += 1)
+          {
+            layer_value_t value = map->value_planes[l][x + (y * map->width)];
+            uint16_t animation = get_tile_animation (tileset, value);
+
+            /* A tile only needs marking dirty once per animation. */
+            if (animation != 0 && animation != last_animation)
+              {
+                add_animated_tile (mapview, (dimension_t) x,
+                                   (dimension_t) y, animation);
+                last_animation = animation;
+              }
+          }
+      }
+
+  mapview->animated_tiles_built = true;
+  mapview->animated_tiles_x_offset = mapview->x_offset;
+  mapview->animated_tiles_y_offset = mapview->y_offset;
+  mapview->animated_tiles_revision = map->value_revision;
+}
+
+
+/* Adds an entry to the index of on-screen animated tiles. */
+static void
+add_animated_tile (mapview_t *mapview,
+                   dimension_t x,
+                   dimension_t y,
+                   uint16_t animation)
+{
+  animated_tile_t *tile;
+
+  if (mapview->num_animated_tiles == mapview->animated_tiles_capacity)
+    {
+      mapview->animated_tiles_capacity =
+        (mapview->animated_tiles_capacity == 0
+         ? 64 : mapview->animated_tiles_capacity * 2);
+      mapview->animated_tiles =
+        realloc (mapview->animated_tiles,
+                 (mapview->animated_tiles_capacity
+                  * sizeof (animated_tile_t)));
+      g_assert (mapview->animated_tiles != NULL);
+    }
+
+  tile = &(mapview->animated_tiles[mapview->num_animated_tiles]);
+  tile->x = x;
+  tile->y = y;
+  tile->animation = animation;
+
+  mapview->num_animated_tiles += 1;
+}
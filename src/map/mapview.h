@@ -90,12 +90,32 @@ typedef struct dirty_rectangle
 } dirty_rectangle_t;
 
 
+/**
+ * An on-screen position holding an animated tile.
+ */
+typedef struct animated_tile
+{
+  dimension_t x;       /**< X co-ordinate of the tile, in tiles. */
+  dimension_t y;       /**< Y co-ordinate of the tile, in tiles. */
+  uint16_t animation;  /**< One plus the index of the tile's animation
+                          in the map tileset. */
+} animated_tile_t;
+
+
 /**
  * A map viewpoint.
  *
  * This contains data required to render a map, including the offset
  * of the current viewpoint, which tiles to render on the next
  * render pass, and suchlike.
+ *
+ * Each map view occupies its own rectangle of the screen (the
+ * viewport) and may show the map scaled down, so that several views
+ * of one map can be shown at once.  Scaled-down views are drawn from
+ * the map's chunk cache (see mapcache.h).
+ *
+ * A map view may also have parallax background layers (see
+ * parallax.h), which show through transparent parts of the map.
  */
 
 typedef struct mapview
@@ -108,6 +128,24 @@ typedef struct mapview
                                  screen, in pixels from the top edge
                                  of the map. Can be negative.*/
 
+  int16_t viewport_x;         /**< X co-ordinate of the left edge of
+                                 the viewport, in pixels from the
+                                 left edge of the screen. */
+  int16_t viewport_y;         /**< Y co-ordinate of the top edge of
+                                 the viewport, in pixels from the top
+                                 edge of the screen. */
+  uint16_t viewport_width;    /**< Width of the viewport, in screen
+                                 pixels. */
+  uint16_t viewport_height;   /**< Height of the viewport, in screen
+                                 pixels. */
+  uint16_t scale;             /**< Scale divisor: each screen pixel
+                                 shows scale by scale map pixels.
+                                 One of 1, 2, 4 or 8. */
+
+  bool scrolled_screen;       /**< Set when scroll_map moves the whole
+                                 screen, which disturbs any other
+                                 views drawn over this one. */
+
   map_t *map;		      /**< Pointer to the map being viewed. */
 
   layer_tag_t num_object_queues; /**< Number of object queues reserved
@@ -124,6 +162,27 @@ typedef struct mapview
   * Stack of dirty rectangles.
   */
   GSList /*@null@*/ *dirty_rectangles;
+
+  GSList *parallax_layers;           /**< List of parallax_layer_t,
+                                        from back to front. */
+
+  animated_tile_t *animated_tiles;   /**< Index of the on-screen
+                                        positions holding animated
+                                        tiles. */
+  uint32_t num_animated_tiles;       /**< Number of entries in the
+                                        animated tile index. */
+  uint32_t animated_tiles_capacity;  /**< Allocated size of the
+                                        animated tile index. */
+
+  bool animated_tiles_built;         /**< Whether the animated tile
+                                        index has been built. */
+  int32_t animated_tiles_x_offset;   /**< x_offset when the animated
+                                        tile index was built. */
+  int32_t animated_tiles_y_offset;   /**< y_offset when the animated
+                                        tile index was built. */
+  uint32_t animated_tiles_revision;  /**< Map value revision when the
+                                        animated tile index was
+                                        built. */
 } mapview_t;
 
 
@@ -131,6 +190,9 @@ typedef struct mapview
 
 extern const char FN_TILESET[];	/**< Tileset filename. */
 
+extern const uint16_t MAX_MAPVIEW_SCALE; /**< Largest allowed map view
+                                            scale divisor. */
+
 
 /* -- PROTOTYPES -- */
 
@@ -138,6 +200,8 @@ extern const char FN_TILESET[];	/**< Tileset filename. */
 /**
  * Initialises a map view.
  *
+ * The map view initially covers the whole screen at full scale.
+ *
  * @param map  Pointer to the map to associate with the map view.
  *
  * @return  a pointer to the map view, or NULL for allocation
@@ -146,6 +210,49 @@ extern const char FN_TILESET[];	/**< Tileset filename. */
 mapview_t *init_mapview (map_t *map);
 
 
+/**
+ * Moves, resizes or rescales a map view's viewport.
+ *
+ * The whole of the new viewport is marked dirty.
+ *
+ * @param mapview  The map view to change.
+ * @param x        X co-ordinate of the left edge of the viewport, in
+ *                 pixels from the left edge of the screen.
+ * @param y        Y co-ordinate of the top edge of the viewport, in
+ *                 pixels from the top edge of the screen.
+ * @param width    Width of the viewport, in screen pixels.
+ * @param height   Height of the viewport, in screen pixels.
+ * @param scale    Scale divisor: 1 for full size, or 2, 4 or 8 to
+ *                 shrink the map by that factor.
+ */
+void set_mapview_viewport (mapview_t *mapview,
+                           int16_t x,
+                           int16_t y,
+                           uint16_t width,
+                           uint16_t height,
+                           uint16_t scale);
+
+
+/**
+ * Gets the width of the area of the map visible in a map view.
+ *
+ * @param mapview  The map view to query.
+ *
+ * @return  the visible width, in map pixels.
+ */
+uint32_t get_mapview_visible_width (mapview_t *mapview);
+
+
+/**
+ * Gets the height of the area of the map visible in a map view.
+ *
+ * @param mapview  The map view to query.
+ *
+ * @return  the visible height, in map pixels.
+ */
+uint32_t get_mapview_visible_height (mapview_t *mapview);
+
+
 /**
  * Add an object sprite to the rendering queue.
  *
@@ -175,6 +282,40 @@ void
 scroll_map (mapview_t *mapview, int16_t x_offset, int16_t y_offset);
 
 
+/**
+ * Marks all on-screen tiles whose animations have just changed frame
+ * as dirty.
+ *
+ * This should be called after advance_tile_animations.  The index of
+ * on-screen animated tiles is rebuilt first if the view has moved or
+ * the map has changed since it was last built.
+ *
+ * @param mapview  The map view to update.
+ */
+void mark_animated_tiles_dirty (mapview_t *mapview);
+
+
+/**
+ * Marks a rectangle of the screen as dirty on a map view.
+ *
+ * The rectangle is translated into map co-ordinates through the map
+ * view's viewport; parts outside the viewport are ignored.
+ *
+ * @param mapview  The map view to mark.
+ * @param x        X co-ordinate of the left edge of the rectangle, in
+ *                 pixels from the left edge of the screen.
+ * @param y        Y co-ordinate of the top edge of the rectangle, in
+ *                 pixels from the top edge of the screen.
+ * @param width    Width of the rectangle, in pixels.
+ * @param height   Height of the rectangle, in pixels.
+ */
+void mark_screen_dirty_rect (mapview_t *mapview,
+                             int16_t x,
+                             int16_t y,
+                             uint16_t width,
+                             uint16_t height);
+
+
 /**
  * Mark a rectangle of tiles as being dirty.
  *
@@ -0,0 +1,399 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/map/minimap.c
+ * @author  agent
+ * @brief   The map minimap.
+ */
+
+#include "../crystals.h"
+
+
+/* -- STATIC DECLARATIONS -- */
+
+/**
+ * Paints the square of one tile into the minimap image.
+ *
+ * The minimap image must be the current drawing target.
+ *
+ * @param minimap  Pointer to the minimap.
+ * @param index    Index (y * width + x) of the tile.
+ */
+static void paint_minimap_tile (minimap_t *minimap, uint32_t index);
+
+
+/**
+ * Draws the square of one tile from the minimap image on-screen.
+ *
+ * @param minimap  Pointer to the minimap.
+ * @param index    Index (y * width + x) of the tile.
+ */
+static void show_minimap_tile (minimap_t *minimap, uint32_t index);
+
+
+/**
+ * Draws a minimap marker on-screen, if its tile is being shown this
+ * render.
+ *
+ * @param owner    The marker's owner (unused).
+ * @param marker   Pointer to the marker.
+ * @param minimap  Pointer to the minimap.
+ */
+static void show_minimap_marker (gpointer owner,
+                                 gpointer marker,
+                                 gpointer minimap);
+
+
+/* -- DEFINITIONS -- */
+
+/* Creates a minimap for a map. */
+minimap_t *
+init_minimap (map_t *map,
+              int16_t screen_x,
+              int16_t screen_y,
+              uint16_t tile_pixels)
+{
+  minimap_t *minimap;
+  image_t *image;
+  uint32_t num_tiles;
+  uint32_t i;
+
+  g_assert (map != NULL);
+  g_assert (map->tileset != NULL);
+  g_assert (tile_pixels > 0);
+  g_assert ((uint32_t) map->width * tile_pixels <= UINT16_MAX
+            && (uint32_t) map->height * tile_pixels <= UINT16_MAX);
+
+  image = create_image ((uint16_t) (map->width * tile_pixels),
+                        (uint16_t) (map->height * tile_pixels),
+                        false);
+  if (image == NULL)
+    {
+      error ("MINIMAP - init_minimap - "
+             "Graphics module cannot create images.");
+      return NULL;
+    }
+
+  num_tiles = (uint32_t) map->width * map->height;
+
+  minimap = xcalloc (1, sizeof (minimap_t));
+  minimap->map = map;
+  minimap->image = image;
+  minimap->screen_x = screen_x;
+  minimap->screen_y = screen_y;
+  minimap->tile_pixels = tile_pixels;
+  minimap->dirty = xcalloc (num_tiles, sizeof (uint8_t));
+  minimap->dirty_tiles = g_array_new (FALSE, FALSE, sizeof (uint32_t));
+  minimap->markers = g_hash_table_new_full (g_direct_hash,
+                                            g_direct_equal,
+                                            NULL,
+                                            free);
+
+  /* This is the only full traversal of the map; from here on, only
+     dirty tiles are repainted. */
+  set_draw_target (image);
+
+  for (i = 0; i < num_tiles; i += 1)
+    paint_minimap_tile (minimap, i);
+
+  set_draw_target (NULL);
+
+  minimap->redraw = true;
+
+  free_minimap (map->minimap);
+  map->minimap = minimap;
+
+  return minimap;
+}
+
+
+/* Marks one tile of a minimap as needing to be repainted. */
+void
+mark_minimap_tile_dirty (minimap_t *minimap,
+                         dimension_t x,
+                         dimension_t y)
+{
+  uint32_t index;
+
+  g_assert (minimap != NULL);
+  g_assert (x < minimap->map->width && y < minimap->map->height);
+
+  index = ((uint32_t) y * minimap->map->width) + x;
+
+  if (minimap->dirty[index])
+    return;
+
+  minimap->dirty[index] = 1;
+  g_array_append_val (minimap->dirty_tiles, index);
+}
+
+
+/* Marks the tiles of a minimap lying under a rectangle of the
+   screen as needing to be repainted. */
+void
+mark_minimap_screen_dirty_rect (minimap_t *minimap,
+                                int16_t x,
+                                int16_t y,
+                                uint16_t width,
+                                uint16_t height)
+{
+  int32_t tile_pixels;
+  int32_t left;
+  int32_t top;
+  int32_t right;
+  int32_t bottom;
+  int32_t tx;
+  int32_t ty;
+
+  g_assert (minimap != NULL);
+
+  tile_pixels = minimap->tile_pixels;
+
+  /* Work out the rectangle relative to the minimap, clipped to it. */
+  left = MAX (x - minimap->screen_x, 0);
+  top = MAX (y - minimap->screen_y, 0);
+  right = MIN (x + width - minimap->screen_x,
+               (int32_t) minimap->map->width * tile_pixels);
+  bottom = MIN (y + height - minimap->screen_y,
+                (int32_t) minimap->map->height * tile_pixels);
+
+  if (right <= left || bottom <= top)
+    return;
+
+  for (ty = top / tile_pixels; ty * tile_pixels < bottom; ty += 1)
+    for (tx = left / tile_pixels; tx * tile_pixels < right; tx += 1)
+      mark_minimap_tile_dirty (minimap, (dimension_t) tx,
+                               (dimension_t) ty);
+}
+
+
+/* Marks the whole minimap as needing to be shown again. */
+void
+mark_minimap_redraw (minimap_t *minimap)
+{
+  g_assert (minimap != NULL);
+
+  minimap->redraw = true;
+}
+
+
+/* Places or moves a marker on a minimap. */
+void
+set_minimap_marker (minimap_t *minimap,
+                    gconstpointer owner,
+                    int32_t map_x,
+                    int32_t map_y)
+{
+  minimap_marker_t *marker;
+  dimension_t x;
+  dimension_t y;
+
+  g_assert (minimap != NULL);
+
+  x = (dimension_t) MAX (0, MIN (map_x / TILE_W,
+                                 (int32_t) minimap->map->width - 1));
+  y = (dimension_t) MAX (0, MIN (map_y / TILE_H,
+                                 (int32_t) minimap->map->height - 1));
+
+  marker = g_hash_table_lookup (minimap->markers, owner);
+  if (marker == NULL)
+    {
+      marker = xcalloc (1, sizeof (minimap_marker_t));
+      g_hash_table_insert (minimap->markers, (gpointer) owner, marker);
+    }
+  else if (marker->x == x && marker->y == y)
+    return;
+  else
+    mark_minimap_tile_dirty (minimap, marker->x, marker->y);
+
+  marker->x = x;
+  marker->y = y;
+  mark_minimap_tile_dirty (minimap, x, y);
+}
+
+
+/* Repaints the dirty tiles of a minimap and draws them on-screen. */
+void
+render_minimap (minimap_t *minimap)
+{
+  uint32_t *dirty_tiles;
+  guint i;
+
+  g_assert (minimap != NULL);
+
+  if (minimap->dirty_tiles->len == 0 && !minimap->redraw)
+    return;
+
+  dirty_tiles = (uint32_t *) minimap->dirty_tiles->data;
+
+  if (minimap->dirty_tiles->len > 0)
+    {
+      set_draw_target (minimap->image);
+
+      for (i = 0; i < minimap->dirty_tiles->len; i += 1)
+        paint_minimap_tile (minimap, dirty_tiles[i]);
+
+      set_draw_target (NULL);
+    }
+
+  if (minimap->redraw)
+    {
+      uint16_t width = (uint16_t) (minimap->map->width
+                                   * minimap->tile_pixels);
+      uint16_t height = (uint16_t) (minimap->map->height
+                                    * minimap->tile_pixels);
+
+      draw_image_direct (minimap->image, 0, 0,
+                         minimap->screen_x, minimap->screen_y,
+                         width, height);
+      add_update_rectangle (minimap->screen_x, minimap->screen_y,
+                            width, height);
+    }
+  else
+    for (i = 0; i < minimap->dirty_tiles->len; i += 1)
+      show_minimap_tile (minimap, dirty_tiles[i]);
+
+  g_hash_table_foreach (minimap->markers, show_minimap_marker, minimap);
+
+  for (i = 0; i < minimap->dirty_tiles->len; i += 1)
+    minimap->dirty[dirty_tiles[i]] = 0;
+
+  g_array_set_size (minimap->dirty_tiles, 0);
+  minimap->redraw = false;
+}
+
+
+/* De-initialises a minimap. */
+void
+free_minimap (minimap_t *minimap)
+{
+  if (minimap)
+    {
+      if (minimap->image)
+        free_image (minimap->image);
+
+      if (minimap->dirty)
+        free (minimap->dirty);
+
+      if (minimap->dirty_tiles)
+        g_array_free (minimap->dirty_tiles, TRUE);
+
+      if (minimap->markers)
+        g_hash_table_destroy (minimap->markers);
+
+      free (minimap);
+    }
+}
+
+
+/* -- STATIC DEFINITIONS -- */
+
+/* Paints the square of one tile into the minimap image. */
+static void
+paint_minimap_tile (minimap_t *minimap, uint32_t index)
+{
+  map_t *map = minimap->map;
+  tile_colour_t *colour = NULL;
+  layer_index_t l;
+
+  /* Find the topmost tile that mostly hides what is beneath it. */
+  for (l = map->max_layer_index + 1; l > 0 && colour == NULL; l -= 1)
+    {
+      layer_value_t value = map->value_planes[l - 1][index];
+      tile_colour_t *candidate;
+
+      /* 0 = transparency */
+      if (value == 0)
+        continue;
+
+      candidate = get_tile_colour (map->tileset, value);
+      if (candidate != NULL && candidate->coverage >= MINIMAP_MIN_COVERAGE)
+        colour = candidate;
+    }
+
+  draw_rectangle ((int16_t) ((index % map->width) * minimap->tile_pixels),
+                  (int16_t) ((index / map->width) * minimap->tile_pixels),
+                  minimap->tile_pixels,
+                  minimap->tile_pixels,
+                  (uint8_t) (colour ? colour->red : 0),
+                  (uint8_t) (colour ? colour->green : 0),
+                  (uint8_t) (colour ? colour->blue : 0));
+}
+
+
+/* Draws the square of one tile from the minimap image on-screen. */
+static void
+show_minimap_tile (minimap_t *minimap, uint32_t index)
+{
+  int16_t x = (int16_t) ((index % minimap->map->width)
+                         * minimap->tile_pixels);
+  int16_t y = (int16_t) ((index / minimap->map->width)
+                         * minimap->tile_pixels);
+
+  draw_image_direct (minimap->image, x, y,
+                     (int16_t) (minimap->screen_x + x),
+                     (int16_t) (minimap->screen_y + y),
+                     minimap->tile_pixels, minimap->tile_pixels);
+  add_update_rectangle ((int16_t) (minimap->screen_x + x),
+                        (int16_t) (minimap->screen_y + y),
+                        minimap->tile_pixels, minimap->tile_pixels);
+}
+
+
+/* Draws a minimap marker on-screen, if its tile is being shown. */
+static void
+show_minimap_marker (gpointer owner, gpointer marker, gpointer minimap)
+{
+  minimap_marker_t *markerc = (minimap_marker_t *) marker;
+  minimap_t *minimapc = (minimap_t *) minimap;
+  uint32_t index = ((uint32_t) markerc->y * minimapc->map->width)
+    + markerc->x;
+
+  (void) owner;
+
+  if (!minimapc->redraw && !minimapc->dirty[index])
+    return;
+
+  draw_rectangle ((int16_t) (minimapc->screen_x
+                             + (markerc->x * minimapc->tile_pixels)),
+                  (int16_t) (minimapc->screen_y
+                             + (markerc->y * minimapc->tile_pixels)),
+                  minimapc->tile_pixels,
+                  minimapc->tile_pixels,
+                  255, 255, 255);
+}
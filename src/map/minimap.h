@@ -0,0 +1,213 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/map/minimap.h
+ * @author  agent
+ * @brief   Prototypes and declarations for the map minimap.
+ *
+ * The minimap is a small overview of a map, with one square of
+ * colour per tile.  Each square takes the average colour (see
+ * get_tile_colour) of the topmost mostly-opaque tile at that
+ * position.
+ *
+ * The minimap image is built once, when the minimap is created, and
+ * afterwards only the squares of tiles marked dirty are repainted.
+ * Changing a tile value on the map marks it dirty automatically, as
+ * does moving a marker.  Rendering the minimap thus costs time in
+ * proportion to the number of changed tiles, not the size of the
+ * map.
+ */
+
+#ifndef _MINIMAP_H
+#define _MINIMAP_H
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  MINIMAP_MIN_COVERAGE = 128  /**< Minimum coverage (see tile_colour_t)
+                                 for a tile to hide the tiles beneath
+                                 it on the minimap. */
+};
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * A minimap marker, showing the position of something on the map.
+ */
+typedef struct minimap_marker
+{
+  dimension_t x;  /**< X co-ordinate of the marked tile. */
+  dimension_t y;  /**< Y co-ordinate of the marked tile. */
+} minimap_marker_t;
+
+
+/**
+ * A map minimap.
+ */
+typedef struct minimap
+{
+  map_t *map;             /**< The map being shown. */
+  image_t *image;         /**< The minimap image, with one square per
+                             tile. */
+
+  int16_t screen_x;       /**< X co-ordinate of the left edge of the
+                             minimap on-screen. */
+  int16_t screen_y;       /**< Y co-ordinate of the top edge of the
+                             minimap on-screen. */
+  uint16_t tile_pixels;   /**< Width and height of one tile's square,
+                             in pixels. */
+
+  uint8_t *dirty;         /**< Per-tile flags, set if the tile is in
+                             dirty_tiles. */
+  GArray *dirty_tiles;    /**< Indices (y * width + x) of the tiles to
+                             repaint on the next render, as
+                             uint32_t. */
+  bool redraw;            /**< Whether the whole minimap must be
+                             shown again on the next render. */
+
+  GHashTable *markers;    /**< Hash table of minimap_marker_t, keyed
+                             on their owner. */
+} minimap_t;
+
+
+/* -- DECLARATIONS -- */
+
+/**
+ * Creates a minimap for a map, and attaches it to the map.
+ *
+ * Any previous minimap of the map is freed.  The minimap is freed
+ * along with the map.
+ *
+ * @param map          Pointer to the map to show.
+ * @param screen_x     X co-ordinate of the left edge of the minimap
+ *                     on-screen.
+ * @param screen_y     Y co-ordinate of the top edge of the minimap
+ *                     on-screen.
+ * @param tile_pixels  Width and height of one tile's square on the
+ *                     minimap, in pixels.
+ *
+ * @return  a pointer to the new minimap, or NULL if the graphics
+ *          module cannot create images.
+ */
+minimap_t *init_minimap (map_t *map,
+                         int16_t screen_x,
+                         int16_t screen_y,
+                         uint16_t tile_pixels);
+
+
+/**
+ * Marks one tile of a minimap as needing to be repainted.
+ *
+ * @param minimap  Pointer to the minimap.
+ * @param x        X co-ordinate of the tile.
+ * @param y        Y co-ordinate of the tile.
+ */
+void mark_minimap_tile_dirty (minimap_t *minimap,
+                              dimension_t x,
+                              dimension_t y);
+
+
+/**
+ * Marks the tiles of a minimap lying under a rectangle of the screen
+ * as needing to be repainted, for example after something else has
+ * been drawn over them.
+ *
+ * @param minimap  Pointer to the minimap.
+ * @param x        X co-ordinate of the left edge of the rectangle, in
+ *                 pixels from the left edge of the screen.
+ * @param y        Y co-ordinate of the top edge of the rectangle, in
+ *                 pixels from the top edge of the screen.
+ * @param width    Width of the rectangle, in pixels.
+ * @param height   Height of the rectangle, in pixels.
+ */
+void mark_minimap_screen_dirty_rect (minimap_t *minimap,
+                                     int16_t x,
+                                     int16_t y,
+                                     uint16_t width,
+                                     uint16_t height);
+
+
+/**
+ * Marks the whole minimap as needing to be shown again, without
+ * repainting any tiles.
+ *
+ * @param minimap  Pointer to the minimap.
+ */
+void mark_minimap_redraw (minimap_t *minimap);
+
+
+/**
+ * Places or moves a marker on a minimap.
+ *
+ * @param minimap  Pointer to the minimap.
+ * @param owner    Pointer identifying the marker, for example the
+ *                 object it follows.
+ * @param map_x    X co-ordinate of the marked position, in pixels
+ *                 from the left edge of the map.
+ * @param map_y    Y co-ordinate of the marked position, in pixels
+ *                 from the top edge of the map.
+ */
+void set_minimap_marker (minimap_t *minimap,
+                         gconstpointer owner,
+                         int32_t map_x,
+                         int32_t map_y);
+
+
+/**
+ * Repaints the dirty tiles of a minimap and draws them on-screen.
+ *
+ * @param minimap  Pointer to the minimap to render.
+ */
+void render_minimap (minimap_t *minimap);
+
+
+/**
+ * De-initialises a minimap.
+ *
+ * This does not detach the minimap from its map; it is normally
+ * called by free_map.
+ *
+ * @param minimap  Pointer to the minimap to free.
+ */
+void free_minimap (minimap_t *minimap);
+
+
+#endif /* not _MINIMAP_H */
@@ -0,0 +1,334 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/map/parallax.c
+ * @author  agent
+ * @brief   Parallax background layers.
+ */
+
+#include "../crystals.h"
+
+
+/* -- STATIC DECLARATIONS -- */
+
+/**
+ * Pre-renders the surface of a parallax layer.
+ *
+ * The surface holds whole repeats of the layer image, enough that a
+ * viewport-sized area starting anywhere within the first repeat
+ * fits inside it.
+ *
+ * @param mapview  Pointer to the map view owning the layer.
+ * @param layer    Pointer to the layer.
+ *
+ * @return  true if the surface was built; false otherwise.
+ */
+static bool build_parallax_surface (mapview_t *mapview,
+                                    parallax_layer_t *layer);
+
+
+/**
+ * Works out where a parallax layer's repeated image starts, given a
+ * screen offset into the viewport.
+ *
+ * @param offset  Scrolled position of the layer, in pixels.
+ * @param size    Size of the layer image along the same axis.
+ *
+ * @return  the on-image position, from 0 to size - 1.
+ */
+static int32_t wrap_parallax_offset (int32_t offset, uint16_t size);
+
+
+/**
+ * Frees a parallax layer.
+ *
+ * @param layer  Pointer to the layer to free.
+ */
+static void free_parallax_layer (gpointer layer);
+
+
+/* -- DEFINITIONS -- */
+
+/* Adds a parallax layer to a map view. */
+bool
+add_parallax_layer (mapview_t *mapview,
+                    const char filename[],
+                    int32_t factor_x,
+                    int32_t factor_y)
+{
+  parallax_layer_t *layer;
+
+  g_assert (mapview != NULL);
+  g_assert (filename != NULL);
+
+  layer = xcalloc (1, sizeof (parallax_layer_t));
+  layer->filename = g_strdup (filename);
+  layer->factor_x = factor_x;
+  layer->factor_y = factor_y;
+
+  if (!build_parallax_surface (mapview, layer))
+    {
+      free_parallax_layer (layer);
+      return false;
+    }
+
+  mapview->parallax_layers = g_slist_append (mapview->parallax_layers,
+                                             layer);
+
+  mark_dirty_rect (mapview,
+                   mapview->x_offset,
+                   mapview->y_offset,
+                   get_mapview_visible_width (mapview),
+                   get_mapview_visible_height (mapview));
+  return true;
+}
+
+
+/* Declares a parallax layer for a map. */
+void
+declare_map_parallax_layer (map_t *map,
+                            const char filename[],
+                            int32_t factor_x,
+                            int32_t factor_y)
+{
+  parallax_layer_t *layer;
+
+  g_assert (map != NULL);
+  g_assert (filename != NULL);
+
+  /* Only the declaration is kept; each map view builds its own
+     surface, sized to its viewport. */
+  layer = xcalloc (1, sizeof (parallax_layer_t));
+  layer->filename = g_strdup (filename);
+  layer->factor_x = factor_x;
+  layer->factor_y = factor_y;
+
+  map->parallax_layers = g_slist_append (map->parallax_layers, layer);
+}
+
+
+/* Adds the parallax layers declared by a map to a map view of it. */
+void
+add_map_parallax_layers (mapview_t *mapview)
+{
+  GSList *node;
+
+  g_assert (mapview != NULL && mapview->map != NULL);
+
+  for (node = mapview->map->parallax_layers;
+       node != NULL;
+       node = node->next)
+    {
+      parallax_layer_t *layer = node->data;
+
+      add_parallax_layer (mapview, layer->filename,
+                          layer->factor_x, layer->factor_y);
+    }
+}
+
+
+/* Discards the pre-rendered surfaces of a map view's parallax
+   layers. */
+void
+invalidate_parallax_layers (mapview_t *mapview)
+{
+  GSList *node;
+
+  g_assert (mapview != NULL);
+
+  for (node = mapview->parallax_layers; node != NULL; node = node->next)
+    {
+      parallax_layer_t *layer = node->data;
+
+      if (layer->surface != NULL)
+        {
+          free_image (layer->surface);
+          layer->surface = NULL;
+        }
+    }
+}
+
+
+/* Draws a map view's parallax layers into a rectangle of the
+   screen. */
+void
+render_parallax_layers (mapview_t *mapview,
+                        int16_t x,
+                        int16_t y,
+                        uint16_t width,
+                        uint16_t height)
+{
+  GSList *node;
+
+  g_assert (mapview != NULL);
+
+  for (node = mapview->parallax_layers; node != NULL; node = node->next)
+    {
+      parallax_layer_t *layer = node->data;
+      int32_t layer_x;
+      int32_t layer_y;
+      int16_t image_x;
+      int16_t image_y;
+
+      if (layer->surface == NULL && !build_parallax_surface (mapview,
+                                                             layer))
+        continue;
+
+      /* Where the top-left of the viewport falls on the layer... */
+      layer_x = ((mapview->x_offset * layer->factor_x)
+                 / PARALLAX_FACTOR_ONE) / mapview->scale;
+      layer_y = ((mapview->y_offset * layer->factor_y)
+                 / PARALLAX_FACTOR_ONE) / mapview->scale;
+
+      /* ...and so where the rectangle falls within the first repeat.
+         The surface is wide enough to hold the rest. */
+      image_x = (int16_t) wrap_parallax_offset (layer_x + x
+                                                - mapview->viewport_x,
+                                                layer->image_width);
+      image_y = (int16_t) wrap_parallax_offset (layer_y + y
+                                                - mapview->viewport_y,
+                                                layer->image_height);
+
+      draw_image_direct (layer->surface, image_x, image_y,
+                         x, y, width, height);
+    }
+}
+
+
+/* De-initialises a list of parallax layers. */
+void
+free_parallax_layers (GSList *layers)
+{
+  g_slist_free_full (layers, free_parallax_layer);
+}
+
+
+/* -- STATIC DEFINITIONS -- */
+
+/* Pre-renders the surface of a parallax layer. */
+static bool
+build_parallax_surface (mapview_t *mapview, parallax_layer_t *layer)
+{
+  image_t *image;
+  uint32_t surface_w;
+  uint32_t surface_h;
+  uint32_t x;
+  uint32_t y;
+
+  image = get_image (load_image (layer->filename));
+  if (image == NULL)
+    {
+      error ("PARALLAX - build_parallax_surface - Couldn't load %s.",
+             layer->filename);
+      return false;
+    }
+
+  if (!get_image_dimensions (image, &layer->image_width,
+                             &layer->image_height)
+      || layer->image_width == 0 || layer->image_height == 0)
+    {
+      error ("PARALLAX - build_parallax_surface - "
+             "Couldn't get the size of %s.", layer->filename);
+      return false;
+    }
+
+  /* One repeat more than is needed to cover the viewport, rounded up
+     to whole repeats. */
+  surface_w = layer->image_width
+    * (((mapview->viewport_width + layer->image_width - 1)
+        / layer->image_width) + 1);
+  surface_h = layer->image_height
+    * (((mapview->viewport_height + layer->image_height - 1)
+        / layer->image_height) + 1);
+
+  if (surface_w > UINT16_MAX || surface_h > UINT16_MAX)
+    {
+      error ("PARALLAX - build_parallax_surface - %s is too large.",
+             layer->filename);
+      return false;
+    }
+
+  layer->surface = create_image ((uint16_t) surface_w,
+                                 (uint16_t) surface_h,
+                                 true);
+  if (layer->surface == NULL)
+    {
+      error ("PARALLAX - build_parallax_surface - "
+             "Graphics module cannot create images.");
+      return false;
+    }
+
+  set_draw_target (layer->surface);
+
+  for (y = 0; y < surface_h; y += layer->image_height)
+    for (x = 0; x < surface_w; x += layer->image_width)
+      draw_image_direct (image, 0, 0,
+                         (int16_t) x, (int16_t) y,
+                         layer->image_width, layer->image_height);
+
+  set_draw_target (NULL);
+
+  return true;
+}
+
+
+/* Works out where a parallax layer's repeated image starts. */
+static int32_t
+wrap_parallax_offset (int32_t offset, uint16_t size)
+{
+  int32_t wrapped = offset % size;
+
+  return (wrapped < 0 ? wrapped + size : wrapped);
+}
+
+
+/* Frees a parallax layer. */
+static void
+free_parallax_layer (gpointer layer)
+{
+  parallax_layer_t *layerc = (parallax_layer_t *) layer;
+
+  if (layerc)
+    {
+      if (layerc->surface)
+        free_image (layerc->surface);
+
+      g_free (layerc->filename);
+      free (layerc);
+    }
+}
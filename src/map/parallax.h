@@ -0,0 +1,179 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/map/parallax.h
+ * @author  agent
+ * @brief   Prototypes and declarations for parallax background layers.
+ *
+ * A map view may have any number of parallax layers behind its map
+ * layers, showing through wherever the map is transparent.  Each
+ * parallax layer is an image repeated endlessly in both directions,
+ * which scrolls at its own speed relative to the map: slower for
+ * distant scenery, faster for near foreground haze.
+ *
+ * Maps may declare parallax layers, which are added to every map
+ * view of the map when it is created.
+ *
+ * Each layer is pre-rendered once into a surface holding enough
+ * repeats of its image to cover the viewport from any starting
+ * offset, so drawing any area of a parallax layer is always a
+ * single blit.
+ */
+
+#ifndef _PARALLAX_H
+#define _PARALLAX_H
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  PARALLAX_FACTOR_ONE = 256  /**< Scroll factor at which a parallax
+                                layer moves with the map. */
+};
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * A parallax background layer.
+ */
+typedef struct parallax_layer
+{
+  char *filename;           /**< Filename of the repeated image. */
+
+  uint16_t image_width;     /**< Width of the repeated image. */
+  uint16_t image_height;    /**< Height of the repeated image. */
+
+  int32_t factor_x;         /**< Horizontal scroll speed, as a
+                               multiple of PARALLAX_FACTOR_ONE. */
+  int32_t factor_y;         /**< Vertical scroll speed, as a multiple
+                               of PARALLAX_FACTOR_ONE. */
+
+  image_t *surface;         /**< Pre-rendered surface of repeats of
+                               the image, or NULL if it is yet to be
+                               built. */
+} parallax_layer_t;
+
+
+/* -- DECLARATIONS -- */
+
+/**
+ * Adds a parallax layer to a map view, in front of any it already
+ * has and behind the map.
+ *
+ * @param mapview   Pointer to the map view.
+ * @param filename  Filename of the image to repeat, relative to the
+ *                  graphics path.
+ * @param factor_x  Horizontal scroll speed: PARALLAX_FACTOR_ONE to
+ *                  move with the map, 0 to stay still.
+ * @param factor_y  Vertical scroll speed, likewise.
+ *
+ * @return  true if the layer was added; false if its image could
+ *          not be loaded or the graphics module cannot pre-render
+ *          it.
+ */
+bool add_parallax_layer (mapview_t *mapview,
+                         const char filename[],
+                         int32_t factor_x,
+                         int32_t factor_y);
+
+
+/**
+ * Declares a parallax layer for a map, to be added to every map view
+ * of the map created from now on, in front of any declared before.
+ *
+ * @param map       Pointer to the map.
+ * @param filename  Filename of the image to repeat, relative to the
+ *                  graphics path.
+ * @param factor_x  Horizontal scroll speed: PARALLAX_FACTOR_ONE to
+ *                  move with the map, 0 to stay still.
+ * @param factor_y  Vertical scroll speed, likewise.
+ */
+void declare_map_parallax_layer (map_t *map,
+                                 const char filename[],
+                                 int32_t factor_x,
+                                 int32_t factor_y);
+
+
+/**
+ * Adds the parallax layers declared by a map to a map view of it.
+ *
+ * @param mapview  Pointer to the map view.
+ */
+void add_map_parallax_layers (mapview_t *mapview);
+
+
+/**
+ * Discards the pre-rendered surfaces of a map view's parallax
+ * layers, for example because the viewport has changed size.  They
+ * are rebuilt when next drawn.
+ *
+ * @param mapview  Pointer to the map view.
+ */
+void invalidate_parallax_layers (mapview_t *mapview);
+
+
+/**
+ * Draws a map view's parallax layers into a rectangle of the screen.
+ *
+ * @param mapview  Pointer to the map view.
+ * @param x        X co-ordinate of the left edge of the rectangle, in
+ *                 pixels from the left edge of the screen.
+ * @param y        Y co-ordinate of the top edge of the rectangle, in
+ *                 pixels from the top edge of the screen.
+ * @param width    Width of the rectangle, in pixels.
+ * @param height   Height of the rectangle, in pixels.
+ */
+void render_parallax_layers (mapview_t *mapview,
+                             int16_t x,
+                             int16_t y,
+                             uint16_t width,
+                             uint16_t height);
+
+
+/**
+ * De-initialises a list of parallax layers, such as those of a map
+ * view or those declared by a map.
+ *
+ * @param layers  List of parallax_layer_t to free.
+ */
+void free_parallax_layers (GSList *layers);
+
+
+#endif /* not _PARALLAX_H */
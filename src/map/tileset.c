@@ -0,0 +1,420 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/map/tileset.c
+ * @author  agent
+ * @brief   Map tilesets.
+ */
+
+#include "../crystals.h"
+
+
+/* -- STATIC DECLARATIONS -- */
+
+/**
+ * Fills in the lookup table entries for one tileset image.
+ *
+ * @param tileset  Pointer to the tileset whose lookup table is being
+ *                 built.
+ * @param index    Index of the tileset image to load.
+ */
+static void build_image_sources (tileset_t *tileset, uint16_t index);
+
+
+/**
+ * Fills in the average colour table entries for one tileset image.
+ *
+ * @param tileset  Pointer to the tileset whose colour table is being
+ *                 built.  The image's lookup table entries must
+ *                 already be filled in.
+ * @param index    Index of the tileset image.
+ */
+static void build_image_colours (tileset_t *tileset, uint16_t index);
+
+
+/**
+ * Advances a tile animation by a period of time.
+ *
+ * @param animation  Pointer to the animation to advance.
+ * @param useconds   Time elapsed since the last call, in
+ *                   microseconds.
+ */
+static void advance_tile_animation (tile_animation_t *animation,
+                                    uint32_t useconds);
+
+
+/* -- DEFINITIONS -- */
+
+/* Allocates and initialises a tileset. */
+tileset_t *
+init_tileset (uint16_t num_images, char *filenames[])
+{
+  tileset_t *tileset;
+  uint16_t i;
+
+  g_assert (num_images > 0 && num_images <= MAX_TILESET_IMAGES);
+  g_assert (filenames != NULL);
+
+  tileset = xcalloc (1, sizeof (tileset_t));
+  tileset->num_images = num_images;
+  tileset->filenames = xcalloc (num_images, sizeof (char *));
+  tileset->images = xcalloc (num_images, sizeof (image_handle_t));
+  tileset->num_sources = (uint32_t) num_images * TILES_PER_IMAGE;
+  tileset->sources = xcalloc (tileset->num_sources,
+                              sizeof (tile_source_t));
+  tileset->colours = xcalloc (tileset->num_sources,
+                              sizeof (tile_colour_t));
+
+  for (i = 0; i < num_images; i += 1)
+    {
+      tileset->filenames[i] = g_strdup (filenames[i]);
+      build_image_sources (tileset, i);
+      build_image_colours (tileset, i);
+    }
+
+  return tileset;
+}
+
+
+/* Looks up the location of a tile's image. */
+tile_source_t *
+get_tile_source (tileset_t *tileset, layer_value_t value)
+{
+  g_assert (tileset != NULL);
+
+  if ((uint32_t) value >= tileset->num_sources)
+    return NULL;
+
+  if (tileset->sources[value].animation != 0)
+    {
+      tile_animation_t *animation =
+        &(tileset->animations[tileset->sources[value].animation - 1]);
+
+      value = animation->frames[animation->current_frame];
+      if ((uint32_t) value >= tileset->num_sources)
+        return NULL;
+    }
+
+  return &(tileset->sources[value]);
+}
+
+
+/* Defines an animation for a tile value. */
+void
+add_tile_animation (tileset_t *tileset,
+                    layer_value_t value,
+                    uint16_t num_frames,
+                    layer_value_t frames[],
+                    uint32_t durations[])
+{
+  tile_animation_t *animation;
+  uint16_t index;
+
+  g_assert (tileset != NULL);
+  g_assert (num_frames > 0);
+  g_assert (frames != NULL && durations != NULL);
+
+  if ((uint32_t) value >= tileset->num_sources)
+    {
+      error ("TILESET - add_tile_animation - Tile %u out of range.",
+             value);
+      return;
+    }
+
+  index = tileset->sources[value].animation;
+  if (index == 0)
+    {
+      tileset->num_animations += 1;
+      tileset->animations =
+        realloc (tileset->animations,
+                 sizeof (tile_animation_t) * tileset->num_animations);
+      g_assert (tileset->animations != NULL);
+
+      index = tileset->num_animations;
+      tileset->sources[value].animation = index;
+    }
+  else
+    {
+      free (tileset->animations[index - 1].frames);
+      free (tileset->animations[index - 1].durations);
+    }
+
+  animation = &(tileset->animations[index - 1]);
+  memset (animation, 0, sizeof (tile_animation_t));
+
+  animation->value = value;
+  animation->num_frames = num_frames;
+  animation->frames = xcalloc (num_frames, sizeof (layer_value_t));
+  animation->durations = xcalloc (num_frames, sizeof (uint32_t));
+
+  memcpy (animation->frames, frames,
+          sizeof (layer_value_t) * num_frames);
+  memcpy (animation->durations, durations,
+          sizeof (uint32_t) * num_frames);
+}
+
+
+/* Retrieves the animation index of a tile value. */
+uint16_t
+get_tile_animation (tileset_t *tileset, layer_value_t value)
+{
+  g_assert (tileset != NULL);
+
+  if ((uint32_t) value >= tileset->num_sources)
+    return 0;
+
+  return tileset->sources[value].animation;
+}
+
+
+/* Retrieves the average colour of a tile. */
+tile_colour_t *
+get_tile_colour (tileset_t *tileset, layer_value_t value)
+{
+  g_assert (tileset != NULL);
+
+  if ((uint32_t) value >= tileset->num_sources)
+    return NULL;
+
+  return &(tileset->colours[value]);
+}
+
+
+/* Advances all tile animations in a tileset by a period of time. */
+bool
+advance_tile_animations (tileset_t *tileset, uint32_t useconds)
+{
+  uint16_t i;
+  bool any_changed = false;
+
+  g_assert (tileset != NULL);
+
+  for (i = 0; i < tileset->num_animations; i += 1)
+    {
+      advance_tile_animation (&(tileset->animations[i]), useconds);
+
+      if (tileset->animations[i].changed)
+        any_changed = true;
+    }
+
+  return any_changed;
+}
+
+
+/* De-initialises a tileset. */
+void
+free_tileset (tileset_t *tileset)
+{
+  if (tileset)
+    {
+      if (tileset->filenames)
+        {
+          uint16_t i;
+
+          for (i = 0; i < tileset->num_images; i += 1)
+            g_free (tileset->filenames[i]);
+
+          free (tileset->filenames);
+        }
+
+      if (tileset->images)
+        {
+          uint16_t i;
+
+          for (i = 0; i < tileset->num_images; i += 1)
+            if (tileset->images[i] != NULL_IMAGE)
+              unpin_image (tileset->images[i]);
+
+          free (tileset->images);
+        }
+
+      if (tileset->sources)
+        free (tileset->sources);
+
+      if (tileset->colours)
+        free (tileset->colours);
+
+      if (tileset->animations)
+        {
+          uint16_t i;
+
+          for (i = 0; i < tileset->num_animations; i += 1)
+            {
+              free (tileset->animations[i].frames);
+              free (tileset->animations[i].durations);
+            }
+
+          free (tileset->animations);
+        }
+
+      free (tileset);
+    }
+}
+
+
+/* -- STATIC DEFINITIONS -- */
+
+/* Fills in the lookup table entries for one tileset image. */
+static void
+build_image_sources (tileset_t *tileset, uint16_t index)
+{
+  image_t *image;
+  uint16_t width;
+  uint16_t height;
+  uint32_t columns;
+  uint32_t rows;
+  uint32_t num_tiles;
+  uint32_t tile;
+  tile_source_t *sources;
+
+  tileset->images[index] = load_image (tileset->filenames[index]);
+  pin_image (tileset->images[index]);
+
+  image = get_image (tileset->images[index]);
+  if (image == NULL)
+    {
+      fatal ("TILESET - build_image_sources - Couldn't load %s.",
+             tileset->filenames[index]);
+    }
+
+  if (get_image_dimensions (image, &width, &height))
+    {
+      columns = width / TILE_W;
+      rows = height / TILE_H;
+    }
+  else
+    {
+      /* Assume the old single-row layout, as far as on-image
+         co-ordinates can reach. */
+      columns = INT16_MAX / TILE_W;
+      rows = 1;
+    }
+
+  num_tiles = columns * rows;
+  if (num_tiles > TILES_PER_IMAGE)
+    num_tiles = TILES_PER_IMAGE;
+
+  sources = tileset->sources + ((uint32_t) index * TILES_PER_IMAGE);
+
+  for (tile = 0; tile < num_tiles; tile += 1)
+    {
+      sources[tile].image = image;
+      sources[tile].x = (int16_t) ((tile % columns) * TILE_W);
+      sources[tile].y = (int16_t) ((tile / columns) * TILE_H);
+    }
+}
+
+
+/* Fills in the average colour table entries for one tileset image. */
+static void
+build_image_colours (tileset_t *tileset, uint16_t index)
+{
+  tile_source_t *sources;
+  tile_colour_t *colours;
+  uint8_t (*grid)[4];
+  uint32_t num_tiles;
+  uint32_t tile;
+  bool have_colours;
+
+  sources = tileset->sources + ((uint32_t) index * TILES_PER_IMAGE);
+  colours = tileset->colours + ((uint32_t) index * TILES_PER_IMAGE);
+
+  /* build_image_sources lays the tiles out in grid order from the
+     first entry, so the used entries are the leading ones. */
+  for (num_tiles = 0; num_tiles < TILES_PER_IMAGE; num_tiles += 1)
+    {
+      if (sources[num_tiles].image == NULL)
+        break;
+    }
+
+  if (num_tiles == 0)
+    return;
+
+  grid = xcalloc (num_tiles, sizeof (*grid));
+
+  /* Average the whole image in one go rather than tile by tile, so
+     the draw queue is only flushed once per image. */
+  have_colours = get_image_grid_colours (sources[0].image,
+                                         TILE_W, TILE_H,
+                                         num_tiles,
+                                         grid);
+
+  for (tile = 0; tile < num_tiles; tile += 1)
+    {
+      if (!have_colours)
+        {
+          /* No pixel access, so fall back to plain grey. */
+          grid[tile][0] = grid[tile][1] = grid[tile][2] = 128;
+          grid[tile][3] = 255;
+        }
+
+      colours[tile].red = grid[tile][0];
+      colours[tile].green = grid[tile][1];
+      colours[tile].blue = grid[tile][2];
+      colours[tile].coverage = grid[tile][3];
+    }
+
+  free (grid);
+}
+
+
+/* Advances a tile animation by a period of time. */
+static void
+advance_tile_animation (tile_animation_t *animation, uint32_t useconds)
+{
+  uint16_t start_frame = animation->current_frame;
+  uint32_t duration = animation->durations[animation->current_frame];
+
+  animation->elapsed += useconds;
+
+  /* Skip as many frames as have elapsed.  A zero-length frame stops
+     the skip, so that it is still shown for one advance. */
+  while (animation->elapsed >= duration)
+    {
+      animation->elapsed -= duration;
+      animation->current_frame =
+        (uint16_t) ((animation->current_frame + 1)
+                    % animation->num_frames);
+
+      duration = animation->durations[animation->current_frame];
+      if (duration == 0)
+        break;
+    }
+
+  animation->changed = (animation->current_frame != start_frame);
+}
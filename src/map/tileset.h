@@ -0,0 +1,268 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    src/map/tileset.h
+ * @author  agent
+ * @brief   Prototypes and declarations for map tilesets.
+ *
+ * A tileset is a set of one or more tileset images, each laid out as
+ * a two-dimensional atlas of TILE_W by TILE_H tiles.  The top bits of
+ * a tile value select the tileset image, and the remaining bits the
+ * tile within it, counting left-to-right, top-to-bottom.
+ *
+ * The on-image position of every tile value is worked out once, when
+ * the tileset is loaded, and stored in a lookup table, so renderers
+ * need not do any arithmetic to find a tile.
+ *
+ * Tile values may also be animated, cycling through a list of other
+ * tile values (frames) with a given duration each.  Animations are
+ * advanced by the tileset as a whole, so all instances of an
+ * animated tile value on a map show the same frame.
+ *
+ * The tileset also stores the average colour of every tile, for use
+ * in overviews such as the minimap.
+ */
+
+#ifndef _TILESET_H
+#define _TILESET_H
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  TILESET_IMAGE_SHIFT = 12,  /**< Number of low bits in a tile value
+                                that select the tile within its
+                                tileset image. */
+
+  TILES_PER_IMAGE = (1 << TILESET_IMAGE_SHIFT),  /**< Number of tile
+                                                    values mapped to
+                                                    each tileset
+                                                    image. */
+
+  MAX_TILESET_IMAGES = (1 << (16 - TILESET_IMAGE_SHIFT))  /**< Maximum
+                                                             number of
+                                                             tileset
+                                                             images. */
+};
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * A tile lookup table entry, giving the location of a tile's image.
+ */
+typedef struct tile_source
+{
+  image_t *image;  /**< The tileset image holding the tile, or NULL if
+                      the tile value does not map to any tile. */
+  int16_t x;       /**< X co-ordinate of the left edge of the tile, in
+                      pixels from the left edge of the image. */
+  int16_t y;       /**< Y co-ordinate of the top edge of the tile, in
+                      pixels from the top edge of the image. */
+  uint16_t animation;  /**< One plus the index of the tile's
+                          animation, or 0 if the tile is not
+                          animated. */
+} tile_source_t;
+
+
+/**
+ * The average colour of a tile.
+ */
+typedef struct tile_colour
+{
+  uint8_t red;       /**< Average red of the tile's opaque pixels. */
+  uint8_t green;     /**< Average green of the tile's opaque
+                        pixels. */
+  uint8_t blue;      /**< Average blue of the tile's opaque pixels. */
+  uint8_t coverage;  /**< Proportion of the tile that is opaque, from
+                        0 (fully transparent) to 255 (fully
+                        opaque). */
+} tile_colour_t;
+
+
+/**
+ * An animated tile definition.
+ */
+typedef struct tile_animation
+{
+  layer_value_t value;      /**< The animated tile value. */
+  uint16_t num_frames;      /**< Number of frames in the animation. */
+  layer_value_t *frames;    /**< Tile values shown in each frame. */
+  uint32_t *durations;      /**< Duration of each frame, in
+                               microseconds. */
+
+  uint16_t current_frame;   /**< Index of the frame being shown. */
+  uint32_t elapsed;         /**< Time spent in the current frame, in
+                               microseconds. */
+  bool changed;             /**< Whether the frame changed in the last
+                               call to advance_tile_animations. */
+} tile_animation_t;
+
+
+/**
+ * A map tileset.
+ */
+typedef struct tileset
+{
+  uint16_t num_images;     /**< Number of tileset images. */
+  char **filenames;        /**< Filenames of the tileset images. */
+  image_handle_t *images;  /**< Handles of the tileset images, which
+                              stay pinned in the image cache while
+                              the lookup table points into them. */
+
+  uint32_t num_sources;    /**< Number of entries in the lookup
+                              table. */
+  tile_source_t *sources;  /**< Lookup table of tile locations,
+                              indexed by tile value. */
+  tile_colour_t *colours;  /**< Table of average tile colours,
+                              indexed by tile value. */
+
+  uint16_t num_animations;        /**< Number of tile animations. */
+  tile_animation_t *animations;   /**< Array of tile animations. */
+} tileset_t;
+
+
+/* -- DECLARATIONS -- */
+
+/**
+ * Allocates and initialises a tileset, loading its images and
+ * building its lookup table.
+ *
+ * @param num_images  Number of tileset images (1 to
+ *                    MAX_TILESET_IMAGES).
+ * @param filenames   Array of the filenames of the tileset images,
+ *                    relative to the graphics path.  These are
+ *                    copied.
+ *
+ * @return  a pointer to the new tileset.
+ */
+tileset_t *init_tileset (uint16_t num_images, char *filenames[]);
+
+
+/**
+ * Looks up the location of a tile's image.
+ *
+ * If the tile value is animated, this returns the location of the
+ * image for the animation's current frame.
+ *
+ * @param tileset  Pointer to the tileset to query.
+ * @param value    The tile value to look up.
+ *
+ * @return  a pointer to the tile's lookup table entry, or NULL if
+ *          the tile value is outside the tileset.  The entry's image
+ *          is NULL if no tile is stored there.
+ */
+tile_source_t *get_tile_source (tileset_t *tileset, layer_value_t value);
+
+
+/**
+ * Defines an animation for a tile value.
+ *
+ * Any existing animation for the tile value is replaced.
+ *
+ * @param tileset     Pointer to the tileset to add the animation to.
+ * @param value       The tile value to animate.
+ * @param num_frames  Number of frames in the animation (at least 1).
+ * @param frames      Array of the tile values to show in each frame.
+ *                    These are copied, and must not themselves be
+ *                    animated.
+ * @param durations   Array of the durations of each frame, in
+ *                    microseconds.  These are copied.
+ */
+void add_tile_animation (tileset_t *tileset,
+                         layer_value_t value,
+                         uint16_t num_frames,
+                         layer_value_t frames[],
+                         uint32_t durations[]);
+
+
+/**
+ * Retrieves the animation index of a tile value.
+ *
+ * @param tileset  Pointer to the tileset to query.
+ * @param value    The tile value to look up.
+ *
+ * @return  one plus the index of the tile value's animation in the
+ *          tileset, or 0 if the tile value is not animated.
+ */
+uint16_t get_tile_animation (tileset_t *tileset, layer_value_t value);
+
+
+/**
+ * Retrieves the average colour of a tile.
+ *
+ * Animated tiles take the colour of their tile value, not of their
+ * current frame.  If the graphics module cannot read image pixels,
+ * every tile with an image is mid-grey and opaque.
+ *
+ * @param tileset  Pointer to the tileset to query.
+ * @param value    The tile value to look up.
+ *
+ * @return  a pointer to the tile's colour, or NULL if the tile value
+ *          is outside the tileset.
+ */
+tile_colour_t *get_tile_colour (tileset_t *tileset, layer_value_t value);
+
+
+/**
+ * Advances all tile animations in a tileset by a period of time.
+ *
+ * Each animation's changed flag is set if, and only if, its frame
+ * changed during this call.
+ *
+ * @param tileset   Pointer to the tileset to animate.
+ * @param useconds  Time elapsed since the last call, in
+ *                  microseconds.
+ *
+ * @return  true if any animation changed frame; false otherwise.
+ */
+bool advance_tile_animations (tileset_t *tileset, uint32_t useconds);
+
+
+/**
+ * De-initialises a tileset.
+ *
+ * The tileset images remain in the image cache.
+ *
+ * @param tileset  Pointer to the tileset to free.
+ */
+void free_tileset (tileset_t *tileset);
+
+
+#endif /* not _TILESET_H */
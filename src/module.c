@@ -211,6 +211,22 @@ get_module_function (module_data module, const char *function, mod_function_ptr
 }
 
 
+/* This loads a pointer to a function from a module, if it exists */
+
+bool_t
+get_optional_module_function (module_data module, const char *function,
+                              mod_function_ptr *func)
+{
+  if (!g_module_symbol (module.lib_handle, function, func))
+    {
+      *func = NULL;
+      return FAILURE;
+    }
+
+  return SUCCESS;
+}
+
+
 /* Load a graphics module. */
 
 bool_t
@@ -270,6 +286,83 @@ load_module_gfx (const char* name, module_set* modules)
                            &modules->gfx.scroll_screen_internal)
       == FAILURE)
     return FAILURE;
+
+  /* Optional functions; these are NULL if not provided. */
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "draw_batch_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.draw_batch_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "get_image_dimensions_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.get_image_dimensions_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "get_image_bytes_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.get_image_bytes_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "create_image_data",
+                                (mod_function_ptr*)
+                                &modules->gfx.create_image_data);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "set_draw_target_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.set_draw_target_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "draw_image_scaled_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.draw_image_scaled_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "get_image_average_colour_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.get_image_average_colour_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "set_tint_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.set_tint_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "shade_rect_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.shade_rect_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "begin_transition_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.begin_transition_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "present_transition_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.present_transition_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "end_transition_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.end_transition_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "set_output_scale_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.set_output_scale_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "dump_screen_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.dump_screen_internal);
+
+  get_optional_module_function (modules->gfx.metadata,
+                                "is_thread_bound_internal",
+                                (mod_function_ptr*)
+                                &modules->gfx.is_thread_bound_internal);
   
   return SUCCESS;
 }
@@ -136,6 +136,9 @@ typedef struct
    * subsystem's wrapper function, load_image, which also stores the
    * data into a cache.
    *
+   * This may be called from several threads at once, when images
+   * are preloaded.
+   *
    * @param filename  The path to the file to load.
    *
    * @return  a pointer to a memory location containing image data
@@ -220,6 +223,248 @@ typedef struct
   void (*scroll_screen_internal) (int16_t x_offset, int16_t y_offset);
 
 
+  /**
+   * Draw a batch of buffered drawing commands, in order.
+   *
+   * This is optional; if the module does not provide it, this is
+   * NULL and the graphics subsystem falls back to calling the
+   * individual drawing functions once per command.
+   *
+   * @param commands  Array of drawing commands.
+   * @param count     Number of commands in the array.
+   */
+  void (*draw_batch_internal) (draw_command_t commands[],
+                               uint32_t count);
+
+
+  /**
+   * Retrieve the dimensions of an image.
+   *
+   * This is optional; if the module does not provide it, this is
+   * NULL and image dimensions are unknown.
+   *
+   * @param image   The image data, in the graphics module-specific
+   *                format returned by load_image_data.
+   * @param width   Pointer to a variable in which to store the width
+   *                of the image, in pixels.
+   * @param height  Pointer to a variable in which to store the
+   *                height of the image, in pixels.
+   */
+  void (*get_image_dimensions_internal) (void *image,
+                                         uint16_t *width,
+                                         uint16_t *height);
+
+
+  /**
+   * Retrieve the amount of memory an image's pixels take up.
+   *
+   * This is optional; if the module does not provide it, this is
+   * NULL and the size is guessed from the image dimensions.
+   *
+   * @param image  The image data, in the graphics module-specific
+   *               format returned by load_image_data.
+   *
+   * @return  the size of the image's pixel data, in bytes.
+   */
+  uint32_t (*get_image_bytes_internal) (void *image);
+
+
+  /**
+   * Create a blank image to draw into.
+   *
+   * This is optional; if the module does not provide it, this is
+   * NULL.
+   *
+   * @param width        The width of the image, in pixels.
+   * @param height       The height of the image, in pixels.
+   * @param transparent  Whether the image starts fully transparent
+   *                     rather than black.
+   *
+   * @return  the image data, to be freed with free_image_data, or
+   *          NULL on failure.
+   */
+  void *(*create_image_data) (uint16_t width,
+                              uint16_t height,
+                              bool transparent);
+
+
+  /**
+   * Redirect drawing into an image, or back to the screen.
+   *
+   * This is optional; if the module does not provide it, this is
+   * NULL.
+   *
+   * @param image  Image data returned by create_image_data, or NULL
+   *               for the screen.
+   */
+  void (*set_draw_target_internal) (void *image);
+
+
+  /**
+   * Draw a rectangular portion of an image, scaled to fit a
+   * rectangle of a different size.
+   *
+   * This is optional; if the module does not provide it, this is
+   * NULL.
+   *
+   * @param image         The image data.
+   * @param image_x       The X-coordinate of the left edge of the
+   *                      on-image rectangle.
+   * @param image_y       The Y-coordinate of the top edge of the
+   *                      on-image rectangle.
+   * @param image_width   The width of the on-image rectangle.
+   * @param image_height  The height of the on-image rectangle.
+   * @param screen_x      The X-coordinate of the left edge of the
+   *                      on-screen rectangle.
+   * @param screen_y      The Y-coordinate of the top edge of the
+   *                      on-screen rectangle.
+   * @param width         The width of the on-screen rectangle.
+   * @param height        The height of the on-screen rectangle.
+   */
+  void (*draw_image_scaled_internal) (void *image,
+                                      int16_t image_x,
+                                      int16_t image_y,
+                                      uint16_t image_width,
+                                      uint16_t image_height,
+                                      int16_t screen_x,
+                                      int16_t screen_y,
+                                      uint16_t width,
+                                      uint16_t height);
+
+
+  /**
+   * Work out the average colour of a rectangular portion of an
+   * image.
+   *
+   * This is optional; if the module does not provide it, this is
+   * NULL.
+   *
+   * @param image     The image data.
+   * @param image_x   The X-coordinate of the left edge of the
+   *                  rectangle.
+   * @param image_y   The Y-coordinate of the top edge of the
+   *                  rectangle.
+   * @param width     The width of the rectangle.
+   * @param height    The height of the rectangle.
+   * @param colour    Array in which to store the average red, green
+   *                  and blue of the opaque pixels in the rectangle,
+   *                  followed by the proportion of pixels that are
+   *                  opaque (0 to 255).
+   */
+  void (*get_image_average_colour_internal) (void *image,
+                                             int16_t image_x,
+                                             int16_t image_y,
+                                             uint16_t width,
+                                             uint16_t height,
+                                             uint8_t colour[4]);
+
+
+  /**
+   * Set the colour tint applied to the screen as it is presented.
+   *
+   * This is optional; if the module does not provide it, this is
+   * NULL and the screen is never tinted.
+   *
+   * @param red    Red multiplier, from 0 (none) to 255 (unchanged).
+   * @param green  Green multiplier, likewise.
+   * @param blue   Blue multiplier, likewise.
+   */
+  void (*set_tint_internal) (uint8_t red, uint8_t green, uint8_t blue);
+
+
+  /**
+   * Darken a rectangle of what has already been drawn.
+   *
+   * This is optional; if the module does not provide it, this is
+   * NULL.
+   *
+   * @param x           The X-coordinate of the left edge of the
+   *                    rectangle.
+   * @param y           The Y-coordinate of the top edge of the
+   *                    rectangle.
+   * @param width       The width of the rectangle.
+   * @param height      The height of the rectangle.
+   * @param brightness  Brightness to leave, from 0 (black) to 255
+   *                    (unchanged).
+   */
+  void (*shade_rect_internal) (int16_t x,
+                               int16_t y,
+                               uint16_t width,
+                               uint16_t height,
+                               uint8_t brightness);
+
+
+  /**
+   * Keep the screen as last presented, to transition from.
+   *
+   * This is optional, along with present_transition_internal and
+   * end_transition_internal; if the module does not provide all
+   * three, they are NULL and screen changes simply cut over.
+   *
+   * @return  true if the screen was kept; false otherwise.
+   */
+  bool (*begin_transition_internal) (void);
+
+
+  /**
+   * Update the whole screen with a mix of the kept screen and what
+   * has been drawn since, in place of update_screen_internal.
+   *
+   * @param type      The style of transition.
+   * @param progress  How far through the transition to show, from 0
+   *                  (all kept screen) to TRANSITION_ONE (none).
+   */
+  void (*present_transition_internal) (transition_type_t type,
+                                       uint16_t progress);
+
+
+  /**
+   * Free the kept screen, and update the whole screen next time.
+   */
+  void (*end_transition_internal) (void);
+
+
+  /**
+   * Present the screen scaled up by a whole number.
+   *
+   * This is optional; if the module does not provide it, this is
+   * NULL and the screen is always presented at its own size.
+   *
+   * @param scale   The scale, from 1 to 4.
+   * @param filter  The filter to scale with.
+   *
+   * @return  true if the output is now scaled; false otherwise.
+   */
+  bool (*set_output_scale_internal) (uint8_t scale,
+                                     output_filter_t filter);
+
+
+  /**
+   * Write the screen as last presented to a PNG file.
+   *
+   * This is optional; if the module does not provide it, this is
+   * NULL and the screen cannot be dumped.
+   *
+   * @param filename  Path of the file to write.
+   *
+   * @return  true if the file was written; false otherwise.
+   */
+  bool (*dump_screen_internal) (const char filename[]);
+
+
+  /**
+   * Say whether all drawing must be done on the thread that created
+   * the screen.
+   *
+   * This is optional; if the module does not provide it, this is
+   * NULL and the module may draw from the render thread.
+   *
+   * @return  true if the render thread must not be used; false
+   *          otherwise.
+   */
+  bool (*is_thread_bound_internal) (void);
+
+
 } module_gfx;
 
 /**
@@ -388,6 +633,26 @@ get_module_function (module_data metadata, const char *function,
                      mod_function_ptr *func);
 
 
+/**
+ * Find a pointer to an optional function within a module.
+ *
+ * Unlike get_module_function, a missing symbol is not treated as an
+ * error; the pointer is simply set to NULL, so that the caller can
+ * fall back to other behaviour.
+ *
+ * @param metadata The module_data structure for the desired module.
+ * @param function The name of the symbol to be loaded.
+ * @param func     A pointer to where the symbol pointer will be stored.
+ *
+ * @return  SUCCESS if the symbol was found, FAILURE otherwise.
+ */
+
+bool_t
+get_optional_module_function (module_data metadata,
+                              const char *function,
+                              mod_function_ptr *func);
+
+
 /**
  * Load the graphics module.
  *
@@ -0,0 +1,278 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file    modules/event-sdl2.c
+ *  @author  agent
+ *  @brief   SDL 2 implementation of event system backend.
+ *
+ *  Use this with gfx-sdl2.  SDL 2 only takes events on the thread
+ *  that made the window, which is why gfx-sdl2 keeps all drawing on
+ *  the main thread, where events are processed.
+ */
+
+#include <stdio.h>
+#include <SDL2/SDL.h>
+
+#include "module.h"
+
+/* Workaround for Windows DLL symbol load failures.
+ *
+ * All outward-facing functions MUST be preceded with
+ * EXPORT so that the DLL loader can see them.
+ */
+
+#ifdef PLATFORM_WINDOWS
+#define EXPORT __declspec(dllexport)
+#else
+#define EXPORT
+#endif /* PLATFORM_WINDOWS */
+
+/* -- STATIC GLOBAL VARIABLES -- */
+
+static void
+(*sg_event_release) (event_t *event); /**< Event release function
+                                         pointer. */
+
+
+/* -- PROTOTYPES -- */
+
+/** Initialise the events module. */
+
+EXPORT int
+init (void);
+
+
+/** Terminate the events module, freeing any remaining data
+    dynamically allocated by the module. */
+
+EXPORT void
+term (void);
+
+
+/** Register a function for handling event releases.
+ *
+ *  @param handle  The function to send event releases to. 
+ *                 This should be event.c's event_release;
+ */
+
+EXPORT void
+register_release_handle (void (*handle) (event_t *event));
+
+
+/** Process one frame of input.
+ *
+ *  This function calls the platform-specific input routines to handle 
+ *  any pending input events, and trigger any relevant callbacks.
+ *
+ */
+
+EXPORT void
+process_events_internal (void);
+
+
+/** Handle an SDL keyboard event.
+ *
+ *  @param event     Event union to populate with information.
+ *  @param sdlevent  SDL event to extract key data from.
+ */
+
+static void
+key_press (event_t *event, SDL_Event *sdlevent);
+
+
+/** Handle an SDL mouse motion event.
+ *
+ *  @param event     Event union to populate with information.
+ *  @param sdlevent  SDL event to extract motion data from.
+ */
+
+static void
+mouse_motion (event_t *event, SDL_Event *sdlevent);
+
+
+/* -- DEFINITIONS -- */
+
+/* Initialise the events module. */
+
+EXPORT int
+init (void)
+{
+  if (SDL_Init (SDL_INIT_VIDEO) != 0)
+    {
+      fprintf (stderr, "event-sdl2: ERROR: Could not init SDL!\n");
+      return FAILURE;
+    }
+
+  return SUCCESS;
+}
+
+
+/* Terminate the events module, freeing any remaining data
+   dynamically allocated by the module. */
+
+EXPORT void
+term (void)
+{
+  SDL_Quit ();
+}
+
+
+/* Register a function for handling event releases. */
+
+EXPORT void
+register_release_handle (void (*handle) (event_t *event))
+{
+  sg_event_release = handle;
+}
+
+
+/* Process one frame of input. */
+
+void
+process_events_internal (void)
+{
+  SDL_Event sdlevent;
+  event_t event;
+
+  while (SDL_PollEvent (&sdlevent))
+    {
+      /* Null out the event. */
+      event.type = 0;
+
+      switch (sdlevent.type)
+        {
+        case SDL_QUIT:
+          /* Quit event (eg window close attempted). */
+          event.type = QUIT_EVENT;
+          break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+          if (sdlevent.button.button == SDL_BUTTON_LEFT)
+            event.button.button = LMB;
+          else if (sdlevent.button.button == SDL_BUTTON_MIDDLE)
+            event.button.button = MMB;
+          else
+            event.button.button = RMB;
+
+          if (sdlevent.type == SDL_MOUSEBUTTONDOWN)
+            event.type = MOUSE_BUTTON_DOWN_EVENT;
+          else
+            event.type = MOUSE_BUTTON_UP_EVENT;
+
+          break;
+        case SDL_MOUSEMOTION:
+          /* Mouse motion events. */
+          mouse_motion (&event, &sdlevent);
+          break;
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+          /* Keyboard events. */
+          key_press (&event, &sdlevent);
+          break;
+        default:
+          break;
+        }
+
+      /* If there was a proper event, release it to callbacks. */
+      if (event.type != 0)
+        (*sg_event_release) (&event);
+    }
+}
+
+
+/* Handle an SDL keyboard event. */
+
+static void
+key_press (event_t *event, SDL_Event *sdlevent)
+{
+  SDL_Keycode sym = sdlevent->key.keysym.sym;
+  bool down = (sdlevent->key.type == SDL_KEYDOWN);
+
+  switch (sym)
+    {
+    case SDLK_ESCAPE:
+      event->skey.code = SK_ESCAPE;
+      break;
+    case SDLK_UP:
+      event->skey.code = SK_UP;
+      break;
+    case SDLK_RIGHT:
+      event->skey.code = SK_RIGHT;
+      break;
+    case SDLK_DOWN:
+      event->skey.code = SK_DOWN;
+      break;
+    case SDLK_LEFT:
+      event->skey.code = SK_LEFT;
+      break;
+    default:
+      /* SDL 2 has no unicode field on key events, but the key codes
+         of printable ASCII keys are their unshifted characters. */
+      if (sym >= ' ' && sym < 0x7F)
+        {
+          event->ascii.type = (down
+                               ? ASCII_KEY_DOWN_EVENT
+                               : ASCII_KEY_UP_EVENT);
+          event->ascii.code = (char) sym;
+        }
+      return;
+    }
+
+  event->skey.type = (down ? SPECIAL_KEY_DOWN_EVENT : SPECIAL_KEY_UP_EVENT);
+}
+
+
+/* Handle an SDL mouse motion event. */
+
+static void
+mouse_motion (event_t *event, SDL_Event *sdlevent)
+{
+  /* gfx-sdl2 sets a logical size on its renderer, so SDL has already
+     scaled the position down to screen co-ordinates; it only needs
+     checking against the screen boundaries. */
+  if (sdlevent->motion.x >= 0
+      && sdlevent->motion.x < SCREEN_W
+      && sdlevent->motion.y >= 0
+      && sdlevent->motion.y < SCREEN_H)
+    {
+      event->motion.type = MOUSE_MOTION_EVENT;
+      event->motion.x = (uint16_t) sdlevent->motion.x;
+      event->motion.y = (uint16_t) sdlevent->motion.y;
+      event->motion.deltax = (int16_t) sdlevent->motion.xrel;
+      event->motion.deltay = (int16_t) sdlevent->motion.yrel;
+    }
+}
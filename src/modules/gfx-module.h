@@ -127,6 +127,9 @@ draw_rect_internal (int16_t x,
  * subsystem's wrapper function, load_image, which also stores the
  * data into a cache.
  *
+ * This may be called from several threads at once, when images are
+ * preloaded, so must not change any state shared between calls.
+ *
  * @param filename  The path to the file to load.
  *
  * @return  a pointer to a memory location containing image data
@@ -217,4 +220,271 @@ EXPORT void
 scroll_screen_internal (int16_t x_offset, int16_t y_offset);
 
 
+/**
+ * Draws a batch of drawing commands, in order.
+ *
+ * This function is optional.  Modules that do not export it will
+ * have each command sent to draw_image_internal or
+ * draw_rect_internal individually instead.
+ *
+ * Modules are free to combine or reorder commands, so long as the
+ * end result on-screen is the same as executing them in order.
+ *
+ * @param commands  Array of drawing commands (see graphics.h).
+ * @param count     Number of commands in the array.
+ */
+EXPORT void
+draw_batch_internal (draw_command_t commands[], uint32_t count);
+
+
+/**
+ * Retrieves the dimensions of an image.
+ *
+ * This function is optional.  Without it, the engine cannot tell
+ * how large images are, and will assume tilesets are a single row
+ * of tiles.
+ *
+ * @param image   The image data, in the graphics module-specific
+ *                format returned by load_image_data.
+ * @param width   Pointer to a variable in which to store the width
+ *                of the image, in pixels.
+ * @param height  Pointer to a variable in which to store the height
+ *                of the image, in pixels.
+ */
+EXPORT void
+get_image_dimensions_internal (void *image,
+                               uint16_t *width,
+                               uint16_t *height);
+
+
+/**
+ * Retrieves the amount of memory an image's pixels take up.
+ *
+ * This function is optional.  Without it, the engine guesses image
+ * sizes from their dimensions when keeping the image cache within
+ * its memory budget.
+ *
+ * @param image  The image data, in the graphics module-specific
+ *               format returned by load_image_data.
+ *
+ * @return  the size of the image's pixel data, in bytes.
+ */
+EXPORT uint32_t
+get_image_bytes_internal (void *image);
+
+
+/**
+ * Creates a blank image to draw into.
+ *
+ * This function is optional, but is needed by set_draw_target_internal.
+ *
+ * @param width        The width of the image, in pixels.
+ * @param height       The height of the image, in pixels.
+ * @param transparent  If true, the image starts fully transparent, and
+ *                     images drawn into it must keep their
+ *                     transparency; otherwise it starts black.
+ *
+ * @return  the image data, to be freed with free_image_data, or NULL
+ *          on failure.
+ */
+EXPORT void *
+create_image_data (uint16_t width, uint16_t height, bool transparent);
+
+
+/**
+ * Redirects drawing into an image, or back to the screen.
+ *
+ * This function is optional.  While an image is the target, all
+ * drawing functions draw into it, with screen co-ordinates taken as
+ * positions on the image.
+ *
+ * @param image  Image data returned by create_image_data, or NULL to
+ *               draw to the screen.
+ */
+EXPORT void
+set_draw_target_internal (void *image);
+
+
+/**
+ * Draws a rectangular portion of an image, scaled to fit a rectangle
+ * of a different size.
+ *
+ * This function is optional.  Transparent areas of the image must
+ * stay transparent.
+ *
+ * @param image         The image data.
+ * @param image_x       The X-coordinate of the left edge of the
+ *                      on-image rectangle.
+ * @param image_y       The Y-coordinate of the top edge of the
+ *                      on-image rectangle.
+ * @param image_width   The width of the on-image rectangle.
+ * @param image_height  The height of the on-image rectangle.
+ * @param screen_x      The X-coordinate of the left edge of the
+ *                      on-screen rectangle.
+ * @param screen_y      The Y-coordinate of the top edge of the
+ *                      on-screen rectangle.
+ * @param width         The width of the on-screen rectangle.
+ * @param height        The height of the on-screen rectangle.
+ */
+EXPORT void
+draw_image_scaled_internal (void *image,
+                            int16_t image_x,
+                            int16_t image_y,
+                            uint16_t image_width,
+                            uint16_t image_height,
+                            int16_t screen_x,
+                            int16_t screen_y,
+                            uint16_t width,
+                            uint16_t height);
+
+
+/**
+ * Works out the average colour of a rectangular portion of an image.
+ *
+ * This function is optional.  Transparent pixels, and any part of
+ * the rectangle outside the image, do not count towards the colour.
+ *
+ * @param image     The image data.
+ * @param image_x   The X-coordinate of the left edge of the
+ *                  rectangle.
+ * @param image_y   The Y-coordinate of the top edge of the rectangle.
+ * @param width     The width of the rectangle.
+ * @param height    The height of the rectangle.
+ * @param colour    Array in which to store the average red, green and
+ *                  blue of the opaque pixels, followed by the
+ *                  proportion of the rectangle that is opaque (0 to
+ *                  255).
+ */
+EXPORT void
+get_image_average_colour_internal (void *image,
+                                   int16_t image_x,
+                                   int16_t image_y,
+                                   uint16_t width,
+                                   uint16_t height,
+                                   uint8_t colour[4]);
+
+
+/**
+ * Sets the colour tint applied to the screen as it is presented.
+ *
+ * This function is optional.  The tint must not affect anything
+ * drawn later, nor images read back from the screen; only what is
+ * shown.  A changed tint applies to the whole screen from the next
+ * update onwards.
+ *
+ * @param red    Red multiplier, from 0 (none) to 255 (unchanged).
+ * @param green  Green multiplier, likewise.
+ * @param blue   Blue multiplier, likewise.
+ */
+EXPORT void
+set_tint_internal (uint8_t red, uint8_t green, uint8_t blue);
+
+
+/**
+ * Darkens a rectangle of what has already been drawn, on the screen
+ * or in the current drawing target.
+ *
+ * This function is optional.
+ *
+ * @param x           The X-coordinate of the left edge of the
+ *                    rectangle.
+ * @param y           The Y-coordinate of the top edge of the
+ *                    rectangle.
+ * @param width       The width of the rectangle.
+ * @param height      The height of the rectangle.
+ * @param brightness  Brightness to leave, from 0 (black) to 255
+ *                    (unchanged).
+ */
+EXPORT void
+shade_rect_internal (int16_t x,
+                     int16_t y,
+                     uint16_t width,
+                     uint16_t height,
+                     uint8_t brightness);
+
+
+/**
+ * Keeps the screen as last presented, to transition from.
+ *
+ * This function is optional, along with present_transition_internal
+ * and end_transition_internal; a module must provide all three or
+ * none.
+ *
+ * @return  true if the screen was kept; false otherwise.
+ */
+EXPORT bool
+begin_transition_internal (void);
+
+
+/**
+ * Updates the whole screen with a mix of the kept screen and what
+ * has been drawn since.  This is called instead of
+ * update_screen_internal while a transition is under way, and must
+ * clear any pending update rectangles in the same way.
+ *
+ * @param type      The style of transition.
+ * @param progress  How far through the transition to show, from 0
+ *                  (all kept screen) to TRANSITION_ONE (none).
+ */
+EXPORT void
+present_transition_internal (transition_type_t type, uint16_t progress);
+
+
+/**
+ * Frees the kept screen.  The next update must update the whole
+ * screen, to wipe away the transition.
+ */
+EXPORT void
+end_transition_internal (void);
+
+
+/**
+ * Presents the screen scaled up by a whole number, resizing the
+ * window to suit.
+ *
+ * This function is optional.  It is called straight after
+ * init_screen_internal, if at all.  Everything else still works in
+ * unscaled screen co-ordinates.
+ *
+ * @param scale   The scale, from 1 to 4.
+ * @param filter  The filter to scale with.  Modules may fall back to
+ *                OUTPUT_NEAREST for scales a filter does not suit.
+ *
+ * @return  true if the output is now scaled; false otherwise, in
+ *          which case the screen is still presented unscaled.
+ */
+EXPORT bool
+set_output_scale_internal (uint8_t scale, output_filter_t filter);
+
+
+/**
+ * Writes the screen as last presented to a PNG file, at the output
+ * scale and with any tint or transition applied.
+ *
+ * This function is optional.  It is only called while no drawing is
+ * going on.
+ *
+ * @param filename  Path of the file to write.
+ *
+ * @return  true if the file was written; false otherwise.
+ */
+EXPORT bool
+dump_screen_internal (const char filename[]);
+
+
+/**
+ * Says whether all drawing must be done on the thread that created
+ * the screen, for backends whose libraries tie their drawing state
+ * to one thread.  If so, no render thread is started, whatever the
+ * configuration asks for.
+ *
+ * This function is optional.
+ *
+ * @return  true if the render thread must not be used; false
+ *          otherwise.
+ */
+EXPORT bool
+is_thread_bound_internal (void);
+
+
 #endif /* _GFX_MODULE_H */
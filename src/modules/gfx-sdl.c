@@ -40,340 +40,2906 @@
  * @file    modules/gfx-sdl.c
  * @author  Matt Windsor
  * @brief   SDL implementation of graphics backend.
+ *
+ * Everything is drawn onto a shadow surface, which is then blitted
+ * to the screen on update.  The shadow surface is a ring (toroidal)
+ * buffer: the screen's top-left corner may lie anywhere within it,
+ * and drawing wraps around its edges.  Scrolling thus only moves
+ * that origin, and presenting any screen rectangle takes at most
+ * four blits.
+ *
+ * The ring is larger than the screen by a guard band on each side,
+ * so that drawing which hangs off the edge of the screen (for
+ * example, partially visible tiles) does not wrap around onto the
+ * opposite edge.
+ *
+ * Damaged rectangles are kept in a small fixed array, and each new
+ * one is merged with any it overlaps or touches when that costs no
+ * extra area.  Once the damage covers enough of the screen, the
+ * whole screen is flipped instead, so the cost of presenting follows
+ * the area damaged rather than the number of updates asked for.
+ *
+ * On machines with more than one processor, large batches of drawing
+ * commands are rasterised in parallel: the screen is split into
+ * horizontal bands, and each band is drawn by its own thread, which
+ * runs through the whole batch clipping each command to its band.
+ * All bands are finished before the batch call returns.
+ *
+ * A colour tint may be applied to the screen as it is presented:
+ * each updated rectangle is tinted on the screen surface after being
+ * copied from the shadow, which itself stays untinted.  For 32-bit
+ * screens the tint kernel uses AVX2 or SSE2 where the processor
+ * supports them, chosen at start-up.  The same kernels shade
+ * rectangles of the shadow for map lighting.
+ *
+ * For screen transitions, the screen as last presented is copied
+ * aside.  Each transition frame presents the whole shadow as usual,
+ * then lays the kept screen back over it: cross-faded by a blend
+ * kernel (again SSE2 or AVX2 for 32-bit screens), uncovered by
+ * straight blits for wipes, or sampled into solid blocks for
+ * mosaics.
+ *
+ * The window may be a whole number of times larger than the screen.
+ * The screen surface is then an ordinary surface, and each rectangle
+ * presented on it is scaled up into the window, by SSE2 kernels
+ * where available, so the cost of scaling follows the area updated.
+ */
+
+
+#include "module.h"
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_image.h>
+
+#include "gfx-module.h" /* Module header file. */
+
+/* The SIMD pixel kernels need GCC's per-function target attributes;
+   elsewhere only the scalar kernels are built. */
+#if defined (__GNUC__) \
+  && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) \
+  && (defined (__i386__) || defined (__x86_64__))
+#define PIXEL_SIMD
+#include <immintrin.h>
+#endif
+
+#undef G_LOG_DOMAIN
+#define G_LOG_DOMAIN "gfx-sdl"
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  RING_GUARD = 64,  /**< Width of the guard band around the screen
+                       area of the ring buffer, in pixels. */
+
+  MIN_PARALLEL_BATCH = 64,  /**< Smallest batch, in commands after
+                               merging, worth splitting into bands. */
+
+  MIN_BAND_HEIGHT = 32,  /**< Smallest height of a band, in pixels. */
+
+  TINT_ONE = 256,  /**< Tint multiplier that leaves a channel
+                      unchanged. */
+
+  MOSAIC_MAX_BLOCK = 32,  /**< Size of mosaic blocks half way through
+                             a mosaic transition, in pixels. */
+
+  MAX_DAMAGE_RECTS = 32,  /**< Most damaged rectangles kept apart;
+                             past this, new ones are merged into
+                             whichever grows least. */
+
+  FULL_FLIP_PERCENT = 50  /**< Share of the screen, in percent, past
+                             which damage is presented with one full
+                             flip. */
+};
+
+
+/**
+ * How an image's pixels use transparency, which decides the format
+ * it is kept in once loaded.
+ */
+typedef enum image_transparency
+{
+  IMAGE_OPAQUE,     /**< Every pixel is fully opaque. */
+  IMAGE_KEYED,      /**< Every pixel is either fully opaque or fully
+                       transparent, so a colour key will do. */
+  IMAGE_TRANSLUCENT /**< Some pixels are partly transparent, so the
+                       image needs an alpha channel. */
+} image_transparency_t;
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * A piece of a screen rectangle, as mapped onto the ring buffer.
+ */
+typedef struct ring_piece
+{
+  SDL_Rect screen;  /**< The piece's position on the screen. */
+  SDL_Rect ring;    /**< The piece's position in the ring buffer. */
+} ring_piece_t;
+
+
+/**
+ * A horizontal band of the screen to rasterise a batch into.
+ */
+typedef struct render_band
+{
+  draw_command_t *commands;  /**< The batch of commands. */
+  uint32_t count;            /**< Number of commands in the batch. */
+  int32_t top;               /**< Y co-ordinate of the top of the
+                                band, in pixels from the top of the
+                                screen. */
+  int32_t bottom;            /**< Y co-ordinate of the row below the
+                                bottom of the band. */
+  bool pooled;               /**< Whether the band is being rendered
+                                by the band pool. */
+} render_band_t;
+
+
+/* -- STATIC GLOBAL VARIABLES -- */
+
+static SDL_Surface *sg_screen; /**< The main screen surface. */
+
+static SDL_Surface *sg_window; /**< The video surface: sg_screen
+                                  itself if the output is unscaled,
+                                  sg_output_scale times its size
+                                  otherwise, or NULL if it could not
+                                  be made again after a failed
+                                  scale. */
+
+static int32_t sg_output_scale; /**< Size of the window relative to
+                                   the screen. */
+
+static output_filter_t sg_output_filter; /**< Filter used to scale
+                                            the screen up. */
+
+static SDL_Surface *sg_shadow; /**< The ring buffer everything is
+                                 * drawn onto. */
+
+static int32_t sg_ring_x; /**< X co-ordinate, in the ring buffer, of
+                             the left edge of the screen. */
+
+static int32_t sg_ring_y; /**< Y co-ordinate, in the ring buffer, of
+                             the top edge of the screen. */
+
+static SDL_Rect sg_damage[MAX_DAMAGE_RECTS]; /**< Damaged rectangles
+                                                to update on the
+                                                screen, clipped to it
+                                                and merged where they
+                                                overlap or touch. */
+
+static int sg_num_damage; /**< Number of damaged rectangles. */
+
+static uint32_t sg_damage_area; /**< Total area of the damaged
+                                   rectangles, in pixels. */
+
+static bool sg_update_full_screen; /**< If true then the entire
+                                      screen must be flipped on the
+                                      next frame. */
+
+static GThreadPool *sg_band_pool; /**< Pool of band rendering
+                                     threads, or NULL if bands are
+                                     not rendered in parallel. */
+
+static guint sg_num_bands; /**< Number of bands to split batches
+                              into. */
+
+static GMutex sg_band_mutex; /**< Guards sg_bands_pending. */
+
+static GCond sg_band_cond; /**< Signalled when a band finishes. */
+
+static guint sg_bands_pending; /**< Number of bands still being
+                                  rendered by the pool. */
+
+static SDL_Surface *sg_target; /**< The image being drawn into, or
+                                  NULL if drawing to the shadow
+                                  surface. */
+
+static GHashTable *sg_mapped_images; /**< Set of images that have
+                                        already been blitted onto the
+                                        shadow surface, and so can be
+                                        blitted from several threads
+                                        at once. */
+
+static uint16_t sg_tint[3]; /**< Red, green and blue tint
+                               multipliers, out of TINT_ONE. */
+
+static bool sg_tinted; /**< Whether the tint changes anything. */
+
+static void (*sg_tint_span) (Uint8 *pixels,
+                             uint32_t length,
+                             const uint16_t multipliers[4]);
+/**< The fastest tint kernel the processor supports. */
+
+static SDL_Surface *sg_transition_from; /**< Copy of the screen being
+                                           transitioned from, or NULL
+                                           if there is no transition
+                                           under way. */
+
+static void (*sg_blend_span) (Uint8 *pixels,
+                              const Uint8 *from,
+                              uint32_t length,
+                              uint16_t weight);
+/**< The fastest blend kernel the processor supports. */
+
+static void (*sg_scale_span) (Uint32 *out,
+                              const Uint32 *in,
+                              int32_t count,
+                              int32_t scale);
+/**< The fastest nearest-neighbour scaling kernel the processor
+   supports. */
+
+static void (*sg_scale2x_span) (Uint32 *top,
+                                Uint32 *bottom,
+                                const Uint32 *above,
+                                const Uint32 *row,
+                                const Uint32 *below,
+                                int32_t left,
+                                int32_t right,
+                                int32_t width);
+/**< The fastest Scale2x kernel the processor supports. */
+
+/**
+ * Copies a rectangle of the shadow onto the screen, tinting it.
+ *
+ * @param rect  The rectangle, in screen co-ordinates.
+ */
+static void
+update_rect_internal (const SDL_Rect *rect);
+
+
+/**
+ * Finds the rectangle bounding two others.
+ *
+ * @param first   The first rectangle.
+ * @param second  The second rectangle.
+ * @param bounds  Set to the rectangle bounding both.  This may be
+ *                either of the others.
+ *
+ * @return  the area of the bounding rectangle, in pixels.
+ */
+static uint32_t
+bound_rects (const SDL_Rect *first,
+             const SDL_Rect *second,
+             SDL_Rect *bounds);
+
+
+/**
+ * Checks whether two rectangles overlap or share an edge.
+ *
+ * @param first   The first rectangle.
+ * @param second  The second rectangle.
+ *
+ * @return  true if the rectangles overlap or touch; false otherwise.
+ */
+static bool
+rects_touch (const SDL_Rect *first, const SDL_Rect *second);
+
+
+/**
+ * Splits a screen rectangle into the pieces it occupies in the ring
+ * buffer.
+ *
+ * The rectangle is first clipped to the screen area, extended by
+ * the given margin on each side.
+ *
+ * @param x       X co-ordinate of the left edge of the rectangle,
+ *                in pixels from the left edge of the screen.
+ * @param y       Y co-ordinate of the top edge of the rectangle,
+ *                in pixels from the top edge of the screen.
+ * @param width   Width of the rectangle, in pixels.
+ * @param height  Height of the rectangle, in pixels.
+ * @param margin  Distance outside the screen area, in pixels, to
+ *                clip to.  This must be no more than RING_GUARD.
+ * @param pieces  Array of four pieces in which to store the result.
+ *
+ * @return  the number of pieces stored (0 to 4).
+ */
+static int
+split_ring_rect (int32_t x,
+                 int32_t y,
+                 int32_t width,
+                 int32_t height,
+                 int32_t margin,
+                 ring_piece_t pieces[4]);
+
+
+/**
+ * Wraps a ring buffer co-ordinate into the range [0, size).
+ *
+ * @param value  The co-ordinate to wrap.
+ * @param size   The size of the ring buffer along this axis.
+ *
+ * @return  the wrapped co-ordinate.
+ */
+static int32_t
+wrap_ring (int32_t value, int32_t size);
+
+
+/**
+ * Checks whether two image drawing commands can be merged into one
+ * blit, ie whether the second continues the first horizontally both
+ * on the image and on the screen.
+ *
+ * @param first   The earlier command.
+ * @param second  The later command.
+ *
+ * @return  true if the second command can be merged onto the end of
+ *          the first; false otherwise.
+ */
+static bool
+image_commands_adjacent (draw_command_t *first, draw_command_t *second);
+
+
+/**
+ * Checks whether two rectangle drawing commands can be merged into
+ * one fill, ie whether they share a colour and the second continues
+ * the first horizontally or vertically.
+ *
+ * @param first   The earlier command.
+ * @param second  The later command.
+ *
+ * @return  true if the second command can be merged onto the end of
+ *          the first; false otherwise.
+ */
+static bool
+rect_commands_adjacent (draw_command_t *first, draw_command_t *second);
+
+
+/**
+ * Merges neighbouring drawing commands in a batch, in place.
+ *
+ * @param commands  Array of drawing commands.
+ * @param count     Number of commands in the array.
+ *
+ * @return  the number of commands left after merging.
+ */
+static uint32_t
+merge_draw_commands (draw_command_t commands[], uint32_t count);
+
+
+/**
+ * Checks whether a batch of drawing commands may safely be split
+ * into bands and rendered in parallel.
+ *
+ * @param commands  Array of drawing commands.
+ * @param count     Number of commands in the array.
+ *
+ * @return  true if the batch can be rendered in parallel; false
+ *          otherwise.
+ */
+static bool
+can_render_in_bands (draw_command_t commands[], uint32_t count);
+
+
+/**
+ * Renders a batch of drawing commands, split into bands rendered in
+ * parallel, returning once all bands are finished.
+ *
+ * @param commands  Array of drawing commands.
+ * @param count     Number of commands in the array.
+ */
+static void
+render_in_bands (draw_command_t commands[], uint32_t count);
+
+
+/**
+ * Renders a batch of drawing commands clipped to one band.
+ *
+ * This is run by the band pool threads.
+ *
+ * @param band     Pointer to the band to render.
+ * @param ignored  Ignored.
+ */
+static void
+render_band (gpointer band, gpointer ignored);
+
+
+/**
+ * Executes one drawing command, clipped to a horizontal band.
+ *
+ * @param command  Pointer to the command to execute.
+ * @param top      Y co-ordinate of the top of the band.
+ * @param bottom   Y co-ordinate of the row below the band.
+ */
+static void
+execute_draw_command_in_band (draw_command_t *command,
+                              int32_t top,
+                              int32_t bottom);
+
+
+/**
+ * Reads a pixel from a locked surface.
+ *
+ * @param surface  The surface to read from.
+ * @param x        The X co-ordinate of the pixel.
+ * @param y        The Y co-ordinate of the pixel.
+ *
+ * @return  the pixel value, in the surface's format.
+ */
+static Uint32
+get_pixel (SDL_Surface *surface, int32_t x, int32_t y);
+
+
+/**
+ * Writes a pixel to a locked surface.
+ *
+ * @param surface  The surface to write to.
+ * @param x        The X co-ordinate of the pixel.
+ * @param y        The Y co-ordinate of the pixel.
+ * @param pixel    The pixel value, in the surface's format.
+ */
+static void
+put_pixel (SDL_Surface *surface, int32_t x, int32_t y, Uint32 pixel);
+
+
+/**
+ * Inspects the pixels of a freshly loaded image to find out how it
+ * uses transparency.
+ *
+ * @param surface  The image, as loaded.
+ *
+ * @return  the kind of transparency the image uses.
+ */
+static image_transparency_t
+classify_image (SDL_Surface *surface);
+
+
+/**
+ * Converts a freshly loaded image to the display format, choosing
+ * the fastest format that keeps its transparency.
+ *
+ * @param surface  The image, as loaded.  This is not freed.
+ *
+ * @return  the converted image, or NULL if it could not be
+ *          converted.
+ */
+static SDL_Surface *
+convert_image (SDL_Surface *surface);
+
+
+/**
+ * Converts an image with only fully opaque and fully transparent
+ * pixels to a colour-keyed, run-length encoded display format image.
+ *
+ * @param surface  The image, as loaded.  This is not freed.
+ *
+ * @return  the converted image, or NULL if every candidate key
+ *          colour is used by an opaque pixel.
+ */
+static SDL_Surface *
+convert_keyed_image (SDL_Surface *surface);
+
+
+/**
+ * Tints a span of 32-bit pixels in place, one byte at a time.
+ *
+ * @param pixels       The first byte of the span, which must be the
+ *                     first byte of a pixel.
+ * @param length       Length of the span, in bytes.
+ * @param multipliers  Multipliers, out of TINT_ONE, for each byte of
+ *                     a pixel.
+ */
+static void
+tint_span_scalar (Uint8 *pixels,
+                  uint32_t length,
+                  const uint16_t multipliers[4]);
+
+
+#ifdef PIXEL_SIMD
+/**
+ * Tints a span of 32-bit pixels in place, 16 bytes at a time, using
+ * SSE2.
+ *
+ * @param pixels       The first byte of the span, which must be the
+ *                     first byte of a pixel.
+ * @param length       Length of the span, in bytes.
+ * @param multipliers  Multipliers, out of TINT_ONE, for each byte of
+ *                     a pixel.
  */
+static void __attribute__ ((target ("sse2")))
+tint_span_sse2 (Uint8 *pixels,
+                uint32_t length,
+                const uint16_t multipliers[4]);
+
+
+/**
+ * Tints a span of 32-bit pixels in place, 32 bytes at a time, using
+ * AVX2.
+ *
+ * @param pixels       The first byte of the span, which must be the
+ *                     first byte of a pixel.
+ * @param length       Length of the span, in bytes.
+ * @param multipliers  Multipliers, out of TINT_ONE, for each byte of
+ *                     a pixel.
+ */
+static void __attribute__ ((target ("avx2")))
+tint_span_avx2 (Uint8 *pixels,
+                uint32_t length,
+                const uint16_t multipliers[4]);
+#endif /* PIXEL_SIMD */
+
+
+/**
+ * Tints a rectangle of a surface in place.
+ *
+ * @param surface  The surface to tint.
+ * @param rect     The rectangle to tint, already clipped to the
+ *                 surface.
+ * @param tint     Red, green and blue multipliers, out of TINT_ONE.
+ */
+static void
+tint_surface_rect (SDL_Surface *surface,
+                   SDL_Rect *rect,
+                   const uint16_t tint[3]);
+
+
+/**
+ * Blends a span of bytes towards another in place, one byte at a
+ * time.
+ *
+ * @param pixels  The span to blend, which keeps weight parts in
+ *                TRANSITION_ONE of its own value.
+ * @param from    The span to blend from.
+ * @param length  Length of the spans, in bytes.
+ * @param weight  Weight of pixels against from, out of
+ *                TRANSITION_ONE.
+ */
+static void
+blend_span_scalar (Uint8 *pixels,
+                   const Uint8 *from,
+                   uint32_t length,
+                   uint16_t weight);
+
+
+#ifdef PIXEL_SIMD
+/**
+ * Blends a span of bytes towards another in place, 16 bytes at a
+ * time, using SSE2.
+ *
+ * @param pixels  The span to blend.
+ * @param from    The span to blend from.
+ * @param length  Length of the spans, in bytes.
+ * @param weight  Weight of pixels against from, out of
+ *                TRANSITION_ONE.
+ */
+static void __attribute__ ((target ("sse2")))
+blend_span_sse2 (Uint8 *pixels,
+                 const Uint8 *from,
+                 uint32_t length,
+                 uint16_t weight);
+
+
+/**
+ * Blends a span of bytes towards another in place, 32 bytes at a
+ * time, using AVX2.
+ *
+ * @param pixels  The span to blend.
+ * @param from    The span to blend from.
+ * @param length  Length of the spans, in bytes.
+ * @param weight  Weight of pixels against from, out of
+ *                TRANSITION_ONE.
+ */
+static void __attribute__ ((target ("avx2")))
+blend_span_avx2 (Uint8 *pixels,
+                 const Uint8 *from,
+                 uint32_t length,
+                 uint16_t weight);
+#endif /* PIXEL_SIMD */
+
+
+/**
+ * Cross-fades the kept screen over the screen surface.
+ *
+ * @param progress  Weight of the screen surface against the kept
+ *                  screen, out of TRANSITION_ONE.
+ */
+static void
+fade_screen (uint16_t progress);
+
+
+/**
+ * Covers the part of the screen surface not yet wiped with the kept
+ * screen.
+ *
+ * @param progress  Proportion of the screen wiped, out of
+ *                  TRANSITION_ONE.
+ */
+static void
+wipe_screen (uint16_t progress);
+
+
+/**
+ * Replaces the screen surface with a mosaic of the kept screen, in
+ * the first half of the transition, or of itself, in the second.
+ *
+ * @param progress  Progress through the transition, out of
+ *                  TRANSITION_ONE.
+ */
+static void
+mosaic_screen (uint16_t progress);
+
+
+/**
+ * Shows the whole screen in the window.
+ */
+static void
+present_full_screen (void);
+
+
+/**
+ * Shows rectangles of the screen in the window.
+ *
+ * @param rects  The rectangles, in screen co-ordinates.  If the
+ *               output is scaled, these are overwritten.
+ * @param count  The number of rectangles.
+ */
+static void
+present_rects (SDL_Rect rects[], int count);
+
+
+/**
+ * Scales a rectangle of the screen up into the window.
+ *
+ * @param rect  The rectangle, in screen co-ordinates.  On return,
+ *              this holds the rectangle of the window that was
+ *              written to, which may be larger, or empty.
+ */
+static void
+scale_rect_to_window (SDL_Rect *rect);
+
+
+/**
+ * Repeats each of a span of 32-bit pixels, one at a time.
+ *
+ * @param out    Where to write count * scale pixels.
+ * @param in     The pixels to scale.
+ * @param count  Number of pixels to scale.
+ * @param scale  Times to repeat each pixel, from 1 to 4.
+ */
+static void
+scale_span_scalar (Uint32 *out,
+                   const Uint32 *in,
+                   int32_t count,
+                   int32_t scale);
+
+
+/**
+ * Applies the Scale2x rules to a span of 32-bit pixels, one at a
+ * time.
+ *
+ * @param top     The output row for the top halves of the pixels.
+ * @param bottom  The output row for the bottom halves.
+ * @param above   The row above the input row, or the input row at
+ *                the top of the screen.
+ * @param row     The input row.
+ * @param below   The row below the input row, or the input row at
+ *                the bottom of the screen.
+ * @param left    Index of the first pixel to scale.
+ * @param right   Index after the last pixel to scale.
+ * @param width   Length of the rows.
+ */
+static void
+scale2x_span_scalar (Uint32 *top,
+                     Uint32 *bottom,
+                     const Uint32 *above,
+                     const Uint32 *row,
+                     const Uint32 *below,
+                     int32_t left,
+                     int32_t right,
+                     int32_t width);
+
+
+#ifdef PIXEL_SIMD
+/**
+ * Repeats each of a span of 32-bit pixels, four pixels at a time,
+ * using SSE2.
+ *
+ * @param out    Where to write count * scale pixels.
+ * @param in     The pixels to scale.
+ * @param count  Number of pixels to scale.
+ * @param scale  Times to repeat each pixel, from 1 to 4.
+ */
+static void __attribute__ ((target ("sse2")))
+scale_span_sse2 (Uint32 *out,
+                 const Uint32 *in,
+                 int32_t count,
+                 int32_t scale);
+
+
+/**
+ * Applies the Scale2x rules to a span of 32-bit pixels, four pixels
+ * at a time, using SSE2.
+ *
+ * @param top     The output row for the top halves of the pixels.
+ * @param bottom  The output row for the bottom halves.
+ * @param above   The row above the input row.
+ * @param row     The input row.
+ * @param below   The row below the input row.
+ * @param left    Index of the first pixel to scale.
+ * @param right   Index after the last pixel to scale.
+ * @param width   Length of the rows.
+ */
+static void __attribute__ ((target ("sse2")))
+scale2x_span_sse2 (Uint32 *top,
+                   Uint32 *bottom,
+                   const Uint32 *above,
+                   const Uint32 *row,
+                   const Uint32 *below,
+                   int32_t left,
+                   int32_t right,
+                   int32_t width);
+#endif /* PIXEL_SIMD */
+
+
+/* -- DEFINITIONS -- */
+
+/* Initialises the module. */
+EXPORT bool
+init (void)
+{
+  sg_screen = NULL;
+  sg_shadow = NULL;
+  sg_ring_x = sg_ring_y = RING_GUARD;
+  sg_num_damage = 0;
+  sg_damage_area = 0;
+  sg_update_full_screen = false;
+  sg_band_pool = NULL;
+  sg_num_bands = 1;
+  sg_bands_pending = 0;
+  sg_mapped_images = NULL;
+  sg_target = NULL;
+  sg_tint[0] = sg_tint[1] = sg_tint[2] = TINT_ONE;
+  sg_tinted = false;
+  sg_tint_span = tint_span_scalar;
+  sg_blend_span = blend_span_scalar;
+  sg_transition_from = NULL;
+  sg_window = NULL;
+  sg_output_scale = 1;
+  sg_output_filter = OUTPUT_NEAREST;
+  sg_scale_span = scale_span_scalar;
+  sg_scale2x_span = scale2x_span_scalar;
+
+  return true;
+}
+
+
+/* Terminates the module, freeing any remaining data dynamically
+   allocated by the module. */
+EXPORT void
+term (void)
+{
+  if (sg_screen)
+    {
+      if (sg_shadow)
+        {
+          SDL_FreeSurface (sg_shadow);
+        }
+
+      if (sg_band_pool)
+        {
+          g_thread_pool_free (sg_band_pool, FALSE, TRUE);
+          sg_band_pool = NULL;
+
+          g_mutex_clear (&sg_band_mutex);
+          g_cond_clear (&sg_band_cond);
+        }
+
+      if (sg_mapped_images)
+        {
+          g_hash_table_destroy (sg_mapped_images);
+          sg_mapped_images = NULL;
+        }
+
+      /* A scaled output's screen is ours; the window is SDL's. */
+      if (sg_window != sg_screen)
+        SDL_FreeSurface (sg_screen);
+
+      IMG_Quit ();
+      SDL_Quit ();
+    }
+}
+
+
+/* Initialises a screen of a given width, height and depth. */
+EXPORT bool
+init_screen_internal (uint16_t width, uint16_t height, uint8_t depth)
+{
+  if (SDL_Init (SDL_INIT_VIDEO) != 0)
+    {
+      g_critical ("Could not initialise SDL");
+      return false;
+    }
+
+  /* SDL_image loads its PNG support on first use, which is not safe
+     if the first use is from several preloading threads at once. */
+  if ((IMG_Init (IMG_INIT_PNG) & IMG_INIT_PNG) == 0)
+    g_warning ("Could not initialise PNG loading early.");
+
+   sg_screen = SDL_SetVideoMode (width, height, depth, SDL_HWSURFACE);
+   if (sg_screen == NULL)
+     {
+       g_critical ("Could not init screen.");
+       SDL_Quit ();
+       return false;
+     }
+
+   sg_window = sg_screen;
+
+   {
+     SDL_PixelFormat *format = sg_screen->format;
+     SDL_Surface *ring;
+
+     ring = SDL_CreateRGBSurface (SDL_SWSURFACE,
+                                  width + (2 * RING_GUARD),
+                                  height + (2 * RING_GUARD),
+                                  format->BitsPerPixel,
+                                  format->Rmask,
+                                  format->Gmask,
+                                  format->Bmask,
+                                  format->Amask);
+     if (ring == NULL)
+       {
+         g_critical ("Could not make shadowbuf.");
+         SDL_Quit ();
+         return false;
+       }
+
+     sg_shadow = SDL_DisplayFormat (ring);
+     SDL_FreeSurface (ring);
+   }
+
+   if (sg_shadow == NULL)
+     {
+       g_critical ("Could not make shadowbuf.");
+       SDL_Quit ();
+       return false;
+     }
+
+   SDL_FillRect (sg_shadow, NULL, SDL_MapRGB (sg_shadow->format,
+                                              0, 0, 0));
+
+   sg_mapped_images = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+   /* Pick the fastest tint kernel this processor can run. */
+   sg_tint_span = tint_span_scalar;
+   sg_blend_span = blend_span_scalar;
+#ifdef PIXEL_SIMD
+   __builtin_cpu_init ();
+   if (__builtin_cpu_supports ("avx2"))
+     {
+       sg_tint_span = tint_span_avx2;
+       sg_blend_span = blend_span_avx2;
+     }
+   else if (__builtin_cpu_supports ("sse2"))
+     {
+       sg_tint_span = tint_span_sse2;
+       sg_blend_span = blend_span_sse2;
+     }
+
+   /* Scaling is bound by memory bandwidth well before SSE2 runs out
+      of arithmetic, so AVX2 would gain little here. */
+   if (__builtin_cpu_supports ("sse2"))
+     {
+       sg_scale_span = scale_span_sse2;
+       sg_scale2x_span = scale2x_span_sse2;
+     }
+#endif /* PIXEL_SIMD */
+
+   /* The calling thread renders one band itself, so the pool needs
+      one fewer thread than there are bands. */
+   sg_num_bands = g_get_num_processors ();
+   if (sg_num_bands > 1)
+     {
+       g_mutex_init (&sg_band_mutex);
+       g_cond_init (&sg_band_cond);
+
+       sg_band_pool = g_thread_pool_new (render_band, NULL,
+                                         (gint) sg_num_bands - 1,
+                                         TRUE, NULL);
+       if (sg_band_pool == NULL)
+         {
+           g_mutex_clear (&sg_band_mutex);
+           g_cond_clear (&sg_band_cond);
+           sg_num_bands = 1;
+         }
+     }
+
+  return true;
+}
+
+
+/* Draws a rectangle of colour on-screen. */
+EXPORT void
+draw_rect_internal (int16_t x,
+                    int16_t y,
+                    uint16_t width,
+                    uint16_t height,
+                    uint8_t red,
+                    uint8_t green,
+                    uint8_t blue)
+{
+  ring_piece_t pieces[4];
+  Uint32 colour;
+  int count;
+  int i;
+
+  if (sg_target != NULL)
+    {
+      SDL_Rect rect;
+
+      rect.x = x;
+      rect.y = y;
+      rect.w = width;
+      rect.h = height;
+
+      SDL_FillRect (sg_target, &rect, SDL_MapRGB (sg_target->format,
+                                                  red, green, blue));
+      return;
+    }
+
+  colour = SDL_MapRGB (sg_shadow->format, red, green, blue);
+  count = split_ring_rect (x, y, width, height, RING_GUARD, pieces);
+
+  for (i = 0; i < count; i += 1)
+    SDL_FillRect (sg_shadow, &(pieces[i].ring), colour);
+}
+
+
+/* Loads an image and returns its data in the module's native format. */
+
+EXPORT void *
+load_image_data (const char filename[])
+{
+  SDL_Surface *surface;
+  SDL_Surface *converted;
+
+  surface = IMG_Load (filename);
+  if (surface == NULL)
+    {
+      g_critical ("Couldn't load %s!", filename);
+      return NULL;
+    }
+
+  /* Convert once here rather than on every blit; if that fails the
+     raw surface still draws, only more slowly. */
+  converted = convert_image (surface);
+  if (converted != NULL)
+    {
+      SDL_FreeSurface (surface);
+      surface = converted;
+    }
+
+  return (void *) surface;
+}
+
+
+/* Frees image data retrieved by load_image_data. */
+EXPORT void
+free_image_data (void *data)
+{
+  if (data)
+    {
+      if (sg_mapped_images)
+        g_hash_table_remove (sg_mapped_images, data);
+
+      SDL_FreeSurface(data);
+    }
+}
+
+
+/* Retrieves the dimensions of an image. */
+EXPORT void
+get_image_dimensions_internal (void *image,
+                               uint16_t *width,
+                               uint16_t *height)
+{
+  SDL_Surface *surface = (SDL_Surface *) image;
+
+  g_assert (surface != NULL);
+
+  *width = (uint16_t) surface->w;
+  *height = (uint16_t) surface->h;
+}
+
+
+/* Retrieves the amount of memory an image's pixels take up. */
+EXPORT uint32_t
+get_image_bytes_internal (void *image)
+{
+  SDL_Surface *surface = (SDL_Surface *) image;
+
+  g_assert (surface != NULL);
+
+  return (uint32_t) surface->pitch * (uint32_t) surface->h;
+}
+
+
+/* Draws a rectangular portion of an image on-screen. */
+EXPORT void
+draw_image_internal (void *image,
+                     int16_t image_x,
+                     int16_t image_y,
+                     int16_t screen_x,
+                     int16_t screen_y,
+                     uint16_t width,
+                     uint16_t height)
+{
+  ring_piece_t pieces[4];
+  SDL_Rect srcrect;
+  SDL_Surface *ptex;
+  int count;
+  int i;
+
+  ptex = (SDL_Surface*) image;
+  g_assert (ptex != NULL);
+
+  if (sg_target != NULL)
+    {
+      SDL_Rect destrect;
+
+      srcrect.x = image_x;
+      srcrect.y = image_y;
+      destrect.x = screen_x;
+      destrect.y = screen_y;
+      srcrect.w = destrect.w = width;
+      srcrect.h = destrect.h = height;
+
+      /* Into a transparent target, copy alpha rather than blending
+         with it, so the target keeps the image's transparency. */
+      if (sg_target->format->Amask != 0 && (ptex->flags & SDL_SRCALPHA))
+        {
+          Uint8 alpha = ptex->format->alpha;
+
+          SDL_SetAlpha (ptex, 0, SDL_ALPHA_OPAQUE);
+          SDL_BlitSurface (ptex, &srcrect, sg_target, &destrect);
+          SDL_SetAlpha (ptex, SDL_SRCALPHA, alpha);
+        }
+      else
+        SDL_BlitSurface (ptex, &srcrect, sg_target, &destrect);
+
+      /* SDL now has this image's blit set up for the target instead
+         of the shadow. */
+      g_hash_table_remove (sg_mapped_images, ptex);
+      return;
+    }
+
+  count = split_ring_rect (screen_x, screen_y, width, height,
+                           RING_GUARD, pieces);
+
+  for (i = 0; i < count; i += 1)
+    {
+      srcrect.x = (Sint16) (image_x + (pieces[i].screen.x - screen_x));
+      srcrect.y = (Sint16) (image_y + (pieces[i].screen.y - screen_y));
+      srcrect.w = pieces[i].screen.w;
+      srcrect.h = pieces[i].screen.h;
+
+      SDL_BlitSurface (ptex, &srcrect, sg_shadow, &(pieces[i].ring));
+    }
+}
+
+
+/* Creates a blank image to draw into. */
+EXPORT void *
+create_image_data (uint16_t width, uint16_t height, bool transparent)
+{
+  SDL_PixelFormat *format = sg_shadow->format;
+  SDL_Surface *surface;
+
+  if (transparent)
+    {
+      surface = SDL_CreateRGBSurface (SDL_SWSURFACE | SDL_SRCALPHA,
+                                      width, height, 32,
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+                                      0xFF000000, 0x00FF0000,
+                                      0x0000FF00, 0x000000FF
+#else
+                                      0x000000FF, 0x0000FF00,
+                                      0x00FF0000, 0xFF000000
+#endif
+                                      );
+      if (surface == NULL)
+        {
+          g_critical ("Couldn't create %ux%u image!", width, height);
+          return NULL;
+        }
+
+      SDL_FillRect (surface, NULL,
+                    SDL_MapRGBA (surface->format, 0, 0, 0,
+                                 SDL_ALPHA_TRANSPARENT));
+      return (void *) surface;
+    }
+
+  surface = SDL_CreateRGBSurface (SDL_SWSURFACE, width, height,
+                                  format->BitsPerPixel,
+                                  format->Rmask,
+                                  format->Gmask,
+                                  format->Bmask,
+                                  format->Amask);
+  if (surface == NULL)
+    {
+      g_critical ("Couldn't create %ux%u image!", width, height);
+      return NULL;
+    }
+
+  SDL_FillRect (surface, NULL, SDL_MapRGB (surface->format, 0, 0, 0));
+  return (void *) surface;
+}
+
+
+/* Redirects drawing into an image, or back to the screen. */
+EXPORT void
+set_draw_target_internal (void *image)
+{
+  sg_target = (SDL_Surface *) image;
+}
+
+
+/* Draws a rectangular portion of an image, scaled. */
+EXPORT void
+draw_image_scaled_internal (void *image,
+                            int16_t image_x,
+                            int16_t image_y,
+                            uint16_t image_width,
+                            uint16_t image_height,
+                            int16_t screen_x,
+                            int16_t screen_y,
+                            uint16_t width,
+                            uint16_t height)
+{
+  SDL_Surface *source = (SDL_Surface *) image;
+  SDL_Surface *dest = (sg_target != NULL ? sg_target : sg_shadow);
+  ring_piece_t pieces[4];
+  int count;
+  int i;
+
+  g_assert (source != NULL);
+
+  if (width == 0 || height == 0)
+    return;
+
+  if (sg_target != NULL)
+    {
+      /* Clip to the target directly; there is no ring to wrap. */
+      int32_t left = MAX (screen_x, 0);
+      int32_t top = MAX (screen_y, 0);
+      int32_t right = MIN (screen_x + width, sg_target->w);
+      int32_t bottom = MIN (screen_y + height, sg_target->h);
+
+      if (right <= left || bottom <= top)
+        return;
+
+      pieces[0].screen.x = pieces[0].ring.x = (Sint16) left;
+      pieces[0].screen.y = pieces[0].ring.y = (Sint16) top;
+      pieces[0].screen.w = pieces[0].ring.w = (Uint16) (right - left);
+      pieces[0].screen.h = pieces[0].ring.h = (Uint16) (bottom - top);
+      count = 1;
+    }
+  else
+    count = split_ring_rect (screen_x, screen_y, width, height,
+                             RING_GUARD, pieces);
+
+  if (SDL_MUSTLOCK (source))
+    SDL_LockSurface (source);
+  if (SDL_MUSTLOCK (dest))
+    SDL_LockSurface (dest);
+
+  /* Nearest-neighbour sampling; pixels that are colour-keyed out or
+     mostly transparent are skipped. */
+  for (i = 0; i < count; i += 1)
+    {
+      int32_t px;
+      int32_t py;
+
+      for (py = 0; py < pieces[i].screen.h; py += 1)
+        {
+          int32_t sy = image_y + ((((pieces[i].screen.y + py) - screen_y)
+                                   * image_height) / height);
+
+          for (px = 0; px < pieces[i].screen.w; px += 1)
+            {
+              int32_t sx = image_x + ((((pieces[i].screen.x + px)
+                                        - screen_x)
+                                       * image_width) / width);
+              Uint32 pixel;
+              Uint8 r, g, b, a;
+
+              if (sx < 0 || sy < 0 || sx >= source->w || sy >= source->h)
+                continue;
+
+              pixel = get_pixel (source, sx, sy);
+
+              if ((source->flags & SDL_SRCCOLORKEY)
+                  && pixel == source->format->colorkey)
+                continue;
+
+              SDL_GetRGBA (pixel, source->format, &r, &g, &b, &a);
+              if (source->format->Amask != 0 && a < 128)
+                continue;
+
+              put_pixel (dest,
+                         pieces[i].ring.x + px,
+                         pieces[i].ring.y + py,
+                         SDL_MapRGB (dest->format, r, g, b));
+            }
+        }
+    }
+
+  if (SDL_MUSTLOCK (dest))
+    SDL_UnlockSurface (dest);
+  if (SDL_MUSTLOCK (source))
+    SDL_UnlockSurface (source);
+}
+
+
+/* Works out the average colour of a rectangular portion of an
+   image. */
+EXPORT void
+get_image_average_colour_internal (void *image,
+                                   int16_t image_x,
+                                   int16_t image_y,
+                                   uint16_t width,
+                                   uint16_t height,
+                                   uint8_t colour[4])
+{
+  SDL_Surface *source = (SDL_Surface *) image;
+  int32_t left = MAX (image_x, 0);
+  int32_t top = MAX (image_y, 0);
+  int32_t right;
+  int32_t bottom;
+  uint32_t totals[3] = { 0, 0, 0 };
+  uint32_t opaque = 0;
+  int32_t x;
+  int32_t y;
+
+  g_assert (source != NULL);
+  g_assert (colour != NULL);
+
+  colour[0] = colour[1] = colour[2] = colour[3] = 0;
+
+  right = MIN (image_x + width, source->w);
+  bottom = MIN (image_y + height, source->h);
+  if (right <= left || bottom <= top)
+    return;
+
+  if (SDL_MUSTLOCK (source))
+    SDL_LockSurface (source);
+
+  for (y = top; y < bottom; y += 1)
+    for (x = left; x < right; x += 1)
+      {
+        Uint32 pixel = get_pixel (source, x, y);
+        Uint8 r, g, b, a;
+
+        if ((source->flags & SDL_SRCCOLORKEY)
+            && pixel == source->format->colorkey)
+          continue;
+
+        SDL_GetRGBA (pixel, source->format, &r, &g, &b, &a);
+        if (source->format->Amask != 0 && a < 128)
+          continue;
+
+        totals[0] += r;
+        totals[1] += g;
+        totals[2] += b;
+        opaque += 1;
+      }
+
+  if (SDL_MUSTLOCK (source))
+    SDL_UnlockSurface (source);
+
+  if (opaque == 0)
+    return;
+
+  colour[0] = (uint8_t) (totals[0] / opaque);
+  colour[1] = (uint8_t) (totals[1] / opaque);
+  colour[2] = (uint8_t) (totals[2] / opaque);
+  colour[3] = (uint8_t) ((opaque * 255) / ((uint32_t) width * height));
+}
+
+
+/* Sets the colour tint applied to the screen as it is presented. */
+EXPORT void
+set_tint_internal (uint8_t red, uint8_t green, uint8_t blue)
+{
+  uint16_t tint[3];
+
+  /* Scale 0-255 to 0-TINT_ONE, so that 255 is exactly unchanged. */
+  tint[0] = (uint16_t) (red + (red >> 7));
+  tint[1] = (uint16_t) (green + (green >> 7));
+  tint[2] = (uint16_t) (blue + (blue >> 7));
+
+  if (tint[0] == sg_tint[0]
+      && tint[1] == sg_tint[1]
+      && tint[2] == sg_tint[2])
+    return;
+
+  sg_tint[0] = tint[0];
+  sg_tint[1] = tint[1];
+  sg_tint[2] = tint[2];
+  sg_tinted = (tint[0] != TINT_ONE
+               || tint[1] != TINT_ONE
+               || tint[2] != TINT_ONE);
+
+  /* Everything on-screen was tinted with the old tint. */
+  sg_update_full_screen = true;
+}
+
+
+/* Darkens a rectangle of what has already been drawn. */
+EXPORT void
+shade_rect_internal (int16_t x,
+                     int16_t y,
+                     uint16_t width,
+                     uint16_t height,
+                     uint8_t brightness)
+{
+  uint16_t tint[3];
+  ring_piece_t pieces[4];
+  int count;
+  int i;
+
+  tint[0] = tint[1] = tint[2] = (uint16_t) (brightness
+                                            + (brightness >> 7));
+
+  if (sg_target != NULL)
+    {
+      SDL_Rect rect;
+      int32_t left = MAX (x, 0);
+      int32_t top = MAX (y, 0);
+      int32_t right = MIN (x + width, sg_target->w);
+      int32_t bottom = MIN (y + height, sg_target->h);
+
+      if (right <= left || bottom <= top)
+        return;
+
+      rect.x = (Sint16) left;
+      rect.y = (Sint16) top;
+      rect.w = (Uint16) (right - left);
+      rect.h = (Uint16) (bottom - top);
+
+      tint_surface_rect (sg_target, &rect, tint);
+      return;
+    }
+
+  count = split_ring_rect (x, y, width, height, RING_GUARD, pieces);
+
+  for (i = 0; i < count; i += 1)
+    tint_surface_rect (sg_shadow, &(pieces[i].ring), tint);
+}
+
+
+/* Keeps the screen as last presented, to transition from. */
+EXPORT bool
+begin_transition_internal (void)
+{
+  end_transition_internal ();
+
+  /* The copy has the screen's format, so the kernels can run over
+     both surfaces' bytes in step. */
+  sg_transition_from = SDL_ConvertSurface (sg_screen, sg_screen->format,
+                                           SDL_SWSURFACE);
+  if (sg_transition_from == NULL)
+    {
+      g_warning ("Could not keep the screen for a transition.");
+      return false;
+    }
+
+  return true;
+}
+
+
+/* Updates the whole screen with a mix of the kept screen and what has
+   been drawn since. */
+EXPORT void
+present_transition_internal (transition_type_t type, uint16_t progress)
+{
+  SDL_Rect full;
+
+  g_assert (sg_transition_from != NULL);
+
+  full.x = full.y = 0;
+  full.w = (Uint16) sg_screen->w;
+  full.h = (Uint16) sg_screen->h;
+  update_rect_internal (&full);
+
+  sg_num_damage = 0;
+  sg_damage_area = 0;
+
+  if (progress < TRANSITION_ONE)
+    switch (type)
+      {
+      case TRANSITION_WIPE:
+        wipe_screen (progress);
+        break;
+      case TRANSITION_MOSAIC:
+        mosaic_screen (progress);
+        break;
+      case TRANSITION_FADE:
+      default:
+        fade_screen (progress);
+        break;
+      }
+
+  present_full_screen ();
+}
+
+
+/* Presents the screen scaled up by a whole number. */
+EXPORT bool
+set_output_scale_internal (uint8_t scale, output_filter_t filter)
+{
+  SDL_Surface *window;
+  SDL_Surface *screen;
+  int32_t width = sg_screen->w;
+  int32_t height = sg_screen->h;
+  int bpp = sg_screen->format->BitsPerPixel;
+
+  g_assert (scale >= 1 && scale <= 4);
+  g_assert (sg_window == sg_screen);
+
+  if (scale == 1)
+    return true;
+
+  /* The scaling kernels work on whole 32-bit pixels. */
+  if (sg_screen->format->BytesPerPixel != 4)
+    {
+      g_warning ("Only 32-bit screens can be scaled.");
+      return false;
+    }
+
+  /* The screen surface is made first, so that the window is left
+     alone if it cannot be. */
+  screen = SDL_CreateRGBSurface (SDL_SWSURFACE, width, height, bpp,
+                                 sg_screen->format->Rmask,
+                                 sg_screen->format->Gmask,
+                                 sg_screen->format->Bmask,
+                                 sg_screen->format->Amask);
+  if (screen == NULL)
+    {
+      g_warning ("Could not make a screen surface to scale.");
+      return false;
+    }
+
+  window = SDL_SetVideoMode (width * scale, height * scale, bpp,
+                             SDL_HWSURFACE);
+  if (window == NULL
+      || window->format->BytesPerPixel != 4
+      || window->format->Rmask != screen->format->Rmask
+      || window->format->Gmask != screen->format->Gmask
+      || window->format->Bmask != screen->format->Bmask)
+    {
+      g_warning ("Could not make a scaled window.");
+
+      /* Setting a video mode replaces the old window, so the
+         unscaled one has to be made again. */
+      window = SDL_SetVideoMode (width, height, bpp, SDL_HWSURFACE);
+      if (window == NULL)
+        {
+          g_critical ("Could not get the unscaled window back.");
+
+          /* Keep drawing into memory, with nothing to present to,
+             rather than into the lost window. */
+          sg_screen = screen;
+          sg_window = NULL;
+          return false;
+        }
+
+      SDL_FreeSurface (screen);
+      sg_screen = sg_window = window;
+      return false;
+    }
+
+  sg_window = window;
+  sg_screen = screen;
+  sg_output_scale = scale;
+
+  /* Scale2x only makes sense at twice the size. */
+  sg_output_filter = (scale == 2 ? filter : OUTPUT_NEAREST);
+  if (filter != sg_output_filter)
+    g_message ("Scale2x needs a scale of 2; scaling by repeating"
+               " pixels instead.");
+
+  sg_update_full_screen = true;
+
+  return true;
+}
+
+
+/* Frees the kept screen. */
+EXPORT void
+end_transition_internal (void)
+{
+  if (sg_transition_from != NULL)
+    {
+      SDL_FreeSurface (sg_transition_from);
+      sg_transition_from = NULL;
+      sg_update_full_screen = true;
+    }
+}
+
+
+/* Draws a batch of drawing commands, in order. */
+EXPORT void
+draw_batch_internal (draw_command_t commands[], uint32_t count)
+{
+  uint32_t i;
+
+  count = merge_draw_commands (commands, count);
+
+  if (can_render_in_bands (commands, count))
+    {
+      render_in_bands (commands, count);
+      return;
+    }
+
+  for (i = 0; i < count; i += 1)
+    {
+      if (commands[i].type == DRAW_COMMAND_IMAGE)
+        {
+          draw_image_internal (commands[i].image,
+                               commands[i].image_x,
+                               commands[i].image_y,
+                               commands[i].screen_x,
+                               commands[i].screen_y,
+                               commands[i].width,
+                               commands[i].height);
+
+          /* SDL has now set up the blit from this image to the
+             shadow, so later batches can use it from any thread. */
+          if (sg_target == NULL)
+            g_hash_table_insert (sg_mapped_images, commands[i].image,
+                                 commands[i].image);
+        }
+      else
+        draw_rect_internal (commands[i].screen_x,
+                            commands[i].screen_y,
+                            commands[i].width,
+                            commands[i].height,
+                            commands[i].red,
+                            commands[i].green,
+                            commands[i].blue);
+    }
+}
+
+
+/* Merges neighbouring drawing commands in a batch, in place. */
+static uint32_t
+merge_draw_commands (draw_command_t commands[], uint32_t count)
+{
+  uint32_t merged;
+  uint32_t i;
+
+  if (count == 0)
+    return 0;
+
+  /* Run-length merge neighbouring commands, so that eg a row of
+     tiles sourced from a contiguous strip of the tileset becomes a
+     single blit. */
+  merged = 0;
+
+  for (i = 1; i < count; i += 1)
+    {
+      draw_command_t *current = &(commands[merged]);
+      draw_command_t *next = &(commands[i]);
+
+      if (current->type == DRAW_COMMAND_IMAGE
+          && image_commands_adjacent (current, next))
+        current->width += next->width;
+      else if (current->type == DRAW_COMMAND_RECT
+               && rect_commands_adjacent (current, next))
+        {
+          if (next->screen_y == current->screen_y)
+            current->width += next->width;
+          else
+            current->height += next->height;
+        }
+      else
+        {
+          merged += 1;
+          commands[merged] = *next;
+        }
+    }
+
+  return merged + 1;
+}
+
+
+/* Checks whether two image drawing commands can be merged. */
+static bool
+image_commands_adjacent (draw_command_t *first, draw_command_t *second)
+{
+  return (second->type == DRAW_COMMAND_IMAGE
+          && second->image == first->image
+          && second->image_y == first->image_y
+          && second->screen_y == first->screen_y
+          && second->height == first->height
+          && second->image_x == first->image_x + first->width
+          && second->screen_x == first->screen_x + first->width
+          && (uint32_t) first->width + second->width <= USHRT_MAX);
+}
+
+
+/* Checks whether two rectangle drawing commands can be merged. */
+static bool
+rect_commands_adjacent (draw_command_t *first, draw_command_t *second)
+{
+  if (second->type != DRAW_COMMAND_RECT
+      || second->red != first->red
+      || second->green != first->green
+      || second->blue != first->blue)
+    return false;
+
+  /* Horizontal continuation. */
+  if (second->screen_y == first->screen_y
+      && second->height == first->height
+      && second->screen_x == first->screen_x + first->width
+      && (uint32_t) first->width + second->width <= USHRT_MAX)
+    return true;
+
+  /* Vertical continuation. */
+  if (second->screen_x == first->screen_x
+      && second->width == first->width
+      && second->screen_y == first->screen_y + first->height
+      && (uint32_t) first->height + second->height <= USHRT_MAX)
+    return true;
+
+  return false;
+}
+
+
+/* Adds a rectangle to the next update run. */
+EXPORT void
+add_update_rectangle_internal (int16_t x,
+                               int16_t y,
+                               uint16_t width,
+                               uint16_t height)
+{
+  SDL_Rect rect;
+  SDL_Rect bounds;
+  int32_t left = MAX (x, 0);
+  int32_t top = MAX (y, 0);
+  int32_t right = MIN (x + width, sg_screen->w);
+  int32_t bottom = MIN (y + height, sg_screen->h);
+  uint32_t screen_area = (uint32_t) sg_screen->w * (uint32_t) sg_screen->h;
+  int i;
+
+  if (sg_update_full_screen || right <= left || bottom <= top)
+    return;
+
+  rect.x = (Sint16) left;
+  rect.y = (Sint16) top;
+  rect.w = (Uint16) (right - left);
+  rect.h = (Uint16) (bottom - top);
+
+  /* Take in every rectangle this one overlaps or touches, as long as
+     their bounds cost no more to present than the two apart.  Each
+     merge grows the rectangle, which may then reach others, so look
+     again from the start. */
+  i = 0;
+  while (i < sg_num_damage)
+    {
+      SDL_Rect *other = &(sg_damage[i]);
+      uint32_t other_area = (uint32_t) other->w * other->h;
+
+      if (rects_touch (&rect, other)
+          && (bound_rects (&rect, other, &bounds)
+              <= ((uint32_t) rect.w * rect.h) + other_area))
+        {
+          sg_damage_area -= other_area;
+          sg_num_damage -= 1;
+          sg_damage[i] = sg_damage[sg_num_damage];
+          rect = bounds;
+          i = 0;
+        }
+      else
+        i += 1;
+    }
+
+  if (sg_num_damage < MAX_DAMAGE_RECTS)
+    {
+      sg_damage[sg_num_damage] = rect;
+      sg_num_damage += 1;
+      sg_damage_area += (uint32_t) rect.w * rect.h;
+    }
+  else
+    {
+      /* Out of room, so grow whichever rectangle takes this one in
+         for the least extra area. */
+      uint32_t best_growth = screen_area;
+      int best = 0;
+
+      for (i = 0; i < sg_num_damage; i += 1)
+        {
+          uint32_t growth = (bound_rects (&rect, &(sg_damage[i]), &bounds)
+                             - ((uint32_t) sg_damage[i].w
+                                * sg_damage[i].h));
+
+          if (growth < best_growth)
+            {
+              best_growth = growth;
+              best = i;
+            }
+        }
+
+      sg_damage_area += best_growth;
+      (void) bound_rects (&rect, &(sg_damage[best]), &(sg_damage[best]));
+    }
+
+  /* Overlaps are counted twice, which only brings the full flip
+     forward a little. */
+  if (sg_damage_area >= (screen_area / 100) * FULL_FLIP_PERCENT)
+    {
+      sg_update_full_screen = true;
+      sg_num_damage = 0;
+      sg_damage_area = 0;
+    }
+}
+
+
+/* Updates the screen. */
+EXPORT void
+update_screen_internal (void)
+{
+  if (sg_update_full_screen)
+    {
+      SDL_Rect full;
+
+      full.x = full.y = 0;
+      full.w = (Uint16) sg_screen->w;
+      full.h = (Uint16) sg_screen->h;
+      update_rect_internal (&full);
+
+      sg_update_full_screen = false;
+      present_full_screen ();
+    }
+  else if (sg_num_damage > 0)
+    {
+      int i;
+
+      for (i = 0; i < sg_num_damage; i += 1)
+        update_rect_internal (&(sg_damage[i]));
+
+      present_rects (sg_damage, sg_num_damage);
+    }
+
+  sg_num_damage = 0;
+  sg_damage_area = 0;
+
+  SDL_Delay (1); /* TODO: remove <-- */
+}
+
+
+/* Copies a rectangle of the shadow onto the screen. */
+static void
+update_rect_internal (const SDL_Rect *rect)
+{
+  ring_piece_t pieces[4];
+  int count;
+  int i;
+
+  count = split_ring_rect (rect->x, rect->y, rect->w, rect->h,
+                           0, pieces);
+
+  for (i = 0; i < count; i += 1)
+    {
+      SDL_BlitSurface (sg_shadow, &(pieces[i].ring),
+                       sg_screen, &(pieces[i].screen));
+
+      /* The blit clipped the screen rectangle for us. */
+      if (sg_tinted)
+        tint_surface_rect (sg_screen, &(pieces[i].screen), sg_tint);
+    }
+}
+
+
+/* Finds the rectangle bounding two others. */
+static uint32_t
+bound_rects (const SDL_Rect *first,
+             const SDL_Rect *second,
+             SDL_Rect *bounds)
+{
+  int32_t left = MIN (first->x, second->x);
+  int32_t top = MIN (first->y, second->y);
+  int32_t right = MAX (first->x + first->w, second->x + second->w);
+  int32_t bottom = MAX (first->y + first->h, second->y + second->h);
+
+  bounds->x = (Sint16) left;
+  bounds->y = (Sint16) top;
+  bounds->w = (Uint16) (right - left);
+  bounds->h = (Uint16) (bottom - top);
+
+  return (uint32_t) (right - left) * (uint32_t) (bottom - top);
+}
+
+
+/* Checks whether two rectangles overlap or share an edge. */
+static bool
+rects_touch (const SDL_Rect *first, const SDL_Rect *second)
+{
+  return (first->x <= second->x + second->w
+          && second->x <= first->x + first->w
+          && first->y <= second->y + second->h
+          && second->y <= first->y + first->h);
+}
+
+
+/* Splits a screen rectangle into the pieces it occupies in the ring
+   buffer. */
+static int
+split_ring_rect (int32_t x,
+                 int32_t y,
+                 int32_t width,
+                 int32_t height,
+                 int32_t margin,
+                 ring_piece_t pieces[4])
+{
+  int32_t ring_w = sg_shadow->w;
+  int32_t ring_h = sg_shadow->h;
+  int32_t right = x + width;
+  int32_t bottom = y + height;
+  int32_t xs[2], ws[2], ys[2], hs[2];
+  int num_x, num_y;
+  int i, j;
+  int count = 0;
+
+  g_assert (margin <= RING_GUARD);
+
+  /* Clip to the screen plus margin. */
+  x = MAX (x, -margin);
+  y = MAX (y, -margin);
+  right = MIN (right, sg_screen->w + margin);
+  bottom = MIN (bottom, sg_screen->h + margin);
+
+  if (right <= x || bottom <= y)
+    return 0;
+
+  /* Split each axis at most once, where it wraps round. */
+  xs[0] = x;
+  ws[0] = MIN (right - x, ring_w - wrap_ring (sg_ring_x + x, ring_w));
+  xs[1] = x + ws[0];
+  ws[1] = right - xs[1];
+  num_x = (ws[1] > 0 ? 2 : 1);
+
+  ys[0] = y;
+  hs[0] = MIN (bottom - y, ring_h - wrap_ring (sg_ring_y + y, ring_h));
+  ys[1] = y + hs[0];
+  hs[1] = bottom - ys[1];
+  num_y = (hs[1] > 0 ? 2 : 1);
+
+  for (j = 0; j < num_y; j += 1)
+    for (i = 0; i < num_x; i += 1)
+      {
+        ring_piece_t *piece = &(pieces[count]);
+
+        piece->screen.x = (Sint16) xs[i];
+        piece->screen.y = (Sint16) ys[j];
+        piece->ring.x = (Sint16) wrap_ring (sg_ring_x + xs[i], ring_w);
+        piece->ring.y = (Sint16) wrap_ring (sg_ring_y + ys[j], ring_h);
+        piece->screen.w = piece->ring.w = (Uint16) ws[i];
+        piece->screen.h = piece->ring.h = (Uint16) hs[j];
+
+        count += 1;
+      }
+
+  return count;
+}
+
+
+/* Wraps a ring buffer co-ordinate into the range [0, size). */
+static int32_t
+wrap_ring (int32_t value, int32_t size)
+{
+  value %= size;
+  return (value < 0 ? value + size : value);
+}
+
+
+/* Translates the screen by a co-ordinate pair, leaving damage. */
+EXPORT void
+scroll_screen_internal (int16_t x_offset, int16_t y_offset)
+{
+  /* Moving the screen's origin in the ring the opposite way moves
+     its contents; the strips uncovered hold stale data, which the
+     caller is expected to redraw. */
+  sg_ring_x = wrap_ring (sg_ring_x - x_offset, sg_shadow->w);
+  sg_ring_y = wrap_ring (sg_ring_y - y_offset, sg_shadow->h);
+
+  /* The whole screen now needs updating! */
+  sg_update_full_screen = true;
+}
+
+
+/* Checks whether a batch of drawing commands may safely be split
+   into bands and rendered in parallel. */
+static bool
+can_render_in_bands (draw_command_t commands[], uint32_t count)
+{
+  uint32_t i;
+
+  if (sg_band_pool == NULL
+      || sg_target != NULL
+      || count < MIN_PARALLEL_BATCH
+      || SDL_MUSTLOCK (sg_shadow))
+    return false;
+
+  /* SDL sets up a blit the first time an image is blitted to a
+     surface, and locks surfaces that need it; neither is safe to do
+     from more than one thread.  Run-length encoded images are the
+     exception: once encoded, blitting them only reads the encoding,
+     without locking. */
+  for (i = 0; i < count; i += 1)
+    {
+      SDL_Surface *image = (SDL_Surface *) commands[i].image;
+
+      if (commands[i].type == DRAW_COMMAND_IMAGE
+          && ((SDL_MUSTLOCK (image)
+               && (image->flags & SDL_RLEACCEL) == 0)
+              || g_hash_table_lookup (sg_mapped_images,
+                                      commands[i].image) == NULL))
+        return false;
+    }
+
+  return true;
+}
+
 
+/* Renders a batch of drawing commands, split into bands rendered in
+   parallel. */
+static void
+render_in_bands (draw_command_t commands[], uint32_t count)
+{
+  render_band_t *bands;
+  int32_t top = -RING_GUARD;
+  int32_t height = sg_screen->h + (2 * RING_GUARD);
+  guint num_bands;
+  guint i;
+
+  num_bands = MIN (sg_num_bands, (guint) (height / MIN_BAND_HEIGHT));
+  if (num_bands < 1)
+    num_bands = 1;
+
+  bands = calloc (num_bands, sizeof (render_band_t));
+  if (bands == NULL)
+    {
+      g_critical ("Could not allocate render bands.");
+      return;
+    }
 
-#include "module.h"
+  for (i = 0; i < num_bands; i += 1)
+    {
+      bands[i].commands = commands;
+      bands[i].count = count;
+      bands[i].top = top + (int32_t) ((height * i) / num_bands);
+      bands[i].bottom = top + (int32_t) ((height * (i + 1)) / num_bands);
+      bands[i].pooled = (i > 0);
+    }
 
-#include <SDL/SDL.h>
-#include <SDL/SDL_image.h>
+  sg_bands_pending = num_bands - 1;
+  for (i = 1; i < num_bands; i += 1)
+    g_thread_pool_push (sg_band_pool, &(bands[i]), NULL);
 
-#include "gfx-module.h" /* Module header file. */
+  render_band (&(bands[0]), NULL);
 
-#undef G_LOG_DOMAIN
-#define G_LOG_DOMAIN "gfx-sdl"
+  /* Join: wait for the pool to finish the other bands. */
+  g_mutex_lock (&sg_band_mutex);
+  while (sg_bands_pending > 0)
+    g_cond_wait (&sg_band_cond, &sg_band_mutex);
+  g_mutex_unlock (&sg_band_mutex);
 
-/* -- STATIC GLOBAL VARIABLES -- */
+  free (bands);
+}
 
-static SDL_Surface *sg_screen; /**< The main screen surface. */
 
-static SDL_Surface *sg_shadow; /**< The screen surface everything is
-                                 * drawn onto. */
+/* Renders a batch of drawing commands clipped to one band. */
+static void
+render_band (gpointer band, gpointer ignored)
+{
+  render_band_t *bandc = (render_band_t *) band;
+  uint32_t i;
 
-static GSList *sg_blit_stack; /**< The stack of rectangles to
-                                 update on the screen. */
+  (void) ignored;
 
-static bool sg_update_full_screen; /**< If true then the entire
-                                      screen must be flipped on the
-                                      next frame. */
+  for (i = 0; i < bandc->count; i += 1)
+    execute_draw_command_in_band (&(bandc->commands[i]),
+                                  bandc->top, bandc->bottom);
+
+  if (bandc->pooled)
+    {
+      g_mutex_lock (&sg_band_mutex);
+      sg_bands_pending -= 1;
+      g_cond_signal (&sg_band_cond);
+      g_mutex_unlock (&sg_band_mutex);
+    }
+}
 
+
+/* Executes one drawing command, clipped to a horizontal band. */
 static void
-update_rect_internal (void *rect, void *ignore);
+execute_draw_command_in_band (draw_command_t *command,
+                              int32_t top,
+                              int32_t bottom)
+{
+  int32_t y = MAX (command->screen_y, top);
+  int32_t end = MIN (command->screen_y + command->height, bottom);
+
+  if (end <= y)
+    return;
+
+  if (command->type == DRAW_COMMAND_IMAGE)
+    draw_image_internal (command->image,
+                         command->image_x,
+                         (int16_t) (command->image_y
+                                    + (y - command->screen_y)),
+                         command->screen_x,
+                         (int16_t) y,
+                         command->width,
+                         (uint16_t) (end - y));
+  else
+    draw_rect_internal (command->screen_x,
+                        (int16_t) y,
+                        command->width,
+                        (uint16_t) (end - y),
+                        command->red,
+                        command->green,
+                        command->blue);
+}
 
 
-/* -- DEFINITIONS -- */
+/* Shows the whole screen in the window. */
+static void
+present_full_screen (void)
+{
+  SDL_Rect full;
 
-/* Initialises the module. */
-EXPORT bool
-init (void)
+  if (sg_window == NULL)
+    return;
+
+  if (sg_window != sg_screen)
+    {
+      full.x = full.y = 0;
+      full.w = (Uint16) sg_screen->w;
+      full.h = (Uint16) sg_screen->h;
+      scale_rect_to_window (&full);
+    }
+
+  SDL_Flip (sg_window);
+}
+
+
+/* Shows rectangles of the screen in the window. */
+static void
+present_rects (SDL_Rect rects[], int count)
 {
-  sg_screen = NULL;
-  sg_shadow = NULL;
-  sg_blit_stack = NULL;
-  sg_update_full_screen = false;
+  int i;
 
-  return true;
+  if (sg_window == NULL)
+    return;
+
+  if (sg_window != sg_screen)
+    for (i = 0; i < count; i += 1)
+      scale_rect_to_window (&(rects[i]));
+
+  SDL_UpdateRects (sg_window, count, rects);
 }
 
 
-/* Terminates the module, freeing any remaining data dynamically
-   allocated by the module. */
-EXPORT void
-term (void)
+/* Scales a rectangle of the screen up into the window. */
+static void
+scale_rect_to_window (SDL_Rect *rect)
 {
-  if (sg_screen)
+  int32_t scale = sg_output_scale;
+  int32_t margin = (sg_output_filter == OUTPUT_SCALE2X ? 1 : 0);
+  int32_t left;
+  int32_t top;
+  int32_t right;
+  int32_t bottom;
+  int32_t y;
+
+  /* Scale2x output depends on each pixel's neighbours, so the ring of
+     pixels round the rectangle may change too. */
+  left = MAX (rect->x - margin, 0);
+  top = MAX (rect->y - margin, 0);
+  right = MIN (rect->x + rect->w + margin, sg_screen->w);
+  bottom = MIN (rect->y + rect->h + margin, sg_screen->h);
+
+  if (right <= left || bottom <= top)
     {
-      if (sg_shadow)
-        {
-          SDL_FreeSurface (sg_shadow);
-        }
+      rect->x = rect->y = 0;
+      rect->w = rect->h = 0;
+      return;
+    }
+
+  if (SDL_MUSTLOCK (sg_window))
+    SDL_LockSurface (sg_window);
+
+  for (y = top; y < bottom; y += 1)
+    {
+      const Uint32 *row = (const Uint32 *) ((Uint8 *) sg_screen->pixels
+                                            + (y * sg_screen->pitch));
+      Uint32 *out = (Uint32 *) ((Uint8 *) sg_window->pixels
+                                + (y * scale * sg_window->pitch));
+      int32_t i;
 
-      if (sg_blit_stack)
+      if (sg_output_filter == OUTPUT_SCALE2X)
         {
-          g_slist_free_full (sg_blit_stack, free);
-          sg_blit_stack = NULL;
+          const Uint32 *above = (y > 0
+                                 ? (const Uint32 *) ((const Uint8 *) row
+                                                     - sg_screen->pitch)
+                                 : row);
+          const Uint32 *below = (y + 1 < sg_screen->h
+                                 ? (const Uint32 *) ((const Uint8 *) row
+                                                     + sg_screen->pitch)
+                                 : row);
+
+          (*sg_scale2x_span) (out,
+                              (Uint32 *) ((Uint8 *) out
+                                          + sg_window->pitch),
+                              above, row, below,
+                              left, right, sg_screen->w);
+          continue;
         }
 
-      SDL_Quit ();
+      /* Scale one window row, then copy it down. */
+      (*sg_scale_span) (out + (left * scale), row + left,
+                        right - left, scale);
+
+      for (i = 1; i < scale; i += 1)
+        memcpy ((Uint8 *) out + (i * sg_window->pitch)
+                + (left * scale * 4),
+                out + (left * scale),
+                (size_t) ((right - left) * scale * 4));
     }
+
+  if (SDL_MUSTLOCK (sg_window))
+    SDL_UnlockSurface (sg_window);
+
+  rect->x = (Sint16) (left * scale);
+  rect->y = (Sint16) (top * scale);
+  rect->w = (Uint16) ((right - left) * scale);
+  rect->h = (Uint16) ((bottom - top) * scale);
 }
 
 
-/* Initialises a screen of a given width, height and depth. */
-EXPORT bool
-init_screen_internal (uint16_t width, uint16_t height, uint8_t depth)
+/* Repeats each of a span of 32-bit pixels, one at a time. */
+static void
+scale_span_scalar (Uint32 *out,
+                   const Uint32 *in,
+                   int32_t count,
+                   int32_t scale)
 {
-  if (SDL_Init (SDL_INIT_VIDEO) != 0)
-    {
-      g_critical ("Could not initialise SDL");
-      return false;
-    }
+  int32_t i;
+  int32_t j;
 
-   sg_screen = SDL_SetVideoMode (width, height, depth, SDL_HWSURFACE);
-   if (sg_screen == NULL)
-     {
-       g_critical ("Could not init screen.");
-       SDL_Quit ();
-       return false;
-     }
+  for (i = 0; i < count; i += 1)
+    for (j = 0; j < scale; j += 1)
+      out[(i * scale) + j] = in[i];
+}
 
-   sg_shadow = SDL_DisplayFormat (sg_screen);
-   if (sg_shadow == NULL)
-     {
-       g_critical ("Could not make shadowbuf.");
-       SDL_Quit ();
-       return false;
-     }
 
-  return true;
+/* Applies the Scale2x rules to a span of 32-bit pixels, one at a
+   time. */
+static void
+scale2x_span_scalar (Uint32 *top,
+                     Uint32 *bottom,
+                     const Uint32 *above,
+                     const Uint32 *row,
+                     const Uint32 *below,
+                     int32_t left,
+                     int32_t right,
+                     int32_t width)
+{
+  int32_t x;
+
+  for (x = left; x < right; x += 1)
+    {
+      Uint32 p = row[x];
+      Uint32 a = above[x];
+      Uint32 d = below[x];
+      Uint32 c = (x > 0 ? row[x - 1] : p);
+      Uint32 b = (x + 1 < width ? row[x + 1] : p);
+
+      top[2 * x] = (c == a && c != d && a != b) ? a : p;
+      top[(2 * x) + 1] = (a == b && a != c && b != d) ? b : p;
+      bottom[2 * x] = (d == c && d != b && c != a) ? c : p;
+      bottom[(2 * x) + 1] = (b == d && b != a && d != c) ? d : p;
+    }
 }
 
 
-/* Draws a rectangle of colour on-screen. */
-EXPORT void
-draw_rect_internal (int16_t x,
-                    int16_t y,
-                    uint16_t width,
-                    uint16_t height,
-                    uint8_t red,
-                    uint8_t green,
-                    uint8_t blue)
+#ifdef PIXEL_SIMD
+/* Repeats each of a span of 32-bit pixels, using SSE2. */
+static void
+scale_span_sse2 (Uint32 *out,
+                 const Uint32 *in,
+                 int32_t count,
+                 int32_t scale)
 {
-  SDL_Rect rect;
+  int32_t i;
 
-  rect.x = x;
-  rect.y = y;
-  rect.w = width;
-  rect.h = height;
+  for (i = 0; i + 4 <= count; i += 4)
+    {
+      __m128i in4 = _mm_loadu_si128 ((__m128i *) (in + i));
+      __m128i *out4 = (__m128i *) (out + (i * scale));
 
-  SDL_FillRect (sg_shadow, &rect, SDL_MapRGB (sg_screen->format,
-                                              red, green, blue));
-}
+      switch (scale)
+        {
+        case 2:
+          _mm_storeu_si128 (out4, _mm_unpacklo_epi32 (in4, in4));
+          _mm_storeu_si128 (out4 + 1, _mm_unpackhi_epi32 (in4, in4));
+          break;
+        case 3:
+          /* 0001 1122 2333 */
+          _mm_storeu_si128 (out4, _mm_shuffle_epi32 (in4, 0x40));
+          _mm_storeu_si128 (out4 + 1, _mm_shuffle_epi32 (in4, 0xA5));
+          _mm_storeu_si128 (out4 + 2, _mm_shuffle_epi32 (in4, 0xFE));
+          break;
+        case 4:
+          {
+            __m128i lo = _mm_unpacklo_epi32 (in4, in4);
+            __m128i hi = _mm_unpackhi_epi32 (in4, in4);
+
+            _mm_storeu_si128 (out4, _mm_unpacklo_epi64 (lo, lo));
+            _mm_storeu_si128 (out4 + 1, _mm_unpackhi_epi64 (lo, lo));
+            _mm_storeu_si128 (out4 + 2, _mm_unpacklo_epi64 (hi, hi));
+            _mm_storeu_si128 (out4 + 3, _mm_unpackhi_epi64 (hi, hi));
+          }
+          break;
+        default:
+          _mm_storeu_si128 (out4, in4);
+          break;
+        }
+    }
 
+  scale_span_scalar (out + (i * scale), in + i, count - i, scale);
+}
 
-/* Loads an image and returns its data in the module's native format. */
 
-EXPORT void *
-load_image_data (const char filename[])
+/* Applies the Scale2x rules to a span of 32-bit pixels, using
+   SSE2. */
+static void
+scale2x_span_sse2 (Uint32 *top,
+                   Uint32 *bottom,
+                   const Uint32 *above,
+                   const Uint32 *row,
+                   const Uint32 *below,
+                   int32_t left,
+                   int32_t right,
+                   int32_t width)
 {
-  SDL_Surface *surface;
+  /* The edge columns have missing neighbours; leave them to the
+     scalar kernel. */
+  int32_t start = MAX (left, 1);
+  int32_t stop = MIN (right, width - 1);
+  int32_t x;
 
-  surface = IMG_Load (filename);
-  if (surface == NULL)
+  scale2x_span_scalar (top, bottom, above, row, below,
+                       left, MIN (start, right), width);
+
+  for (x = start; x + 4 <= stop; x += 4)
     {
-      g_critical ("Couldn't load %s!", filename);
+      __m128i p = _mm_loadu_si128 ((__m128i *) (row + x));
+      __m128i a = _mm_loadu_si128 ((__m128i *) (above + x));
+      __m128i d = _mm_loadu_si128 ((__m128i *) (below + x));
+      __m128i c = _mm_loadu_si128 ((__m128i *) (row + x - 1));
+      __m128i b = _mm_loadu_si128 ((__m128i *) (row + x + 1));
+      __m128i ca = _mm_cmpeq_epi32 (c, a);
+      __m128i cd = _mm_cmpeq_epi32 (c, d);
+      __m128i ab = _mm_cmpeq_epi32 (a, b);
+      __m128i bd = _mm_cmpeq_epi32 (b, d);
+      __m128i m0 = _mm_andnot_si128 (_mm_or_si128 (cd, ab), ca);
+      __m128i m1 = _mm_andnot_si128 (_mm_or_si128 (ca, bd), ab);
+      __m128i m2 = _mm_andnot_si128 (_mm_or_si128 (bd, ca), cd);
+      __m128i m3 = _mm_andnot_si128 (_mm_or_si128 (ab, cd), bd);
+      __m128i e0 = _mm_or_si128 (_mm_and_si128 (m0, a),
+                                 _mm_andnot_si128 (m0, p));
+      __m128i e1 = _mm_or_si128 (_mm_and_si128 (m1, b),
+                                 _mm_andnot_si128 (m1, p));
+      __m128i e2 = _mm_or_si128 (_mm_and_si128 (m2, c),
+                                 _mm_andnot_si128 (m2, p));
+      __m128i e3 = _mm_or_si128 (_mm_and_si128 (m3, d),
+                                 _mm_andnot_si128 (m3, p));
+
+      _mm_storeu_si128 ((__m128i *) (top + (2 * x)),
+                        _mm_unpacklo_epi32 (e0, e1));
+      _mm_storeu_si128 ((__m128i *) (top + (2 * x) + 4),
+                        _mm_unpackhi_epi32 (e0, e1));
+      _mm_storeu_si128 ((__m128i *) (bottom + (2 * x)),
+                        _mm_unpacklo_epi32 (e2, e3));
+      _mm_storeu_si128 ((__m128i *) (bottom + (2 * x) + 4),
+                        _mm_unpackhi_epi32 (e2, e3));
     }
 
-  return (void *) surface;
+  scale2x_span_scalar (top, bottom, above, row, below, x, right, width);
 }
+#endif /* PIXEL_SIMD */
 
 
-/* Frees image data retrieved by load_image_data. */
-EXPORT void
-free_image_data (void *data)
+/* Reads a pixel from a locked surface. */
+static Uint32
+get_pixel (SDL_Surface *surface, int32_t x, int32_t y)
 {
-  if (data)
-    SDL_FreeSurface(data);
+  Uint8 *p = ((Uint8 *) surface->pixels
+              + (y * surface->pitch)
+              + (x * surface->format->BytesPerPixel));
+
+  switch (surface->format->BytesPerPixel)
+    {
+    case 1:
+      return *p;
+    case 2:
+      return *(Uint16 *) p;
+    case 3:
+      if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
+        return (Uint32) ((p[0] << 16) | (p[1] << 8) | p[2]);
+      else
+        return (Uint32) (p[0] | (p[1] << 8) | (p[2] << 16));
+    default:
+      return *(Uint32 *) p;
+    }
 }
 
 
-/* Draws a rectangular portion of an image on-screen. */
-EXPORT void
-draw_image_internal (void *image,
-                     int16_t image_x,
-                     int16_t image_y,
-                     int16_t screen_x,
-                     int16_t screen_y,
-                     uint16_t width,
-                     uint16_t height)
+/* Writes a pixel to a locked surface. */
+static void
+put_pixel (SDL_Surface *surface, int32_t x, int32_t y, Uint32 pixel)
 {
-  SDL_Rect srcrect, destrect;
-  SDL_Surface *ptex;
-
-  ptex = (SDL_Surface*) image;
-  g_assert (ptex != NULL);
+  Uint8 *p = ((Uint8 *) surface->pixels
+              + (y * surface->pitch)
+              + (x * surface->format->BytesPerPixel));
 
-  srcrect.x = image_x;
-  srcrect.y = image_y;
-
-  destrect.x = screen_x;
-  destrect.y = screen_y;
+  switch (surface->format->BytesPerPixel)
+    {
+    case 1:
+      *p = (Uint8) pixel;
+      break;
+    case 2:
+      *(Uint16 *) p = (Uint16) pixel;
+      break;
+    case 3:
+      if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
+        {
+          p[0] = (Uint8) ((pixel >> 16) & 0xFF);
+          p[1] = (Uint8) ((pixel >> 8) & 0xFF);
+          p[2] = (Uint8) (pixel & 0xFF);
+        }
+      else
+        {
+          p[0] = (Uint8) (pixel & 0xFF);
+          p[1] = (Uint8) ((pixel >> 8) & 0xFF);
+          p[2] = (Uint8) ((pixel >> 16) & 0xFF);
+        }
+      break;
+    default:
+      *(Uint32 *) p = pixel;
+      break;
+    }
+}
 
-  srcrect.w = destrect.w = width;
-  srcrect.h = destrect.h = height;
 
-  SDL_BlitSurface (ptex, &srcrect, sg_shadow, &destrect);
+/* Inspects a freshly loaded image's pixels to find out how it uses
+   transparency. */
+static image_transparency_t
+classify_image (SDL_Surface *surface)
+{
+  image_transparency_t result = IMAGE_OPAQUE;
+  int32_t x;
+  int32_t y;
+
+  if (surface->flags & SDL_SRCCOLORKEY)
+    return IMAGE_KEYED;
+  if (surface->format->Amask == 0)
+    return IMAGE_OPAQUE;
+
+  if (SDL_MUSTLOCK (surface))
+    SDL_LockSurface (surface);
+
+  for (y = 0; y < surface->h && result != IMAGE_TRANSLUCENT; y += 1)
+    for (x = 0; x < surface->w; x += 1)
+      {
+        Uint8 r, g, b, a;
+
+        SDL_GetRGBA (get_pixel (surface, x, y), surface->format,
+                     &r, &g, &b, &a);
+
+        if (a == SDL_ALPHA_TRANSPARENT)
+          result = IMAGE_KEYED;
+        else if (a != SDL_ALPHA_OPAQUE)
+          {
+            result = IMAGE_TRANSLUCENT;
+            break;
+          }
+      }
+
+  if (SDL_MUSTLOCK (surface))
+    SDL_UnlockSurface (surface);
+
+  return result;
 }
 
 
-/* Adds a rectangle to the next update run. */
-EXPORT void
-add_update_rectangle_internal (int16_t x,
-                               int16_t y,
-                               uint16_t width,
-                               uint16_t height)
+/* Converts a freshly loaded image to the fastest display format
+   that keeps its transparency. */
+static SDL_Surface *
+convert_image (SDL_Surface *surface)
 {
-  SDL_Rect *rect;
+  SDL_Surface *converted = NULL;
 
-  rect = calloc (1, sizeof (SDL_Rect));
-  if (rect == NULL)
+  switch (classify_image (surface))
     {
-      g_critical ("Could not allocate an update rectangle.");
-      return;
+    case IMAGE_OPAQUE:
+      converted = SDL_DisplayFormat (surface);
+      break;
+    case IMAGE_KEYED:
+      converted = convert_keyed_image (surface);
+      if (converted == NULL)
+        converted = SDL_DisplayFormatAlpha (surface);
+      break;
+    case IMAGE_TRANSLUCENT:
+      converted = SDL_DisplayFormatAlpha (surface);
+      break;
     }
-  rect->x = x;
-  rect->y = y;
-  rect->w = width;
-  rect->h = height;
 
-  sg_blit_stack = g_slist_prepend (sg_blit_stack, rect);
+  return converted;
 }
 
 
-/* Updates the screen. */
-EXPORT void
-update_screen_internal (void)
+/* Converts an image with only fully opaque and fully transparent
+   pixels to a colour-keyed, run-length encoded display format
+   image. */
+static SDL_Surface *
+convert_keyed_image (SDL_Surface *surface)
 {
-  g_slist_foreach (sg_blit_stack, update_rect_internal, NULL);
+  /* Colours to try as the key, in order; these are rare in artwork. */
+  static const Uint8 candidates[][3] = {
+    { 255, 0, 255 },
+    { 0, 255, 255 },
+    { 255, 255, 0 },
+    { 0, 255, 0 }
+  };
+  SDL_Surface *keyed;
+  Uint32 key = 0;
+  bool found = false;
+  size_t c;
+  int32_t x;
+  int32_t y;
+
+  keyed = SDL_DisplayFormat (surface);
+  if (keyed == NULL)
+    return NULL;
+
+  /* An image that already had a colour key keeps it, converted to
+     the display format. */
+  if (surface->flags & SDL_SRCCOLORKEY)
+    {
+      SDL_SetColorKey (keyed, SDL_SRCCOLORKEY | SDL_RLEACCEL,
+                       keyed->format->colorkey);
+      return keyed;
+    }
 
-  if (sg_update_full_screen)
+  if (SDL_MUSTLOCK (surface))
+    SDL_LockSurface (surface);
+  if (SDL_MUSTLOCK (keyed))
+    SDL_LockSurface (keyed);
+
+  /* The key must not be a colour any opaque pixel maps to. */
+  for (c = 0; c < sizeof (candidates) / sizeof (candidates[0]) && !found;
+       c += 1)
     {
-      sg_update_full_screen = false;
-      SDL_Flip (sg_screen);
+      key = SDL_MapRGB (keyed->format, candidates[c][0],
+                        candidates[c][1], candidates[c][2]);
+      found = true;
+
+      for (y = 0; y < keyed->h && found; y += 1)
+        for (x = 0; x < keyed->w; x += 1)
+          {
+            Uint8 r, g, b, a;
+
+            SDL_GetRGBA (get_pixel (surface, x, y), surface->format,
+                         &r, &g, &b, &a);
+
+            if (a != SDL_ALPHA_TRANSPARENT
+                && get_pixel (keyed, x, y) == key)
+              {
+                found = false;
+                break;
+              }
+          }
     }
-  else
+
+  if (found)
     {
-      /* Collate rectangles into an array and UpdateRects them. */
-      SDL_Rect *rectlist;
-      void *current;
-      int i;
-      int len;
+      for (y = 0; y < keyed->h; y += 1)
+        for (x = 0; x < keyed->w; x += 1)
+          {
+            Uint8 r, g, b, a;
 
-      len = g_slist_length (sg_blit_stack);
-      rectlist = calloc (len, sizeof (SDL_Rect));
-      for (i = 0; i < len; i += 1)
-        {
-          current = g_slist_nth_data (sg_blit_stack, i);
-          memcpy (&(rectlist[i]),
-                  current,
-                  sizeof (SDL_Rect));
-        }
+            SDL_GetRGBA (get_pixel (surface, x, y), surface->format,
+                         &r, &g, &b, &a);
+
+            if (a == SDL_ALPHA_TRANSPARENT)
+              put_pixel (keyed, x, y, key);
+          }
+    }
 
-      SDL_UpdateRects (sg_screen, len, rectlist);
+  if (SDL_MUSTLOCK (keyed))
+    SDL_UnlockSurface (keyed);
+  if (SDL_MUSTLOCK (surface))
+    SDL_UnlockSurface (surface);
 
-      free (rectlist);
+  if (!found)
+    {
+      SDL_FreeSurface (keyed);
+      return NULL;
     }
 
-  g_slist_free_full (sg_blit_stack, free);
-  sg_blit_stack = NULL;
+  SDL_SetColorKey (keyed, SDL_SRCCOLORKEY | SDL_RLEACCEL, key);
+  return keyed;
+}
 
-  SDL_Delay (1); /* TODO: remove <-- */
+
+/* Tints a span of 32-bit pixels in place, one byte at a time. */
+static void
+tint_span_scalar (Uint8 *pixels,
+                  uint32_t length,
+                  const uint16_t multipliers[4])
+{
+  uint32_t i;
+
+  for (i = 0; i < length; i += 1)
+    pixels[i] = (Uint8) ((pixels[i] * multipliers[i & 3]) >> 8);
 }
 
 
-/* Updates one rectangle. */
+#ifdef PIXEL_SIMD
+/* Tints a span of 32-bit pixels in place, using SSE2. */
 static void
-update_rect_internal (void *rect, void *ignore)
+tint_span_sse2 (Uint8 *pixels,
+                uint32_t length,
+                const uint16_t multipliers[4])
 {
-  SDL_Rect *rectc = (SDL_Rect *) rect;
-  SDL_BlitSurface (sg_shadow, rectc, sg_screen, rectc);
+  __m128i zero = _mm_setzero_si128 ();
+  __m128i factors = _mm_set_epi16 ((short) multipliers[3],
+                                   (short) multipliers[2],
+                                   (short) multipliers[1],
+                                   (short) multipliers[0],
+                                   (short) multipliers[3],
+                                   (short) multipliers[2],
+                                   (short) multipliers[1],
+                                   (short) multipliers[0]);
+  uint32_t i;
+
+  /* Widen each byte to 16 bits, multiply, and narrow the high
+     bytes back down.  255 * TINT_ONE still fits in 16 bits. */
+  for (i = 0; i + 16 <= length; i += 16)
+    {
+      __m128i in = _mm_loadu_si128 ((__m128i *) (pixels + i));
+      __m128i lo = _mm_unpacklo_epi8 (in, zero);
+      __m128i hi = _mm_unpackhi_epi8 (in, zero);
+
+      lo = _mm_srli_epi16 (_mm_mullo_epi16 (lo, factors), 8);
+      hi = _mm_srli_epi16 (_mm_mullo_epi16 (hi, factors), 8);
+
+      _mm_storeu_si128 ((__m128i *) (pixels + i),
+                        _mm_packus_epi16 (lo, hi));
+    }
 
-  (void) ignore;
+  tint_span_scalar (pixels + i, length - i, multipliers);
 }
 
 
-/* Translates the screen by a co-ordinate pair, leaving damage. */
-EXPORT void
-scroll_screen_internal (int16_t x_offset, int16_t y_offset)
+/* Tints a span of 32-bit pixels in place, using AVX2. */
+static void
+tint_span_avx2 (Uint8 *pixels,
+                uint32_t length,
+                const uint16_t multipliers[4])
 {
-  SDL_Rect source, dest;
+  __m256i zero = _mm256_setzero_si256 ();
+  __m256i factors = _mm256_set_epi16 ((short) multipliers[3],
+                                      (short) multipliers[2],
+                                      (short) multipliers[1],
+                                      (short) multipliers[0],
+                                      (short) multipliers[3],
+                                      (short) multipliers[2],
+                                      (short) multipliers[1],
+                                      (short) multipliers[0],
+                                      (short) multipliers[3],
+                                      (short) multipliers[2],
+                                      (short) multipliers[1],
+                                      (short) multipliers[0],
+                                      (short) multipliers[3],
+                                      (short) multipliers[2],
+                                      (short) multipliers[1],
+                                      (short) multipliers[0]);
+  uint32_t i;
+
+  /* As tint_span_sse2; the unpacks and pack all work within 128-bit
+     lanes, so the bytes come back out in their original order. */
+  for (i = 0; i + 32 <= length; i += 32)
+    {
+      __m256i in = _mm256_loadu_si256 ((__m256i *) (pixels + i));
+      __m256i lo = _mm256_unpacklo_epi8 (in, zero);
+      __m256i hi = _mm256_unpackhi_epi8 (in, zero);
+
+      lo = _mm256_srli_epi16 (_mm256_mullo_epi16 (lo, factors), 8);
+      hi = _mm256_srli_epi16 (_mm256_mullo_epi16 (hi, factors), 8);
 
-  /* These are all temporary variables, which are
-   * used for boundary-checking before populating the SDL rects.
-   */
+      _mm256_storeu_si256 ((__m256i *) (pixels + i),
+                           _mm256_packus_epi16 (lo, hi));
+    }
 
-  int32_t source_x;
-  int32_t source_y;
-  int32_t source_width;
-  int32_t source_height;
+  tint_span_sse2 (pixels + i, length - i, multipliers);
+}
+#endif /* PIXEL_SIMD */
 
-  int32_t dest_x;
-  int32_t dest_y;
 
-  source_x = dest_x = source_y = dest_y = 0;
+/* Blends a span of bytes towards another, one byte at a time. */
+static void
+blend_span_scalar (Uint8 *pixels,
+                   const Uint8 *from,
+                   uint32_t length,
+                   uint16_t weight)
+{
+  uint16_t from_weight = (uint16_t) (TRANSITION_ONE - weight);
+  uint32_t i;
 
-  source_width = dest.w = (Uint16) sg_screen->w;
-  source_height = dest.h = (Uint16) sg_screen->h;
+  for (i = 0; i < length; i += 1)
+    pixels[i] = (Uint8) (((pixels[i] * weight)
+                          + (from[i] * from_weight)) >> 8);
+}
 
-  /* Set up the offsets. */
 
-  if (x_offset < 0)
+#ifdef PIXEL_SIMD
+/* Blends a span of bytes towards another, using SSE2. */
+static void
+blend_span_sse2 (Uint8 *pixels,
+                 const Uint8 *from,
+                 uint32_t length,
+                 uint16_t weight)
+{
+  __m128i zero = _mm_setzero_si128 ();
+  __m128i weights = _mm_set1_epi16 ((short) weight);
+  __m128i from_weights = _mm_set1_epi16 ((short) (TRANSITION_ONE
+                                                  - weight));
+  uint32_t i;
+
+  /* The two products of each byte sum to at most 255 *
+     TRANSITION_ONE, which still fits in 16 unsigned bits. */
+  for (i = 0; i + 16 <= length; i += 16)
     {
-      source_x -= x_offset;
-      source_width += x_offset;
+      __m128i in = _mm_loadu_si128 ((__m128i *) (pixels + i));
+      __m128i out = _mm_loadu_si128 ((__m128i *) (from + i));
+      __m128i lo = _mm_add_epi16
+        (_mm_mullo_epi16 (_mm_unpacklo_epi8 (in, zero), weights),
+         _mm_mullo_epi16 (_mm_unpacklo_epi8 (out, zero), from_weights));
+      __m128i hi = _mm_add_epi16
+        (_mm_mullo_epi16 (_mm_unpackhi_epi8 (in, zero), weights),
+         _mm_mullo_epi16 (_mm_unpackhi_epi8 (out, zero), from_weights));
+
+      _mm_storeu_si128 ((__m128i *) (pixels + i),
+                        _mm_packus_epi16 (_mm_srli_epi16 (lo, 8),
+                                          _mm_srli_epi16 (hi, 8)));
     }
-  else
+
+  blend_span_scalar (pixels + i, from + i, length - i, weight);
+}
+
+
+/* Blends a span of bytes towards another, using AVX2. */
+static void
+blend_span_avx2 (Uint8 *pixels,
+                 const Uint8 *from,
+                 uint32_t length,
+                 uint16_t weight)
+{
+  __m256i zero = _mm256_setzero_si256 ();
+  __m256i weights = _mm256_set1_epi16 ((short) weight);
+  __m256i from_weights = _mm256_set1_epi16 ((short) (TRANSITION_ONE
+                                                     - weight));
+  uint32_t i;
+
+  /* As blend_span_sse2, lane by lane. */
+  for (i = 0; i + 32 <= length; i += 32)
     {
-      dest_x += x_offset;
-      source_width -= x_offset;
+      __m256i in = _mm256_loadu_si256 ((__m256i *) (pixels + i));
+      __m256i out = _mm256_loadu_si256 ((__m256i *) (from + i));
+      __m256i lo = _mm256_add_epi16
+        (_mm256_mullo_epi16 (_mm256_unpacklo_epi8 (in, zero), weights),
+         _mm256_mullo_epi16 (_mm256_unpacklo_epi8 (out, zero),
+                             from_weights));
+      __m256i hi = _mm256_add_epi16
+        (_mm256_mullo_epi16 (_mm256_unpackhi_epi8 (in, zero), weights),
+         _mm256_mullo_epi16 (_mm256_unpackhi_epi8 (out, zero),
+                             from_weights));
+
+      _mm256_storeu_si256 ((__m256i *) (pixels + i),
+                           _mm256_packus_epi16 (_mm256_srli_epi16 (lo, 8),
+                                                _mm256_srli_epi16 (hi, 8)));
     }
 
-  if (y_offset < 0)
+  blend_span_sse2 (pixels + i, from + i, length - i, weight);
+}
+#endif /* PIXEL_SIMD */
+
+
+/* Cross-fades the kept screen over the screen surface. */
+static void
+fade_screen (uint16_t progress)
+{
+  int32_t y;
+
+  if (sg_screen->format->BytesPerPixel != 4)
+    {
+      /* Let SDL blend other depths, with per-surface alpha. */
+      SDL_SetAlpha (sg_transition_from, SDL_SRCALPHA,
+                    (Uint8) (((TRANSITION_ONE - progress) * 255)
+                             / TRANSITION_ONE));
+      SDL_BlitSurface (sg_transition_from, NULL, sg_screen, NULL);
+      SDL_SetAlpha (sg_transition_from, 0, SDL_ALPHA_OPAQUE);
+      return;
+    }
+
+  if (SDL_MUSTLOCK (sg_screen))
+    SDL_LockSurface (sg_screen);
+
+  for (y = 0; y < sg_screen->h; y += 1)
+    (*sg_blend_span) ((Uint8 *) sg_screen->pixels + (y * sg_screen->pitch),
+                      ((Uint8 *) sg_transition_from->pixels
+                       + (y * sg_transition_from->pitch)),
+                      (uint32_t) sg_screen->w * 4,
+                      progress);
+
+  if (SDL_MUSTLOCK (sg_screen))
+    SDL_UnlockSurface (sg_screen);
+}
+
+
+/* Covers the unwiped part of the screen with the kept screen. */
+static void
+wipe_screen (uint16_t progress)
+{
+  SDL_Rect rect;
+  int32_t edge = (sg_screen->w * progress) / TRANSITION_ONE;
+
+  rect.x = (Sint16) edge;
+  rect.y = 0;
+  rect.w = (Uint16) (sg_screen->w - edge);
+  rect.h = (Uint16) sg_screen->h;
+
+  SDL_BlitSurface (sg_transition_from, &rect, sg_screen, &rect);
+}
+
+
+/* Replaces the screen with a mosaic of the kept screen or itself. */
+static void
+mosaic_screen (uint16_t progress)
+{
+  SDL_Surface *source;
+  int32_t distance;
+  int32_t block;
+  int32_t bpp = sg_screen->format->BytesPerPixel;
+  int32_t x0;
+  int32_t y0;
+
+  /* Blocks grow towards the half-way point, where the picture
+     changes over, and shrink after it. */
+  if (progress < TRANSITION_ONE / 2)
     {
-      source_y -= y_offset;
-      source_height += y_offset;
+      source = sg_transition_from;
+      distance = progress;
     }
   else
     {
-      dest_y += y_offset;
-      source_height -= y_offset;
+      source = sg_screen;
+      distance = TRANSITION_ONE - progress;
     }
 
+  block = 1 + (((MOSAIC_MAX_BLOCK - 1) * distance * 2) / TRANSITION_ONE);
 
-  /* Now check for overflows. */
-  if (source_x > SHRT_MAX
-      || source_y > SHRT_MAX
-      || dest_x > SHRT_MAX
-      || dest_y > SHRT_MAX
-      || source_x < SHRT_MIN
-      || source_y < SHRT_MIN
-      || dest_x < SHRT_MIN
-      || dest_y < SHRT_MIN)
-    {
-      g_critical ("Coordinate overflow when scrolling.");
-    }
+  if (block == 1 && source == sg_screen)
+    return;
 
+  if (SDL_MUSTLOCK (sg_screen))
+    SDL_LockSurface (sg_screen);
 
-  if (source_width > USHRT_MAX
-      || source_height > USHRT_MAX
-      || source_width < 0
-      || source_height < 0)
+  for (y0 = 0; y0 < sg_screen->h; y0 += block)
     {
-      g_critical ("Dimension overflow when scrolling.");
+      int32_t rows = MIN (block, sg_screen->h - y0);
+      Uint8 *row = (Uint8 *) sg_screen->pixels + (y0 * sg_screen->pitch);
+      int32_t y;
+
+      /* Fill the top row of each block with its top-left pixel.  Each
+         block reads its own first pixel before writing over it, so
+         this also works with the screen as its own source. */
+      for (x0 = 0; x0 < sg_screen->w; x0 += block)
+        {
+          int32_t columns = MIN (block, sg_screen->w - x0);
+          Uint32 pixel = get_pixel (source, x0, y0);
+          int32_t x;
+
+          if (bpp == 4)
+            for (x = 0; x < columns; x += 1)
+              ((Uint32 *) row)[x0 + x] = pixel;
+          else
+            for (x = 0; x < columns; x += 1)
+              put_pixel (sg_screen, x0 + x, y0, pixel);
+        }
+
+      /* The rest of the block rows are copies of the top one. */
+      for (y = 1; y < rows; y += 1)
+        memcpy (row + (y * sg_screen->pitch), row,
+                (size_t) (sg_screen->w * bpp));
     }
 
+  if (SDL_MUSTLOCK (sg_screen))
+    SDL_UnlockSurface (sg_screen);
+}
+
 
-  /* Convert down. */
-  source.x = (int16_t) source_x;
-  source.y = (int16_t) source_y;
-  dest.x   = (int16_t) dest_x;
-  dest.y   = (int16_t) dest_y;
-  source.w = (uint16_t) source_width;
-  source.h = (uint16_t) source_height;
+/* Tints a rectangle of a surface in place. */
+static void
+tint_surface_rect (SDL_Surface *surface,
+                   SDL_Rect *rect,
+                   const uint16_t tint[3])
+{
+  int32_t x;
+  int32_t y;
 
+  if (rect->w == 0 || rect->h == 0)
+    return;
 
-  SDL_BlitSurface (sg_screen, &source, sg_shadow, &dest);
-  /* The whole screen now needs updating! */
-  SDL_BlitSurface (sg_shadow, NULL, sg_screen, NULL);
-  sg_update_full_screen = true;
+  if (SDL_MUSTLOCK (surface))
+    SDL_LockSurface (surface);
+
+  if (surface->format->BytesPerPixel == 4)
+    {
+      uint16_t multipliers[4];
+      int i;
+
+      /* Work out which channel each byte of a pixel holds. */
+      for (i = 0; i < 4; i += 1)
+        {
+          int shift = (SDL_BYTEORDER == SDL_BIG_ENDIAN
+                       ? 24 - (8 * i)
+                       : 8 * i);
+          Uint32 byte_mask = (Uint32) 0xFF << shift;
+
+          if (surface->format->Rmask == byte_mask)
+            multipliers[i] = tint[0];
+          else if (surface->format->Gmask == byte_mask)
+            multipliers[i] = tint[1];
+          else if (surface->format->Bmask == byte_mask)
+            multipliers[i] = tint[2];
+          else
+            multipliers[i] = TINT_ONE;
+        }
+
+      for (y = rect->y; y < rect->y + rect->h; y += 1)
+        (*sg_tint_span) ((Uint8 *) surface->pixels
+                         + (y * surface->pitch) + (rect->x * 4),
+                         (uint32_t) rect->w * 4,
+                         multipliers);
+    }
+  else
+    {
+      /* Packed 8, 16 or 24-bit pixels; go through SDL's colour
+         conversion instead. */
+      for (y = rect->y; y < rect->y + rect->h; y += 1)
+        for (x = rect->x; x < rect->x + rect->w; x += 1)
+          {
+            Uint8 r, g, b;
+
+            SDL_GetRGB (get_pixel (surface, x, y), surface->format,
+                        &r, &g, &b);
+            put_pixel (surface, x, y,
+                       SDL_MapRGB (surface->format,
+                                   (Uint8) ((r * tint[0]) >> 8),
+                                   (Uint8) ((g * tint[1]) >> 8),
+                                   (Uint8) ((b * tint[2]) >> 8)));
+          }
+    }
+
+  if (SDL_MUSTLOCK (surface))
+    SDL_UnlockSurface (surface);
 }
@@ -0,0 +1,1357 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    modules/gfx-sdl2.c
+ * @author  agent
+ * @brief   SDL 2 implementation of graphics backend.
+ *
+ * Drawing goes through an SDL_Renderer, so it can be done by the GPU.
+ * Loaded images are uploaded to textures the first time they are
+ * drawn, and the screen is a texture that drawing builds up in.
+ * Presenting copies the screen to the window in one go, scaled by the
+ * output scale and tinted on the way.  Runs of drawing commands
+ * change as little of the renderer's state as they can, so SDL can
+ * send their copies and fills on together in batches.
+ *
+ * Renderers that cannot draw into textures get a fallback: drawing is
+ * done into surfaces in memory, as with gfx-sdl, and only the updated
+ * rectangles of the screen are uploaded, into a streaming texture.
+ *
+ * SDL's hints pick the renderer and vsync, and can be set from the
+ * environment: SDL_VIDEODRIVER=dummy with SDL_RENDER_DRIVER=software
+ * renders with no display at all, for build servers, and
+ * SDL_RENDER_VSYNC=1 waits for vertical sync on each present.
+ *
+ * SDL 2 renderers can only be used from the thread that created
+ * them, so this module asks for the render thread to be left off,
+ * and all drawing is done on the main thread.  Its window takes
+ * input through event-sdl2, on the same thread.
+ */
+
+
+#include "module.h"
+
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include "gfx-module.h" /* Module header file. */
+
+#undef G_LOG_DOMAIN
+#define G_LOG_DOMAIN "gfx-sdl2"
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  MAX_UPDATE_RECTS = 64,    /**< Most update rectangles kept before
+                               the whole screen is updated instead. */
+
+  MOSAIC_MAX_BLOCK = 32     /**< Size of mosaic blocks half way
+                               through a mosaic transition, in
+                               pixels. */
+};
+
+
+/**
+ * Alpha channel of a fully opaque ARGB pixel.
+ */
+#define OPAQUE_ALPHA 0xFF000000u
+
+
+/**
+ * How an image's pixels use transparency, which decides how it is
+ * blended.
+ */
+typedef enum image_transparency
+{
+  IMAGE_OPAQUE,     /**< Every pixel is fully opaque. */
+  IMAGE_KEYED,      /**< Every pixel is either fully opaque or fully
+                       transparent. */
+  IMAGE_TRANSLUCENT /**< Some pixels may be partly transparent. */
+} image_transparency_t;
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * An image, or the screen.
+ *
+ * When drawing into textures, every image is drawn from and into
+ * through its texture, and loaded images keep their surface only to
+ * be read back.  Otherwise, images are drawn from and into through
+ * their surfaces, and only the screen has a texture.
+ */
+typedef struct sdl2_image
+{
+  SDL_Surface *surface;   /**< The image's ARGB pixels in memory, or
+                             NULL if it has none yet. */
+  SDL_Texture *texture;   /**< The image's texture, or NULL if it has
+                             none yet. */
+  int width;              /**< Width of the image, in pixels. */
+  int height;             /**< Height of the image, in pixels. */
+  image_transparency_t transparency; /**< How the pixels use
+                                        transparency. */
+  bool transparent;       /**< Whether images drawn into this one
+                             keep their transparency, rather than
+                             being blended into it. */
+  bool created;           /**< Whether the image was made blank to be
+                             drawn into, rather than loaded. */
+} sdl2_image_t;
+
+
+/* -- STATIC GLOBAL VARIABLES -- */
+
+static SDL_Window *sg_window; /**< The window. */
+
+static SDL_Renderer *sg_renderer; /**< The window's renderer. */
+
+static bool sg_use_targets; /**< Whether the renderer can draw into
+                               textures. */
+
+static sdl2_image_t sg_screen; /**< The screen, as drawn. */
+
+static sdl2_image_t sg_spare; /**< A second screen, which the screen
+                                 is scrolled into. */
+
+static sdl2_image_t *sg_target; /**< The image being drawn into, or
+                                   NULL to draw to the screen. */
+
+static SDL_Texture *sg_bound; /**< The texture the renderer is drawing
+                                 into, or NULL for the window. */
+
+static SDL_Texture *sg_transition_from; /**< Copy of the screen being
+                                           transitioned from, or NULL
+                                           if there is no
+                                           transition. */
+
+static SDL_Texture *sg_mosaic; /**< Texture mosaic transitions shrink
+                                  the screen into, or NULL if none is
+                                  needed yet. */
+
+static SDL_Surface *sg_shade; /**< A white pixel, stretched over
+                                 rectangles to shade them when drawing
+                                 in memory. */
+
+static SDL_Rect sg_update_rects[MAX_UPDATE_RECTS]; /**< Rectangles to
+                                                      present on the
+                                                      next update. */
+
+static uint32_t sg_num_update_rects; /**< Number of update
+                                        rectangles. */
+
+static bool sg_update_full_screen; /**< If true then the entire
+                                      screen is presented on the next
+                                      update. */
+
+static uint8_t sg_tint[3]; /**< Red, green and blue tint applied to
+                              the screen as it is presented. */
+
+
+/* -- STATIC DECLARATIONS -- */
+
+/**
+ * Finds out how a freshly loaded image uses transparency.
+ *
+ * @param surface  The image's ARGB surface.
+ *
+ * @return  the kind of transparency the image uses.
+ */
+static image_transparency_t
+classify_surface (SDL_Surface *surface);
+
+
+/**
+ * Gives an image what it needs to be drawn with, or into, if it does
+ * not have it already.
+ *
+ * This happens on first use rather than when the image is made, as
+ * images may be made while another thread is drawing.
+ *
+ * @param image  The image.
+ *
+ * @return  true if the image can be drawn with; false otherwise.
+ */
+static bool
+prepare_image (sdl2_image_t *image);
+
+
+/**
+ * Frees an image's texture and surface, leaving the image itself.
+ *
+ * @param image  The image.
+ */
+static void
+clear_image (sdl2_image_t *image);
+
+
+/**
+ * Points the renderer at a texture, unless it already is.
+ *
+ * @param texture  The texture to draw into, or NULL for the window.
+ */
+static void
+bind_texture (SDL_Texture *texture);
+
+
+/**
+ * Frees a texture, first pointing the renderer away from it.
+ *
+ * @param texture  The texture to free, or NULL.
+ */
+static void
+destroy_texture (SDL_Texture *texture);
+
+
+/**
+ * Readies the image being drawn into, or the screen, for drawing.
+ *
+ * @return  the image to draw into, or NULL if it cannot be drawn
+ *          into.
+ */
+static sdl2_image_t *
+begin_drawing (void);
+
+
+/**
+ * Copies part of an image into the image being drawn into, or the
+ * screen, scaling it if the rectangles differ in size.
+ *
+ * @param image   The image to copy from.
+ * @param source  The rectangle of the image to copy.
+ * @param dest    The rectangle to copy it to.
+ */
+static void
+copy_image (sdl2_image_t *image,
+            const SDL_Rect *source,
+            const SDL_Rect *dest);
+
+
+/**
+ * Uploads a rectangle of the screen from memory into its texture.
+ *
+ * @param rect  The rectangle, in screen co-ordinates.
+ */
+static void
+upload_rect (const SDL_Rect *rect);
+
+
+/**
+ * Copies the screen to the window, tinted, ready to present.
+ */
+static void
+draw_screen_to_window (void);
+
+
+/**
+ * Covers the window with a mosaic of the kept screen or the screen.
+ *
+ * @param progress  How far through the transition to show.
+ */
+static void
+mosaic_window (uint16_t progress);
+
+
+/* -- DEFINITIONS -- */
+
+/* Initialises the module. */
+EXPORT bool
+init (void)
+{
+  sg_window = NULL;
+  sg_renderer = NULL;
+  sg_use_targets = false;
+  memset (&sg_screen, 0, sizeof (sg_screen));
+  memset (&sg_spare, 0, sizeof (sg_spare));
+  sg_target = NULL;
+  sg_bound = NULL;
+  sg_transition_from = NULL;
+  sg_mosaic = NULL;
+  sg_shade = NULL;
+  sg_num_update_rects = 0;
+  sg_update_full_screen = false;
+  sg_tint[0] = sg_tint[1] = sg_tint[2] = 255;
+
+  return true;
+}
+
+
+/* Terminates the module, freeing any remaining data dynamically
+   allocated by the module. */
+EXPORT void
+term (void)
+{
+  end_transition_internal ();
+  clear_image (&sg_spare);
+  clear_image (&sg_screen);
+
+  if (sg_shade != NULL)
+    {
+      SDL_FreeSurface (sg_shade);
+      sg_shade = NULL;
+    }
+
+  if (sg_renderer != NULL)
+    {
+      SDL_DestroyRenderer (sg_renderer);
+      sg_renderer = NULL;
+    }
+
+  if (sg_window != NULL)
+    {
+      SDL_DestroyWindow (sg_window);
+      sg_window = NULL;
+
+      IMG_Quit ();
+      SDL_Quit ();
+    }
+
+  sg_target = NULL;
+  sg_bound = NULL;
+}
+
+
+/* Initialises a screen of a given width, height and depth. */
+EXPORT bool
+init_screen_internal (uint16_t width, uint16_t height, uint8_t depth)
+{
+  /* Everything is 32-bit here, whatever the depth asked for. */
+  (void) depth;
+
+  if (SDL_Init (SDL_INIT_VIDEO) != 0)
+    {
+      g_critical ("Could not initialise SDL: %s", SDL_GetError ());
+      return false;
+    }
+
+  /* SDL_image loads its PNG support on first use, which is not safe
+     if the first use is from several preloading threads at once. */
+  if ((IMG_Init (IMG_INIT_PNG) & IMG_INIT_PNG) == 0)
+    g_warning ("Could not initialise PNG loading early.");
+
+  /* Scaled pixels stay sharp, and the renderer may hold draws back to
+     send them on together.  Both can still be overridden from the
+     environment. */
+  SDL_SetHint (SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+  SDL_SetHint (SDL_HINT_RENDER_BATCHING, "1");
+
+  sg_window = SDL_CreateWindow ("crystals",
+                                SDL_WINDOWPOS_UNDEFINED,
+                                SDL_WINDOWPOS_UNDEFINED,
+                                width,
+                                height,
+                                0);
+  if (sg_window == NULL)
+    {
+      g_critical ("Could not init screen: %s", SDL_GetError ());
+      IMG_Quit ();
+      SDL_Quit ();
+      return false;
+    }
+
+  sg_renderer = SDL_CreateRenderer (sg_window, -1, 0);
+  if (sg_renderer == NULL)
+    {
+      g_critical ("Could not create a renderer: %s", SDL_GetError ());
+      term ();
+      return false;
+    }
+
+  /* Drawing to the window is in screen co-ordinates, whatever size
+     the output scale makes it. */
+  SDL_RenderSetLogicalSize (sg_renderer, width, height);
+
+  sg_use_targets = (SDL_RenderTargetSupported (sg_renderer) == SDL_TRUE);
+  if (!sg_use_targets)
+    g_message ("Renderer can't draw into textures; drawing in memory.");
+
+  sg_screen.width = sg_spare.width = width;
+  sg_screen.height = sg_spare.height = height;
+  sg_screen.transparency = sg_spare.transparency = IMAGE_OPAQUE;
+  sg_screen.created = sg_spare.created = true;
+
+  if (!prepare_image (&sg_screen) || !prepare_image (&sg_spare))
+    {
+      g_critical ("Could not create %ux%u screen.", width, height);
+      term ();
+      return false;
+    }
+
+  if (!sg_use_targets)
+    {
+      sg_screen.texture = SDL_CreateTexture (sg_renderer,
+                                             SDL_PIXELFORMAT_ARGB8888,
+                                             SDL_TEXTUREACCESS_STREAMING,
+                                             width,
+                                             height);
+      sg_shade = SDL_CreateRGBSurfaceWithFormat (0, 1, 1, 32,
+                                                 SDL_PIXELFORMAT_ARGB8888);
+      if (sg_screen.texture == NULL || sg_shade == NULL)
+        {
+          g_critical ("Could not create %ux%u screen.", width, height);
+          term ();
+          return false;
+        }
+
+      SDL_SetTextureBlendMode (sg_screen.texture, SDL_BLENDMODE_NONE);
+
+      /* Multiplying by a grey darkens the colour and leaves the alpha
+         alone. */
+      SDL_FillRect (sg_shade, NULL, 0xFFFFFFFFu);
+      SDL_SetSurfaceBlendMode (sg_shade, SDL_BLENDMODE_MOD);
+    }
+
+  sg_update_full_screen = true;
+  return true;
+}
+
+
+/* Draws a rectangle of colour on-screen. */
+EXPORT void
+draw_rect_internal (int16_t x,
+                    int16_t y,
+                    uint16_t width,
+                    uint16_t height,
+                    uint8_t red,
+                    uint8_t green,
+                    uint8_t blue)
+{
+  sdl2_image_t *dest = begin_drawing ();
+  SDL_Rect rect;
+
+  if (dest == NULL)
+    return;
+
+  rect.x = x;
+  rect.y = y;
+  rect.w = width;
+  rect.h = height;
+
+  if (sg_use_targets)
+    {
+      SDL_SetRenderDrawBlendMode (sg_renderer, SDL_BLENDMODE_NONE);
+      SDL_SetRenderDrawColor (sg_renderer, red, green, blue, 255);
+      SDL_RenderFillRect (sg_renderer, &rect);
+    }
+  else
+    SDL_FillRect (dest->surface, &rect,
+                  (OPAQUE_ALPHA
+                   | ((uint32_t) red << 16)
+                   | ((uint32_t) green << 8)
+                   | (uint32_t) blue));
+}
+
+
+/* Loads an image and returns its data in the module's native format. */
+EXPORT void *
+load_image_data (const char filename[])
+{
+  SDL_Surface *loaded;
+  SDL_Surface *surface;
+  sdl2_image_t *image;
+
+  loaded = IMG_Load (filename);
+  if (loaded == NULL)
+    {
+      g_critical ("Couldn't load %s!", filename);
+      return NULL;
+    }
+
+  /* This may run on a preloading thread, so the image is only
+     converted here; it gets its texture when it is first drawn. */
+  surface = SDL_ConvertSurfaceFormat (loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+  SDL_FreeSurface (loaded);
+  if (surface == NULL)
+    {
+      g_critical ("Couldn't convert %s!", filename);
+      return NULL;
+    }
+
+  image = calloc (1, sizeof (sdl2_image_t));
+  if (image == NULL)
+    {
+      g_critical ("Couldn't allocate image data for %s!", filename);
+      SDL_FreeSurface (surface);
+      return NULL;
+    }
+
+  image->surface = surface;
+  image->width = surface->w;
+  image->height = surface->h;
+  image->transparency = classify_surface (surface);
+  image->transparent = (image->transparency != IMAGE_OPAQUE);
+  image->created = false;
+
+  SDL_SetSurfaceBlendMode (surface,
+                           (image->transparency == IMAGE_OPAQUE
+                            ? SDL_BLENDMODE_NONE
+                            : SDL_BLENDMODE_BLEND));
+  return (void *) image;
+}
+
+
+/* Frees image data retrieved by load_image_data. */
+EXPORT void
+free_image_data (void *data)
+{
+  sdl2_image_t *image = (sdl2_image_t *) data;
+
+  if (image == NULL)
+    return;
+
+  clear_image (image);
+  free (image);
+}
+
+
+/* Retrieves the dimensions of an image. */
+EXPORT void
+get_image_dimensions_internal (void *image,
+                               uint16_t *width,
+                               uint16_t *height)
+{
+  sdl2_image_t *imagec = (sdl2_image_t *) image;
+
+  g_assert (imagec != NULL);
+
+  *width = (uint16_t) imagec->width;
+  *height = (uint16_t) imagec->height;
+}
+
+
+/* Retrieves the amount of memory an image's pixels take up. */
+EXPORT uint32_t
+get_image_bytes_internal (void *image)
+{
+  sdl2_image_t *imagec = (sdl2_image_t *) image;
+  uint32_t bytes;
+
+  g_assert (imagec != NULL);
+
+  bytes = (uint32_t) imagec->width * (uint32_t) imagec->height * 4;
+
+  /* Loaded images keep their surface alongside their texture. */
+  if (sg_use_targets && !imagec->created)
+    bytes *= 2;
+
+  return bytes;
+}
+
+
+/* Draws a rectangular portion of an image on-screen. */
+EXPORT void
+draw_image_internal (void *image,
+                     int16_t image_x,
+                     int16_t image_y,
+                     int16_t screen_x,
+                     int16_t screen_y,
+                     uint16_t width,
+                     uint16_t height)
+{
+  SDL_Rect source;
+  SDL_Rect dest;
+
+  g_assert (image != NULL);
+
+  source.x = image_x;
+  source.y = image_y;
+  dest.x = screen_x;
+  dest.y = screen_y;
+  source.w = dest.w = width;
+  source.h = dest.h = height;
+
+  copy_image ((sdl2_image_t *) image, &source, &dest);
+}
+
+
+/* Draws a batch of drawing commands. */
+EXPORT void
+draw_batch_internal (draw_command_t commands[], uint32_t count)
+{
+  uint32_t i;
+
+  /* The target is bound by the first command and stays bound, so the
+     renderer can queue up the whole batch. */
+  for (i = 0; i < count; i += 1)
+    {
+      draw_command_t *command = &(commands[i]);
+
+      if (command->type == DRAW_COMMAND_IMAGE)
+        draw_image_internal (command->image,
+                             command->image_x,
+                             command->image_y,
+                             command->screen_x,
+                             command->screen_y,
+                             command->width,
+                             command->height);
+      else if (command->type == DRAW_COMMAND_RECT)
+        draw_rect_internal (command->screen_x,
+                            command->screen_y,
+                            command->width,
+                            command->height,
+                            command->red,
+                            command->green,
+                            command->blue);
+    }
+}
+
+
+/* Creates a blank image to draw into. */
+EXPORT void *
+create_image_data (uint16_t width, uint16_t height, bool transparent)
+{
+  sdl2_image_t *image;
+
+  image = calloc (1, sizeof (sdl2_image_t));
+  if (image == NULL)
+    {
+      g_critical ("Couldn't create %ux%u image!", width, height);
+      return NULL;
+    }
+
+  /* What will be drawn into a transparent image is unknown, so it
+     has to be blended.  Its pixels are made when it is first
+     used. */
+  image->width = width;
+  image->height = height;
+  image->transparent = transparent;
+  image->transparency = (transparent ? IMAGE_TRANSLUCENT : IMAGE_OPAQUE);
+  image->created = true;
+  return (void *) image;
+}
+
+
+/* Redirects drawing into an image, or back to the screen. */
+EXPORT void
+set_draw_target_internal (void *image)
+{
+  sg_target = (sdl2_image_t *) image;
+}
+
+
+/* Draws a rectangular portion of an image, scaled. */
+EXPORT void
+draw_image_scaled_internal (void *image,
+                            int16_t image_x,
+                            int16_t image_y,
+                            uint16_t image_width,
+                            uint16_t image_height,
+                            int16_t screen_x,
+                            int16_t screen_y,
+                            uint16_t width,
+                            uint16_t height)
+{
+  SDL_Rect source;
+  SDL_Rect dest;
+
+  g_assert (image != NULL);
+
+  if (width == 0 || height == 0)
+    return;
+
+  source.x = image_x;
+  source.y = image_y;
+  source.w = image_width;
+  source.h = image_height;
+  dest.x = screen_x;
+  dest.y = screen_y;
+  dest.w = width;
+  dest.h = height;
+
+  copy_image ((sdl2_image_t *) image, &source, &dest);
+}
+
+
+/* Works out the average colour of a rectangular portion of an
+   image. */
+EXPORT void
+get_image_average_colour_internal (void *image,
+                                   int16_t image_x,
+                                   int16_t image_y,
+                                   uint16_t width,
+                                   uint16_t height,
+                                   uint8_t colour[4])
+{
+  sdl2_image_t *source = (sdl2_image_t *) image;
+  SDL_Rect whole;
+  SDL_Rect wanted;
+  SDL_Rect rect;
+  uint32_t totals[3] = { 0, 0, 0 };
+  uint32_t opaque = 0;
+  int x;
+  int y;
+
+  g_assert (source != NULL);
+  g_assert (colour != NULL);
+
+  colour[0] = colour[1] = colour[2] = colour[3] = 0;
+
+  /* Images drawn into by the renderer have no pixels in memory to
+     read. */
+  if (source->surface == NULL)
+    return;
+
+  whole.x = whole.y = 0;
+  whole.w = source->width;
+  whole.h = source->height;
+  wanted.x = image_x;
+  wanted.y = image_y;
+  wanted.w = width;
+  wanted.h = height;
+
+  if (!SDL_IntersectRect (&wanted, &whole, &rect))
+    return;
+
+  if (SDL_MUSTLOCK (source->surface))
+    SDL_LockSurface (source->surface);
+
+  for (y = rect.y; y < rect.y + rect.h; y += 1)
+    {
+      const uint32_t *row = (const uint32_t *)
+        ((const uint8_t *) source->surface->pixels
+         + (y * source->surface->pitch));
+
+      for (x = rect.x; x < rect.x + rect.w; x += 1)
+        {
+          uint32_t pixel = row[x];
+
+          if ((pixel >> 24) < 128)
+            continue;
+
+          totals[0] += (pixel >> 16) & 0xFF;
+          totals[1] += (pixel >> 8) & 0xFF;
+          totals[2] += pixel & 0xFF;
+          opaque += 1;
+        }
+    }
+
+  if (SDL_MUSTLOCK (source->surface))
+    SDL_UnlockSurface (source->surface);
+
+  if (opaque == 0)
+    return;
+
+  colour[0] = (uint8_t) (totals[0] / opaque);
+  colour[1] = (uint8_t) (totals[1] / opaque);
+  colour[2] = (uint8_t) (totals[2] / opaque);
+  colour[3] = (uint8_t) ((opaque * 255) / ((uint32_t) width * height));
+}
+
+
+/* Sets the colour tint applied to the screen as it is presented. */
+EXPORT void
+set_tint_internal (uint8_t red, uint8_t green, uint8_t blue)
+{
+  if (red == sg_tint[0] && green == sg_tint[1] && blue == sg_tint[2])
+    return;
+
+  sg_tint[0] = red;
+  sg_tint[1] = green;
+  sg_tint[2] = blue;
+  sg_update_full_screen = true;
+}
+
+
+/* Darkens a rectangle of what has already been drawn. */
+EXPORT void
+shade_rect_internal (int16_t x,
+                     int16_t y,
+                     uint16_t width,
+                     uint16_t height,
+                     uint8_t brightness)
+{
+  sdl2_image_t *dest;
+  SDL_Rect rect;
+
+  if (brightness == 255)
+    return;
+
+  dest = begin_drawing ();
+  if (dest == NULL)
+    return;
+
+  rect.x = x;
+  rect.y = y;
+  rect.w = width;
+  rect.h = height;
+
+  /* Either way, the colour is multiplied by a grey, which leaves the
+     alpha alone. */
+  if (sg_use_targets)
+    {
+      SDL_SetRenderDrawBlendMode (sg_renderer, SDL_BLENDMODE_MOD);
+      SDL_SetRenderDrawColor (sg_renderer,
+                              brightness, brightness, brightness, 255);
+      SDL_RenderFillRect (sg_renderer, &rect);
+    }
+  else
+    {
+      SDL_SetSurfaceColorMod (sg_shade, brightness, brightness, brightness);
+      SDL_BlitScaled (sg_shade, NULL, dest->surface, &rect);
+    }
+}
+
+
+/* Adds a rectangle to the next update run. */
+EXPORT void
+add_update_rectangle_internal (int16_t x,
+                               int16_t y,
+                               uint16_t width,
+                               uint16_t height)
+{
+  SDL_Rect *rect;
+
+  if (sg_update_full_screen)
+    return;
+
+  if (sg_num_update_rects == MAX_UPDATE_RECTS)
+    {
+      sg_update_full_screen = true;
+      return;
+    }
+
+  rect = &(sg_update_rects[sg_num_update_rects]);
+  rect->x = x;
+  rect->y = y;
+  rect->w = width;
+  rect->h = height;
+  sg_num_update_rects += 1;
+}
+
+
+/* Updates the screen. */
+EXPORT void
+update_screen_internal (void)
+{
+  uint32_t i;
+
+  if (!sg_update_full_screen && sg_num_update_rects == 0)
+    return;
+
+  /* The whole screen texture is presented either way; when drawing
+     in memory, only the updated parts of it need uploading first. */
+  if (!sg_use_targets)
+    {
+      if (sg_update_full_screen)
+        upload_rect (NULL);
+      else
+        for (i = 0; i < sg_num_update_rects; i += 1)
+          upload_rect (&(sg_update_rects[i]));
+    }
+
+  draw_screen_to_window ();
+  SDL_RenderPresent (sg_renderer);
+
+  sg_update_full_screen = false;
+  sg_num_update_rects = 0;
+}
+
+
+/* Translate the screen by a co-ordinate pair, leaving damage. */
+EXPORT void
+scroll_screen_internal (int16_t x_offset, int16_t y_offset)
+{
+  SDL_Rect dest;
+  sdl2_image_t swap;
+
+  dest.x = x_offset;
+  dest.y = y_offset;
+  dest.w = sg_screen.width;
+  dest.h = sg_screen.height;
+
+  /* The screen is copied, moved, into the spare screen, and the two
+     change places.  The strips uncovered keep stale data, which the
+     caller is expected to redraw. */
+  if (sg_use_targets)
+    {
+      bind_texture (sg_spare.texture);
+      SDL_SetTextureColorMod (sg_screen.texture, 255, 255, 255);
+      SDL_RenderCopy (sg_renderer, sg_screen.texture, NULL, &dest);
+    }
+  else
+    SDL_BlitSurface (sg_screen.surface, NULL, sg_spare.surface, &dest);
+
+  /* When drawing in memory, the streaming texture stays with the
+     screen. */
+  swap = sg_screen;
+  sg_screen = sg_spare;
+  sg_spare = swap;
+
+  if (!sg_use_targets)
+    {
+      sg_screen.texture = sg_spare.texture;
+      sg_spare.texture = NULL;
+    }
+
+  /* The whole screen now needs updating! */
+  sg_update_full_screen = true;
+}
+
+
+/* Keeps the screen as last drawn, to transition from. */
+EXPORT bool
+begin_transition_internal (void)
+{
+  SDL_Texture *kept;
+
+  end_transition_internal ();
+
+  if (sg_use_targets)
+    {
+      kept = SDL_CreateTexture (sg_renderer,
+                                SDL_PIXELFORMAT_ARGB8888,
+                                SDL_TEXTUREACCESS_TARGET,
+                                sg_screen.width,
+                                sg_screen.height);
+      if (kept != NULL)
+        {
+          bind_texture (kept);
+          SDL_SetTextureColorMod (sg_screen.texture, 255, 255, 255);
+          SDL_RenderCopy (sg_renderer, sg_screen.texture, NULL, NULL);
+        }
+    }
+  else
+    kept = SDL_CreateTextureFromSurface (sg_renderer, sg_screen.surface);
+
+  if (kept == NULL)
+    {
+      g_warning ("Could not keep the screen for a transition.");
+      return false;
+    }
+
+  /* It is drawn over the screen, tinted as it was when kept. */
+  SDL_SetTextureBlendMode (kept, SDL_BLENDMODE_BLEND);
+  SDL_SetTextureColorMod (kept, sg_tint[0], sg_tint[1], sg_tint[2]);
+  sg_transition_from = kept;
+  return true;
+}
+
+
+/* Updates the whole screen with a mix of the kept screen and what has
+   been drawn since. */
+EXPORT void
+present_transition_internal (transition_type_t type, uint16_t progress)
+{
+  int width = sg_screen.width;
+  int height = sg_screen.height;
+
+  g_assert (sg_transition_from != NULL);
+
+  if (!sg_use_targets)
+    upload_rect (NULL);
+
+  draw_screen_to_window ();
+
+  /* Mosaics shrink the screen into a texture, so without those, fade
+     instead. */
+  if (type == TRANSITION_MOSAIC && !sg_use_targets)
+    type = TRANSITION_FADE;
+
+  if (progress < TRANSITION_ONE)
+    switch (type)
+      {
+      case TRANSITION_WIPE:
+        {
+          /* Cover the unwiped part with the kept screen. */
+          SDL_Rect rest;
+
+          rest.x = (width * progress) / TRANSITION_ONE;
+          rest.y = 0;
+          rest.w = width - rest.x;
+          rest.h = height;
+          SDL_RenderCopy (sg_renderer, sg_transition_from, &rest, &rest);
+        }
+        break;
+      case TRANSITION_MOSAIC:
+        mosaic_window (progress);
+        break;
+      case TRANSITION_FADE:
+      default:
+        SDL_SetTextureAlphaMod (sg_transition_from,
+                                (uint8_t) ((255 * (TRANSITION_ONE
+                                                   - progress))
+                                           / TRANSITION_ONE));
+        SDL_RenderCopy (sg_renderer, sg_transition_from, NULL, NULL);
+        SDL_SetTextureAlphaMod (sg_transition_from, 255);
+        break;
+      }
+
+  SDL_RenderPresent (sg_renderer);
+
+  sg_update_full_screen = false;
+  sg_num_update_rects = 0;
+}
+
+
+/* Frees the kept screen. */
+EXPORT void
+end_transition_internal (void)
+{
+  destroy_texture (sg_mosaic);
+  sg_mosaic = NULL;
+
+  if (sg_transition_from == NULL)
+    return;
+
+  destroy_texture (sg_transition_from);
+  sg_transition_from = NULL;
+  sg_update_full_screen = true;
+}
+
+
+/* Presents the screen scaled up by a whole number. */
+EXPORT bool
+set_output_scale_internal (uint8_t scale, output_filter_t filter)
+{
+  g_assert (scale >= 1 && scale <= 4);
+
+  /* The renderer stretches the screen to fit the window. */
+  if (filter != OUTPUT_NEAREST)
+    g_message ("Only scaling by repeating pixels is available.");
+
+  SDL_SetWindowSize (sg_window,
+                     sg_screen.width * scale,
+                     sg_screen.height * scale);
+  sg_update_full_screen = true;
+  return true;
+}
+
+
+/* Says whether all drawing must be done on the thread that created
+   the screen. */
+EXPORT bool
+is_thread_bound_internal (void)
+{
+  /* SDL 2 only lets a renderer, and the window it draws to, be used
+     from the thread that created them. */
+  return true;
+}
+
+
+/* -- STATIC DEFINITIONS -- */
+
+/* Finds out how a freshly loaded image uses transparency. */
+static image_transparency_t
+classify_surface (SDL_Surface *surface)
+{
+  image_transparency_t result = IMAGE_OPAQUE;
+  int x;
+  int y;
+
+  for (y = 0; y < surface->h; y += 1)
+    {
+      const uint32_t *row = (const uint32_t *)
+        ((const uint8_t *) surface->pixels + (y * surface->pitch));
+
+      for (x = 0; x < surface->w; x += 1)
+        {
+          uint32_t alpha = row[x] & OPAQUE_ALPHA;
+
+          if (alpha == 0)
+            result = IMAGE_KEYED;
+          else if (alpha != OPAQUE_ALPHA)
+            return IMAGE_TRANSLUCENT;
+        }
+    }
+
+  return result;
+}
+
+
+/* Gives an image what it needs to be drawn with, or into. */
+static bool
+prepare_image (sdl2_image_t *image)
+{
+  SDL_BlendMode blend = (image->transparency == IMAGE_OPAQUE
+                         ? SDL_BLENDMODE_NONE
+                         : SDL_BLENDMODE_BLEND);
+
+  if (sg_use_targets && image->texture == NULL)
+    {
+      if (image->created)
+        image->texture = SDL_CreateTexture (sg_renderer,
+                                            SDL_PIXELFORMAT_ARGB8888,
+                                            SDL_TEXTUREACCESS_TARGET,
+                                            image->width,
+                                            image->height);
+      else
+        image->texture = SDL_CreateTextureFromSurface (sg_renderer,
+                                                       image->surface);
+
+      if (image->texture == NULL)
+        {
+          g_critical ("Couldn't make %dx%d texture: %s",
+                      image->width, image->height, SDL_GetError ());
+          return false;
+        }
+
+      SDL_SetTextureBlendMode (image->texture, blend);
+
+      if (image->created)
+        {
+          SDL_Texture *bound = sg_bound;
+
+          bind_texture (image->texture);
+          SDL_SetRenderDrawColor (sg_renderer, 0, 0, 0,
+                                  (image->transparent ? 0 : 255));
+          SDL_RenderClear (sg_renderer);
+          bind_texture (bound);
+        }
+    }
+  else if (!sg_use_targets && image->surface == NULL)
+    {
+      image->surface = SDL_CreateRGBSurfaceWithFormat (0,
+                                                       image->width,
+                                                       image->height,
+                                                       32,
+                                                       SDL_PIXELFORMAT_ARGB8888);
+      if (image->surface == NULL)
+        {
+          g_critical ("Couldn't make %dx%d surface: %s",
+                      image->width, image->height, SDL_GetError ());
+          return false;
+        }
+
+      SDL_SetSurfaceBlendMode (image->surface, blend);
+      SDL_FillRect (image->surface, NULL,
+                    (image->transparent ? 0 : OPAQUE_ALPHA));
+    }
+
+  return true;
+}
+
+
+/* Frees an image's texture and surface. */
+static void
+clear_image (sdl2_image_t *image)
+{
+  destroy_texture (image->texture);
+  image->texture = NULL;
+
+  if (image->surface != NULL)
+    {
+      SDL_FreeSurface (image->surface);
+      image->surface = NULL;
+    }
+}
+
+
+/* Points the renderer at a texture, unless it already is. */
+static void
+bind_texture (SDL_Texture *texture)
+{
+  /* Changing target makes the renderer send on what it has queued, so
+     it is only done when needed. */
+  if (texture == sg_bound)
+    return;
+
+  SDL_SetRenderTarget (sg_renderer, texture);
+  sg_bound = texture;
+}
+
+
+/* Frees a texture, first pointing the renderer away from it. */
+static void
+destroy_texture (SDL_Texture *texture)
+{
+  if (texture == NULL)
+    return;
+
+  /* A new texture could be given the same address, which would then
+     look bound when it is not. */
+  if (texture == sg_bound)
+    bind_texture (NULL);
+
+  SDL_DestroyTexture (texture);
+}
+
+
+/* Readies the image being drawn into, or the screen, for drawing. */
+static sdl2_image_t *
+begin_drawing (void)
+{
+  sdl2_image_t *dest = (sg_target != NULL ? sg_target : &sg_screen);
+
+  if (!prepare_image (dest))
+    return NULL;
+
+  if (sg_use_targets)
+    bind_texture (dest->texture);
+
+  return dest;
+}
+
+
+/* Copies part of an image into the image being drawn into. */
+static void
+copy_image (sdl2_image_t *image,
+            const SDL_Rect *source,
+            const SDL_Rect *dest)
+{
+  sdl2_image_t *target;
+  bool copy;
+
+  if (!prepare_image (image))
+    return;
+
+  target = begin_drawing ();
+  if (target == NULL)
+    return;
+
+  /* Into a transparent image, partly transparent pixels are copied
+     rather than blended, so it keeps their transparency. */
+  copy = (image->transparency == IMAGE_TRANSLUCENT && target->transparent);
+
+  if (sg_use_targets)
+    {
+      if (copy)
+        SDL_SetTextureBlendMode (image->texture, SDL_BLENDMODE_NONE);
+
+      SDL_RenderCopy (sg_renderer, image->texture, source, dest);
+
+      if (copy)
+        SDL_SetTextureBlendMode (image->texture, SDL_BLENDMODE_BLEND);
+    }
+  else
+    {
+      /* SDL clips the destination rectangle it is given. */
+      SDL_Rect clipped = *dest;
+
+      if (copy)
+        SDL_SetSurfaceBlendMode (image->surface, SDL_BLENDMODE_NONE);
+
+      if (source->w == dest->w && source->h == dest->h)
+        SDL_BlitSurface (image->surface, source, target->surface, &clipped);
+      else
+        SDL_BlitScaled (image->surface, source, target->surface, &clipped);
+
+      if (copy)
+        SDL_SetSurfaceBlendMode (image->surface, SDL_BLENDMODE_BLEND);
+    }
+}
+
+
+/* Uploads a rectangle of the screen from memory into its texture. */
+static void
+upload_rect (const SDL_Rect *rect)
+{
+  SDL_Surface *surface = sg_screen.surface;
+  SDL_Rect whole;
+  SDL_Rect clipped;
+  const uint8_t *pixels;
+
+  whole.x = whole.y = 0;
+  whole.w = sg_screen.width;
+  whole.h = sg_screen.height;
+
+  if (rect == NULL)
+    clipped = whole;
+  else if (!SDL_IntersectRect (rect, &whole, &clipped))
+    return;
+
+  pixels = ((const uint8_t *) surface->pixels
+            + (clipped.y * surface->pitch)
+            + (clipped.x * 4));
+  SDL_UpdateTexture (sg_screen.texture, &clipped, pixels, surface->pitch);
+}
+
+
+/* Copies the screen to the window, tinted, ready to present. */
+static void
+draw_screen_to_window (void)
+{
+  bind_texture (NULL);
+  SDL_SetTextureColorMod (sg_screen.texture,
+                          sg_tint[0], sg_tint[1], sg_tint[2]);
+  SDL_RenderCopy (sg_renderer, sg_screen.texture, NULL, NULL);
+}
+
+
+/* Covers the window with a mosaic of the kept screen or the
+   screen. */
+static void
+mosaic_window (uint16_t progress)
+{
+  SDL_Texture *source;
+  SDL_Rect small;
+  SDL_Rect large;
+  int distance;
+  int block;
+
+  /* Blocks grow towards the half-way point, where the picture
+     changes over, and shrink after it. */
+  if (progress < TRANSITION_ONE / 2)
+    {
+      source = sg_transition_from;
+      distance = progress;
+    }
+  else
+    {
+      source = sg_screen.texture;
+      distance = TRANSITION_ONE - progress;
+    }
+
+  block = 1 + (((MOSAIC_MAX_BLOCK - 1) * distance * 2) / TRANSITION_ONE);
+
+  if (block == 1 && source == sg_screen.texture)
+    return;
+
+  if (sg_mosaic == NULL)
+    {
+      sg_mosaic = SDL_CreateTexture (sg_renderer,
+                                     SDL_PIXELFORMAT_ARGB8888,
+                                     SDL_TEXTUREACCESS_TARGET,
+                                     sg_screen.width,
+                                     sg_screen.height);
+      if (sg_mosaic == NULL)
+        return;
+    }
+
+  /* Shrink the picture to a pixel a block, then stretch it back. */
+  small.x = small.y = large.x = large.y = 0;
+  small.w = (sg_screen.width + block - 1) / block;
+  small.h = (sg_screen.height + block - 1) / block;
+  large.w = small.w * block;
+  large.h = small.h * block;
+
+  bind_texture (sg_mosaic);
+  SDL_RenderCopy (sg_renderer, source, NULL, &small);
+  bind_texture (NULL);
+  SDL_RenderCopy (sg_renderer, sg_mosaic, &small, &large);
+}
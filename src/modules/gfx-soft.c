@@ -0,0 +1,1586 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    modules/gfx-soft.c
+ * @author  agent
+ * @brief   Headless software implementation of graphics backend.
+ *
+ * Nothing here needs a display.  The screen, and every image, is a
+ * block of 32-bit ARGB pixels in memory, and all drawing is done by
+ * the module's own kernels, so the cost of rendering can be measured
+ * on machines without a window system.  Images are decoded with
+ * libpng.
+ *
+ * Each loaded image is checked once for how it uses transparency,
+ * which picks its blit kernel: rows of opaque images are copied
+ * whole, colour-keyed images (only fully opaque or fully transparent
+ * pixels) skip their transparent pixels, and only images with
+ * partly transparent pixels are blended.  Blending works on the red
+ * and blue channels of a pixel together, then the green, rather than
+ * one channel at a time.  Fills write one row, then copy it.  Where
+ * the processor has SSE2, the keyed, blending and tinting kernels
+ * work on four pixels at a time instead.
+ *
+ * Presenting copies the updated rectangles into a second buffer,
+ * which holds what would be on-screen: tinted, mixed with the kept
+ * screen during transitions, but never drawn into.  That buffer can
+ * be written out as a PNG, scaled by the output scale, through
+ * dump_screen_internal.
+ */
+
+
+#include "module.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <png.h>
+
+#include "gfx-module.h" /* Module header file. */
+
+/* The SIMD pixel kernels need GCC's per-function target attributes;
+   elsewhere only the scalar kernels are built. */
+#if defined (__GNUC__) \
+  && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) \
+  && (defined (__i386__) || defined (__x86_64__))
+#define PIXEL_SIMD
+#include <immintrin.h>
+#endif /* __GNUC__ >= 4.9 on x86 */
+
+#undef G_LOG_DOMAIN
+#define G_LOG_DOMAIN "gfx-soft"
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  MULTIPLIER_ONE = 256,     /**< Channel multiplier that leaves a
+                               channel unchanged. */
+
+  MAX_UPDATE_RECTS = 64,    /**< Most update rectangles kept before
+                               the whole screen is updated instead. */
+
+  MOSAIC_MAX_BLOCK = 32     /**< Size of mosaic blocks half way
+                               through a mosaic transition, in
+                               pixels. */
+};
+
+
+/**
+ * Alpha channel of a fully opaque pixel.
+ */
+#define OPAQUE_ALPHA 0xFF000000u
+
+
+/**
+ * How an image's pixels use transparency, which decides how it is
+ * blitted.
+ */
+typedef enum image_transparency
+{
+  IMAGE_OPAQUE,     /**< Every pixel is fully opaque. */
+  IMAGE_KEYED,      /**< Every pixel is either fully opaque or fully
+                       transparent. */
+  IMAGE_TRANSLUCENT /**< Some pixels may be partly transparent. */
+} image_transparency_t;
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * An image, or the screen: a block of ARGB pixels.
+ */
+typedef struct soft_image
+{
+  uint32_t *pixels;       /**< The pixels, a row at a time from the
+                             top, each 0xAARRGGBB. */
+  int32_t width;          /**< Width of the image, in pixels. */
+  int32_t height;         /**< Height of the image, in pixels. */
+  image_transparency_t transparency; /**< How the pixels use
+                                        transparency. */
+  bool transparent;       /**< Whether images drawn into this one
+                             keep their transparency, rather than
+                             being blended into it. */
+} soft_image_t;
+
+
+/**
+ * A rectangle of the screen.
+ */
+typedef struct soft_rect
+{
+  int32_t x;       /**< X co-ordinate of the left edge. */
+  int32_t y;       /**< Y co-ordinate of the top edge. */
+  int32_t width;   /**< Width, in pixels. */
+  int32_t height;  /**< Height, in pixels. */
+} soft_rect_t;
+
+
+/* -- STATIC GLOBAL VARIABLES -- */
+
+static soft_image_t *sg_screen; /**< The screen, as drawn. */
+
+static soft_image_t *sg_presented; /**< The screen as last presented,
+                                      tinted and mixed with any
+                                      transition. */
+
+static soft_image_t *sg_target; /**< The image being drawn into, or
+                                   NULL to draw to the screen. */
+
+static soft_image_t *sg_transition_from; /**< Copy of the presented
+                                            screen being transitioned
+                                            from, or NULL if there is
+                                            no transition. */
+
+static soft_rect_t sg_update_rects[MAX_UPDATE_RECTS]; /**< Rectangles
+                                                         to present on
+                                                         the next
+                                                         update. */
+
+static uint32_t sg_num_update_rects; /**< Number of update
+                                        rectangles. */
+
+static bool sg_update_full_screen; /**< If true then the entire
+                                      screen is presented on the next
+                                      update. */
+
+static uint16_t sg_tint[3]; /**< Red, green and blue tint multipliers,
+                               out of MULTIPLIER_ONE. */
+
+static bool sg_tinted; /**< Whether the tint changes anything. */
+
+static uint8_t sg_output_scale; /**< Scale of dumped frames relative
+                                   to the screen. */
+
+static void (*sg_copy_keyed_span) (uint32_t *out,
+                                   const uint32_t *in,
+                                   int32_t length);
+/**< The fastest keyed copy kernel the processor supports. */
+
+static void (*sg_blend_span) (uint32_t *out,
+                              const uint32_t *in,
+                              int32_t length);
+/**< The fastest blending kernel the processor supports. */
+
+static void (*sg_multiply_span) (uint32_t *out,
+                                 const uint32_t *in,
+                                 int32_t length,
+                                 const uint16_t multipliers[3]);
+/**< The fastest multiplying kernel the processor supports. */
+
+
+/* -- STATIC DECLARATIONS -- */
+
+/**
+ * Allocates an image.
+ *
+ * @param width   The width of the image, in pixels.
+ * @param height  The height of the image, in pixels.
+ *
+ * @return  the image, with its pixels uninitialised, or NULL if it
+ *          could not be allocated.
+ */
+static soft_image_t *
+new_soft_image (int32_t width, int32_t height);
+
+
+/**
+ * Frees an image.
+ *
+ * @param image  The image to free, or NULL.
+ */
+static void
+free_soft_image (soft_image_t *image);
+
+
+/**
+ * Finds out how a freshly loaded image uses transparency.
+ *
+ * @param image  The image.
+ *
+ * @return  the kind of transparency the image uses.
+ */
+static image_transparency_t
+classify_image (soft_image_t *image);
+
+
+/**
+ * Clips a rectangle to an image.
+ *
+ * @param image   The image.
+ * @param x       Pointer to the X co-ordinate of the left edge,
+ *                which is updated.
+ * @param y       Pointer to the Y co-ordinate of the top edge, which
+ *                is updated.
+ * @param width   Pointer to the width, which is updated.
+ * @param height  Pointer to the height, which is updated.
+ *
+ * @return  true if any of the rectangle is left; false otherwise.
+ */
+static bool
+clip_rect (soft_image_t *image,
+           int32_t *x,
+           int32_t *y,
+           int32_t *width,
+           int32_t *height);
+
+
+/**
+ * Fills a rectangle of an image with a single pixel value.
+ *
+ * @param image   The image, which the rectangle must lie within.
+ * @param x       X co-ordinate of the left edge of the rectangle.
+ * @param y       Y co-ordinate of the top edge of the rectangle.
+ * @param width   Width of the rectangle, in pixels.
+ * @param height  Height of the rectangle, in pixels.
+ * @param pixel   The pixel value to fill with.
+ */
+static void
+fill_rect (soft_image_t *image,
+           int32_t x,
+           int32_t y,
+           int32_t width,
+           int32_t height,
+           uint32_t pixel);
+
+
+/**
+ * Copies a span of colour-keyed pixels, skipping transparent ones,
+ * one pixel at a time.
+ *
+ * @param out     The first pixel to write.
+ * @param in      The first pixel to read.
+ * @param length  Number of pixels.
+ */
+static void
+copy_keyed_span_scalar (uint32_t *out, const uint32_t *in, int32_t length);
+
+
+/**
+ * Blends a span of pixels over another by their alpha, one pixel at
+ * a time.
+ *
+ * @param out     The first pixel to blend over, which keeps its
+ *                alpha.
+ * @param in      The first pixel to blend.
+ * @param length  Number of pixels.
+ */
+static void
+blend_span_scalar (uint32_t *out, const uint32_t *in, int32_t length);
+
+
+/**
+ * Mixes two pixels' colours.
+ *
+ * @param over    The pixel mixed in.
+ * @param under   The pixel mixed into, whose alpha is kept.
+ * @param amount  Amount of over to mix in, out of MULTIPLIER_ONE.
+ *
+ * @return  the mixed pixel.
+ */
+static uint32_t
+mix_pixel (uint32_t over, uint32_t under, uint32_t amount);
+
+
+/**
+ * Multiplies the colour channels of a span of pixels, one pixel at a
+ * time.
+ *
+ * @param out          The first pixel to write.
+ * @param in           The first pixel to read, which may be out.
+ * @param length       Number of pixels.
+ * @param multipliers  Red, green and blue multipliers, out of
+ *                     MULTIPLIER_ONE.
+ */
+static void
+multiply_span_scalar (uint32_t *out,
+                      const uint32_t *in,
+                      int32_t length,
+                      const uint16_t multipliers[3]);
+
+
+#ifdef PIXEL_SIMD
+/**
+ * Copies a span of colour-keyed pixels, skipping transparent ones,
+ * four pixels at a time, using SSE2.
+ *
+ * @param out     The first pixel to write.
+ * @param in      The first pixel to read.
+ * @param length  Number of pixels.
+ */
+static void __attribute__ ((target ("sse2")))
+copy_keyed_span_sse2 (uint32_t *out, const uint32_t *in, int32_t length);
+
+
+/**
+ * Blends a span of pixels over another by their alpha, four pixels
+ * at a time, using SSE2.
+ *
+ * @param out     The first pixel to blend over, which keeps its
+ *                alpha.
+ * @param in      The first pixel to blend.
+ * @param length  Number of pixels.
+ */
+static void __attribute__ ((target ("sse2")))
+blend_span_sse2 (uint32_t *out, const uint32_t *in, int32_t length);
+
+
+/**
+ * Multiplies the colour channels of a span of pixels, four pixels at
+ * a time, using SSE2.
+ *
+ * @param out          The first pixel to write.
+ * @param in           The first pixel to read, which may be out.
+ * @param length       Number of pixels.
+ * @param multipliers  Red, green and blue multipliers, out of
+ *                     MULTIPLIER_ONE.
+ */
+static void __attribute__ ((target ("sse2")))
+multiply_span_sse2 (uint32_t *out,
+                    const uint32_t *in,
+                    int32_t length,
+                    const uint16_t multipliers[3]);
+#endif /* PIXEL_SIMD */
+
+
+/**
+ * Presents a rectangle of the screen.
+ *
+ * @param rect  The rectangle, in screen co-ordinates.
+ */
+static void
+present_rect (soft_rect_t *rect);
+
+
+/**
+ * Replaces the presented screen with a mosaic of the kept screen or
+ * itself.
+ *
+ * @param progress  How far through the transition to show.
+ */
+static void
+mosaic_presented (uint16_t progress);
+
+
+/* -- DEFINITIONS -- */
+
+/* Initialises the module. */
+EXPORT bool
+init (void)
+{
+  sg_screen = NULL;
+  sg_presented = NULL;
+  sg_target = NULL;
+  sg_transition_from = NULL;
+  sg_num_update_rects = 0;
+  sg_update_full_screen = false;
+  sg_tint[0] = sg_tint[1] = sg_tint[2] = MULTIPLIER_ONE;
+  sg_tinted = false;
+  sg_output_scale = 1;
+  sg_copy_keyed_span = copy_keyed_span_scalar;
+  sg_blend_span = blend_span_scalar;
+  sg_multiply_span = multiply_span_scalar;
+
+  return true;
+}
+
+
+/* Terminates the module, freeing any remaining data dynamically
+   allocated by the module. */
+EXPORT void
+term (void)
+{
+  free_soft_image (sg_transition_from);
+  free_soft_image (sg_presented);
+  free_soft_image (sg_screen);
+
+  sg_transition_from = NULL;
+  sg_presented = NULL;
+  sg_screen = NULL;
+  sg_target = NULL;
+}
+
+
+/* Initialises a screen of a given width, height and depth. */
+EXPORT bool
+init_screen_internal (uint16_t width, uint16_t height, uint8_t depth)
+{
+  /* Everything is 32-bit here, whatever the depth asked for. */
+  (void) depth;
+
+  sg_screen = new_soft_image (width, height);
+  sg_presented = new_soft_image (width, height);
+  if (sg_screen == NULL || sg_presented == NULL)
+    {
+      g_critical ("Couldn't create %ux%u screen!", width, height);
+      return false;
+    }
+
+  fill_rect (sg_screen, 0, 0, width, height, OPAQUE_ALPHA);
+  fill_rect (sg_presented, 0, 0, width, height, OPAQUE_ALPHA);
+
+  /* Pick the fastest kernels this processor can run. */
+  sg_copy_keyed_span = copy_keyed_span_scalar;
+  sg_blend_span = blend_span_scalar;
+  sg_multiply_span = multiply_span_scalar;
+#ifdef PIXEL_SIMD
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("sse2"))
+    {
+      sg_copy_keyed_span = copy_keyed_span_sse2;
+      sg_blend_span = blend_span_sse2;
+      sg_multiply_span = multiply_span_sse2;
+    }
+#endif /* PIXEL_SIMD */
+
+  return true;
+}
+
+
+/* Draws a rectangle of colour on-screen. */
+EXPORT void
+draw_rect_internal (int16_t x,
+                    int16_t y,
+                    uint16_t width,
+                    uint16_t height,
+                    uint8_t red,
+                    uint8_t green,
+                    uint8_t blue)
+{
+  soft_image_t *dest = (sg_target != NULL ? sg_target : sg_screen);
+  int32_t left = x;
+  int32_t top = y;
+  int32_t w = width;
+  int32_t h = height;
+
+  if (!clip_rect (dest, &left, &top, &w, &h))
+    return;
+
+  fill_rect (dest, left, top, w, h,
+             (OPAQUE_ALPHA
+              | ((uint32_t) red << 16)
+              | ((uint32_t) green << 8)
+              | (uint32_t) blue));
+}
+
+
+/* Loads an image and returns its data in the module's native format. */
+EXPORT void *
+load_image_data (const char filename[])
+{
+  FILE *file;
+  png_structp png;
+  png_infop info;
+  soft_image_t *volatile image = NULL;
+  png_bytep *volatile rows = NULL;
+  png_uint_32 width;
+  png_uint_32 height;
+  int colour_type;
+  int bit_depth;
+  bool has_alpha;
+  png_uint_32 y;
+
+  file = fopen (filename, "rb");
+  if (file == NULL)
+    {
+      g_critical ("Couldn't load %s!", filename);
+      return NULL;
+    }
+
+  png = png_create_read_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  info = (png != NULL ? png_create_info_struct (png) : NULL);
+  if (info == NULL)
+    {
+      g_critical ("Couldn't set up to decode %s!", filename);
+      png_destroy_read_struct (&png, NULL, NULL);
+      fclose (file);
+      return NULL;
+    }
+
+  /* libpng jumps back here on any error. */
+  if (setjmp (png_jmpbuf (png)))
+    {
+      g_critical ("Couldn't decode %s!", filename);
+      png_destroy_read_struct (&png, &info, NULL);
+      fclose (file);
+      free (rows);
+      free_soft_image (image);
+      return NULL;
+    }
+
+  png_init_io (png, file);
+  png_read_info (png, info);
+
+  colour_type = png_get_color_type (png, info);
+  bit_depth = png_get_bit_depth (png, info);
+  has_alpha = ((colour_type & PNG_COLOR_MASK_ALPHA)
+               || png_get_valid (png, info, PNG_INFO_tRNS));
+
+  /* Whatever the file holds, have libpng turn it into 8-bit ARGB
+     pixels in native byte order. */
+  if (colour_type == PNG_COLOR_TYPE_PALETTE)
+    png_set_palette_to_rgb (png);
+  if (colour_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
+    png_set_expand_gray_1_2_4_to_8 (png);
+  if (png_get_valid (png, info, PNG_INFO_tRNS))
+    png_set_tRNS_to_alpha (png);
+  if (bit_depth == 16)
+    png_set_strip_16 (png);
+  if (!(colour_type & PNG_COLOR_MASK_COLOR))
+    png_set_gray_to_rgb (png);
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  png_set_bgr (png);
+  if (!has_alpha)
+    png_set_filler (png, 0xFF, PNG_FILLER_AFTER);
+#else
+  png_set_swap_alpha (png);
+  if (!has_alpha)
+    png_set_filler (png, 0xFF, PNG_FILLER_BEFORE);
+#endif
+
+  (void) png_set_interlace_handling (png);
+  png_read_update_info (png, info);
+
+  width = png_get_image_width (png, info);
+  height = png_get_image_height (png, info);
+  if (width > UINT16_MAX || height > UINT16_MAX
+      || png_get_rowbytes (png, info) != width * 4)
+    png_error (png, "unsupported image size or format");
+
+  image = new_soft_image ((int32_t) width, (int32_t) height);
+  rows = calloc (height, sizeof (png_bytep));
+  if (image == NULL || rows == NULL)
+    png_error (png, "out of memory");
+
+  for (y = 0; y < height; y += 1)
+    rows[y] = (png_bytep) (image->pixels + (y * width));
+
+  png_read_image (png, rows);
+  png_read_end (png, NULL);
+
+  png_destroy_read_struct (&png, &info, NULL);
+  fclose (file);
+  free (rows);
+
+  image->transparency = classify_image (image);
+  image->transparent = (image->transparency != IMAGE_OPAQUE);
+  return (void *) image;
+}
+
+
+/* Frees image data retrieved by load_image_data. */
+EXPORT void
+free_image_data (void *data)
+{
+  free_soft_image ((soft_image_t *) data);
+}
+
+
+/* Retrieves the dimensions of an image. */
+EXPORT void
+get_image_dimensions_internal (void *image,
+                               uint16_t *width,
+                               uint16_t *height)
+{
+  soft_image_t *imagec = (soft_image_t *) image;
+
+  g_assert (imagec != NULL);
+
+  *width = (uint16_t) imagec->width;
+  *height = (uint16_t) imagec->height;
+}
+
+
+/* Retrieves the amount of memory an image's pixels take up. */
+EXPORT uint32_t
+get_image_bytes_internal (void *image)
+{
+  soft_image_t *imagec = (soft_image_t *) image;
+
+  g_assert (imagec != NULL);
+
+  return (uint32_t) imagec->width * (uint32_t) imagec->height * 4;
+}
+
+
+/* Draws a rectangular portion of an image on-screen. */
+EXPORT void
+draw_image_internal (void *image,
+                     int16_t image_x,
+                     int16_t image_y,
+                     int16_t screen_x,
+                     int16_t screen_y,
+                     uint16_t width,
+                     uint16_t height)
+{
+  soft_image_t *source = (soft_image_t *) image;
+  soft_image_t *dest = (sg_target != NULL ? sg_target : sg_screen);
+  int32_t sx = image_x;
+  int32_t sy = image_y;
+  int32_t dx = screen_x;
+  int32_t dy = screen_y;
+  int32_t w = width;
+  int32_t h = height;
+  int32_t left;
+  int32_t top;
+  int32_t row;
+
+  g_assert (source != NULL);
+
+  /* Clip to the source, then to the destination, moving the other
+     rectangle's corner in step. */
+  left = sx;
+  top = sy;
+  if (!clip_rect (source, &sx, &sy, &w, &h))
+    return;
+  dx += sx - left;
+  dy += sy - top;
+
+  left = dx;
+  top = dy;
+  if (!clip_rect (dest, &dx, &dy, &w, &h))
+    return;
+  sx += dx - left;
+  sy += dy - top;
+
+  for (row = 0; row < h; row += 1)
+    {
+      uint32_t *out = dest->pixels + ((dy + row) * dest->width) + dx;
+      const uint32_t *in = (source->pixels
+                            + ((sy + row) * source->width) + sx);
+
+      /* Into a transparent image, partly transparent pixels are
+         copied rather than blended, so it keeps their
+         transparency. */
+      if (source->transparency == IMAGE_OPAQUE
+          || (source->transparency == IMAGE_TRANSLUCENT
+              && dest->transparent))
+        memcpy (out, in, (size_t) w * sizeof (uint32_t));
+      else if (source->transparency == IMAGE_KEYED)
+        sg_copy_keyed_span (out, in, w);
+      else
+        sg_blend_span (out, in, w);
+    }
+}
+
+
+/* Draws a batch of drawing commands. */
+EXPORT void
+draw_batch_internal (draw_command_t commands[], uint32_t count)
+{
+  uint32_t i;
+
+  for (i = 0; i < count; i += 1)
+    {
+      draw_command_t *command = &(commands[i]);
+
+      if (command->type == DRAW_COMMAND_IMAGE)
+        draw_image_internal (command->image,
+                             command->image_x,
+                             command->image_y,
+                             command->screen_x,
+                             command->screen_y,
+                             command->width,
+                             command->height);
+      else if (command->type == DRAW_COMMAND_RECT)
+        draw_rect_internal (command->screen_x,
+                            command->screen_y,
+                            command->width,
+                            command->height,
+                            command->red,
+                            command->green,
+                            command->blue);
+    }
+}
+
+
+/* Creates a blank image to draw into. */
+EXPORT void *
+create_image_data (uint16_t width, uint16_t height, bool transparent)
+{
+  soft_image_t *image;
+
+  image = new_soft_image (width, height);
+  if (image == NULL)
+    {
+      g_critical ("Couldn't create %ux%u image!", width, height);
+      return NULL;
+    }
+
+  /* What will be drawn into a transparent image is unknown, so it
+     has to be blended. */
+  image->transparent = transparent;
+  image->transparency = (transparent ? IMAGE_TRANSLUCENT : IMAGE_OPAQUE);
+
+  fill_rect (image, 0, 0, width, height,
+             (transparent ? 0 : OPAQUE_ALPHA));
+  return (void *) image;
+}
+
+
+/* Redirects drawing into an image, or back to the screen. */
+EXPORT void
+set_draw_target_internal (void *image)
+{
+  sg_target = (soft_image_t *) image;
+}
+
+
+/* Draws a rectangular portion of an image, scaled. */
+EXPORT void
+draw_image_scaled_internal (void *image,
+                            int16_t image_x,
+                            int16_t image_y,
+                            uint16_t image_width,
+                            uint16_t image_height,
+                            int16_t screen_x,
+                            int16_t screen_y,
+                            uint16_t width,
+                            uint16_t height)
+{
+  soft_image_t *source = (soft_image_t *) image;
+  soft_image_t *dest = (sg_target != NULL ? sg_target : sg_screen);
+  int32_t left = screen_x;
+  int32_t top = screen_y;
+  int32_t w = width;
+  int32_t h = height;
+  int32_t px;
+  int32_t py;
+
+  g_assert (source != NULL);
+
+  if (width == 0 || height == 0
+      || !clip_rect (dest, &left, &top, &w, &h))
+    return;
+
+  /* Nearest-neighbour sampling; mostly transparent pixels are
+     skipped. */
+  for (py = top; py < top + h; py += 1)
+    {
+      int32_t sy = image_y + (((py - screen_y) * image_height) / height);
+      uint32_t *out = dest->pixels + (py * dest->width);
+
+      if (sy < 0 || sy >= source->height)
+        continue;
+
+      for (px = left; px < left + w; px += 1)
+        {
+          int32_t sx = image_x + (((px - screen_x) * image_width) / width);
+          uint32_t pixel;
+
+          if (sx < 0 || sx >= source->width)
+            continue;
+
+          pixel = source->pixels[(sy * source->width) + sx];
+          if ((pixel >> 24) >= 128)
+            out[px] = (dest->transparent ? pixel : pixel | OPAQUE_ALPHA);
+        }
+    }
+}
+
+
+/* Works out the average colour of a rectangular portion of an
+   image. */
+EXPORT void
+get_image_average_colour_internal (void *image,
+                                   int16_t image_x,
+                                   int16_t image_y,
+                                   uint16_t width,
+                                   uint16_t height,
+                                   uint8_t colour[4])
+{
+  soft_image_t *source = (soft_image_t *) image;
+  int32_t left = image_x;
+  int32_t top = image_y;
+  int32_t w = width;
+  int32_t h = height;
+  uint32_t totals[3] = { 0, 0, 0 };
+  uint32_t opaque = 0;
+  int32_t x;
+  int32_t y;
+
+  g_assert (source != NULL);
+  g_assert (colour != NULL);
+
+  colour[0] = colour[1] = colour[2] = colour[3] = 0;
+
+  if (!clip_rect (source, &left, &top, &w, &h))
+    return;
+
+  for (y = top; y < top + h; y += 1)
+    for (x = left; x < left + w; x += 1)
+      {
+        uint32_t pixel = source->pixels[(y * source->width) + x];
+
+        if ((pixel >> 24) < 128)
+          continue;
+
+        totals[0] += (pixel >> 16) & 0xFF;
+        totals[1] += (pixel >> 8) & 0xFF;
+        totals[2] += pixel & 0xFF;
+        opaque += 1;
+      }
+
+  if (opaque == 0)
+    return;
+
+  colour[0] = (uint8_t) (totals[0] / opaque);
+  colour[1] = (uint8_t) (totals[1] / opaque);
+  colour[2] = (uint8_t) (totals[2] / opaque);
+  colour[3] = (uint8_t) ((opaque * 255) / ((uint32_t) width * height));
+}
+
+
+/* Sets the colour tint applied to the screen as it is presented. */
+EXPORT void
+set_tint_internal (uint8_t red, uint8_t green, uint8_t blue)
+{
+  uint16_t tint[3];
+
+  /* Scale 0-255 to 0-MULTIPLIER_ONE, so that 255 is exactly
+     unchanged. */
+  tint[0] = (uint16_t) (red + (red >> 7));
+  tint[1] = (uint16_t) (green + (green >> 7));
+  tint[2] = (uint16_t) (blue + (blue >> 7));
+
+  if (tint[0] == sg_tint[0]
+      && tint[1] == sg_tint[1]
+      && tint[2] == sg_tint[2])
+    return;
+
+  memcpy (sg_tint, tint, sizeof (sg_tint));
+  sg_tinted = (tint[0] != MULTIPLIER_ONE
+               || tint[1] != MULTIPLIER_ONE
+               || tint[2] != MULTIPLIER_ONE);
+  sg_update_full_screen = true;
+}
+
+
+/* Darkens a rectangle of what has already been drawn. */
+EXPORT void
+shade_rect_internal (int16_t x,
+                     int16_t y,
+                     uint16_t width,
+                     uint16_t height,
+                     uint8_t brightness)
+{
+  soft_image_t *dest = (sg_target != NULL ? sg_target : sg_screen);
+  uint16_t multipliers[3];
+  int32_t left = x;
+  int32_t top = y;
+  int32_t w = width;
+  int32_t h = height;
+  int32_t row;
+
+  if (brightness == 255 || !clip_rect (dest, &left, &top, &w, &h))
+    return;
+
+  multipliers[0] = multipliers[1] = multipliers[2]
+    = (uint16_t) (brightness + (brightness >> 7));
+
+  for (row = top; row < top + h; row += 1)
+    {
+      uint32_t *span = dest->pixels + (row * dest->width) + left;
+
+      sg_multiply_span (span, span, w, multipliers);
+    }
+}
+
+
+/* Adds a rectangle to the next update run. */
+EXPORT void
+add_update_rectangle_internal (int16_t x,
+                               int16_t y,
+                               uint16_t width,
+                               uint16_t height)
+{
+  soft_rect_t *rect;
+
+  if (sg_update_full_screen)
+    return;
+
+  if (sg_num_update_rects == MAX_UPDATE_RECTS)
+    {
+      sg_update_full_screen = true;
+      return;
+    }
+
+  rect = &(sg_update_rects[sg_num_update_rects]);
+  rect->x = x;
+  rect->y = y;
+  rect->width = width;
+  rect->height = height;
+  sg_num_update_rects += 1;
+}
+
+
+/* Updates the screen. */
+EXPORT void
+update_screen_internal (void)
+{
+  uint32_t i;
+
+  if (sg_update_full_screen)
+    {
+      soft_rect_t full;
+
+      full.x = full.y = 0;
+      full.width = sg_screen->width;
+      full.height = sg_screen->height;
+      present_rect (&full);
+    }
+  else
+    for (i = 0; i < sg_num_update_rects; i += 1)
+      present_rect (&(sg_update_rects[i]));
+
+  sg_update_full_screen = false;
+  sg_num_update_rects = 0;
+}
+
+
+/* Translate the screen by a co-ordinate pair, leaving damage. */
+EXPORT void
+scroll_screen_internal (int16_t x_offset, int16_t y_offset)
+{
+  int32_t width = sg_screen->width;
+  int32_t height = sg_screen->height;
+  int32_t columns = width - abs (x_offset);
+  int32_t rows = height - abs (y_offset);
+  int32_t from_x = MAX (-x_offset, 0);
+  int32_t to_x = MAX (x_offset, 0);
+  int32_t i;
+
+  /* The strips uncovered keep stale data, which the caller is
+     expected to redraw. */
+  if (columns > 0 && rows > 0)
+    for (i = 0; i < rows; i += 1)
+      {
+        /* Go against the direction of the move, so no row is
+           overwritten before it is read. */
+        int32_t row = (y_offset > 0 ? rows - 1 - i : i);
+        int32_t from_y = row + MAX (-y_offset, 0);
+        int32_t to_y = row + MAX (y_offset, 0);
+
+        memmove (sg_screen->pixels + (to_y * width) + to_x,
+                 sg_screen->pixels + (from_y * width) + from_x,
+                 (size_t) columns * sizeof (uint32_t));
+      }
+
+  /* The whole screen now needs updating! */
+  sg_update_full_screen = true;
+}
+
+
+/* Keeps the screen as last presented, to transition from. */
+EXPORT bool
+begin_transition_internal (void)
+{
+  size_t bytes;
+
+  end_transition_internal ();
+
+  sg_transition_from = new_soft_image (sg_presented->width,
+                                       sg_presented->height);
+  if (sg_transition_from == NULL)
+    {
+      g_warning ("Could not keep the screen for a transition.");
+      return false;
+    }
+
+  bytes = ((size_t) sg_presented->width * sg_presented->height
+           * sizeof (uint32_t));
+  memcpy (sg_transition_from->pixels, sg_presented->pixels, bytes);
+  return true;
+}
+
+
+/* Updates the whole screen with a mix of the kept screen and what has
+   been drawn since. */
+EXPORT void
+present_transition_internal (transition_type_t type, uint16_t progress)
+{
+  int32_t width = sg_presented->width;
+  int32_t height = sg_presented->height;
+  int32_t x;
+  int32_t y;
+
+  g_assert (sg_transition_from != NULL);
+
+  sg_update_full_screen = true;
+  update_screen_internal ();
+
+  if (progress >= TRANSITION_ONE)
+    return;
+
+  switch (type)
+    {
+    case TRANSITION_WIPE:
+      {
+        /* Cover the unwiped part with the kept screen. */
+        int32_t edge = (width * progress) / TRANSITION_ONE;
+
+        for (y = 0; y < height; y += 1)
+          memcpy (sg_presented->pixels + (y * width) + edge,
+                  sg_transition_from->pixels + (y * width) + edge,
+                  (size_t) (width - edge) * sizeof (uint32_t));
+      }
+      break;
+    case TRANSITION_MOSAIC:
+      mosaic_presented (progress);
+      break;
+    case TRANSITION_FADE:
+    default:
+      {
+        uint32_t amount = (((TRANSITION_ONE - progress) * MULTIPLIER_ONE)
+                           / TRANSITION_ONE);
+
+        for (y = 0; y < height; y += 1)
+          for (x = 0; x < width; x += 1)
+            {
+              uint32_t *pixel = sg_presented->pixels + (y * width) + x;
+
+              *pixel = mix_pixel (sg_transition_from->pixels[(y * width)
+                                                             + x],
+                                  *pixel,
+                                  amount);
+            }
+      }
+      break;
+    }
+}
+
+
+/* Frees the kept screen. */
+EXPORT void
+end_transition_internal (void)
+{
+  if (sg_transition_from == NULL)
+    return;
+
+  free_soft_image (sg_transition_from);
+  sg_transition_from = NULL;
+  sg_update_full_screen = true;
+}
+
+
+/* Presents the screen scaled up by a whole number. */
+EXPORT bool
+set_output_scale_internal (uint8_t scale, output_filter_t filter)
+{
+  g_assert (scale >= 1 && scale <= 4);
+
+  /* There is no window to resize, so the scale only applies to
+     dumped frames. */
+  if (filter != OUTPUT_NEAREST)
+    g_message ("Dumped frames are scaled by repeating pixels.");
+
+  sg_output_scale = scale;
+  return true;
+}
+
+
+/* Writes the screen as last presented to a PNG file. */
+EXPORT bool
+dump_screen_internal (const char filename[])
+{
+  FILE *file;
+  png_structp png;
+  png_infop info;
+  png_bytep volatile row = NULL;
+  int32_t scale = sg_output_scale;
+  int32_t width = sg_presented->width;
+  int32_t height = sg_presented->height;
+  int32_t x;
+  int32_t y;
+  int32_t i;
+
+  file = fopen (filename, "wb");
+  if (file == NULL)
+    {
+      g_warning ("Couldn't open %s to dump the screen to.", filename);
+      return false;
+    }
+
+  png = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  info = (png != NULL ? png_create_info_struct (png) : NULL);
+  if (info == NULL)
+    {
+      g_warning ("Couldn't set up to dump the screen to %s.", filename);
+      png_destroy_write_struct (&png, NULL);
+      fclose (file);
+      return false;
+    }
+
+  /* libpng jumps back here on any error. */
+  if (setjmp (png_jmpbuf (png)))
+    {
+      g_warning ("Couldn't dump the screen to %s.", filename);
+      png_destroy_write_struct (&png, &info);
+      fclose (file);
+      free (row);
+      return false;
+    }
+
+  png_init_io (png, file);
+
+  /* Frames may be dumped every frame, so favour speed over size. */
+  png_set_compression_level (png, 1);
+
+  png_set_IHDR (png, info,
+                (png_uint_32) (width * scale),
+                (png_uint_32) (height * scale),
+                8,
+                PNG_COLOR_TYPE_RGB,
+                PNG_INTERLACE_NONE,
+                PNG_COMPRESSION_TYPE_DEFAULT,
+                PNG_FILTER_TYPE_DEFAULT);
+  png_write_info (png, info);
+
+  row = malloc ((size_t) width * scale * 3);
+  if (row == NULL)
+    png_error (png, "out of memory");
+
+  for (y = 0; y < height; y += 1)
+    {
+      const uint32_t *in = sg_presented->pixels + (y * width);
+      png_bytep out = row;
+
+      for (x = 0; x < width; x += 1)
+        for (i = 0; i < scale; i += 1)
+          {
+            *(out++) = (png_byte) ((in[x] >> 16) & 0xFF);
+            *(out++) = (png_byte) ((in[x] >> 8) & 0xFF);
+            *(out++) = (png_byte) (in[x] & 0xFF);
+          }
+
+      for (i = 0; i < scale; i += 1)
+        png_write_row (png, row);
+    }
+
+  png_write_end (png, NULL);
+  png_destroy_write_struct (&png, &info);
+  fclose (file);
+  free (row);
+
+  return true;
+}
+
+
+/* -- STATIC DEFINITIONS -- */
+
+/* Allocates an image. */
+static soft_image_t *
+new_soft_image (int32_t width, int32_t height)
+{
+  soft_image_t *image;
+
+  image = calloc (1, sizeof (soft_image_t));
+  if (image == NULL)
+    return NULL;
+
+  image->pixels = malloc ((size_t) width * height * sizeof (uint32_t));
+  if (image->pixels == NULL)
+    {
+      free (image);
+      return NULL;
+    }
+
+  image->width = width;
+  image->height = height;
+  image->transparency = IMAGE_OPAQUE;
+  image->transparent = false;
+  return image;
+}
+
+
+/* Frees an image. */
+static void
+free_soft_image (soft_image_t *image)
+{
+  if (image == NULL)
+    return;
+
+  free (image->pixels);
+  free (image);
+}
+
+
+/* Finds out how a freshly loaded image uses transparency. */
+static image_transparency_t
+classify_image (soft_image_t *image)
+{
+  image_transparency_t result = IMAGE_OPAQUE;
+  size_t count = (size_t) image->width * image->height;
+  size_t i;
+
+  for (i = 0; i < count; i += 1)
+    {
+      uint32_t alpha = image->pixels[i] & OPAQUE_ALPHA;
+
+      if (alpha == 0)
+        result = IMAGE_KEYED;
+      else if (alpha != OPAQUE_ALPHA)
+        return IMAGE_TRANSLUCENT;
+    }
+
+  return result;
+}
+
+
+/* Clips a rectangle to an image. */
+static bool
+clip_rect (soft_image_t *image,
+           int32_t *x,
+           int32_t *y,
+           int32_t *width,
+           int32_t *height)
+{
+  int32_t left = MAX (*x, 0);
+  int32_t top = MAX (*y, 0);
+  int32_t right = MIN (*x + *width, image->width);
+  int32_t bottom = MIN (*y + *height, image->height);
+
+  if (right <= left || bottom <= top)
+    return false;
+
+  *x = left;
+  *y = top;
+  *width = right - left;
+  *height = bottom - top;
+  return true;
+}
+
+
+/* Fills a rectangle of an image with a single pixel value. */
+static void
+fill_rect (soft_image_t *image,
+           int32_t x,
+           int32_t y,
+           int32_t width,
+           int32_t height,
+           uint32_t pixel)
+{
+  uint32_t *first = image->pixels + (y * image->width) + x;
+  int32_t i;
+
+  for (i = 0; i < width; i += 1)
+    first[i] = pixel;
+
+  /* The other rows are copies of the first. */
+  for (i = 1; i < height; i += 1)
+    memcpy (first + (i * image->width), first,
+            (size_t) width * sizeof (uint32_t));
+}
+
+
+/* Copies a span of colour-keyed pixels, one pixel at a time. */
+static void
+copy_keyed_span_scalar (uint32_t *out, const uint32_t *in, int32_t length)
+{
+  int32_t i;
+
+  for (i = 0; i < length; i += 1)
+    if (in[i] & OPAQUE_ALPHA)
+      out[i] = in[i];
+}
+
+
+/* Blends a span of pixels over another by their alpha, one pixel at a
+   time. */
+static void
+blend_span_scalar (uint32_t *out, const uint32_t *in, int32_t length)
+{
+  int32_t i;
+
+  for (i = 0; i < length; i += 1)
+    {
+      uint32_t alpha = in[i] >> 24;
+
+      if (alpha == 0xFF)
+        out[i] = in[i] | (out[i] & OPAQUE_ALPHA);
+      else if (alpha != 0)
+        out[i] = mix_pixel (in[i], out[i], alpha + (alpha >> 7));
+    }
+}
+
+
+/* Mixes two pixels' colours. */
+static uint32_t
+mix_pixel (uint32_t over, uint32_t under, uint32_t amount)
+{
+  uint32_t rest = MULTIPLIER_ONE - amount;
+  uint32_t red_blue;
+  uint32_t green;
+
+  /* Red and blue are 16 bits apart, so can be multiplied together
+     without one spilling into the other. */
+  red_blue = ((((over & 0xFF00FF) * amount)
+               + ((under & 0xFF00FF) * rest)) >> 8) & 0xFF00FF;
+  green = ((((over & 0x00FF00) * amount)
+            + ((under & 0x00FF00) * rest)) >> 8) & 0x00FF00;
+
+  return (under & OPAQUE_ALPHA) | red_blue | green;
+}
+
+
+/* Multiplies the colour channels of a span of pixels, one pixel at a
+   time. */
+static void
+multiply_span_scalar (uint32_t *out,
+                      const uint32_t *in,
+                      int32_t length,
+                      const uint16_t multipliers[3])
+{
+  int32_t i;
+
+  for (i = 0; i < length; i += 1)
+    {
+      uint32_t pixel = in[i];
+
+      out[i] = ((pixel & OPAQUE_ALPHA)
+                | (((((pixel >> 16) & 0xFF) * multipliers[0]) >> 8) << 16)
+                | (((((pixel >> 8) & 0xFF) * multipliers[1]) >> 8) << 8)
+                | (((pixel & 0xFF) * multipliers[2]) >> 8));
+    }
+}
+
+
+#ifdef PIXEL_SIMD
+/* Copies a span of colour-keyed pixels, using SSE2. */
+static void
+copy_keyed_span_sse2 (uint32_t *out, const uint32_t *in, int32_t length)
+{
+  __m128i zero = _mm_setzero_si128 ();
+  __m128i alpha = _mm_set1_epi32 ((int) OPAQUE_ALPHA);
+  int32_t i;
+
+  /* Transparent pixels keep what was under them, so each group is
+     merged with the destination rather than stored over it. */
+  for (i = 0; i + 4 <= length; i += 4)
+    {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) (in + i));
+      __m128i under = _mm_loadu_si128 ((__m128i *) (out + i));
+      __m128i clear = _mm_cmpeq_epi32 (_mm_and_si128 (pixels, alpha),
+                                       zero);
+
+      _mm_storeu_si128 ((__m128i *) (out + i),
+                        _mm_or_si128 (_mm_and_si128 (clear, under),
+                                      _mm_andnot_si128 (clear, pixels)));
+    }
+
+  copy_keyed_span_scalar (out + i, in + i, length - i);
+}
+
+
+/* Blends a span of pixels over another by their alpha, using SSE2. */
+static void
+blend_span_sse2 (uint32_t *out, const uint32_t *in, int32_t length)
+{
+  __m128i zero = _mm_setzero_si128 ();
+  __m128i alpha = _mm_set1_epi32 ((int) OPAQUE_ALPHA);
+  __m128i one = _mm_set1_epi16 (MULTIPLIER_ONE);
+  int32_t i;
+
+  for (i = 0; i + 4 <= length; i += 4)
+    {
+      __m128i over = _mm_loadu_si128 ((const __m128i *) (in + i));
+      __m128i under = _mm_loadu_si128 ((__m128i *) (out + i));
+      __m128i over_alpha = _mm_and_si128 (over, alpha);
+      __m128i opaque = _mm_cmpeq_epi32 (over_alpha, alpha);
+      __m128i over_lo;
+      __m128i over_hi;
+      __m128i amount_lo;
+      __m128i amount_hi;
+      __m128i lo;
+      __m128i hi;
+      __m128i mixed;
+
+      /* Sprites are mostly fully transparent, so skip those groups
+         outright. */
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (over_alpha, zero))
+          == 0xFFFF)
+        continue;
+
+      /* Spread each pixel's alpha across its four channels, as the
+         same 0-MULTIPLIER_ONE amount mix_pixel uses.  A fully opaque
+         or fully transparent pixel then mixes to exactly one side. */
+      over_lo = _mm_unpacklo_epi8 (over, zero);
+      over_hi = _mm_unpackhi_epi8 (over, zero);
+      amount_lo = _mm_shufflehi_epi16 (_mm_shufflelo_epi16
+                                       (over_lo, _MM_SHUFFLE (3, 3, 3, 3)),
+                                       _MM_SHUFFLE (3, 3, 3, 3));
+      amount_hi = _mm_shufflehi_epi16 (_mm_shufflelo_epi16
+                                       (over_hi, _MM_SHUFFLE (3, 3, 3, 3)),
+                                       _MM_SHUFFLE (3, 3, 3, 3));
+      amount_lo = _mm_add_epi16 (amount_lo, _mm_srli_epi16 (amount_lo, 7));
+      amount_hi = _mm_add_epi16 (amount_hi, _mm_srli_epi16 (amount_hi, 7));
+
+      /* The two products of each channel sum to at most 255 *
+         MULTIPLIER_ONE, which still fits in 16 unsigned bits. */
+      lo = _mm_add_epi16
+        (_mm_mullo_epi16 (over_lo, amount_lo),
+         _mm_mullo_epi16 (_mm_unpacklo_epi8 (under, zero),
+                          _mm_sub_epi16 (one, amount_lo)));
+      hi = _mm_add_epi16
+        (_mm_mullo_epi16 (over_hi, amount_hi),
+         _mm_mullo_epi16 (_mm_unpackhi_epi8 (under, zero),
+                          _mm_sub_epi16 (one, amount_hi)));
+      mixed = _mm_packus_epi16 (_mm_srli_epi16 (lo, 8),
+                                _mm_srli_epi16 (hi, 8));
+
+      /* As blend_span_scalar, the result keeps the alpha under it,
+         except that fully opaque pixels make it opaque. */
+      _mm_storeu_si128 ((__m128i *) (out + i),
+                        _mm_or_si128
+                        (_mm_andnot_si128 (alpha, mixed),
+                         _mm_and_si128 (_mm_or_si128 (under, opaque),
+                                        alpha)));
+    }
+
+  blend_span_scalar (out + i, in + i, length - i);
+}
+
+
+/* Multiplies the colour channels of a span of pixels, using SSE2. */
+static void
+multiply_span_sse2 (uint32_t *out,
+                    const uint32_t *in,
+                    int32_t length,
+                    const uint16_t multipliers[3])
+{
+  __m128i zero = _mm_setzero_si128 ();
+  /* Pixels are 0xAARRGGBB, so blue is the lowest byte in memory;
+     alpha is multiplied by MULTIPLIER_ONE to keep it as it is. */
+  __m128i factors = _mm_set_epi16 (MULTIPLIER_ONE,
+                                   (short) multipliers[0],
+                                   (short) multipliers[1],
+                                   (short) multipliers[2],
+                                   MULTIPLIER_ONE,
+                                   (short) multipliers[0],
+                                   (short) multipliers[1],
+                                   (short) multipliers[2]);
+  int32_t i;
+
+  /* Widen each byte to 16 bits, multiply, and narrow the high bytes
+     back down.  255 * MULTIPLIER_ONE still fits in 16 bits. */
+  for (i = 0; i + 4 <= length; i += 4)
+    {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) (in + i));
+      __m128i lo = _mm_unpacklo_epi8 (pixels, zero);
+      __m128i hi = _mm_unpackhi_epi8 (pixels, zero);
+
+      lo = _mm_srli_epi16 (_mm_mullo_epi16 (lo, factors), 8);
+      hi = _mm_srli_epi16 (_mm_mullo_epi16 (hi, factors), 8);
+
+      _mm_storeu_si128 ((__m128i *) (out + i),
+                        _mm_packus_epi16 (lo, hi));
+    }
+
+  multiply_span_scalar (out + i, in + i, length - i, multipliers);
+}
+#endif /* PIXEL_SIMD */
+
+
+/* Presents a rectangle of the screen. */
+static void
+present_rect (soft_rect_t *rect)
+{
+  int32_t x = rect->x;
+  int32_t y = rect->y;
+  int32_t width = rect->width;
+  int32_t height = rect->height;
+  int32_t row;
+
+  if (!clip_rect (sg_screen, &x, &y, &width, &height))
+    return;
+
+  for (row = y; row < y + height; row += 1)
+    {
+      uint32_t *out = sg_presented->pixels + (row * sg_screen->width) + x;
+      const uint32_t *in = sg_screen->pixels + (row * sg_screen->width) + x;
+
+      if (sg_tinted)
+        sg_multiply_span (out, in, width, sg_tint);
+      else
+        memcpy (out, in, (size_t) width * sizeof (uint32_t));
+    }
+}
+
+
+/* Replaces the presented screen with a mosaic of the kept screen or
+   itself. */
+static void
+mosaic_presented (uint16_t progress)
+{
+  soft_image_t *source;
+  int32_t distance;
+  int32_t block;
+  int32_t width = sg_presented->width;
+  int32_t height = sg_presented->height;
+  int32_t x0;
+  int32_t y0;
+
+  /* Blocks grow towards the half-way point, where the picture
+     changes over, and shrink after it. */
+  if (progress < TRANSITION_ONE / 2)
+    {
+      source = sg_transition_from;
+      distance = progress;
+    }
+  else
+    {
+      source = sg_presented;
+      distance = TRANSITION_ONE - progress;
+    }
+
+  block = 1 + (((MOSAIC_MAX_BLOCK - 1) * distance * 2) / TRANSITION_ONE);
+
+  if (block == 1 && source == sg_presented)
+    return;
+
+  /* Each block takes its top-left pixel, which is read before the
+     block is written over, so the presented screen can be its own
+     source. */
+  for (y0 = 0; y0 < height; y0 += block)
+    for (x0 = 0; x0 < width; x0 += block)
+      fill_rect (sg_presented, x0, y0,
+                 MIN (block, width - x0),
+                 MIN (block, height - y0),
+                 source->pixels[(y0 * width) + x0]);
+}
@@ -0,0 +1,167 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file     src/pacing.c
+ * @author   agent
+ * @brief    Frame pacing.
+ */
+
+#include "crystals.h"
+
+
+/* -- STATIC GLOBAL VARIABLES -- */
+
+static uint32_t sg_max_frame_skip; /**< Most frames to skip in a
+                                      row. */
+
+static bool sg_adaptive_quality; /**< Whether skipping lowers the
+                                    frame quality. */
+
+static frame_stats_t sg_stats; /**< Counts since start-up. */
+
+static uint32_t sg_window_frames; /**< Frames simulated since the
+                                     quality was last reviewed. */
+
+static uint32_t sg_window_skipped; /**< Of those, frames skipped. */
+
+
+/* -- STATIC DECLARATIONS -- */
+
+/**
+ * Raises or lowers the frame quality according to how many frames
+ * have been skipped lately.
+ */
+static void review_frame_quality (void);
+
+
+/* -- DEFINITIONS -- */
+
+/* Initialises frame pacing. */
+void
+init_pacing (void)
+{
+  int32_t max_frame_skip = cfg_get_int ("gfx", "max_frame_skip",
+                                        g_config);
+
+  sg_max_frame_skip = (uint32_t) MAX (0, max_frame_skip);
+
+  sg_adaptive_quality = (cfg_get_int ("gfx", "adaptive_quality",
+                                      g_config) == 1);
+
+  memset (&sg_stats, 0, sizeof (frame_stats_t));
+  sg_stats.quality = QUALITY_FULL;
+
+  sg_window_frames = 0;
+  sg_window_skipped = 0;
+}
+
+
+/* Takes the whole frames due out of an amount of elapsed time. */
+uint32_t
+take_frame_ticks (uint32_t *useconds)
+{
+  uint32_t ticks;
+
+  g_assert (useconds != NULL);
+
+  ticks = *useconds / USECONDS_PER_FRAME;
+  if (ticks == 0)
+    return 0;
+
+  *useconds %= USECONDS_PER_FRAME;
+
+  if (ticks > sg_max_frame_skip + 1)
+    {
+      sg_stats.frames_dropped += ticks - (sg_max_frame_skip + 1);
+      ticks = sg_max_frame_skip + 1;
+    }
+
+  sg_stats.frames_drawn += 1;
+  sg_stats.frames_skipped += ticks - 1;
+
+  sg_window_frames += ticks;
+  sg_window_skipped += ticks - 1;
+
+  if (sg_window_frames >= FRAMES_PER_SECOND)
+    review_frame_quality ();
+
+  return ticks;
+}
+
+
+/* Gets the current frame quality. */
+frame_quality_t
+get_frame_quality (void)
+{
+  return sg_stats.quality;
+}
+
+
+/* Gets the counts of how frames have been paced. */
+void
+get_frame_stats (frame_stats_t *stats)
+{
+  g_assert (stats != NULL);
+
+  *stats = sg_stats;
+}
+
+
+/* -- STATIC DEFINITIONS -- */
+
+/* Raises or lowers the frame quality. */
+static void
+review_frame_quality (void)
+{
+  if (sg_adaptive_quality)
+    {
+      /* Lower quality if over a quarter of frames went undrawn, and
+         only raise it again once none have, so it does not flap. */
+      if (sg_window_skipped * 4 > sg_window_frames
+          && sg_stats.quality < QUALITY_HALF_ANIMATION)
+        {
+          sg_stats.quality += 1;
+          sg_stats.quality_drops += 1;
+        }
+      else if (sg_window_skipped == 0 && sg_stats.quality > QUALITY_FULL)
+        sg_stats.quality -= 1;
+    }
+
+  sg_window_frames = 0;
+  sg_window_skipped = 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file     src/pacing.h
+ * @author   agent
+ * @brief    Public interface for frame pacing.
+ *
+ * The game is simulated at a steady FRAMES_PER_SECOND.  When a pass
+ * through the main loop takes longer than a frame, the frames it
+ * fell behind by are simulated without being drawn, up to a limit
+ * set by the max_frame_skip key of the gfx group (4 in the shipped
+ * config; 0 draws every frame, and is also used if the key is
+ * missing).  Past that limit, the game slows down instead.
+ *
+ * If the adaptive_quality key of the gfx group is 1, as it is in the
+ * shipped config, frame skipping that goes on for a second or more
+ * also lowers the frame quality, which states can check to leave out
+ * expensive effects.  Quality comes back a step at a time once frames
+ * stop being skipped.
+ */
+
+
+#ifndef _PACING_H
+#define _PACING_H
+
+
+/* -- CONSTANTS -- */
+
+/**
+ * Frame qualities, from best to worst.  Each quality also makes the
+ * savings of the qualities above it.
+ */
+typedef enum frame_quality
+{
+  QUALITY_FULL,           /**< Everything is simulated and drawn. */
+  QUALITY_NO_PARTICLES,   /**< Particle emitters stop emitting
+                             particles on their own. */
+  QUALITY_HALF_ANIMATION  /**< Animations advance every other frame,
+                             halving how often they are redrawn. */
+} frame_quality_t;
+
+
+/* -- STRUCTURES -- */
+
+/**
+ * Counts of how frames have been paced since start-up.
+ */
+typedef struct frame_stats
+{
+  uint32_t frames_drawn;    /**< Frames simulated and drawn. */
+  uint32_t frames_skipped;  /**< Frames simulated but not drawn. */
+  uint32_t frames_dropped;  /**< Frames neither simulated nor drawn,
+                               because the skip limit was reached;
+                               each one slows the game down. */
+  uint32_t quality_drops;   /**< Times the frame quality has been
+                               lowered. */
+  frame_quality_t quality;  /**< The current frame quality. */
+} frame_stats_t;
+
+
+/* -- DECLARATIONS -- */
+
+/**
+ * Initialises frame pacing from the configuration.
+ */
+void init_pacing (void);
+
+
+/**
+ * Takes the whole frames due out of an amount of elapsed time.
+ *
+ * Every frame taken should be simulated, and only the last drawn.
+ * Any frames over the skip limit are dropped.
+ *
+ * @param useconds  Pointer to the elapsed time, in microseconds.  The
+ *                  time taken up by the frames due, or dropped, is
+ *                  subtracted from it.
+ *
+ * @return  the number of frames to simulate, which is 0 if a whole
+ *          frame has not yet elapsed.
+ */
+uint32_t take_frame_ticks (uint32_t *useconds);
+
+
+/**
+ * Gets the current frame quality.
+ *
+ * @return  the current frame quality.
+ */
+frame_quality_t get_frame_quality (void);
+
+
+/**
+ * Gets the counts of how frames have been paced.
+ *
+ * @param stats  Pointer to the structure to fill in.
+ */
+void get_frame_stats (frame_stats_t *stats);
+
+
+#endif /* not _PACING_H */
@@ -52,6 +52,16 @@ static struct state_functions sg_functions = {NULL,
                                               NULL,
                                               NULL};  /**< Function table. */
 
+/** Style of transition between states. */
+static transition_type_t sg_transition_type = TRANSITION_FADE;
+
+/** Length of transition between states, in frames. */
+static uint16_t sg_transition_frames;
+
+/** Whether sg_transition_frames has been chosen, rather than left to
+    default to half a second. */
+static bool sg_transition_chosen = false;
+
 
 /* -- DEFINITIONS -- */
 
@@ -79,6 +89,16 @@ set_state (state_t new_state)
 }
 
 
+/* Choose how the screen changes over when the state changes. */
+void
+set_state_transition (transition_type_t type, uint16_t frames)
+{
+  sg_transition_type = type;
+  sg_transition_frames = frames;
+  sg_transition_chosen = true;
+}
+
+
 /* Process an enqueued state change, if any, and return the current state. */
 state_t
 update_state (void)
@@ -87,6 +107,17 @@ update_state (void)
   if (sg_enqueued_state == STATE_NULL)
     return sg_state;
 
+  /* Keep the outgoing state's last frame to transition from.  There
+     is nothing to keep before the first state, and no point when
+     quitting. */
+  if (sg_state != STATE_NULL && sg_enqueued_state != STATE_QUIT)
+    {
+      if (!sg_transition_chosen)
+        sg_transition_frames = (uint16_t) (FRAMES_PER_SECOND / 2);
+
+      start_transition (sg_transition_type, sg_transition_frames);
+    }
+
   cleanup_state ();
 
   init_state (sg_enqueued_state);
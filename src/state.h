@@ -142,6 +142,21 @@ void
 set_state (state_t new_state);
 
 
+/**
+ * Choose how the screen changes over when the state changes.
+ *
+ * By default, state changes fade over half a second.  Changes to
+ * STATE_QUIT, and the first state entered, always cut over.
+ *
+ * @param type    The style of transition (see graphics.h).
+ * @param frames  The number of frames the transition lasts, or 0 to
+ *                cut over.
+ */
+
+void
+set_state_transition (transition_type_t type, uint16_t frames);
+
+
 /**
  * Process an enqueued state change, if any.
  *
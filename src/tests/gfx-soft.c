@@ -0,0 +1,271 @@
+/*
+ * Crystals (working title)
+ *
+ * Copyright (c) 2026 agent.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   * The names of contributors may not be used to endorse or promote
+ *     products derived from this software without specific prior
+ *     written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * AFOREMENTIONED COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file    src/tests/gfx-soft.c
+ *  @author  agent
+ *  @brief   Smoke test for the headless software graphics module.
+ *
+ *  Loads gfx-soft straight from the module directory, draws a
+ *  rectangle, presents it and dumps the screen, then reads the dump
+ *  back to check the rectangle made it out.  Needs no display, so it
+ *  can run on build servers.
+ */
+
+#include <stdio.h>
+#include <glib.h>
+#include <gmodule.h>
+#include <png.h>
+
+#include "../types.h"
+
+#ifndef MODPATH
+#define MODPATH "src/modules/"
+#endif /* MODPATH */
+
+
+/* -- CONSTANTS -- */
+
+enum
+{
+  SCREEN_WIDTH = 64,   /**< Width of the test screen, in pixels. */
+  SCREEN_HEIGHT = 48,  /**< Height of the test screen, in pixels. */
+
+  RECT_X = 8,          /**< Left edge of the drawn rectangle. */
+  RECT_Y = 16,         /**< Top edge of the drawn rectangle. */
+  RECT_WIDTH = 24,     /**< Width of the drawn rectangle. */
+  RECT_HEIGHT = 12     /**< Height of the drawn rectangle. */
+};
+
+
+/* -- STRUCTURES -- */
+
+/** The parts of gfx-soft the test uses. */
+typedef struct
+{
+  bool (*init) (void);
+  void (*term) (void);
+  bool (*init_screen_internal) (uint16_t width, uint16_t height,
+                                uint8_t depth);
+  void (*draw_rect_internal) (int16_t x, int16_t y,
+                              uint16_t width, uint16_t height,
+                              uint8_t red, uint8_t green, uint8_t blue);
+  void (*add_update_rectangle_internal) (int16_t x, int16_t y,
+                                         uint16_t width, uint16_t height);
+  void (*update_screen_internal) (void);
+  bool (*dump_screen_internal) (const char filename[]);
+} gfx_soft_t;
+
+
+/* -- PROTOTYPES -- */
+
+/** Looks up one function of the module.
+ *
+ *  @param module  The module.
+ *  @param name    Name of the function.
+ *  @param symbol  Pointer to where to store the function.
+ *
+ *  @return  true if the function was found; false otherwise.
+ */
+
+static bool
+get_function (GModule *module, const char name[], gpointer *symbol);
+
+
+/** Reads a screen dump back and checks it shows the rectangle.
+ *
+ *  @param filename  Path of the dump.
+ *
+ *  @return  true if the dump is as expected; false otherwise.
+ */
+
+static bool
+check_dump (const char filename[]);
+
+
+/* -- DEFINITIONS -- */
+
+int
+main (void)
+{
+  GModule *module;
+  gfx_soft_t gfx;
+  char *filename;
+  bool passed;
+
+  module = g_module_open (MODPATH "gfx-soft." G_MODULE_SUFFIX, 0);
+  if (module == NULL)
+    {
+      fprintf (stderr, "gfx-soft: Could not load module: %s\n",
+               g_module_error ());
+      return 1;
+    }
+
+  if (!(get_function (module, "init", (gpointer *) &gfx.init)
+        && get_function (module, "term", (gpointer *) &gfx.term)
+        && get_function (module, "init_screen_internal",
+                         (gpointer *) &gfx.init_screen_internal)
+        && get_function (module, "draw_rect_internal",
+                         (gpointer *) &gfx.draw_rect_internal)
+        && get_function (module, "add_update_rectangle_internal",
+                         (gpointer *) &gfx.add_update_rectangle_internal)
+        && get_function (module, "update_screen_internal",
+                         (gpointer *) &gfx.update_screen_internal)
+        && get_function (module, "dump_screen_internal",
+                         (gpointer *) &gfx.dump_screen_internal))
+      || !(*gfx.init) ()
+      || !(*gfx.init_screen_internal) (SCREEN_WIDTH, SCREEN_HEIGHT, 32))
+    {
+      fprintf (stderr, "gfx-soft: Could not set up the screen.\n");
+      g_module_close (module);
+      return 1;
+    }
+
+  (*gfx.draw_rect_internal) (RECT_X, RECT_Y, RECT_WIDTH, RECT_HEIGHT,
+                             255, 0, 0);
+  (*gfx.add_update_rectangle_internal) (0, 0, SCREEN_WIDTH,
+                                        SCREEN_HEIGHT);
+  (*gfx.update_screen_internal) ();
+
+  filename = g_build_filename (g_get_tmp_dir (),
+                               "crystals-gfx-soft-test.png", NULL);
+
+  passed = ((*gfx.dump_screen_internal) (filename)
+            && check_dump (filename));
+
+  remove (filename);
+  g_free (filename);
+
+  (*gfx.term) ();
+  g_module_close (module);
+
+  printf ("gfx-soft: %s\n", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
+
+
+/* Looks up one function of the module. */
+
+static bool
+get_function (GModule *module, const char name[], gpointer *symbol)
+{
+  if (g_module_symbol (module, name, symbol) && *symbol != NULL)
+    return true;
+
+  fprintf (stderr, "gfx-soft: Module has no %s.\n", name);
+  return false;
+}
+
+
+/* Reads a screen dump back and checks it shows the rectangle. */
+
+static bool
+check_dump (const char filename[])
+{
+  FILE *file;
+  png_structp png;
+  png_infop info;
+  png_byte row[SCREEN_WIDTH * 3];
+  volatile bool passed = true;
+  int x;
+  int y;
+
+  file = fopen (filename, "rb");
+  if (file == NULL)
+    {
+      fprintf (stderr, "gfx-soft: No dump at %s.\n", filename);
+      return false;
+    }
+
+  png = png_create_read_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  info = (png != NULL ? png_create_info_struct (png) : NULL);
+  if (info == NULL)
+    {
+      png_destroy_read_struct (&png, NULL, NULL);
+      fclose (file);
+      return false;
+    }
+
+  /* libpng jumps back here on any error. */
+  if (setjmp (png_jmpbuf (png)))
+    {
+      fprintf (stderr, "gfx-soft: Dump is not a readable PNG.\n");
+      png_destroy_read_struct (&png, &info, NULL);
+      fclose (file);
+      return false;
+    }
+
+  png_init_io (png, file);
+  png_read_info (png, info);
+
+  if (png_get_image_width (png, info) != SCREEN_WIDTH
+      || png_get_image_height (png, info) != SCREEN_HEIGHT
+      || png_get_color_type (png, info) != PNG_COLOR_TYPE_RGB
+      || png_get_bit_depth (png, info) != 8)
+    {
+      fprintf (stderr, "gfx-soft: Dump is not a %dx%d RGB image.\n",
+               SCREEN_WIDTH, SCREEN_HEIGHT);
+      passed = false;
+    }
+
+  /* Inside the rectangle should be red; the rest of the screen was
+     cleared to black. */
+  for (y = 0; passed && y < SCREEN_HEIGHT; y += 1)
+    {
+      png_read_row (png, row, NULL);
+
+      for (x = 0; passed && x < SCREEN_WIDTH; x += 1)
+        {
+          bool inside = (x >= RECT_X && x < RECT_X + RECT_WIDTH
+                         && y >= RECT_Y && y < RECT_Y + RECT_HEIGHT);
+
+          if (row[x * 3] != (inside ? 255 : 0)
+              || row[(x * 3) + 1] != 0
+              || row[(x * 3) + 2] != 0)
+            {
+              fprintf (stderr, "gfx-soft: Wrong colour at %d, %d.\n",
+                       x, y);
+              passed = false;
+            }
+        }
+    }
+
+  png_destroy_read_struct (&png, &info, NULL);
+  fclose (file);
+  return passed;
+}
+
+/* vim: set et ts=2 sw=2 softtabstop=2: */